@@ -0,0 +1,79 @@
+// Arithmetic, comparison and boolean expressions in $project and $group give the same results
+// whether they are evaluated directly or fall back to the expression tree.
+
+var t = db.jstests_agg_compiled_expressions;
+t.drop();
+
+t.insert({_id: 0, a: 2, b: 3, c: {d: 4}});
+t.insert({_id: 1, a: NumberLong(5), b: 2.5});
+t.insert({_id: 2, a: NumberInt(2147483647), b: NumberInt(1)});
+t.insert({_id: 3, b: 1});
+t.insert({_id: 4, a: null, b: 0});
+t.insert({_id: 5, a: new Date(1000), b: 10});
+t.insert({_id: 6, a: 7, b: 0, c: [{d: 1}, {d: 2}]});
+
+var res = t.aggregate({$match: {_id: {$lte: 4}}},
+                      {$sort: {_id: 1}},
+                      {$project: {sum: {$add: ['$a', '$b', 1]},
+                                  pair: {$add: ['$a', '$b']},
+                                  diff: {$subtract: ['$a', '$b']},
+                                  nested: {$multiply: ['$c.d', 2]},
+                                  big: {$and: [{$ne: ['$b', 0]},
+                                               {$gt: [{$divide: ['$a', '$b']}, 1]}]},
+                                  cmp: {$cmp: ['$a', '$b']}}}).toArray();
+assert.eq(5, res.length, tojson(res));
+
+assert.eq(6, res[0].sum);
+assert.eq(-1, res[0].diff);
+assert.eq(8, res[0].nested);
+assert.eq(false, res[0].big);
+assert.eq(-1, res[0].cmp);
+
+assert.eq(8.5, res[1].sum);
+assert.eq(2.5, res[1].diff);
+assert.eq(null, res[1].nested);
+assert.eq(true, res[1].big);
+assert.eq(1, res[1].cmp);
+
+// An int + int that overflows an int is a long.
+assert.eq(NumberLong(2147483648), res[2].pair);
+
+// Missing and null operands give null.
+assert.eq(null, res[3].sum);
+assert.eq(null, res[4].diff);
+assert.eq(false, res[4].big);
+
+// Dates are handled by the expression tree.
+res = t.aggregate({$match: {_id: 5}},
+                  {$project: {sum: {$add: ['$a', '$b', 1]}, diff: {$subtract: ['$a', '$b']}}})
+          .toArray();
+assert.eq(new Date(1011), res[0].sum);
+assert.eq(new Date(990), res[0].diff);
+
+// $and stops at its first false operand, so 7 / 0 is never evaluated.
+res = t.aggregate({$match: {_id: 6}},
+                  {$project: {big: {$and: [{$ne: ['$b', 0]},
+                                           {$gt: [{$divide: ['$a', '$b']}, 1]}]}}}).toArray();
+assert.eq(false, res[0].big);
+
+// Field paths through arrays are handled by the expression tree, and $multiply fails on them like
+// it always has.
+assert.throws(function() {
+    t.aggregate({$match: {_id: 6}}, {$project: {x: {$multiply: ['$c.d', 2]}}}).toArray();
+});
+
+// $group accumulator arguments and _id expressions.
+res = t.aggregate({$match: {_id: {$in: [0, 1, 2]}}},
+                  {$group: {_id: {$gt: ['$b', 2]},
+                            total: {$sum: {$multiply: ['$a', '$b']}},
+                            n: {$sum: 1}}},
+                  {$sort: {_id: 1}}).toArray();
+assert.eq(2, res.length, tojson(res));
+assert.eq(false, res[0]._id);
+assert.eq(1, res[0].n);
+assert.eq(2147483647, res[0].total);
+assert.eq(true, res[1]._id);
+assert.eq(2, res[1].n);
+assert.eq(2 * 3 + 5 * 2.5, res[1].total);
+
+t.drop();
@@ -0,0 +1,76 @@
+// [$sort, $group] where the $group only takes the first or last document of each group is answered
+// with a distinct scan over an index on the sort, and [$sort, $limit] passes its limit to the
+// index scan.
+
+var t = db.jstests_agg_first_per_group;
+t.drop();
+
+for (var a = 0; a < 20; a++) {
+    for (var b = 0; b < 50; b++) {
+        t.insert({a: a, b: (b * 7) % 50, c: a * 100 + b});
+    }
+}
+t.ensureIndex({a: 1, b: 1});
+
+// Returns the winning plan of the initial cursor, or null when sharded.
+function winningPlan(pipeline) {
+    var explain = t.aggregate(pipeline, {explain: true});
+    if (!explain.stages) {
+        return null;
+    }
+    return explain.stages[0].$cursor.queryPlanner.winningPlan;
+}
+
+// The same pipeline behind a $project, which keeps the $sort and $group in the pipeline.
+function unoptimized(pipeline) {
+    return [{$project: {a: 1, b: 1, c: 1}}].concat(pipeline);
+}
+
+function sortById(docs) {
+    return docs.sort(function(x, y) { return x._id - y._id; });
+}
+
+function check(pipeline, expectDistinct) {
+    var plan = winningPlan(pipeline);
+    if (plan) {
+        assert.eq(expectDistinct, /DISTINCT/.test(tojson(plan)), tojson(plan));
+    }
+    assert.eq(sortById(t.aggregate(unoptimized(pipeline)).toArray()),
+              sortById(t.aggregate(pipeline).toArray()));
+}
+
+check([{$sort: {a: 1, b: 1}}, {$group: {_id: '$a', b: {$first: '$b'}, c: {$first: '$c'}}}],
+      true);
+check([{$sort: {a: 1, b: -1}}, {$group: {_id: '$a', b: {$first: '$b'}}}], false);
+check([{$sort: {a: -1, b: -1}}, {$group: {_id: '$a', b: {$first: '$b'}}}], true);
+check([{$sort: {a: 1, b: 1}}, {$group: {_id: '$a', b: {$last: '$b'}, c: {$last: '$c'}}}], true);
+check([{$sort: {a: 1}}, {$group: {_id: '$a'}}], true);
+
+// Mixing $first and $last, or other accumulators, needs every document.
+check([{$sort: {a: 1, b: 1}}, {$group: {_id: '$a', x: {$first: '$b'}, y: {$last: '$b'}}}],
+      false);
+check([{$sort: {a: 1, b: 1}}, {$group: {_id: '$a', x: {$first: '$b'}, n: {$sum: 1}}}], false);
+
+// A predicate on the index keys is applied before skipping. One on another field is not.
+check([{$match: {a: {$gte: 5}, b: {$gt: 10}}},
+       {$sort: {a: 1, b: 1}},
+       {$group: {_id: '$a', b: {$first: '$b'}, c: {$first: '$c'}}}],
+      true);
+check([{$match: {c: {$mod: [3, 0]}}},
+       {$sort: {a: 1, b: 1}},
+       {$group: {_id: '$a', b: {$first: '$b'}, c: {$first: '$c'}}}],
+      false);
+
+// $sort and $limit scan only as far as the limit.
+var limited = [{$sort: {a: 1, b: 1}}, {$limit: 5}];
+var plan = winningPlan(limited);
+if (plan) {
+    assert(/LIMIT/.test(tojson(plan)), tojson(plan));
+}
+assert.eq(t.aggregate(unoptimized(limited)).toArray(), t.aggregate(limited).toArray());
+
+// A multikey index may not order whole arrays, so it is not distinct scanned.
+t.insert({a: [1, 30], b: 0, c: -1});
+check([{$sort: {a: 1, b: 1}}, {$group: {_id: '$a', c: {$first: '$c'}}}], false);
+
+t.drop();
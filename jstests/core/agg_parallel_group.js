@@ -0,0 +1,71 @@
+// $group with its input hash-partitioned across worker threads gives the same groups as the
+// single-threaded $group, including when the partitions spill to disk.
+
+var t = db.jstests_agg_parallel_group;
+t.drop();
+
+function setGroupThreads(n) {
+    var res = db.adminCommand({setParameter: 1, internalDocumentSourceGroupThreads: n});
+    assert.commandWorked(res);
+    return res.was;
+}
+
+function sortedGroups(pipeline, options) {
+    return t.aggregate(pipeline, options).toArray().sort(function(a, b) {
+        return a._id < b._id ? -1 : (a._id > b._id ? 1 : 0);
+    });
+}
+
+for (var i = 0; i < 10000; i++) {
+    t.insert({a: i % 97, b: i, c: "v" + (i % 13)});
+}
+
+var pipeline = [{$group: {_id: '$a',
+                          n: {$sum: 1},
+                          total: {$sum: '$b'},
+                          low: {$min: '$b'},
+                          values: {$addToSet: '$c'}}}];
+
+var oldThreads = setGroupThreads(0);
+var serial = sortedGroups(pipeline);
+assert.eq(97, serial.length);
+
+setGroupThreads(4);
+var parallel = sortedGroups(pipeline);
+assert.eq(serial.length, parallel.length);
+for (var i = 0; i < serial.length; i++) {
+    assert.eq(serial[i]._id, parallel[i]._id);
+    assert.eq(serial[i].n, parallel[i].n);
+    assert.eq(serial[i].total, parallel[i].total);
+    assert.eq(serial[i].low, parallel[i].low);
+    assert.eq(serial[i].values.sort(), parallel[i].values.sort());
+}
+
+// Explain shows how many partitions the $group uses.  Sharded explain output has no 'stages'.
+var explain = t.aggregate(pipeline, {explain: true});
+if (explain.stages) {
+    var groupStage = null;
+    for (var i = 0; i < explain.stages.length; i++) {
+        if (explain.stages[i].$group) {
+            groupStage = explain.stages[i];
+        }
+    }
+    assert(groupStage, tojson(explain));
+    assert.eq(4, groupStage.numPartitions, tojson(explain));
+}
+
+// Each of the 4 partitions gets a quarter of the 100MB $group limit, so 40MB of distinct _ids
+// makes them spill.
+t.drop();
+var bigStr = Array(1024 * 1024 + 1).toString(); // 1MB of ','
+for (var i = 0; i < 40; i++) {
+    t.insert({_id: i, bigStr: i + bigStr});
+}
+var bigPipeline = [{$group: {_id: '$_id', bigStr: {$first: '$bigStr'}}}];
+var res = t.runCommand('aggregate', {pipeline: bigPipeline});
+assert.commandFailed(res);
+assert.eq(16945, res.code);
+assert.eq(40, t.aggregate(bigPipeline, {allowDiskUse: true}).itcount());
+
+setGroupThreads(oldThreads);
+t.drop();
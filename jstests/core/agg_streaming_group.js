@@ -0,0 +1,69 @@
+// $group streams its output when its input is sorted by the fields of its _id.
+
+var t = db.jstests_agg_streaming_group;
+t.drop();
+
+for (var i = 0; i < 100; i++) {
+    t.insert({_id: i, k: i % 7, v: i});
+}
+t.ensureIndex({k: 1});
+
+// Returns whether the $group of an unsharded pipeline streams, and undefined when sharded since
+// the $group then runs in the merger.
+function isStreaming(pipeline) {
+    var explain = t.aggregate(pipeline, {explain: true});
+    if (!explain.stages) {
+        return undefined;
+    }
+    for (var i = 0; i < explain.stages.length; i++) {
+        if (explain.stages[i].$group) {
+            return explain.stages[i].streaming === true;
+        }
+    }
+    assert(false, tojson(explain));
+}
+
+function check(pipeline, expectStreaming) {
+    var streaming = isStreaming(pipeline);
+    assert(streaming === undefined || streaming === expectStreaming, tojson(pipeline));
+
+    var res = t.aggregate(pipeline).toArray();
+    var expected = {};
+    for (var i = 0; i < 100; i++) {
+        var k = i % 7;
+        expected[k] = (expected[k] || 0) + i;
+    }
+    assert.eq(7, res.length, tojson(res));
+    res.forEach(function(doc) {
+        assert.eq(expected[doc._id], doc.total, tojson(doc));
+    });
+}
+
+// The sort is provided by the index on k.
+check([{$sort: {k: 1}}, {$group: {_id: '$k', total: {$sum: '$v'}}}], true);
+check([{$sort: {k: -1}}, {$group: {_id: '$k', total: {$sum: '$v'}}}], true);
+
+// The sort runs in the pipeline.
+check([{$project: {k: 1, v: 1}}, {$sort: {k: 1}}, {$group: {_id: '$k', total: {$sum: '$v'}}}],
+      true);
+
+// Input not ordered by the _id.
+check([{$sort: {v: 1}}, {$group: {_id: '$k', total: {$sum: '$v'}}}], false);
+
+// Once the index on k is multikey, it orders documents by array element, so documents holding
+// equal arrays can be apart. The $group then hashes its input.
+t.drop();
+t.insert({_id: 0, k: [1, 5]});
+t.insert({_id: 1, k: 3});
+t.insert({_id: 2, k: [1, 5]});
+t.insert({_id: 3, k: 1});
+t.ensureIndex({k: 1});
+var pipeline = [{$sort: {k: 1}}, {$group: {_id: '$k', n: {$sum: 1}}}];
+assert.neq(true, isStreaming(pipeline));
+var res = t.aggregate(pipeline).toArray();
+assert.eq(3, res.length, tojson(res));
+res.forEach(function(doc) {
+    assert.eq(tojson(doc._id) == tojson([1, 5]) ? 2 : 1, doc.n, tojson(doc));
+});
+
+t.drop();
@@ -0,0 +1,49 @@
+// Count and distinct with predicates on any field of a compound index are answered from the index
+// keys alone.
+
+var collName = "jstests_count_distinct_covered";
+var t = db[collName];
+t.drop();
+
+t.ensureIndex({a: 1, b: 1, c: 1});
+for (var a = 0; a < 5; a++) {
+    for (var b = 0; b < 4; b++) {
+        for (var c = 0; c < 10; c++) {
+            t.insert({a: a, b: b, c: c, d: c});
+        }
+    }
+}
+
+// Count with a predicate on a later field of the index, which is not a single interval.
+var query = {a: {$gte: 1}, c: {$in: [2, 7]}};
+assert.eq(32, t.count(query));
+var explain = db.runCommand({explain: {count: collName, query: query},
+                             verbosity: "executionStats"});
+assert.eq(32, explain.executionStats.executionStages.nCounted);
+assert.eq(0, explain.executionStats.totalDocsExamined);
+
+// A predicate on a field outside the index still has to fetch.
+query = {a: {$gte: 1}, d: 7};
+assert.eq(16, t.count(query));
+explain = db.runCommand({explain: {count: collName, query: query},
+                         verbosity: "executionStats"});
+assert.eq(16, explain.executionStats.executionStages.nCounted);
+assert.lt(0, explain.executionStats.totalDocsExamined);
+
+// Distinct over a non-leading field, with a filter on another field of the index.
+var res = t.runCommand("distinct", {key: "b", query: {a: {$gt: 2}, c: 7}});
+assert.eq([0, 1, 2, 3], res.values.sort());
+assert.eq(0, res.stats.nscannedObjects);
+assert(/DISTINCT/.test(res.stats.planSummary), tojson(res.stats));
+
+// Distinct over the leading field with a filter on a later field.
+res = t.runCommand("distinct", {key: "a", query: {a: {$gte: 0}, c: 9}});
+assert.eq([0, 1, 2, 3, 4], res.values.sort());
+assert.eq(0, res.stats.nscannedObjects);
+assert(/DISTINCT/.test(res.stats.planSummary), tojson(res.stats));
+
+// Distinct over a non-leading field without a query skips through the whole index.
+res = t.runCommand("distinct", {key: "c"});
+assert.eq(10, res.values.length);
+assert.eq(0, res.stats.nscannedObjects);
+assert(/DISTINCT/.test(res.stats.planSummary), tojson(res.stats));
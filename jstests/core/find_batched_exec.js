@@ -0,0 +1,53 @@
+// With internalQueryExecBatched on, finds pull results out of their plan a batch at a time.  They
+// must return the same results as unbatched finds, including across getMore and deletions.
+var t = db.jstests_find_batched_exec;
+t.drop();
+
+t.ensureIndex({a: 1});
+for (var i = 0; i < 500; i++) {
+    t.insert({_id: i, a: i % 50});
+}
+
+function runQueries() {
+    return {
+        all: t.find().sort({_id: 1}).toArray(),
+        filtered: t.find({a: {$gte: 10, $lt: 20}}, {_id: 1}).sort({_id: 1}).toArray(),
+        limited: t.find({a: 3}).limit(4).toArray().length,
+        skipped: t.find().skip(480).itcount()
+    };
+}
+
+var expected = runQueries();
+assert.eq(500, expected.all.length);
+assert.eq(100, expected.filtered.length);
+assert.eq(4, expected.limited);
+assert.eq(20, expected.skipped);
+
+assert.commandWorked(db.adminCommand({setParameter: 1, internalQueryExecBatched: true}));
+try {
+    assert.eq(expected, runQueries());
+
+    // Deleting documents while results are buffered between getMores neither loses the
+    // documents that remain nor returns any document twice.
+    var cursor = t.find({a: {$lt: 25}}).batchSize(10);
+    var seen = {};
+    var remaining = 0;
+    function take(doc) {
+        assert(!seen[doc._id], tojson(doc));
+        seen[doc._id] = true;
+        if (doc.a < 5) {
+            remaining++;
+        }
+    }
+    for (var n = 0; n < 10; n++) {
+        take(cursor.next());
+    }
+    assert.writeOK(t.remove({a: {$gte: 5, $lt: 25}}));
+    while (cursor.hasNext()) {
+        take(cursor.next());
+    }
+    assert.eq(50, remaining);
+}
+finally {
+    assert.commandWorked(db.adminCommand({setParameter: 1, internalQueryExecBatched: false}));
+}
@@ -0,0 +1,39 @@
+// A query on a non-leading field of a compound index skip-scans the index when its leading field
+// has few distinct values and internalQueryPlannerEnableIndexSkipScan is on.
+load("jstests/libs/analyze_plan.js");
+
+var t = db.jstests_index_skip_scan;
+t.drop();
+
+t.ensureIndex({tenant: 1, ts: 1});
+for (var tenant = 0; tenant < 3; tenant++) {
+    for (var ts = 0; ts < 2000; ts++) {
+        t.insert({tenant: tenant, ts: ts});
+    }
+}
+
+var query = {ts: {$gte: 100, $lt: 105}};
+assert.eq(15, t.find(query).itcount());
+
+// Without the knob, which is off by default, the query scans the collection.
+var explain = t.find({ts: 200}).explain();
+assert(isCollscan(explain.queryPlanner.winningPlan), tojson(explain));
+
+assert.commandWorked(db.adminCommand({setParameter: 1,
+                                      internalQueryPlannerEnableIndexSkipScan: true}));
+try {
+    explain = t.find(query).explain("executionStats");
+    assert(isIxscan(explain.queryPlanner.winningPlan), "skip scan should beat the collection scan");
+    assert.eq(15, explain.executionStats.nReturned);
+    assert.gt(100, explain.executionStats.totalKeysExamined);
+
+    // The results are in (tenant, ts) order.
+    var results = t.find(query, {_id: 0}).toArray();
+    for (var i = 0; i < results.length; i++) {
+        assert.eq({tenant: Math.floor(i / 5), ts: 100 + (i % 5)}, results[i]);
+    }
+}
+finally {
+    assert.commandWorked(db.adminCommand({setParameter: 1,
+                                          internalQueryPlannerEnableIndexSkipScan: false}));
+}
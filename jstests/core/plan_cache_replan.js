@@ -0,0 +1,51 @@
+// A cached plan which does much worse than it did when it was cached is replanned, and the
+// replan shows up in the planCacheListPlans counters.
+
+var t = db.jstests_plan_cache_replan;
+t.drop();
+
+// With {a: 1, b: 399} the {a: 1} index has to look at 400 documents to find the one that
+// matches, while the {b: 1} index finds it straight away.
+for (var i = 0; i < 400; i++) {
+    t.save({a: 1, b: i});
+}
+for (var i = 0; i < 100; i++) {
+    t.save({a: 2 + i, b: 0});
+}
+
+// Creating the indexes clears the plan cache.
+t.ensureIndex({a: 1});
+t.ensureIndex({b: 1});
+
+function getCounters(query) {
+    var res = t.runCommand('planCacheListPlans', {query: query});
+    assert.commandWorked(res);
+    assert(res.hasOwnProperty('counters'), 'counters missing from planCacheListPlans result');
+    return res.counters;
+}
+
+var before = getCounters({a: 5, b: 0});
+assert.eq(0, before.replans, tojson(before));
+
+// {a: 1} wins for this query, and is cached having done very little work.
+assert.eq(1, t.find({a: 5, b: 0}).itcount());
+assert.gt(t.getPlanCache().getPlansByQuery({a: 5, b: 0}).length, 0,
+          'query shape should have been cached');
+
+// The same shape with values for which the cached plan is a bad choice.
+assert.eq(1, t.find({a: 1, b: 399}).itcount());
+
+var after = getCounters({a: 5, b: 0});
+assert.eq(1, after.replans, tojson(after));
+assert.eq(1, after.evictions.replanned, tojson(after));
+
+// Replanning cached the new winner in place of the old one.
+var plans = t.getPlanCache().getPlansByQuery({a: 5, b: 0});
+assert.gt(plans.length, 0, 'replanned query should have been cached again');
+
+// The replan ratio must be positive.
+[0, -1].forEach(function(ratio) {
+    assert.commandFailed(db.adminCommand({setParameter: 1, internalQueryCacheReplanRatio: ratio}));
+});
+assert.eq(10, db.adminCommand({getParameter: 1,
+                               internalQueryCacheReplanRatio: 1}).internalQueryCacheReplanRatio);
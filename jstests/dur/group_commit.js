@@ -0,0 +1,48 @@
+// Test that j:true writers are acknowledged through explicit group commits when
+// journalGroupCommit is enabled, and that the batching metrics are reported.
+
+var testname = "dur_group_commit";
+var path = MongoRunner.dataPath + testname;
+
+var conn = startMongodEmpty("--port", 30001, "--dbpath", path, "--dur",
+                            "--journalCommitInterval", "300",
+                            "--setParameter", "journalGroupCommit=true");
+var db = conn.getDB("test");
+
+function wakeStats() {
+    var dur = db.serverStatus().dur;
+    assert(dur.groupCommitWake.enabled, tojson(dur));
+    return dur.groupCommitWake;
+}
+
+// Every j:true write is acknowledged through a group commit ticket rather than by waiting out the
+// 300ms commit interval.
+var before = wakeStats();
+for (var i = 0; i < 50; i++) {
+    db.foo.insert({_id: i});
+    var res = db.runCommand({getlasterror: 1, j: true});
+    assert.isnull(res.err, tojson(res));
+}
+var after = wakeStats();
+assert.eq(50, after.writersWoken - before.writersWoken, tojson(after));
+
+// Concurrent writers share commits: fewer commits acknowledge writers than there are writers.
+before = after;
+var shells = [];
+for (var i = 0; i < 4; i++) {
+    shells.push(startParallelShell(
+        "for (var j = 0; j < 100; j++) {" +
+        "    db.bar.insert({x: j});" +
+        "    assert.isnull(db.runCommand({getlasterror: 1, j: true}).err);" +
+        "}", 30001));
+}
+shells.forEach(function(join) { join(); });
+assert.eq(400, db.bar.count());
+
+after = wakeStats();
+var woken = after.writersWoken - before.writersWoken;
+assert.eq(400, woken, tojson(after));
+assert.lt(after.commitsWithWaiters - before.commitsWithWaiters, woken, tojson(after));
+
+stopMongod(30001);
+print(testname + " SUCCESS");
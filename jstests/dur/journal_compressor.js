@@ -0,0 +1,49 @@
+// Test that journal files written with each journalCompressor are recovered after a crash,
+// including sections large enough to be compressed as several frames with snappyFramed.
+
+var testname = "dur_journal_compressor";
+var path = MongoRunner.dataPath + testname;
+
+function runTest(compressor) {
+    jsTest.log("Testing journalCompressor=" + compressor);
+
+    var conn = startMongodEmpty("--port", 30001, "--dbpath", path, "--dur", "--smallfiles",
+                                "--setParameter", "journalCompressor=" + compressor);
+    var db = conn.getDB("test");
+    assert.eq(compressor, db.adminCommand({getParameter: 1, journalCompressor: 1}).journalCompressor);
+
+    // Small commits.
+    for (var i = 0; i < 20; i++) {
+        db.foo.insert({_id: i});
+        assert.isnull(db.runCommand({getlasterror: 1, j: true}).err);
+    }
+
+    // A commit of several MB, which spans more than one compression frame.
+    var big = new Array(64 * 1024).join("x");
+    for (var i = 0; i < 100; i++) {
+        db.bar.insert({_id: i, s: big, n: Math.random()});
+    }
+    assert.isnull(db.runCommand({getlasterror: 1, j: true}).err);
+
+    stopMongod(30001, /*signal*/9);
+
+    conn = startMongodNoReset("--port", 30001, "--dbpath", path, "--dur", "--smallfiles");
+    db = conn.getDB("test");
+    assert.eq(20, db.foo.count());
+    assert.eq(100, db.bar.count());
+    assert.eq(big, db.bar.findOne({_id: 57}).s);
+    assert(db.bar.validate(true).valid);
+    stopMongod(30001);
+}
+
+runTest("snappy");
+runTest("snappyFramed");
+runTest("none");
+
+// The default is the format that older versions can recover.
+var conn = startMongodEmpty("--port", 30001, "--dbpath", path, "--dur", "--smallfiles");
+assert.eq("snappy", conn.getDB("admin").runCommand({getParameter: 1, journalCompressor: 1})
+                                       .journalCompressor);
+stopMongod(30001);
+
+print(testname + " SUCCESS");
@@ -0,0 +1,48 @@
+// Replay the same journal with serial and parallel recovery and check that both produce the same
+// data.
+
+var testname = "dur_recover_parallel";
+var path = MongoRunner.dataPath + testname;
+var serialPath = MongoRunner.dataPath + testname + "_serial";
+
+// Build a journal that needs replaying. --syncdelay 0 keeps the data files from being flushed,
+// so everything must come back from the journal.
+var conn = startMongodEmpty("--port", 30001, "--dbpath", path, "--dur", "--smallfiles",
+                            "--syncdelay", 0);
+var db = conn.getDB("test");
+
+var pad = new Array(512).join("p");
+for (var i = 0; i < 50000; i++) {
+    db.foo.insert({_id: i, x: i % 100, pad: pad});
+}
+db.foo.ensureIndex({x: 1});
+// Overlapping writes to the same documents, so ordering matters.
+for (var i = 0; i < 20; i++) {
+    db.foo.update({}, {$inc: {n: 1}}, {multi: true});
+}
+db.foo.remove({x: {$lt: 10}});
+assert.isnull(db.runCommand({getlasterror: 1, j: true}).err);
+
+var expectedCount = db.foo.count();
+var expectedSum = db.foo.aggregate({$group: {_id: null, n: {$sum: "$n"}}}).toArray()[0].n;
+
+stopMongod(30001, /*signal*/9);
+copyDbpath(path, serialPath);
+
+function recover(dbpath, threads) {
+    var conn = startMongodNoReset("--port", 30001, "--dbpath", dbpath, "--dur", "--smallfiles",
+                                  "--setParameter", "journalRecoveryThreads=" + threads);
+    var db = conn.getDB("test");
+    assert.eq(threads, db.adminCommand({getParameter: 1, journalRecoveryThreads: 1})
+                         .journalRecoveryThreads);
+    assert.eq(expectedCount, db.foo.count());
+    assert.eq(expectedCount, db.foo.find().hint({x: 1}).itcount());
+    assert.eq(expectedSum, db.foo.aggregate({$group: {_id: null, n: {$sum: "$n"}}}).toArray()[0].n);
+    assert(db.foo.validate(true).valid);
+    stopMongod(30001);
+}
+
+recover(serialPath, 1);
+recover(path, 4);
+
+print(testname + " SUCCESS");
@@ -0,0 +1,57 @@
+// Check that collections created with compressRecords store less data and otherwise behave like
+// any other collection.
+
+var plain = db.compress_records_plain;
+var packed = db.compress_records;
+plain.drop();
+packed.drop();
+
+assert.commandWorked( db.createCollection( packed.getName(), { compressRecords : true } ) );
+assert.commandFailed( db.runCommand( { create : "compress_records_capped", capped : true,
+                                       size : 100000, compressRecords : true } ) );
+
+var text = new Array( 50 ).join( "the quick brown fox jumps over the lazy dog. " );
+for ( var i = 0; i < 5000; i++ ) {
+    plain.insert( { _id : i, x : i % 10, text : text } );
+    packed.insert( { _id : i, x : i % 10, text : text } );
+}
+packed.ensureIndex( { x : 1 } );
+
+var stats = packed.stats();
+assert( stats.compressRecords, tojson( stats ) );
+assert.lt( stats.size, plain.stats().size / 4, tojson( stats ) );
+
+function check() {
+    assert.eq( plain.count(), packed.count() );
+    assert.eq( plain.find( { x : 3 } ).itcount(), packed.find( { x : 3 } ).hint( { x : 1 } ).itcount() );
+    assert.eq( plain.findOne( { _id : 4321 } ), packed.findOne( { _id : 4321 } ) );
+    assert( packed.validate( true ).valid );
+}
+
+check();
+
+// Updates that would be in place for plain records rewrite the document.
+plain.update( {}, { $inc : { n : 1 } }, { multi : true } );
+packed.update( {}, { $inc : { n : 1 } }, { multi : true } );
+// Growing documents may have to move.
+plain.update( { x : 5 }, { $set : { more : text + text } }, { multi : true } );
+packed.update( { x : 5 }, { $set : { more : text + text } }, { multi : true } );
+plain.remove( { x : 7 } );
+packed.remove( { x : 7 } );
+check();
+
+// Updates that change nothing don't rewrite the document.
+var res = packed.update( { _id : 4321 }, { $set : { x : 1 } } );
+assert.eq( 1, res.nMatched, tojson( res ) );
+assert.eq( 0, res.nModified, tojson( res ) );
+
+assert.commandWorked( packed.runCommand( "compact" ) );
+check();
+
+// The option survives renaming the collection.
+assert.commandWorked( db.adminCommand( { renameCollection : packed.getFullName(),
+                                         to : packed.getFullName() + "_renamed" } ) );
+assert( db.compress_records_renamed.stats().compressRecords );
+
+db.compress_records_renamed.drop();
+plain.drop();
@@ -30,6 +30,8 @@ function setAndCheckParameter(dbConn, parameterName, newValue, expectedResult) {
 setAndCheckParameter(dbConn, "logLevel", 1);
 setAndCheckParameter(dbConn, "logLevel", 1.5, 1);
 setAndCheckParameter(dbConn, "journalCommitInterval", 100);
+setAndCheckParameter(dbConn, "journalGroupCommit", true);
+setAndCheckParameter(dbConn, "journalGroupCommit", false);
 setAndCheckParameter(dbConn, "traceExceptions", true);
 setAndCheckParameter(dbConn, "traceExceptions", false);
 setAndCheckParameter(dbConn, "traceExceptions", 1, true);
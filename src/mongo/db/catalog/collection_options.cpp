@@ -57,6 +57,7 @@ namespace mongo {
         flags = 0;
         flagsSet = false;
         temp = false;
+        compressRecords = false;
     }
 
     Status CollectionOptions::parse( const BSONObj& options ) {
@@ -118,8 +119,15 @@ namespace mongo {
             else if ( fieldName == "temp" ) {
                 temp = e.trueValue();
             }
+            else if ( fieldName == "compressRecords" ) {
+                compressRecords = e.trueValue();
+            }
         }
 
+        if ( capped && compressRecords )
+            return Status( ErrorCodes::BadValue,
+                           "compressRecords is not supported for capped collections" );
+
         return Status::OK();
     }
 
@@ -147,6 +155,9 @@ namespace mongo {
         if ( temp )
             b.appendBool( "temp", true );
 
+        if ( compressRecords )
+            b.appendBool( "compressRecords", true );
+
         return b.obj();
     }
 
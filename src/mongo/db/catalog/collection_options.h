@@ -72,6 +72,9 @@ namespace mongo {
         bool flagsSet;
 
         bool temp;
+
+        // store records compressed, if the storage engine supports it; not for capped collections
+        bool compressRecords;
     };
 
 }
@@ -53,6 +53,16 @@ namespace mongo {
         options.setNoIdIndex();
         options.flags = 5;
         checkRoundTrip( options );
+
+        options.capped = false;
+        options.compressRecords = true;
+        checkRoundTrip( options );
+    }
+
+    TEST( CollectionOptions, ErrorCappedCompressRecords ) {
+        ASSERT_NOT_OK( CollectionOptions().parse( fromjson( "{capped: true, size: 1024, "
+                                                            "compressRecords: true}" ) ) );
+        ASSERT_OK( CollectionOptions().parse( fromjson( "{capped: false, compressRecords: true}" ) ) );
     }
 
     TEST( CollectionOptions, ErrorBadSize ) {
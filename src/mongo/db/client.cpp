@@ -382,6 +382,8 @@ namespace mongo {
         nscannedObjects = -1;
         idhack = false;
         scanAndOrder = false;
+        sortMemUsage = -1;
+        sortUsedDisk = false;
         nMatched = -1;
         nModified = -1;
         ninserted = -1;
@@ -452,6 +454,8 @@ namespace mongo {
         OPDEBUG_TOSTRING_HELP( nscannedObjects );
         OPDEBUG_TOSTRING_HELP_BOOL( idhack );
         OPDEBUG_TOSTRING_HELP_BOOL( scanAndOrder );
+        OPDEBUG_TOSTRING_HELP( sortMemUsage );
+        OPDEBUG_TOSTRING_HELP_BOOL( sortUsedDisk );
         OPDEBUG_TOSTRING_HELP( nmoved );
         OPDEBUG_TOSTRING_HELP( nMatched );
         OPDEBUG_TOSTRING_HELP( nModified );
@@ -545,6 +549,8 @@ namespace mongo {
         OPDEBUG_APPEND_NUMBER( nscannedObjects );
         OPDEBUG_APPEND_BOOL( idhack );
         OPDEBUG_APPEND_BOOL( scanAndOrder );
+        OPDEBUG_APPEND_NUMBER( sortMemUsage );
+        OPDEBUG_APPEND_BOOL( sortUsedDisk );
         OPDEBUG_APPEND_BOOL( moved );
         OPDEBUG_APPEND_NUMBER( nmoved );
         OPDEBUG_APPEND_NUMBER( nMatched );
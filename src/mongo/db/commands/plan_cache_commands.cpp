@@ -86,6 +86,22 @@ namespace {
         return Status::OK();
     }
 
+    /**
+     * Appends the plan cache's replanning and eviction counters to 'bob'.
+     */
+    void appendCounters(const PlanCache& planCache, BSONObjBuilder* bob) {
+        PlanCacheCounters counters = planCache.getCounters();
+        BSONObjBuilder countersBob(bob->subobjStart("counters"));
+        countersBob.appendNumber("replans", counters.replans);
+        BSONObjBuilder evictionsBob(countersBob.subobjStart("evictions"));
+        evictionsBob.appendNumber("leastRecentlyUsed", counters.evictedLeastRecentlyUsed);
+        evictionsBob.appendNumber("degraded", counters.evictedDegraded);
+        evictionsBob.appendNumber("replanned", counters.evictedReplanned);
+        evictionsBob.appendNumber("writeOps", counters.evictedWriteOps);
+        evictionsBob.doneFast();
+        countersBob.doneFast();
+    }
+
     //
     // Command instances.
     // Registers commands with the command system and make commands
@@ -369,19 +385,15 @@ namespace mongo {
 
         scoped_ptr<CanonicalQuery> cq(cqRaw);
 
-        if (!planCache.contains(*cq)) {
-            // Return empty plans in results if query shape does not
-            // exist in plan cache.
+        // Return empty plans in results if query shape does not exist in plan cache.  A shape
+        // which is only cached per selectivity bucket has no entry of its own to list either.
+        PlanCacheEntry* entryRaw;
+        if (!planCache.contains(*cq) || !planCache.getEntry(*cq, &entryRaw).isOK()) {
             BSONArrayBuilder plansBuilder(bob->subarrayStart("plans"));
             plansBuilder.doneFast();
+            appendCounters(planCache, bob);
             return Status::OK();
         }
-
-        PlanCacheEntry* entryRaw;
-        Status result = planCache.getEntry(*cq, &entryRaw);
-        if (!result.isOK()) {
-            return result;
-        }
         scoped_ptr<PlanCacheEntry> entry(entryRaw);
 
         BSONArrayBuilder plansBuilder(bob->subarrayStart("plans"));
@@ -433,6 +445,9 @@ namespace mongo {
         }
         plansBuilder.doneFast();
 
+        // Counters are kept for the whole collection's cache, not just this query shape.
+        appendCounters(planCache, bob);
+
         return Status::OK();
     }
 
@@ -397,4 +397,36 @@ namespace {
         ASSERT_EQUALS(plans.size(), 2U);
     }
 
+    TEST(PlanCacheCommandsTest, planCacheListPlansCounters) {
+        CanonicalQuery* cqRaw;
+        ASSERT_OK(CanonicalQuery::canonicalize(ns, fromjson("{a: 1}"), &cqRaw));
+        auto_ptr<CanonicalQuery> cq(cqRaw);
+
+        PlanCache planCache;
+        QuerySolution qs;
+        qs.cacheData.reset(createSolutionCacheData());
+        std::vector<QuerySolution*> solns;
+        solns.push_back(&qs);
+        planCache.add(*cq, solns, createDecision(1U));
+
+        // Replanning evicts the entry the first time only.
+        planCache.notifyOfReplan(*cq);
+        planCache.notifyOfReplan(*cq);
+        ASSERT_FALSE(planCache.contains(*cq));
+
+        OperationContextNoop txn;
+        BSONObjBuilder bob;
+        BSONObj cmdObj = BSON("query" << cq->getQueryObj());
+        ASSERT_OK(PlanCacheListPlans::list(&txn, planCache, ns, cmdObj, &bob));
+        BSONObj resultObj = bob.obj();
+
+        BSONObj counters = resultObj.getObjectField("counters");
+        ASSERT_EQUALS(2, counters["replans"].numberLong());
+        BSONObj evictions = counters.getObjectField("evictions");
+        ASSERT_EQUALS(1, evictions["replanned"].numberLong());
+        ASSERT_EQUALS(0, evictions["leastRecentlyUsed"].numberLong());
+        ASSERT_EQUALS(0, evictions["degraded"].numberLong());
+        ASSERT_EQUALS(0, evictions["writeOps"].numberLong());
+    }
+
 }  // namespace
@@ -165,6 +165,8 @@ namespace mongo {
         long long nscannedObjects;
         bool idhack;         // indicates short circuited code path on an update to make the update faster
         bool scanAndOrder;   // scanandorder query plan aspect was used
+        long long sortMemUsage; // most bytes held at once by the in-memory sort
+        bool sortUsedDisk;   // the in-memory sort spilled to disk
         long long  nMatched; // number of records that match the query
         long long  nModified; // number of records written (no no-ops)
         long long  nmoved;   // updates resulted in a move (moves are expensive)
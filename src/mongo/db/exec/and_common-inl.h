@@ -86,7 +86,10 @@ namespace mongo {
                         break;
                     }
                 }
-                if (!found) { dest->keyData.push_back(src.keyData[i]); }
+                if (!found) {
+                    // The key may live in the storage of 'src', which can be freed before 'dest'.
+                    dest->addKeyData(src.keyData[i].indexKeyPattern, src.keyData[i].keyData);
+                }
             }
         }
     };
@@ -28,6 +28,7 @@
 
 #include "mongo/db/exec/and_hash.h"
 
+#include "mongo/db/catalog/collection.h"
 #include "mongo/db/exec/and_common-inl.h"
 #include "mongo/db/exec/filter.h"
 #include "mongo/db/exec/working_set_common.h"
@@ -59,6 +60,7 @@ namespace mongo {
           _collection(collection),
           _ws(ws),
           _filter(filter),
+          _locsOnly(false),
           _hashingChildren(true),
           _currentChild(0),
           _commonStats(kStageType),
@@ -74,6 +76,7 @@ namespace mongo {
           _collection(collection),
           _ws(ws),
           _filter(filter),
+          _locsOnly(false),
           _hashingChildren(true),
           _currentChild(0),
           _commonStats(kStageType),
@@ -86,6 +89,15 @@ namespace mongo {
 
     void AndHashStage::addChild(PlanStage* child) { _children.push_back(child); }
 
+    void AndHashStage::setLocsOnly() {
+        invariant(_lookAheadResults.empty());
+        _locsOnly = true;
+    }
+
+    size_t AndHashStage::numCandidates() const {
+        return _locsOnly ? _locs.size() : _dataMap.size();
+    }
+
     size_t AndHashStage::getMemUsage() const {
         return _memUsage;
     }
@@ -100,7 +112,7 @@ namespace mongo {
         // Or we're streaming in results from the last child.
 
         // If there's nothing to probe against, we're EOF.
-        if (_dataMap.empty()) { return true; }
+        if (0 == numCandidates()) { return true; }
 
         // Otherwise, we're done when the last child is done.
         invariant(_children.size() >= 2);
@@ -142,6 +154,7 @@ namespace mongo {
                         // A child went right to EOF.  Bail out.
                         _hashingChildren = false;
                         _dataMap.clear();
+                        _locs.clear();
                         return PlanStage::IS_EOF;
                     }
                     else if (PlanStage::ADVANCED == childStatus) {
@@ -165,6 +178,7 @@ namespace mongo {
 
                         _hashingChildren = false;
                         _dataMap.clear();
+                        _locs.clear();
                         return PlanStage::FAILURE;
                     }
                     // We ignore NEED_TIME.
@@ -208,12 +222,16 @@ namespace mongo {
         // Returning results.  We read from the last child and return the results that are in our
         // hash map.
 
-        // We should be EOF if we're not hashing results and the dataMap is empty.
-        verify(!_dataMap.empty());
+        // We should be EOF if we're not hashing results and there are no candidates left.
+        verify(0 != numCandidates());
 
         // We probe _dataMap with the last child.
         verify(_currentChild == _children.size() - 1);
 
+        if (_locsOnly) {
+            return probeLocsOnly(out);
+        }
+
         // Get the next result for the (_children.size() - 1)-th child.
         StageState childStatus = workChild(_children.size() - 1, out);
         if (PlanStage::ADVANCED != childStatus) {
@@ -262,6 +280,48 @@ namespace mongo {
         }
     }
 
+    PlanStage::StageState AndHashStage::probeLocsOnly(WorkingSetID* out) {
+        StageState childStatus = workChild(_children.size() - 1, out);
+        if (PlanStage::ADVANCED != childStatus) {
+            return childStatus;
+        }
+
+        WorkingSetMember* member = _ws->get(*out);
+
+        // Maybe the child had an invalidation.  We intersect DiskLoc(s) so we can't do anything
+        // with this WSM.
+        if (!member->hasLoc()) {
+            _ws->flagForReview(*out);
+            return PlanStage::NEED_TIME;
+        }
+
+        if (!_locs.remove(member->loc)) {
+            // Child's output wasn't in every previous child.  Throw it out.
+            _ws->free(*out);
+            ++_commonStats.needTime;
+            return PlanStage::NEED_TIME;
+        }
+
+        // The result is in every child.  We have only the last child's index keys to match
+        // against, so if there is a filter we fetch the document now that we know we need it.
+        if (NULL != _filter) {
+            if (!member->hasObj()) {
+                member->keyData.clear();
+                member->obj = _collection->docFor(_txn, member->loc);
+                member->state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+            }
+
+            if (!Filter::passes(member, _filter)) {
+                _ws->free(*out);
+                ++_commonStats.needTime;
+                return PlanStage::NEED_TIME;
+            }
+        }
+
+        ++_commonStats.advanced;
+        return PlanStage::ADVANCED;
+    }
+
     PlanStage::StageState AndHashStage::workChild(size_t childNo, WorkingSetID* out) {
         if (WorkingSet::INVALID_ID != _lookAheadResults[childNo]) {
             *out = _lookAheadResults[childNo];
@@ -290,6 +350,18 @@ namespace mongo {
             }
 
             verify(member->hasLoc());
+
+            if (_locsOnly) {
+                _locs.insert(member->loc);
+                _ws->free(id);
+
+                // Update memory stats.
+                _memUsage = _locs.getMemUsage();
+
+                ++_commonStats.needTime;
+                return PlanStage::NEED_TIME;
+            }
+
             verify(_dataMap.end() == _dataMap.find(member->loc));
 
             _dataMap[member->loc] = id;
@@ -305,13 +377,13 @@ namespace mongo {
             _currentChild = 1;
 
             // If our first child was empty, don't scan any others, no possible results.
-            if (_dataMap.empty()) {
+            if (0 == numCandidates()) {
                 _hashingChildren = false;
                 return PlanStage::IS_EOF;
             }
 
             ++_commonStats.needTime;
-            _specificStats.mapAfterChild.push_back(_dataMap.size());
+            _specificStats.mapAfterChild.push_back(numCandidates());
 
             return PlanStage::NEED_TIME;
         }
@@ -354,7 +426,15 @@ namespace mongo {
             }
 
             verify(member->hasLoc());
-            if (_dataMap.end() == _dataMap.find(member->loc)) {
+            if (_locsOnly) {
+                if (_locs.contains(member->loc)) {
+                    _seenLocs.insert(member->loc);
+
+                    // Update memory stats.
+                    _memUsage = _locs.getMemUsage() + _seenLocs.getMemUsage();
+                }
+            }
+            else if (_dataMap.end() == _dataMap.find(member->loc)) {
                 // Ignore.  It's not in any previous child.
             }
             else {
@@ -376,31 +456,39 @@ namespace mongo {
             // Finished with a child.
             ++_currentChild;
 
-            // Keep elements of _dataMap that are in _seenMap.
-            DataMap::iterator it = _dataMap.begin();
-            while (it != _dataMap.end()) {
-                if (_seenMap.end() == _seenMap.find(it->first)) {
-                    DataMap::iterator toErase = it;
-                    ++it;
-
-                    // Update memory stats.
-                    WorkingSetMember* member = _ws->get(toErase->second);
-                    _memUsage -= member->getMemUsage();
-
-                    _ws->free(toErase->second);
-                    _dataMap.erase(toErase);
-                }
-                else { ++it; }
+            if (_locsOnly) {
+                // Everything this child saw was a candidate, so what it saw is the intersection.
+                _locs.swap(_seenLocs);
+                _seenLocs.clear();
+                _memUsage = _locs.getMemUsage();
             }
+            else {
+                // Keep elements of _dataMap that are in _seenMap.
+                DataMap::iterator it = _dataMap.begin();
+                while (it != _dataMap.end()) {
+                    if (_seenMap.end() == _seenMap.find(it->first)) {
+                        DataMap::iterator toErase = it;
+                        ++it;
+
+                        // Update memory stats.
+                        WorkingSetMember* member = _ws->get(toErase->second);
+                        _memUsage -= member->getMemUsage();
+
+                        _ws->free(toErase->second);
+                        _dataMap.erase(toErase);
+                    }
+                    else { ++it; }
+                }
 
-            _specificStats.mapAfterChild.push_back(_dataMap.size());
+                _seenMap.clear();
+            }
 
-            _seenMap.clear();
+            _specificStats.mapAfterChild.push_back(numCandidates());
 
             // _dataMap is now the intersection of the first _currentChild nodes.
 
             // If we have nothing to AND with after finishing any child, stop.
-            if (_dataMap.empty()) {
+            if (0 == numCandidates()) {
                 _hashingChildren = false;
                 return PlanStage::IS_EOF;
             }
@@ -481,6 +569,27 @@ namespace mongo {
         // If it's a mutation the predicates implied by the AND-ing may no longer be true.
         //
         // So, we flag and try to pick it up later.
+        if (_locsOnly) {
+            _seenLocs.remove(dl);
+            if (_locs.remove(dl)) {
+                if (_hashingChildren) {
+                    ++_specificStats.flaggedInProgress;
+                }
+                else {
+                    ++_specificStats.flaggedButPassed;
+                }
+
+                // We don't have a member for the DiskLoc, so make one to hold the document.
+                WorkingSetID id = _ws->allocate();
+                WorkingSetMember* member = _ws->get(id);
+                member->loc = dl;
+                member->state = WorkingSetMember::LOC_AND_IDX;
+                WorkingSetCommon::fetchAndInvalidateLoc(_txn, member, _collection);
+                _ws->flagForReview(id);
+            }
+            return;
+        }
+
         DataMap::iterator it = _dataMap.find(dl);
         if (_dataMap.end() != it) {
             WorkingSetID id = it->second;
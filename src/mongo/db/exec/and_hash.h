@@ -33,6 +33,7 @@
 
 #include "mongo/db/diskloc.h"
 #include "mongo/db/jsobj.h"
+#include "mongo/db/exec/disk_loc_set.h"
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/matcher/expression.h"
 #include "mongo/platform/unordered_set.h"
@@ -49,6 +50,11 @@ namespace mongo {
      * is fetched and added to the WorkingSet as "flagged for further review."  Because this stage
      * operates with DiskLocs, we are unable to evaluate the AND for the invalidated DiskLoc, and it
      * must be fully matched later.
+     *
+     * By default the stage holds on to the WorkingSetMember of every candidate so that it can
+     * merge the index keys of all children into its results.  In locs-only mode (see
+     * setLocsOnly()) it instead keeps just a DiskLocSet per child and returns the members
+     * produced by the last child, fetching them itself only if it has a filter to apply.
      */
     class AndHashStage : public PlanStage {
     public:
@@ -70,6 +76,14 @@ namespace mongo {
 
         void addChild(PlanStage* child);
 
+        /**
+         * Intersect DiskLocs only, dropping the index key data of all children but the last.
+         * Uses a fraction of the memory of the default mode, so much larger intersections fit
+         * under the memory limit.  Only valid if the parent stage fetches the results.  Must be
+         * called before the first call to work().
+         */
+        void setLocsOnly();
+
         /**
          * Returns memory usage.
          * For testing only.
@@ -102,6 +116,16 @@ namespace mongo {
         StageState hashOtherChildren(WorkingSetID* out);
         StageState workChild(size_t childNo, WorkingSetID* out);
 
+        /**
+         * Returns the next result in locs-only mode, once all but the last child are hashed.
+         */
+        StageState probeLocsOnly(WorkingSetID* out);
+
+        /**
+         * Number of candidates left after the children hashed so far.
+         */
+        size_t numCandidates() const;
+
         // Not owned by us.
         OperationContext* _txn;
         const Collection* _collection;
@@ -130,6 +154,11 @@ namespace mongo {
         typedef unordered_set<DiskLoc, DiskLoc::Hasher> SeenMap;
         SeenMap _seenMap;
 
+        // In locs-only mode, these take the place of _dataMap and _seenMap.
+        bool _locsOnly;
+        DiskLocSet _locs;
+        DiskLocSet _seenLocs;
+
         // True if we're still intersecting _children[0..._children.size()-1].
         bool _hashingChildren;
 
@@ -141,7 +170,8 @@ namespace mongo {
         AndHashStats _specificStats;
 
         // The usage in bytes of all buffered data that we're holding.
-        // Memory usage is calculated from keys held in _dataMap only.
+        // Memory usage is calculated from keys held in _dataMap, or from the size of the
+        // DiskLocSets in locs-only mode.
         // For simplicity, results in _lookAheadResults do not count towards the limit.
         size_t _memUsage;
 
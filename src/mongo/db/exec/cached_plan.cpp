@@ -26,7 +26,13 @@
  *    it in the license file.
  */
 
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kQuery
+
 #include "mongo/db/exec/cached_plan.h"
+
+#include <algorithm>
+
+#include "mongo/db/exec/multi_plan.h"
 #include "mongo/db/exec/working_set_common.h"
 #include "mongo/util/mongoutils/str.h"
 
@@ -34,23 +40,36 @@
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/catalog/database.h"
 #include "mongo/db/client.h"
+#include "mongo/db/query/explain.h"
 #include "mongo/db/query/plan_cache.h"
 #include "mongo/db/query/plan_ranker.h"
 #include "mongo/db/query/qlog.h"
+#include "mongo/db/query/query_knobs.h"
+#include "mongo/db/query/query_planner.h"
+#include "mongo/db/query/stage_builder.h"
+#include "mongo/util/log.h"
 
 namespace mongo {
 
     // static
     const char* CachedPlanStage::kStageType = "CACHED_PLAN";
 
-    CachedPlanStage::CachedPlanStage(const Collection* collection,
+    CachedPlanStage::CachedPlanStage(OperationContext* txn,
+                                     Collection* collection,
+                                     WorkingSet* ws,
                                      CanonicalQuery* cq,
+                                     const QueryPlannerParams& params,
+                                     size_t decisionWorks,
                                      PlanStage* mainChild,
                                      QuerySolution* mainQs,
                                      PlanStage* backupChild,
                                      QuerySolution* backupQs)
-        : _collection(collection),
+        : _txn(txn),
+          _collection(collection),
+          _ws(ws),
           _canonicalQuery(cq),
+          _plannerParams(params),
+          _decisionWorks(decisionWorks),
           _mainQs(mainQs),
           _backupQs(backupQs),
           _mainChildPlan(mainChild),
@@ -68,7 +87,68 @@ namespace mongo {
         }
     }
 
-    bool CachedPlanStage::isEOF() { return getActiveChild()->isEOF(); }
+    bool CachedPlanStage::isEOF() { return _results.empty() && getActiveChild()->isEOF(); }
+
+    void CachedPlanStage::pickBestPlan() {
+        // Adds the amount of time taken by pickBestPlan() to executionTimeMillis.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        // Without a baseline there's nothing to compare against.
+        if (0 == _decisionWorks) { return; }
+
+        // Stop at the same number of results that plan ranking does.
+        size_t numResults = (size_t)internalQueryPlanEvaluationMaxResults;
+        size_t numToReturn = _canonicalQuery->getParsed().getNumToReturn();
+        if (numToReturn > 0) {
+            numResults = std::min(numToReturn, numResults);
+        }
+
+        const size_t maxWorks = static_cast<size_t>(internalQueryCacheReplanRatio
+                                                    * _decisionWorks);
+
+        for (size_t i = 0; i < maxWorks; ++i) {
+            WorkingSetID id = WorkingSet::INVALID_ID;
+            StageState state = _mainChildPlan->work(&id);
+
+            if (PlanStage::ADVANCED == state) {
+                _results.push_back(id);
+                if (_results.size() >= numResults) {
+                    // The cached plan is as productive as it was when it was cached.
+                    return;
+                }
+            }
+            else if (PlanStage::IS_EOF == state) {
+                return;
+            }
+            else if (PlanStage::FAILURE == state) {
+                if (WorkingSet::INVALID_ID != id) {
+                    _ws->free(id);
+                }
+
+                if (_results.empty() && NULL != _backupChildPlan.get()) {
+                    // This is what the backup plan is for.
+                    _usingBackupChild = true;
+                    return;
+                }
+
+                replan("cached plan failed");
+                return;
+            }
+            else if (PlanStage::DEAD == state) {
+                // work() will hear about it from the child again.
+                return;
+            }
+        }
+
+        replan(mongoutils::str::stream() << "cached plan took more than " << maxWorks
+                                         << " works to produce " << _results.size()
+                                         << " results, it took " << _decisionWorks
+                                         << " works when it was cached");
+    }
+
+    bool CachedPlanStage::replanned() const {
+        return _specificStats.replanned;
+    }
 
     PlanStage::StageState CachedPlanStage::work(WorkingSetID* out) {
         ++_commonStats.works;
@@ -76,6 +156,15 @@ namespace mongo {
         // Adds the amount of time taken by work() to executionTimeMillis.
         ScopedTimer timer(&_commonStats.executionTimeMillis);
 
+        // Return anything buffered by pickBestPlan() first.
+        if (!_results.empty()) {
+            *out = _results.front();
+            _results.pop_front();
+            _alreadyProduced = true;
+            ++_commonStats.advanced;
+            return PlanStage::ADVANCED;
+        }
+
         if (isEOF()) { return PlanStage::IS_EOF; }
 
         StageState childStatus = getActiveChild()->work(out);
@@ -98,7 +187,10 @@ namespace mongo {
     }
 
     void CachedPlanStage::saveState() {
-        if (! _usingBackupChild) {
+        if (NULL != _replannedRoot.get()) {
+            _replannedRoot->saveState();
+        }
+        else if (! _usingBackupChild) {
             _mainChildPlan->saveState();
         }
 
@@ -109,34 +201,57 @@ namespace mongo {
     }
 
     void CachedPlanStage::restoreState(OperationContext* opCtx) {
+        _txn = opCtx;
+
         if (NULL != _backupChildPlan.get()) {
             _backupChildPlan->restoreState(opCtx);
         }
 
-        if (! _usingBackupChild) {
+        if (NULL != _replannedRoot.get()) {
+            _replannedRoot->restoreState(opCtx);
+        }
+        else if (! _usingBackupChild) {
             _mainChildPlan->restoreState(opCtx);
         }
         ++_commonStats.unyields;
     }
 
     void CachedPlanStage::invalidate(const DiskLoc& dl, InvalidationType type) {
-        if (! _usingBackupChild) {
+        if (NULL != _replannedRoot.get()) {
+            _replannedRoot->invalidate(dl, type);
+        }
+        else if (! _usingBackupChild) {
             _mainChildPlan->invalidate(dl, type);
         }
         if (NULL != _backupChildPlan.get()) {
             _backupChildPlan->invalidate(dl, type);
         }
+
+        // Buffered results whose documents change are flagged, and dropped like
+        // MultiPlanStage drops them.
+        for (std::list<WorkingSetID>::iterator it = _results.begin(); it != _results.end();) {
+            if (WorkingSet::INVALID_ID == *it) {
+                ++it;
+                continue;
+            }
+
+            WorkingSetMember* member = _ws->get(*it);
+            if (member->hasLoc() && member->loc == dl) {
+                WorkingSetCommon::fetchAndInvalidateLoc(_txn, member, _collection);
+                _ws->flagForReview(*it);
+                it = _results.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+
         ++_commonStats.invalidates;
     }
 
     vector<PlanStage*> CachedPlanStage::getChildren() const {
         vector<PlanStage*> children;
-        if (_usingBackupChild) {
-            children.push_back(_backupChildPlan.get());
-        }
-        else {
-            children.push_back(_mainChildPlan.get());
-        }
+        children.push_back(getActiveChild());
         return children;
     }
 
@@ -146,12 +261,7 @@ namespace mongo {
         auto_ptr<PlanStageStats> ret(new PlanStageStats(_commonStats, STAGE_CACHED_PLAN));
         ret->specific.reset(new CachedPlanStats(_specificStats));
 
-        if (_usingBackupChild) {
-            ret->children.push_back(_backupChildPlan->getStats());
-        }
-        else {
-            ret->children.push_back(_mainChildPlan->getStats());
-        }
+        ret->children.push_back(getActiveChild()->getStats());
 
         return ret.release();
     }
@@ -184,7 +294,71 @@ namespace mongo {
         }
     }
 
+    void CachedPlanStage::replan(const std::string& reason) {
+        vector<QuerySolution*> solutions;
+        Status status = QueryPlanner::plan(*_canonicalQuery, _plannerParams, &solutions);
+        if (!status.isOK() || solutions.empty()) {
+            QLOG() << "Not replanning " << _canonicalQuery->toStringShort() << ", " << reason
+                   << ", as it can't be planned: " << status.toString();
+            for (size_t ix = 0; ix < solutions.size(); ++ix) {
+                delete solutions[ix];
+            }
+            return;
+        }
+
+        LOG(1) << "Replanning " << _canonicalQuery->toStringShort() << ": " << reason;
+
+        // Nothing has been returned from the cached plan, throw away what it produced.
+        for (std::list<WorkingSetID>::iterator it = _results.begin(); it != _results.end(); ++it) {
+            if (WorkingSet::INVALID_ID != *it) {
+                _ws->free(*it);
+            }
+        }
+        _results.clear();
+
+        _collection->infoCache()->getPlanCache()->notifyOfReplan(*_canonicalQuery);
+        _specificStats.replanned = true;
+
+        // The entry is gone, there's nothing to give feedback on.
+        _updatedCache = true;
+
+        // The trees point into the solutions so they go first.
+        _usingBackupChild = false;
+        _mainChildPlan.reset();
+        _backupChildPlan.reset();
+        _mainQs.reset();
+        _backupQs.reset();
+
+        if (1 == solutions.size()) {
+            PlanStage* root;
+            verify(StageBuilder::build(_txn, _collection, *solutions[0], _ws, &root));
+            _replannedQs.reset(solutions[0]);
+            _replannedRoot.reset(root);
+            return;
+        }
+
+        // Choose between the solutions, caching the winner, just as if the query hadn't been
+        // cached.
+        MultiPlanStage* multiPlanStage = new MultiPlanStage(_txn, _collection, _canonicalQuery);
+        _replannedRoot.reset(multiPlanStage);
+        for (size_t ix = 0; ix < solutions.size(); ++ix) {
+            if (solutions[ix]->cacheData.get()) {
+                solutions[ix]->cacheData->indexFilterApplied = _plannerParams.indexFiltersApplied;
+            }
+
+            PlanStage* nextPlanRoot;
+            verify(StageBuilder::build(_txn, _collection, *solutions[ix], _ws, &nextPlanRoot));
+
+            // Takes ownership of the solution and the root.
+            multiPlanStage->addPlan(solutions[ix], nextPlanRoot, _ws);
+        }
+        multiPlanStage->pickBestPlan();
+    }
+
     PlanStage* CachedPlanStage::getActiveChild() const {
+        if (NULL != _replannedRoot.get()) {
+            return _replannedRoot.get();
+        }
         return _usingBackupChild ? _backupChildPlan.get() : _mainChildPlan.get();
     }
 
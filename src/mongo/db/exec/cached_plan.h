@@ -28,11 +28,14 @@
 
 #pragma once
 
+#include <list>
+
 #include "mongo/db/diskloc.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/exec/working_set.h"
 #include "mongo/db/query/canonical_query.h"
+#include "mongo/db/query/query_planner_params.h"
 #include "mongo/db/query/query_solution.h"
 
 namespace mongo {
@@ -41,16 +44,27 @@ namespace mongo {
      * This stage outputs its mainChild, and possibly its backup child
      * and also updates the cache.
      *
+     * If pickBestPlan() finds that the cached plan does much worse than it did when it was
+     * cached, the query is planned again from scratch and this stage outputs the new plan.
+     *
      * Preconditions: Valid DiskLoc.
      *
      */
     class CachedPlanStage : public PlanStage {
     public:
         /**
-         * Takes ownership of 'mainChild', 'mainQs', 'backupChild', and 'backupQs'.
+         * Takes ownership of 'mainChild', 'mainQs', 'backupChild', and 'backupQs'.  Does not take
+         * ownership of 'ws', which the children share.
+         *
+         * 'decisionWorks' is how many works the cached plan took while it was being ranked, or 0
+         * if that isn't known.
          */
-        CachedPlanStage(const Collection* collection,
+        CachedPlanStage(OperationContext* txn,
+                        Collection* collection,
+                        WorkingSet* ws,
                         CanonicalQuery* cq,
+                        const QueryPlannerParams& params,
+                        size_t decisionWorks,
                         PlanStage* mainChild,
                         QuerySolution* mainQs,
                         PlanStage* backupChild = NULL,
@@ -76,18 +90,52 @@ namespace mongo {
 
         virtual const SpecificStats* getSpecificStats();
 
+        /**
+         * Runs the cached plan for a trial period, buffering its results, until it produces as
+         * many results as the plan ranking would have or hits EOF.  If it needs more than
+         * internalQueryCacheReplanRatio times the works it took when it was ranked, or fails
+         * without a backup plan, the cached plan is thrown away and the query is replanned.
+         * Nothing has been returned yet at that point, so no results are duplicated.
+         */
+        void pickBestPlan();
+
+        /** Returns true if pickBestPlan() replanned the query. */
+        bool replanned() const;
+
         static const char* kStageType;
 
     private:
         PlanStage* getActiveChild() const;
         void updateCache();
 
+        /**
+         * Evicts the cached plan and replaces the children with a plan (or a MultiPlanStage
+         * choosing between plans) made from scratch.  Keeps the cached plan if the query can't
+         * be planned.
+         */
+        void replan(const std::string& reason);
+
         // not owned
-        const Collection* _collection;
+        OperationContext* _txn;
+
+        // not owned
+        Collection* _collection;
+
+        // not owned
+        WorkingSet* _ws;
 
         // not owned
         CanonicalQuery* _canonicalQuery;
 
+        // Used to plan the query again if the cached plan does badly.
+        QueryPlannerParams _plannerParams;
+
+        // How many works the cached plan took while it was being ranked.
+        size_t _decisionWorks;
+
+        // Results produced by pickBestPlan() which haven't been returned yet.
+        std::list<WorkingSetID> _results;
+
         // Owned by us. Must be deleted after the corresponding PlanStage trees, as
         // those trees point into the query solutions.
         boost::scoped_ptr<QuerySolution> _mainQs;
@@ -98,6 +146,12 @@ namespace mongo {
         boost::scoped_ptr<PlanStage> _mainChildPlan;
         boost::scoped_ptr<PlanStage> _backupChildPlan;
 
+        // Set if we replanned.  Replaces both children above, which are deleted.  If replanning
+        // came up with one solution it is owned by _replannedQs, otherwise _replannedRoot is a
+        // MultiPlanStage owning the solutions.
+        boost::scoped_ptr<QuerySolution> _replannedQs;
+        boost::scoped_ptr<PlanStage> _replannedRoot;
+
         // True if the main plan errors before producing results
         // and if a backup plan is available (can happen with blocking sorts)
         bool _usingBackupChild;
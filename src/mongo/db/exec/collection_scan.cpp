@@ -50,6 +50,7 @@ namespace mongo {
         : _txn(txn),
           _workingSet(workingSet),
           _filter(filter),
+          _compiledFilter(CompiledMatchExpression::compile(filter)),
           _params(params),
           _nsDropped(false),
           _commonStats(kStageType) {
@@ -63,6 +64,33 @@ namespace mongo {
         // Adds the amount of time taken by work() to executionTimeMillis.
         ScopedTimer timer(&_commonStats.executionTimeMillis);
 
+        return doWork(out);
+    }
+
+    PlanStage::StageState CollectionScan::workBatch(size_t maxWorks,
+                                                    std::vector<WorkingSetID>* out) {
+        // Adds the amount of time taken by workBatch() to executionTimeMillis.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        for (size_t i = 0; i < maxWorks; ++i) {
+            ++_commonStats.works;
+            WorkingSetID id = WorkingSet::INVALID_ID;
+            StageState state = doWork(&id);
+            if (PlanStage::ADVANCED == state) {
+                out->push_back(id);
+            }
+            else if (PlanStage::NEED_TIME != state) {
+                if (PlanStage::FAILURE == state) {
+                    out->push_back(id);
+                }
+                return state;
+            }
+        }
+
+        return out->empty() ? PlanStage::NEED_TIME : PlanStage::ADVANCED;
+    }
+
+    PlanStage::StageState CollectionScan::doWork(WorkingSetID* out) {
         if (_nsDropped) { return PlanStage::DEAD; }
 
         // Do some init if we haven't already.
@@ -110,7 +138,7 @@ namespace mongo {
 
         ++_specificStats.docsTested;
 
-        if (Filter::passes(member, _filter)) {
+        if (Filter::passes(member, _filter, _compiledFilter.get())) {
             *out = id;
             ++_commonStats.advanced;
             return PlanStage::ADVANCED;
@@ -32,6 +32,7 @@
 #include "mongo/db/exec/collection_scan_common.h"
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/matcher/expression.h"
+#include "mongo/db/matcher/expression_compiled.h"
 
 namespace mongo {
 
@@ -53,6 +54,7 @@ namespace mongo {
                        const MatchExpression* filter);
 
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks, std::vector<WorkingSetID>* out);
         virtual bool isEOF();
 
         virtual void invalidate(const DiskLoc& dl, InvalidationType type);
@@ -72,6 +74,11 @@ namespace mongo {
         static const char* kStageType;
 
     private:
+        /**
+         * The body of work(), without the stats that work() and workBatch() keep differently.
+         */
+        StageState doWork(WorkingSetID* out);
+
         /**
          * Returns true if the record 'loc' references is in memory, false otherwise.
          */
@@ -86,6 +93,10 @@ namespace mongo {
         // The filter is not owned by us.
         const MatchExpression* _filter;
 
+        // The filter compiled for testing every document we scan.  NULL if there is no filter
+        // or compiling it would not help.
+        scoped_ptr<CompiledMatchExpression> _compiledFilter;
+
         scoped_ptr<RecordIterator> _iter;
 
         CollectionScanParams _params;
@@ -0,0 +1,201 @@
+/**
+ *    Copyright (C) 2014 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/db/exec/disk_loc_set.h"
+
+#include <algorithm>
+
+#include "mongo/util/assert_util.h"
+
+namespace mongo {
+
+    const size_t DiskLocSet::kInitialSlots = 16;
+
+    const size_t DiskLocSet::kBloomBitsPerSlot = 8;
+
+    namespace {
+
+        // Marks a slot whose DiskLoc was removed.  Probe sequences continue past it.
+        const DiskLoc kTombstone(-2, 0);
+
+    }  // namespace
+
+    DiskLocSet::DiskLocSet() : _size(0), _used(0) { }
+
+    // static
+    uint64_t DiskLocSet::hash(const DiskLoc& loc) {
+        // The 64-bit finalizer of MurmurHash3, so that every bit of the result depends on both
+        // halves of the DiskLoc.  We take the slot and the Bloom filter bits from different parts
+        // of the hash.
+        uint64_t h = (static_cast<uint64_t>(static_cast<uint32_t>(loc.a())) << 32)
+                     | static_cast<uint32_t>(loc.getOfs());
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // static
+    bool DiskLocSet::isEmpty(const DiskLoc& slot) {
+        return slot.isNull();
+    }
+
+    // static
+    bool DiskLocSet::isTombstone(const DiskLoc& slot) {
+        return slot == kTombstone;
+    }
+
+    bool DiskLocSet::mayContain(uint64_t h) const {
+        const uint64_t mask = _bloom.size() * 64 - 1;
+        const uint64_t bit1 = (h >> 20) & mask;
+        const uint64_t bit2 = (h >> 42) & mask;
+        return (_bloom[bit1 / 64] & (1ULL << (bit1 % 64)))
+            && (_bloom[bit2 / 64] & (1ULL << (bit2 % 64)));
+    }
+
+    void DiskLocSet::addToBloom(uint64_t h) {
+        const uint64_t mask = _bloom.size() * 64 - 1;
+        const uint64_t bit1 = (h >> 20) & mask;
+        const uint64_t bit2 = (h >> 42) & mask;
+        _bloom[bit1 / 64] |= 1ULL << (bit1 % 64);
+        _bloom[bit2 / 64] |= 1ULL << (bit2 % 64);
+    }
+
+    size_t DiskLocSet::findSlot(const DiskLoc& loc, uint64_t h) const {
+        const size_t mask = _slots.size() - 1;
+        size_t firstTombstone = _slots.size();
+        for (size_t i = h & mask; ; i = (i + 1) & mask) {
+            const DiskLoc& slot = _slots[i];
+            if (slot == loc) {
+                return i;
+            }
+            if (isEmpty(slot)) {
+                return firstTombstone < _slots.size() ? firstTombstone : i;
+            }
+            if (isTombstone(slot) && firstTombstone == _slots.size()) {
+                firstTombstone = i;
+            }
+        }
+    }
+
+    bool DiskLocSet::insert(const DiskLoc& loc) {
+        verify(!isEmpty(loc) && !isTombstone(loc));
+
+        // Keep the table at most three quarters full, counting tombstones, so that there is
+        // always an empty slot to end a probe sequence.
+        if ((_used + 1) * 4 > _slots.size() * 3) {
+            size_t numSlots = std::max(_slots.size(), kInitialSlots);
+            while ((_size + 1) * 2 > numSlots) {
+                numSlots *= 2;
+            }
+            rehash(numSlots);
+        }
+
+        const uint64_t h = hash(loc);
+        const size_t i = findSlot(loc, h);
+        if (_slots[i] == loc) {
+            return false;
+        }
+        if (isEmpty(_slots[i])) {
+            ++_used;
+        }
+        _slots[i] = loc;
+        ++_size;
+        addToBloom(h);
+        return true;
+    }
+
+    bool DiskLocSet::contains(const DiskLoc& loc) const {
+        if (0 == _size) {
+            return false;
+        }
+        const uint64_t h = hash(loc);
+        if (!mayContain(h)) {
+            return false;
+        }
+        return _slots[findSlot(loc, h)] == loc;
+    }
+
+    bool DiskLocSet::remove(const DiskLoc& loc) {
+        if (0 == _size) {
+            return false;
+        }
+        const uint64_t h = hash(loc);
+        if (!mayContain(h)) {
+            return false;
+        }
+        const size_t i = findSlot(loc, h);
+        if (!(_slots[i] == loc)) {
+            return false;
+        }
+        _slots[i] = kTombstone;
+        --_size;
+        return true;
+    }
+
+    void DiskLocSet::clear() {
+        std::vector<DiskLoc>().swap(_slots);
+        std::vector<uint64_t>().swap(_bloom);
+        _size = 0;
+        _used = 0;
+    }
+
+    void DiskLocSet::swap(DiskLocSet& other) {
+        _slots.swap(other._slots);
+        _bloom.swap(other._bloom);
+        std::swap(_size, other._size);
+        std::swap(_used, other._used);
+    }
+
+    size_t DiskLocSet::getMemUsage() const {
+        return _slots.capacity() * sizeof(DiskLoc) + _bloom.capacity() * sizeof(uint64_t);
+    }
+
+    void DiskLocSet::rehash(size_t numSlots) {
+        std::vector<DiskLoc> oldSlots(numSlots);
+        oldSlots.swap(_slots);
+        std::vector<uint64_t>(numSlots * kBloomBitsPerSlot / 64, 0).swap(_bloom);
+        _size = 0;
+        _used = 0;
+
+        for (size_t i = 0; i < oldSlots.size(); ++i) {
+            const DiskLoc& slot = oldSlots[i];
+            if (isEmpty(slot) || isTombstone(slot)) {
+                continue;
+            }
+            const uint64_t h = hash(slot);
+            _slots[findSlot(slot, h)] = slot;
+            addToBloom(h);
+            ++_size;
+            ++_used;
+        }
+    }
+
+}  // namespace mongo
@@ -0,0 +1,112 @@
+/**
+ *    Copyright (C) 2014 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "mongo/db/diskloc.h"
+#include "mongo/platform/cstdint.h"
+
+namespace mongo {
+
+    /**
+     * A compact set of DiskLocs for intersecting the output of index scans.  The DiskLocs are
+     * kept in an open-addressing hash table, 8 bytes apiece, with a Bloom filter in front of it:
+     * most probes for a DiskLoc that is not in the set are answered by the filter alone, without
+     * touching the much larger table.
+     *
+     * Removing a DiskLoc leaves a tombstone in the table and its bits in the Bloom filter; both
+     * are cleaned up the next time the table grows.
+     */
+    class DiskLocSet {
+    public:
+        DiskLocSet();
+
+        /**
+         * Adds 'loc' to the set.  Returns true if it was not already present.  'loc' must not be
+         * null.
+         */
+        bool insert(const DiskLoc& loc);
+
+        bool contains(const DiskLoc& loc) const;
+
+        /**
+         * Removes 'loc' from the set.  Returns true if it was present.
+         */
+        bool remove(const DiskLoc& loc);
+
+        size_t size() const { return _size; }
+
+        bool empty() const { return 0 == _size; }
+
+        void clear();
+
+        void swap(DiskLocSet& other);
+
+        /**
+         * Bytes of memory held by the table and the Bloom filter.
+         */
+        size_t getMemUsage() const;
+
+    private:
+        static const size_t kInitialSlots;
+
+        // Bits of Bloom filter per table slot.
+        static const size_t kBloomBitsPerSlot;
+
+        static uint64_t hash(const DiskLoc& loc);
+
+        static bool isEmpty(const DiskLoc& slot);
+        static bool isTombstone(const DiskLoc& slot);
+
+        bool mayContain(uint64_t h) const;
+        void addToBloom(uint64_t h);
+
+        /**
+         * Returns the slot holding 'loc', or if it is absent, the first empty slot on its probe
+         * sequence.
+         */
+        size_t findSlot(const DiskLoc& loc, uint64_t h) const;
+
+        /**
+         * Rehashes into a table of 'numSlots' slots, dropping tombstones.
+         */
+        void rehash(size_t numSlots);
+
+        std::vector<DiskLoc> _slots;
+        std::vector<uint64_t> _bloom;
+
+        // Number of DiskLocs in the set.
+        size_t _size;
+
+        // Number of DiskLocs plus tombstones.  Bounds the length of probe sequences.
+        size_t _used;
+    };
+
+}  // namespace mongo
@@ -0,0 +1,119 @@
+/**
+ *    Copyright (C) 2014 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+/**
+ * This file contains tests for mongo/db/exec/disk_loc_set.cpp
+ */
+
+#include <set>
+
+#include "mongo/db/exec/disk_loc_set.h"
+#include "mongo/unittest/unittest.h"
+
+using namespace mongo;
+
+namespace {
+
+    TEST(DiskLocSetTest, InsertContainsRemove) {
+        DiskLocSet set;
+        ASSERT_TRUE(set.empty());
+        ASSERT_FALSE(set.contains(DiskLoc(0, 8)));
+
+        ASSERT_TRUE(set.insert(DiskLoc(0, 8)));
+        ASSERT_FALSE(set.insert(DiskLoc(0, 8)));
+        ASSERT_TRUE(set.insert(DiskLoc(1, 8)));
+        ASSERT_EQUALS(2U, set.size());
+        ASSERT_TRUE(set.contains(DiskLoc(0, 8)));
+        ASSERT_TRUE(set.contains(DiskLoc(1, 8)));
+        ASSERT_FALSE(set.contains(DiskLoc(0, 16)));
+
+        ASSERT_TRUE(set.remove(DiskLoc(0, 8)));
+        ASSERT_FALSE(set.remove(DiskLoc(0, 8)));
+        ASSERT_FALSE(set.contains(DiskLoc(0, 8)));
+        ASSERT_TRUE(set.contains(DiskLoc(1, 8)));
+        ASSERT_EQUALS(1U, set.size());
+
+        // A removed DiskLoc can come back.
+        ASSERT_TRUE(set.insert(DiskLoc(0, 8)));
+        ASSERT_TRUE(set.contains(DiskLoc(0, 8)));
+        ASSERT_EQUALS(2U, set.size());
+
+        set.clear();
+        ASSERT_TRUE(set.empty());
+        ASSERT_FALSE(set.contains(DiskLoc(1, 8)));
+    }
+
+    // Mix inserts and removes so that the table fills with tombstones and grows, and check
+    // every step against std::set.
+    TEST(DiskLocSetTest, MatchesStdSet) {
+        DiskLocSet set;
+        std::set<DiskLoc> expected;
+        unsigned int seed = 1;
+        for (int i = 0; i < 100000; ++i) {
+            seed = seed * 1103515245 + 12345;
+            DiskLoc loc((seed >> 8) % 4, (seed >> 12) % 4096);
+            switch ((seed >> 24) % 3) {
+            case 0:
+                ASSERT_EQUALS(expected.insert(loc).second, set.insert(loc));
+                break;
+            case 1:
+                ASSERT_EQUALS(expected.erase(loc) > 0, set.remove(loc));
+                break;
+            default:
+                ASSERT_EQUALS(expected.count(loc) > 0, set.contains(loc));
+            }
+            ASSERT_EQUALS(expected.size(), set.size());
+        }
+    }
+
+    TEST(DiskLocSetTest, Swap) {
+        DiskLocSet a;
+        DiskLocSet b;
+        a.insert(DiskLoc(0, 8));
+        b.insert(DiskLoc(0, 16));
+        b.insert(DiskLoc(0, 24));
+
+        a.swap(b);
+        ASSERT_EQUALS(2U, a.size());
+        ASSERT_TRUE(a.contains(DiskLoc(0, 16)));
+        ASSERT_FALSE(a.contains(DiskLoc(0, 8)));
+        ASSERT_EQUALS(1U, b.size());
+        ASSERT_TRUE(b.contains(DiskLoc(0, 8)));
+    }
+
+    // The set should cost a small constant number of bytes per DiskLoc.
+    TEST(DiskLocSetTest, MemUsage) {
+        DiskLocSet set;
+        const int n = 100000;
+        for (int i = 0; i < n; ++i) {
+            set.insert(DiskLoc(0, i * 8));
+        }
+        ASSERT_LESS_THAN_OR_EQUALS(set.getMemUsage(), n * 4 * (sizeof(DiskLoc) + 1));
+    }
+
+}  // namespace
@@ -49,6 +49,13 @@ namespace mongo {
           _params(params),
           _commonStats(kStageType) {
         _specificStats.keyPattern = _params.descriptor->keyPattern();
+
+        // Add a BSON representation of the filter to the stats tree, if there is one.
+        if (NULL != _params.filter) {
+            BSONObjBuilder bob;
+            _params.filter->toBSON(&bob);
+            _commonStats.filter = bob.obj();
+        }
     }
 
     void DistinctScan::initIndexCursor() {
@@ -105,8 +112,24 @@ namespace mongo {
 
         if (isEOF()) { return PlanStage::IS_EOF; }
 
-        // Grab the next (key, value) from the index.
-        BSONObj ownedKeyObj = _btreeCursor->getKey().getOwned();
+        // A key that fails the filter says nothing about the other keys with the same value of
+        // the distinct field, so we can only step to the next key rather than skip.
+        if (NULL != _params.filter) {
+            ++_specificStats.matchTested;
+            if (!Filter::passes(_btreeCursor->getKey(), _descriptor->keyPattern(),
+                                _params.filter)) {
+                _btreeCursor->next();
+                checkEnd();
+                ++_commonStats.needTime;
+                return PlanStage::NEED_TIME;
+            }
+        }
+
+        // Grab the next (key, value) from the index.  The key is copied into the WSM now as it can
+        // change once the cursor moves.
+        WorkingSetID id = _workingSet->allocate();
+        WorkingSetMember* member = _workingSet->get(id);
+        member->addKeyData(_descriptor->keyPattern(), _btreeCursor->getKey());
         DiskLoc loc = _btreeCursor->getValue();
 
         // The underlying IndexCursor points at the *next* thing we want to return.  We do this so
@@ -125,10 +148,7 @@ namespace mongo {
         checkEnd();
 
         // Package up the result for the caller.
-        WorkingSetID id = _workingSet->allocate();
-        WorkingSetMember* member = _workingSet->get(id);
         member->loc = loc;
-        member->keyData.push_back(IndexKeyDatum(_descriptor->keyPattern(), ownedKeyObj));
         member->state = WorkingSetMember::LOC_AND_IDX;
 
         *out = id;
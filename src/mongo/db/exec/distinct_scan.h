@@ -49,7 +49,8 @@ namespace mongo {
     struct DistinctParams {
         DistinctParams() : descriptor(NULL),
                            direction(1),
-                           fieldNo(0) { }
+                           fieldNo(0),
+                           filter(NULL) { }
 
         // What index are we traversing?
         const IndexDescriptor* descriptor;
@@ -66,6 +67,10 @@ namespace mongo {
         // If we distinct over 'a' the position is 0.
         // If we distinct over 'b' the position is 1.
         int fieldNo;
+
+        // Predicates over the other fields of the index key, if any.  Not owned by us.  A key
+        // must pass the filter before we skip past the other keys with its value.
+        const MatchExpression* filter;
     };
 
     /**
@@ -75,6 +80,10 @@ namespace mongo {
      * for that field, so there is no point in examining all keys with the same value for that
      * field.
      *
+     * If there is a filter, keys are examined one at a time until one passes it, and only then do
+     * we skip to the next value.  The filter is evaluated on the index key, so no documents are
+     * fetched either way.
+     *
      * Only created through the getExecutorDistinct path.  See db/query/get_executor.cpp
      */
     class DistinctScan : public PlanStage {
@@ -31,6 +31,7 @@
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/exec/filter.h"
 #include "mongo/db/exec/working_set_common.h"
+#include "mongo/db/storage/record_store.h"
 #include "mongo/util/fail_point_service.h"
 #include "mongo/util/mongoutils/str.h"
 
@@ -49,6 +50,7 @@ namespace mongo {
           _ws(ws),
           _child(child),
           _filter(filter),
+          _compiledFilter(CompiledMatchExpression::compile(filter)),
           _commonStats(kStageType) { }
 
     FetchStage::~FetchStage() { }
@@ -71,38 +73,18 @@ namespace mongo {
         StageState status = _child->work(&id);
 
         if (PlanStage::ADVANCED == status) {
-            WorkingSetMember* member = _ws->get(id);
-
-            // If there's an obj there, there is no fetching to perform.
-            if (member->hasObj()) {
-                ++_specificStats.alreadyHasObj;
-            }
-            else {
-                // We need a valid loc to fetch from and this is the only state that has one.
-                verify(WorkingSetMember::LOC_AND_IDX == member->state);
-                verify(member->hasLoc());
-
-                // Don't need index data anymore as we have an obj.
-                member->keyData.clear();
-                member->obj = _collection->docFor(_txn, member->loc);
-                member->state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+            if (fetchAndMatch(_ws->get(id))) {
+                *out = id;
+                ++_commonStats.advanced;
+                return PlanStage::ADVANCED;
             }
 
-            ++_specificStats.docsExamined;
-
-            return returnIfMatches(member, id, out);
+            _ws->free(id);
+            ++_commonStats.needTime;
+            return PlanStage::NEED_TIME;
         }
         else if (PlanStage::FAILURE == status) {
-            *out = id;
-            // If a stage fails, it may create a status WSM to indicate why it
-            // failed, in which case 'id' is valid.  If ID is invalid, we
-            // create our own error message.
-            if (WorkingSet::INVALID_ID == id) {
-                mongoutils::str::stream ss;
-                ss << "fetch stage failed to read in results from child";
-                Status status(ErrorCodes::InternalError, ss);
-                *out = WorkingSetCommon::allocateStatusMember( _ws, status);
-            }
+            *out = childFailed(id);
             return status;
         }
         else {
@@ -113,6 +95,111 @@ namespace mongo {
         }
     }
 
+    PlanStage::StageState FetchStage::workBatch(size_t maxWorks, std::vector<WorkingSetID>* out) {
+        // Adds the amount of time taken by workBatch() to executionTimeMillis.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        if (isEOF()) {
+            ++_commonStats.works;
+            return PlanStage::IS_EOF;
+        }
+
+        StageState status = _child->workBatch(maxWorks, out);
+
+        WorkingSetID failedId = WorkingSet::INVALID_ID;
+        if (PlanStage::FAILURE == status) {
+            failedId = out->back();
+            out->pop_back();
+        }
+
+        _commonStats.works += std::max(out->size(), size_t(1));
+        prefetch(*out);
+
+        // Fetch and filter the batch, keeping the results which match at the front of 'out'.
+        size_t numMatched = 0;
+        for (size_t i = 0; i < out->size(); ++i) {
+            WorkingSetID id = (*out)[i];
+            if (fetchAndMatch(_ws->get(id))) {
+                (*out)[numMatched++] = id;
+                ++_commonStats.advanced;
+            }
+            else {
+                _ws->free(id);
+                ++_commonStats.needTime;
+            }
+        }
+        out->resize(numMatched);
+
+        if (PlanStage::FAILURE == status) {
+            out->push_back(childFailed(failedId));
+            return status;
+        }
+        else if (PlanStage::ADVANCED == status || PlanStage::NEED_TIME == status) {
+            if (out->empty()) {
+                ++_commonStats.needTime;
+                return PlanStage::NEED_TIME;
+            }
+            return PlanStage::ADVANCED;
+        }
+        return status;
+    }
+
+    void FetchStage::prefetch(const std::vector<WorkingSetID>& ids) {
+        std::vector<DiskLoc> locs;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            WorkingSetMember* member = _ws->get(ids[i]);
+            if (!member->hasObj() && member->hasLoc()) {
+                locs.push_back(member->loc);
+            }
+        }
+
+        // Nothing to overlap with a single record, it is about to be read anyway.
+        if (locs.size() > 1) {
+            _collection->getRecordStore()->prefetch(_txn, locs);
+            _specificStats.prefetched += locs.size();
+        }
+    }
+
+    bool FetchStage::fetchAndMatch(WorkingSetMember* member) {
+        // If there's an obj there, there is no fetching to perform.
+        if (member->hasObj()) {
+            ++_specificStats.alreadyHasObj;
+        }
+        else {
+            // We need a valid loc to fetch from and this is the only state that has one.
+            verify(WorkingSetMember::LOC_AND_IDX == member->state);
+            verify(member->hasLoc());
+
+            // Don't need index data anymore as we have an obj.
+            member->keyData.clear();
+            member->obj = _collection->docFor(_txn, member->loc);
+            member->state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+        }
+
+        ++_specificStats.docsExamined;
+
+        if (!Filter::passes(member, _filter, _compiledFilter.get())) {
+            return false;
+        }
+        if (NULL != _filter) {
+            ++_specificStats.matchTested;
+        }
+        return true;
+    }
+
+    WorkingSetID FetchStage::childFailed(WorkingSetID id) {
+        // If a stage fails, it may create a status WSM to indicate why it
+        // failed, in which case 'id' is valid.  If ID is invalid, we
+        // create our own error message.
+        if (WorkingSet::INVALID_ID == id) {
+            mongoutils::str::stream ss;
+            ss << "fetch stage failed to read in results from child";
+            Status status(ErrorCodes::InternalError, ss);
+            return WorkingSetCommon::allocateStatusMember( _ws, status);
+        }
+        return id;
+    }
+
     void FetchStage::saveState() {
         ++_commonStats.yields;
         _child->saveState();
@@ -130,27 +217,6 @@ namespace mongo {
         _child->invalidate(dl, type);
     }
 
-    PlanStage::StageState FetchStage::returnIfMatches(WorkingSetMember* member,
-                                                      WorkingSetID memberID,
-                                                      WorkingSetID* out) {
-        if (Filter::passes(member, _filter)) {
-            if (NULL != _filter) {
-                ++_specificStats.matchTested;
-            }
-
-            *out = memberID;
-
-            ++_commonStats.advanced;
-            return PlanStage::ADVANCED;
-        }
-        else {
-            _ws->free(memberID);
-
-            ++_commonStats.needTime;
-            return PlanStage::NEED_TIME;
-        }
-    }
-
     vector<PlanStage*> FetchStage::getChildren() const {
         vector<PlanStage*> children;
         children.push_back(_child.get());
@@ -32,6 +32,7 @@
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/matcher/expression.h"
+#include "mongo/db/matcher/expression_compiled.h"
 
 namespace mongo {
 
@@ -41,6 +42,9 @@ namespace mongo {
      * In WorkingSetMember terms, it transitions from LOC_AND_IDX to LOC_AND_UNOWNED_OBJ by reading
      * the record at the provided loc.  Returns verbatim any data that already has an object.
      *
+     * workBatch() passes the locs of a batch that still need fetching to RecordStore::prefetch so
+     * the reads of the batch can overlap.
+     *
      * Preconditions: Valid DiskLoc.
      */
     class FetchStage : public PlanStage {
@@ -55,6 +59,7 @@ namespace mongo {
 
         virtual bool isEOF();
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks, std::vector<WorkingSetID>* out);
 
         virtual void saveState();
         virtual void restoreState(OperationContext* opCtx);
@@ -75,11 +80,22 @@ namespace mongo {
     private:
 
         /**
-         * If the member (with id memberID) passes our filter, set *out to memberID and return that
-         * ADVANCED.  Otherwise, free memberID and return NEED_TIME.
+         * Reads the member's document if it doesn't have one yet.  Returns true if the member
+         * passes our filter.
+         */
+        bool fetchAndMatch(WorkingSetMember* member);
+
+        /**
+         * Returns the id of a status member explaining why our child failed, given the id the
+         * child returned with FAILURE.
          */
-        StageState returnIfMatches(WorkingSetMember* member, WorkingSetID memberID,
-                                   WorkingSetID* out);
+        WorkingSetID childFailed(WorkingSetID id);
+
+        /**
+         * Asks the record store to read ahead the records of the members which still need
+         * fetching.
+         */
+        void prefetch(const std::vector<WorkingSetID>& ids);
 
         OperationContext* _txn;
 
@@ -94,6 +110,10 @@ namespace mongo {
         // The filter is not owned by us.
         const MatchExpression* _filter;
 
+        // The filter compiled for testing every document we fetch.  NULL if there is no filter
+        // or compiling it would not help.
+        scoped_ptr<CompiledMatchExpression> _compiledFilter;
+
         // Stats
         CommonStats _commonStats;
         FetchStats _specificStats;
@@ -30,6 +30,7 @@
 
 #include "mongo/db/exec/working_set.h"
 #include "mongo/db/matcher/expression.h"
+#include "mongo/db/matcher/expression_compiled.h"
 #include "mongo/db/matcher/matchable.h"
 
 namespace mongo {
@@ -158,6 +159,19 @@ namespace mongo {
             return filter->matches(&doc, NULL);
         }
 
+        /**
+         * Same as above, but 'wsm' is tested with 'compiled', the compiled form of 'filter', if
+         * there is one and 'wsm' has an object.
+         */
+        static bool passes(WorkingSetMember* wsm,
+                           const MatchExpression* filter,
+                           const CompiledMatchExpression* compiled) {
+            if (NULL != compiled && wsm->hasObj()) {
+                return compiled->matchesBSON(wsm->obj);
+            }
+            return passes(wsm, filter);
+        }
+
         static bool passes(const BSONObj& keyData,
                            const BSONObj& keyPattern,
                            const MatchExpression* filter) {
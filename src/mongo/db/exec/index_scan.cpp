@@ -149,6 +149,33 @@ namespace mongo {
         // Adds the amount of time taken by work() to executionTimeMillis.
         ScopedTimer timer(&_commonStats.executionTimeMillis);
 
+        return doWork(out);
+    }
+
+    PlanStage::StageState IndexScan::workBatch(size_t maxWorks,
+                                               std::vector<WorkingSetID>* out) {
+        // Adds the amount of time taken by workBatch() to executionTimeMillis.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        for (size_t i = 0; i < maxWorks; ++i) {
+            ++_commonStats.works;
+            WorkingSetID id = WorkingSet::INVALID_ID;
+            StageState state = doWork(&id);
+            if (PlanStage::ADVANCED == state) {
+                out->push_back(id);
+            }
+            else if (PlanStage::NEED_TIME != state) {
+                if (PlanStage::FAILURE == state) {
+                    out->push_back(id);
+                }
+                return state;
+            }
+        }
+
+        return out->empty() ? PlanStage::NEED_TIME : PlanStage::ADVANCED;
+    }
+
+    PlanStage::StageState IndexScan::doWork(WorkingSetID* out) {
         if (INITIALIZING == _scanState) {
             invariant(NULL == _indexCursor.get());
             initIndexScan();
@@ -168,11 +195,13 @@ namespace mongo {
             BSONObj keyObj = _indexCursor->getKey();
             DiskLoc loc = _indexCursor->getValue();
 
+            WorkingSetID id = WorkingSet::INVALID_ID;
             bool filterPasses = Filter::passes(keyObj, _keyPattern, _filter);
             if ( filterPasses ) {
                 // We must make a copy of the on-disk data since it can mutate during the execution
-                // of this query.
-                keyObj = keyObj.getOwned();
+                // of this query.  The WSM keeps the copy in key storage it reuses.
+                id = _workingSet->allocate();
+                _workingSet->get(id)->addKeyData(_keyPattern, keyObj);
             }
 
             // Move to the next result.
@@ -185,6 +214,9 @@ namespace mongo {
             if (_shouldDedup) {
                 ++_specificStats.dupsTested;
                 if (_returned.end() != _returned.find(loc)) {
+                    if (WorkingSet::INVALID_ID != id) {
+                        _workingSet->free(id);
+                    }
                     ++_specificStats.dupsDropped;
                     ++_commonStats.needTime;
                     return PlanStage::NEED_TIME;
@@ -200,15 +232,13 @@ namespace mongo {
                 }
 
                 // Fill out the WSM.
-                WorkingSetID id = _workingSet->allocate();
                 WorkingSetMember* member = _workingSet->get(id);
                 member->loc = loc;
-                member->keyData.push_back(IndexKeyDatum(_keyPattern, keyObj));
                 member->state = WorkingSetMember::LOC_AND_IDX;
 
                 if (_params.addKeyMetadata) {
                     BSONObjBuilder bob;
-                    bob.appendKeys(_keyPattern, keyObj);
+                    bob.appendKeys(_keyPattern, member->keyData.back().keyData);
                     member->addComputed(new IndexKeyComputedData(bob.obj()));
                 }
 
@@ -107,6 +107,7 @@ namespace mongo {
         virtual ~IndexScan() { }
 
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks, std::vector<WorkingSetID>* out);
         virtual bool isEOF();
         virtual void saveState();
         virtual void restoreState(OperationContext* opCtx);
@@ -125,6 +126,11 @@ namespace mongo {
         static const char* kStageType;
 
     private:
+        /**
+         * The body of work(), without the stats that work() and workBatch() keep differently.
+         */
+        StageState doWork(WorkingSetID* out);
+
         /**
          * Initialize the underlying IndexCursor, grab information from the catalog for stats.
          */
@@ -83,6 +83,33 @@ namespace mongo {
         }
     }
 
+    PlanStage::StageState LimitStage::workBatch(size_t maxWorks, std::vector<WorkingSetID>* out) {
+        // Adds the amount of time taken by workBatch() to executionTimeMillis.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        if (0 == _numToReturn) {
+            ++_commonStats.works;
+            // We've returned as many results as we're limited to.
+            return PlanStage::IS_EOF;
+        }
+
+        // Every result takes at least one work, so this can't overshoot the limit.
+        StageState status = _child->workBatch(std::min(maxWorks, static_cast<size_t>(_numToReturn)),
+                                              out);
+        const size_t numResults = (PlanStage::FAILURE == status) ? out->size() - 1 : out->size();
+        _commonStats.works += std::max(numResults, size_t(1));
+        _commonStats.advanced += numResults;
+        _numToReturn -= static_cast<int>(numResults);
+
+        if (PlanStage::FAILURE == status && WorkingSet::INVALID_ID == out->back()) {
+            mongoutils::str::stream ss;
+            ss << "limit stage failed to read in results from child";
+            Status status(ErrorCodes::InternalError, ss);
+            out->back() = WorkingSetCommon::allocateStatusMember( _ws, status);
+        }
+        return status;
+    }
+
     void LimitStage::saveState() {
         ++_commonStats.yields;
         _child->saveState();
@@ -0,0 +1,346 @@
+/**
+ *    Copyright (C) 2014 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/db/exec/parallel_collection_scan.h"
+
+#include <algorithm>
+#include <boost/shared_ptr.hpp>
+
+#include "mongo/db/catalog/collection.h"
+#include "mongo/db/exec/working_set.h"
+#include "mongo/db/exec/working_set_common.h"
+#include "mongo/db/query/query_knobs.h"
+#include "mongo/db/storage/record_store.h"
+#include "mongo/stdx/functional.h"
+#include "mongo/util/concurrency/thread_pool.h"
+#include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
+
+namespace {
+
+    using namespace mongo;
+
+    // The workers of all parallel collection scans, and the number of threads they were made
+    // with.
+    boost::mutex workerPoolMutex;
+    boost::shared_ptr<ThreadPool> workerPool;
+    int workerPoolThreads = 0;
+
+    /**
+     * Returns the worker pool, replacing it first if internalQueryParallelCollectionScanThreads
+     * has changed since it was made.  The caller must hold on to the pool until its tasks are
+     * done.
+     */
+    boost::shared_ptr<ThreadPool> getWorkerPool() {
+        const int numThreads = std::max(internalQueryParallelCollectionScanThreads, 1);
+        boost::lock_guard<boost::mutex> lock(workerPoolMutex);
+        if (!workerPool || workerPoolThreads != numThreads) {
+            workerPool.reset(new ThreadPool(numThreads));
+            workerPoolThreads = numThreads;
+        }
+        return workerPool;
+    }
+
+}  // namespace
+
+namespace mongo {
+
+    // static
+    const char* ParallelCollectionScan::kStageType = "PARALLEL_COLLSCAN";
+
+    // static
+    const size_t ParallelCollectionScan::kRecordsPerRound = 512;
+
+    ParallelCollectionScan::ParallelCollectionScan(OperationContext* txn,
+                                                   Collection* collection,
+                                                   WorkingSet* workingSet,
+                                                   const MatchExpression* filter,
+                                                   size_t numThreads)
+        : _txn(txn),
+          _collection(collection),
+          _workingSet(workingSet),
+          _filter(filter),
+          _compiledFilter(CompiledMatchExpression::compile(filter)),
+          _numThreads(numThreads),
+          _initialized(false),
+          _nsDropped(false),
+          _tasksRunning(0),
+          _workerStatus(Status::OK()),
+          _commonStats(kStageType) {
+        _specificStats.numThreads = numThreads;
+    }
+
+    PlanStage::StageState ParallelCollectionScan::work(WorkingSetID* out) {
+        ++_commonStats.works;
+
+        // Adds the amount of time taken by work() to executionTimeMillis.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        if (_nsDropped) { return PlanStage::DEAD; }
+
+        // Do some init if we haven't already.
+        if (!_initialized) {
+            if (NULL == _collection) {
+                _nsDropped = true;
+                return PlanStage::DEAD;
+            }
+
+            std::vector<RecordIterator*> iterators = _collection->getManyIterators(_txn);
+            _iterators.mutableVector().swap(iterators);
+            _partitions.resize(_iterators.size());
+            for (size_t i = 0; i < _iterators.size(); ++i) {
+                _partitions[i].iterator = _iterators[i];
+            }
+            _specificStats.numPartitions = _partitions.size();
+            _initialized = true;
+
+            ++_commonStats.needTime;
+            return PlanStage::NEED_TIME;
+        }
+
+        if (_results.empty()) {
+            if (isEOF()) { return PlanStage::IS_EOF; }
+
+            Status status = runRound();
+            if (!status.isOK()) {
+                *out = WorkingSetCommon::allocateStatusMember(_workingSet, status);
+                return PlanStage::FAILURE;
+            }
+
+            ++_commonStats.needTime;
+            return PlanStage::NEED_TIME;
+        }
+
+        Result result = _results.front();
+        _results.pop_front();
+
+        WorkingSetID id = _workingSet->allocate();
+        WorkingSetMember* member = _workingSet->get(id);
+        member->loc = result.loc;
+        member->obj = result.obj;
+        member->state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+
+        // The document changed after a worker matched it, so match it again.
+        if (result.recheck) {
+            member->obj = _collection->docFor(_txn, result.loc);
+            if (!matches(member->obj)) {
+                _workingSet->free(id);
+                ++_commonStats.needTime;
+                return PlanStage::NEED_TIME;
+            }
+        }
+
+        *out = id;
+        ++_commonStats.advanced;
+        return PlanStage::ADVANCED;
+    }
+
+    Status ParallelCollectionScan::runRound() {
+        ++_specificStats.rounds;
+
+        // Fix which partitions take part before any worker starts, since the workers finish
+        // partitions as they go.
+        _roundPartitions.clear();
+        for (size_t i = 0; i < _partitions.size(); ++i) {
+            if (!_partitions[i].iterator->isEOF()) {
+                _roundPartitions.push_back(i);
+            }
+        }
+        const size_t numWorkers = std::min(_numThreads, _roundPartitions.size());
+        invariant(numWorkers > 0);
+
+        // Keeps the pool alive for the round even if the knob changes meanwhile.
+        const boost::shared_ptr<ThreadPool> pool = getWorkerPool();
+        {
+            boost::lock_guard<boost::mutex> lock(_roundMutex);
+            _tasksRunning = numWorkers;
+            _workerStatus = Status::OK();
+        }
+        for (size_t worker = 0; worker < numWorkers; ++worker) {
+            pool->schedule(stdx::bind(&ParallelCollectionScan::scanPartitions,
+                                      this, worker, numWorkers));
+        }
+
+        {
+            boost::unique_lock<boost::mutex> lock(_roundMutex);
+            while (_tasksRunning > 0) {
+                _roundDone.wait(lock);
+            }
+            if (!_workerStatus.isOK()) {
+                return _workerStatus;
+            }
+        }
+
+        // Merge the partitions' matches in partition order.
+        for (size_t i = 0; i < _partitions.size(); ++i) {
+            Partition& partition = _partitions[i];
+            _specificStats.docsTested += partition.docsTested;
+            partition.docsTested = 0;
+            _results.insert(_results.end(), partition.results.begin(), partition.results.end());
+            partition.results.clear();
+        }
+
+        return Status::OK();
+    }
+
+    bool ParallelCollectionScan::matches(const BSONObj& obj) const {
+        if (NULL != _compiledFilter.get()) {
+            return _compiledFilter->matchesBSON(obj);
+        }
+        return NULL == _filter || _filter->matchesBSON(obj, NULL);
+    }
+
+    void ParallelCollectionScan::scanPartitions(size_t worker, size_t numWorkers) {
+        Status status = Status::OK();
+        try {
+            // The partitions of the round are dealt out round-robin.
+            for (size_t i = worker; i < _roundPartitions.size(); i += numWorkers) {
+                Partition& partition = _partitions[_roundPartitions[i]];
+                RecordIterator* iterator = partition.iterator;
+
+                for (size_t n = 0; n < kRecordsPerRound && !iterator->isEOF(); ++n) {
+                    DiskLoc loc = iterator->getNext();
+                    BSONObj obj = iterator->dataFor(loc).toBson();
+                    ++partition.docsTested;
+                    if (matches(obj)) {
+                        partition.results.push_back(Result(loc, obj));
+                    }
+                }
+            }
+        }
+        catch (const DBException& e) {
+            status = e.toStatus();
+        }
+        catch (const std::exception& e) {
+            status = Status(ErrorCodes::InternalError,
+                            str::stream() << "parallel collection scan worker failed: "
+                                          << e.what());
+        }
+
+        boost::lock_guard<boost::mutex> lock(_roundMutex);
+        if (!status.isOK() && _workerStatus.isOK()) {
+            _workerStatus = status;
+        }
+        if (0 == --_tasksRunning) {
+            _roundDone.notify_all();
+        }
+    }
+
+    bool ParallelCollectionScan::isEOF() {
+        if (_nsDropped) { return true; }
+        if (!_initialized) { return false; }
+        if (!_results.empty()) { return false; }
+        for (size_t i = 0; i < _partitions.size(); ++i) {
+            if (!_partitions[i].iterator->isEOF()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void ParallelCollectionScan::invalidate(const DiskLoc& dl, InvalidationType type) {
+        ++_commonStats.invalidates;
+
+        // Deletions can harm the underlying RecordIterators so we must pass them down.
+        if (INVALIDATION_DELETION == type) {
+            for (size_t i = 0; i < _iterators.size(); ++i) {
+                _iterators[i]->invalidate(dl);
+            }
+        }
+
+        // A buffered match that is deleted is dropped.  One that is modified is matched again
+        // before we return it.
+        std::deque<Result>::iterator it = _results.begin();
+        while (it != _results.end()) {
+            if (it->loc != dl) {
+                ++it;
+            }
+            else if (INVALIDATION_DELETION == type) {
+                it = _results.erase(it);
+            }
+            else {
+                it->recheck = true;
+                ++it;
+            }
+        }
+    }
+
+    void ParallelCollectionScan::saveState() {
+        ++_commonStats.yields;
+        for (size_t i = 0; i < _iterators.size(); ++i) {
+            _iterators[i]->saveState();
+        }
+
+        // The buffered documents may point into storage that can go away while we yield.
+        for (size_t i = 0; i < _results.size(); ++i) {
+            _results[i].obj = _results[i].obj.getOwned();
+        }
+    }
+
+    void ParallelCollectionScan::restoreState(OperationContext* opCtx) {
+        _txn = opCtx;
+        ++_commonStats.unyields;
+        for (size_t i = 0; i < _iterators.size(); ++i) {
+            if (!_iterators[i]->restoreState(opCtx)) {
+                warning() << "Collection dropped or state deleted during yield of "
+                          << "ParallelCollectionScan";
+                _nsDropped = true;
+            }
+        }
+    }
+
+    std::vector<PlanStage*> ParallelCollectionScan::getChildren() const {
+        std::vector<PlanStage*> empty;
+        return empty;
+    }
+
+    PlanStageStats* ParallelCollectionScan::getStats() {
+        _commonStats.isEOF = isEOF();
+
+        // Add a BSON representation of the filter to the stats tree, if there is one.
+        if (NULL != _filter) {
+            BSONObjBuilder bob;
+            _filter->toBSON(&bob);
+            _commonStats.filter = bob.obj();
+        }
+
+        std::auto_ptr<PlanStageStats> ret(new PlanStageStats(_commonStats,
+                                                             STAGE_PARALLEL_COLLSCAN));
+        ret->specific.reset(new ParallelCollectionScanStats(_specificStats));
+        return ret.release();
+    }
+
+    const CommonStats* ParallelCollectionScan::getCommonStats() {
+        return &_commonStats;
+    }
+
+    const SpecificStats* ParallelCollectionScan::getSpecificStats() {
+        return &_specificStats;
+    }
+
+}  // namespace mongo
@@ -0,0 +1,190 @@
+/**
+ *    Copyright (C) 2014 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <deque>
+#include <vector>
+
+#include "mongo/base/owned_pointer_vector.h"
+#include "mongo/base/status.h"
+#include "mongo/db/diskloc.h"
+#include "mongo/db/exec/plan_stage.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/db/matcher/expression.h"
+#include "mongo/db/matcher/expression_compiled.h"
+
+namespace mongo {
+
+    class Collection;
+    class OperationContext;
+    class RecordIterator;
+    class WorkingSet;
+
+    /**
+     * Scans a whole collection on several threads.  The record store is split into partitions,
+     * one per RecordIterator from getManyIterators() (an extent, under mmap_v1), and the filter
+     * is evaluated on a shared pool of worker threads.
+     *
+     * The scan proceeds in rounds.  When it has no buffered results, work() hands every
+     * unfinished partition to a worker, waits for each to scan its next few records, and then
+     * buffers the matches in partition order.  Workers only run inside work(), so yielding and
+     * invalidation happen while they are idle.  Results come out in no particular order.
+     *
+     * Only valid when the caller's lock keeps writers out of the collection while work() runs.
+     * The workers have no Client or OperationContext of their own.  They read through the
+     * caller's RecordIterators, and so under the caller's OperationContext and locks, while the
+     * caller waits for them in work().  A worker of its own with its own Locker could deadlock:
+     * its lock request would queue behind a waiting writer, which in turn waits for the caller.
+     * Sharing is safe because the workers only call getNext() and dataFor() on their own
+     * iterators, and those don't use the OperationContext beyond reading through it.  Under
+     * mmap_v1 they read the mapped extents.  Record stores with a single iterator get a single
+     * worker, which uses the OperationContext while the caller is blocked.  The filter must be
+     * safe to evaluate on several threads at once, so it may not contain $where.
+     *
+     * The worker pool is shared by all scans and sized by
+     * internalQueryParallelCollectionScanThreads.  It is replaced when the knob changes; scans
+     * still running a round on the old pool keep it until the round ends.
+     */
+    class ParallelCollectionScan : public PlanStage {
+    public:
+        ParallelCollectionScan(OperationContext* txn,
+                               Collection* collection,
+                               WorkingSet* workingSet,
+                               const MatchExpression* filter,
+                               size_t numThreads);
+
+        virtual StageState work(WorkingSetID* out);
+        virtual bool isEOF();
+
+        virtual void invalidate(const DiskLoc& dl, InvalidationType type);
+        virtual void saveState();
+        virtual void restoreState(OperationContext* opCtx);
+
+        virtual std::vector<PlanStage*> getChildren() const;
+
+        virtual StageType stageType() const { return STAGE_PARALLEL_COLLSCAN; }
+
+        virtual PlanStageStats* getStats();
+
+        virtual const CommonStats* getCommonStats();
+
+        virtual const SpecificStats* getSpecificStats();
+
+        static const char* kStageType;
+
+        // How many records does each partition scan per round?
+        static const size_t kRecordsPerRound;
+
+    private:
+        struct Result {
+            Result(const DiskLoc& l, const BSONObj& o) : loc(l), obj(o), recheck(false) { }
+
+            DiskLoc loc;
+            BSONObj obj;
+
+            // Set if the document was modified since we matched it.
+            bool recheck;
+        };
+
+        struct Partition {
+            Partition() : iterator(NULL), docsTested(0) { }
+
+            // Owned by _iterators.
+            RecordIterator* iterator;
+
+            // Matches from the current round.  Written only by the worker scanning this
+            // partition.
+            std::vector<Result> results;
+            size_t docsTested;
+        };
+
+        /**
+         * Hands every unfinished partition to a worker, waits for them all, and buffers what they
+         * found.  Returns the first error a worker hit, if any.
+         */
+        Status runRound();
+
+        /**
+         * Runs on a worker thread.  Scans the next kRecordsPerRound records of every
+         * 'numWorkers'-th partition of the round, starting with the 'worker'-th.
+         */
+        void scanPartitions(size_t worker, size_t numWorkers);
+
+        /**
+         * Returns true if there is no filter or 'obj' satisfies it.  Safe to call from workers.
+         */
+        bool matches(const BSONObj& obj) const;
+
+        // transactional context for read locks. Not owned by us
+        OperationContext* _txn;
+
+        // Not owned by us.
+        Collection* _collection;
+
+        // WorkingSet is not owned by us.
+        WorkingSet* _workingSet;
+
+        // The filter is not owned by us.
+        const MatchExpression* _filter;
+
+        // The filter compiled for the workers.  NULL if there is no filter or compiling it would
+        // not help.  Matching with it is const, so the workers share it.
+        boost::scoped_ptr<CompiledMatchExpression> _compiledFilter;
+
+        size_t _numThreads;
+
+        bool _initialized;
+
+        // True if the collection went away during a yield.
+        bool _nsDropped;
+
+        OwnedPointerVector<RecordIterator> _iterators;
+        std::vector<Partition> _partitions;
+
+        // Indices into _partitions of the partitions taking part in the current round.
+        std::vector<size_t> _roundPartitions;
+
+        // Matches not yet returned.
+        std::deque<Result> _results;
+
+        // Protects _tasksRunning and _workerStatus while a round runs.
+        boost::mutex _roundMutex;
+        boost::condition_variable _roundDone;
+        size_t _tasksRunning;
+        Status _workerStatus;
+
+        // Stats
+        CommonStats _commonStats;
+        ParallelCollectionScanStats _specificStats;
+    };
+
+}  // namespace mongo
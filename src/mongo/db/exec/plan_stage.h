@@ -28,6 +28,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "mongo/db/exec/plan_stats.h"
 #include "mongo/db/exec/working_set.h"
 #include "mongo/db/invalidation_type.h"
@@ -155,6 +157,35 @@ namespace mongo {
          */
         virtual StageState work(WorkingSetID* out) = 0;
 
+        /**
+         * Does the work of up to 'maxWorks' calls to work() at once, appending the id of every
+         * result produced to 'out', which must be empty.
+         *
+         * Returns IS_EOF, DEAD or FAILURE if work() returned that and ended the batch; for FAILURE
+         * the last id in 'out' is the status member (or INVALID_ID) rather than a result.
+         * Otherwise returns ADVANCED if there are results in 'out' and NEED_TIME if not.  The
+         * results are returned in the order work() would have returned them.
+         *
+         * The default calls work() in a loop.  Stages which can produce results more cheaply a
+         * batch at a time override it.
+         */
+        virtual StageState workBatch(size_t maxWorks, std::vector<WorkingSetID>* out) {
+            for (size_t i = 0; i < maxWorks; ++i) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                StageState state = work(&id);
+                if (ADVANCED == state) {
+                    out->push_back(id);
+                }
+                else if (NEED_TIME != state) {
+                    if (FAILURE == state) {
+                        out->push_back(id);
+                    }
+                    return state;
+                }
+            }
+            return out->empty() ? NEED_TIME : ADVANCED;
+        }
+
         /**
          * Returns true if no more work can be done on the query / out of results.
          */
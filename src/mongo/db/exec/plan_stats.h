@@ -198,8 +198,14 @@ namespace mongo {
         // What's our current memory usage?
         size_t memUsage;
 
+        // What's the most memory we have used at any point?
+        size_t maxMemUsage;
+
         // What's our memory limit?
         size_t memLimit;
+
+        // Did we have to spill data to disk because we ran out of memory?
+        bool usedDisk;
     };
 
     struct AndSortedStats : public SpecificStats {
@@ -224,11 +230,14 @@ namespace mongo {
     };
 
     struct CachedPlanStats : public SpecificStats {
-        CachedPlanStats() { }
+        CachedPlanStats() : replanned(false) { }
 
         virtual SpecificStats* clone() const {
             return new CachedPlanStats(*this);
         }
+
+        // Did the cached plan do badly enough during its trial period that we replanned?
+        bool replanned;
     };
 
     struct CollectionScanStats : public SpecificStats {
@@ -247,6 +256,30 @@ namespace mongo {
         int direction;
     };
 
+    struct ParallelCollectionScanStats : public SpecificStats {
+        ParallelCollectionScanStats() : docsTested(0),
+                                        numThreads(0),
+                                        numPartitions(0),
+                                        rounds(0) { }
+
+        virtual SpecificStats* clone() const {
+            ParallelCollectionScanStats* specific = new ParallelCollectionScanStats(*this);
+            return specific;
+        }
+
+        // How many documents did we check against our filter?
+        size_t docsTested;
+
+        // How many threads may scan at once?
+        size_t numThreads;
+
+        // How many pieces was the collection split into?
+        size_t numPartitions;
+
+        // How many times did we hand out work to the threads?
+        size_t rounds;
+    };
+
     struct CountStats : public SpecificStats {
         CountStats() : nCounted(0), nSkipped(0), trivialCount(false) { }
 
@@ -298,7 +331,7 @@ namespace mongo {
     };
 
     struct DistinctScanStats : public SpecificStats {
-        DistinctScanStats() : keysExamined(0) { }
+        DistinctScanStats() : keysExamined(0), matchTested(0) { }
 
         virtual SpecificStats* clone() const {
             DistinctScanStats* specific = new DistinctScanStats(*this);
@@ -309,6 +342,9 @@ namespace mongo {
         // How many keys did we look at while distinct-ing?
         size_t keysExamined;
 
+        // How many keys did we test against the filter?
+        size_t matchTested;
+
         BSONObj keyPattern;
     };
 
@@ -316,7 +352,8 @@ namespace mongo {
         FetchStats() : alreadyHasObj(0),
                        forcedFetches(0),
                        matchTested(0),
-                       docsExamined(0) { }
+                       docsExamined(0),
+                       prefetched(0) { }
 
         virtual ~FetchStats() { }
 
@@ -340,6 +377,9 @@ namespace mongo {
 
         // The total number of full documents touched by the fetch stage.
         size_t docsExamined;
+
+        // How many records were handed to the record store to read ahead of fetching them.
+        size_t prefetched;
     };
 
     struct GroupStats : public SpecificStats {
@@ -485,7 +525,11 @@ namespace mongo {
     };
 
     struct SortStats : public SpecificStats {
-        SortStats() : forcedFetches(0), memUsage(0), memLimit(0) { }
+        SortStats() : forcedFetches(0),
+                      memUsage(0),
+                      maxMemUsage(0),
+                      memLimit(0),
+                      usedDisk(false) { }
 
         virtual ~SortStats() { }
 
@@ -500,9 +544,15 @@ namespace mongo {
         // What's our current memory usage?
         size_t memUsage;
 
+        // What's the most memory we have used at any point?
+        size_t maxMemUsage;
+
         // What's our memory limit?
         size_t memLimit;
 
+        // Did we have to spill data to disk because we ran out of memory?
+        bool usedDisk;
+
         // The number of results to return from the sort.
         size_t limit;
 
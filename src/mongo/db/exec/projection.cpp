@@ -236,6 +236,43 @@ namespace mongo {
         return status;
     }
 
+    PlanStage::StageState ProjectionStage::workBatch(size_t maxWorks,
+                                                     std::vector<WorkingSetID>* out) {
+        // Adds the amount of time taken by workBatch() to executionTimeMillis.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        StageState status = _child->workBatch(maxWorks, out);
+        const size_t numResults = (PlanStage::FAILURE == status) ? out->size() - 1 : out->size();
+        _commonStats.works += std::max(numResults, size_t(1));
+
+        for (size_t i = 0; i < numResults; ++i) {
+            Status projStatus = transform(_ws->get((*out)[i]));
+            if (!projStatus.isOK()) {
+                warning() << "Couldn't execute projection, status = "
+                          << projStatus.toString() << endl;
+                // The results before this one are still returned, the rest are dropped.
+                for (size_t j = i; j < out->size(); ++j) {
+                    if (WorkingSet::INVALID_ID != (*out)[j]) {
+                        _ws->free((*out)[j]);
+                    }
+                }
+                out->resize(i);
+                out->push_back(WorkingSetCommon::allocateStatusMember(_ws, projStatus));
+                _commonStats.advanced += i;
+                return PlanStage::FAILURE;
+            }
+        }
+        _commonStats.advanced += numResults;
+
+        if (PlanStage::FAILURE == status && WorkingSet::INVALID_ID == out->back()) {
+            mongoutils::str::stream ss;
+            ss << "projection stage failed to read in results from child";
+            Status status(ErrorCodes::InternalError, ss);
+            out->back() = WorkingSetCommon::allocateStatusMember( _ws, status);
+        }
+        return status;
+    }
+
     void ProjectionStage::saveState() {
         ++_commonStats.yields;
         _child->saveState();
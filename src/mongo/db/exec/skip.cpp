@@ -87,6 +87,36 @@ namespace mongo {
         }
     }
 
+    PlanStage::StageState SkipStage::workBatch(size_t maxWorks, std::vector<WorkingSetID>* out) {
+        // Adds the amount of time taken by workBatch() to executionTimeMillis.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        StageState status = _child->workBatch(maxWorks, out);
+        const size_t numResults = (PlanStage::FAILURE == status) ? out->size() - 1 : out->size();
+        _commonStats.works += std::max(numResults, size_t(1));
+
+        // Drop the results we're still skipping.
+        const size_t numSkipped = std::min(numResults, static_cast<size_t>(_toSkip));
+        for (size_t i = 0; i < numSkipped; ++i) {
+            _ws->free((*out)[i]);
+        }
+        out->erase(out->begin(), out->begin() + numSkipped);
+        _toSkip -= static_cast<int>(numSkipped);
+        _commonStats.needTime += numSkipped;
+        _commonStats.advanced += numResults - numSkipped;
+
+        if (PlanStage::FAILURE == status && WorkingSet::INVALID_ID == out->back()) {
+            mongoutils::str::stream ss;
+            ss << "skip stage failed to read in results from child";
+            Status status(ErrorCodes::InternalError, ss);
+            out->back() = WorkingSetCommon::allocateStatusMember( _ws, status);
+        }
+        else if (PlanStage::ADVANCED == status && out->empty()) {
+            status = PlanStage::NEED_TIME;
+        }
+        return status;
+    }
+
     void SkipStage::saveState() {
         ++_commonStats.yields;
         _child->saveState();
@@ -38,6 +38,7 @@
 #include "mongo/db/query/lite_parsed_query.h"
 #include "mongo/db/query/qlog.h"
 #include "mongo/db/query/query_planner.h"
+#include "mongo/db/storage_options.h"
 
 namespace mongo {
 
@@ -45,6 +46,55 @@ namespace mongo {
 
     const size_t kMaxBytes = 32 * 1024 * 1024;
 
+    /**
+     * Orders the external sorter's data the way WorkingSetComparator orders buffered items.
+     */
+    class SortStageSpilledResultComparator {
+    public:
+        explicit SortStageSpilledResultComparator(const BSONObj& pattern) : _pattern(pattern) { }
+
+        int operator()(const std::pair<BSONObj, SortStageSpilledResult>& lhs,
+                       const std::pair<BSONObj, SortStageSpilledResult>& rhs) const {
+            // False means ignore field names.
+            int result = lhs.first.woCompare(rhs.first, _pattern, false);
+            if (0 != result) {
+                return result;
+            }
+            return lhs.second.loc.compare(rhs.second.loc);
+        }
+
+    private:
+        BSONObj _pattern;
+    };
+
+    //
+    // SortStageSpilledResult
+    //
+
+    void SortStageSpilledResult::serializeForSorter(BufBuilder& buf) const {
+        loc.serializeForSorter(buf);
+        buf.appendNum(seq);
+        obj.serializeForSorter(buf);
+    }
+
+    // static
+    SortStageSpilledResult SortStageSpilledResult::deserializeForSorter(
+            BufReader& buf,
+            const SorterDeserializeSettings&) {
+        DiskLoc loc = DiskLoc::deserializeForSorter(buf, DiskLoc::SorterDeserializeSettings());
+        long long seq = buf.read<long long>();
+        BSONObj obj = BSONObj::deserializeForSorter(buf, BSONObj::SorterDeserializeSettings());
+        return SortStageSpilledResult(obj, loc, seq);
+    }
+
+    int SortStageSpilledResult::memUsageForSorter() const {
+        return sizeof(DiskLoc) + sizeof(long long) + obj.memUsageForSorter();
+    }
+
+    SortStageSpilledResult SortStageSpilledResult::getOwned() const {
+        return SortStageSpilledResult(obj.getOwned(), loc, seq);
+    }
+
     // static
     const char* SortStage::kStageType = "SORT";
 
@@ -293,6 +343,8 @@ namespace mongo {
           _limit(params.limit),
           _sorted(false),
           _resultIterator(_data.end()),
+          _allowDiskUse(params.allowDiskUse),
+          _numSpilled(0),
           _commonStats(kStageType),
           _memUsage(0) {
     }
@@ -302,6 +354,9 @@ namespace mongo {
     bool SortStage::isEOF() {
         // We're done when our child has no more results, we've sorted the child's results, and
         // we've returned all sorted results.
+        if (NULL != _spilledResults.get()) {
+            return _child->isEOF() && _sorted && !_spilledResults->more();
+        }
         return _child->isEOF() && _sorted && (_data.end() == _resultIterator);
     }
 
@@ -315,16 +370,10 @@ namespace mongo {
             // This is heavy and should be done as part of work().
             _sortKeyGen.reset(new SortStageKeyGenerator(_collection, _pattern, _query));
             _sortKeyComparator.reset(new WorkingSetComparator(_sortKeyGen->getSortComparator()));
-            // If limit > 1, we need to initialize _dataSet here to maintain ordered
-            // set of data items while fetching from the child stage.
-            if (_limit > 1) {
-                const WorkingSetComparator& cmp = *_sortKeyComparator;
-                _dataSet.reset(new SortableDataItemSet(cmp));
-            }
             return PlanStage::NEED_TIME;
         }
 
-        if (_memUsage > kMaxBytes) {
+        if (_memUsage > kMaxBytes && NULL == _sorter.get() && !(_allowDiskUse && spill())) {
             mongoutils::str::stream ss;
             ss << "sort stage buffered data usage of " << _memUsage
                << " bytes exceeds internal limit of " << kMaxBytes << " bytes";
@@ -357,7 +406,7 @@ namespace mongo {
                 // The data remains in the WorkingSet and we wrap the WSID with the sort key.
                 SortableDataItem item;
                 Status sortKeyStatus = _sortKeyGen->getSortKey(*member, &item.sortKey);
-                if (!_sortKeyGen->getSortKey(*member, &item.sortKey).isOK()) {
+                if (!sortKeyStatus.isOK()) {
                     *out = WorkingSetCommon::allocateStatusMember(_ws, sortKeyStatus);
                     return PlanStage::FAILURE;
                 }
@@ -367,7 +416,22 @@ namespace mongo {
                     item.loc = member->loc;
                 }
 
-                addToBuffer(item);
+                if (NULL != _sorter.get() && canSpill(*member)) {
+                    addToSorter(item);
+                }
+                else if (NULL != _sorter.get()) {
+                    Status status(ErrorCodes::Overflow,
+                                  "sort stage can't spill results with computed data to disk");
+                    *out = WorkingSetCommon::allocateStatusMember(_ws, status);
+                    return PlanStage::FAILURE;
+                }
+                else {
+                    addToBuffer(item);
+                }
+
+                if (_memUsage > _specificStats.maxMemUsage) {
+                    _specificStats.maxMemUsage = _memUsage;
+                }
 
                 ++_commonStats.needTime;
                 return PlanStage::NEED_TIME;
@@ -375,8 +439,13 @@ namespace mongo {
             else if (PlanStage::IS_EOF == code) {
                 // TODO: We don't need the lock for this.  We could ask for a yield and do this work
                 // unlocked.  Also, this is performing a lot of work for one call to work(...)
-                sortBuffer();
-                _resultIterator = _data.begin();
+                if (NULL != _sorter.get()) {
+                    _spilledResults.reset(_sorter->done());
+                }
+                else {
+                    sortBuffer();
+                    _resultIterator = _data.begin();
+                }
                 _sorted = true;
                 ++_commonStats.needTime;
                 return PlanStage::NEED_TIME;
@@ -402,6 +471,33 @@ namespace mongo {
             }
         }
 
+        // Returning results read back from the external sorter.  They go back into the
+        // WorkingSet, without their DiskLoc if it was invalidated while they were spilled.
+        if (NULL != _spilledResults.get()) {
+            verify(_spilledResults->more());
+            SortStageSpilledResult result = _spilledResults->next().second;
+
+            *out = _ws->allocate();
+            WorkingSetMember* member = _ws->get(*out);
+            member->obj = result.obj.getOwned();
+            bool invalidated = result.loc.isNull();
+            if (!invalidated) {
+                InvalidationMap::const_iterator it = _invalidatedSinceSpill.find(result.loc);
+                invalidated = it != _invalidatedSinceSpill.end() && result.seq < it->second;
+            }
+
+            if (!invalidated) {
+                member->loc = result.loc;
+                member->state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+            }
+            else {
+                member->state = WorkingSetMember::OWNED_OBJ;
+            }
+
+            ++_commonStats.advanced;
+            return PlanStage::ADVANCED;
+        }
+
         // Returning results.
         verify(_resultIterator != _data.end());
         verify(_sorted);
@@ -434,6 +530,17 @@ namespace mongo {
         ++_commonStats.invalidates;
         _child->invalidate(dl, type);
 
+        // Whatever the sorter holds for 'dl' is the document from before the invalidation.  We
+        // only have to drop the DiskLoc when the result is read back.
+        if (NULL != _sorter.get()) {
+            long long& invalidatedAt = _invalidatedSinceSpill[dl];
+            if (invalidatedAt < _numSpilled) {
+                invalidatedAt = _numSpilled;
+                ++_specificStats.forcedFetches;
+            }
+            return;
+        }
+
         // If we have a deletion, we can fetch and carry on.
         // If we have a mutation, it's easier to fetch and use the previous document.
         // So, no matter what, fetch and keep the doc in play.
@@ -481,6 +588,7 @@ namespace mongo {
     }
 
     const SpecificStats* SortStage::getSpecificStats() {
+        _specificStats.memUsage = _memUsage;
         return &_specificStats;
     }
 
@@ -499,14 +607,17 @@ namespace mongo {
      *                     Updates memory usage if item was replaced.
      *     sortBuffer() - Does nothing.
      * limit > 1:
-     *     addToBuffer() - Does not update vector. Adds item to set.
-     *                     If size of set exceeds limit, remove item from set
-     *                     with lowest key. Updates memory usage accordingly.
-     *     sortBuffer() - Copies items from set to vectors.
+     *     addToBuffer() - Pushes item onto the max-heap in the vector.
+     *                     Once the heap holds limit items, a new item
+     *                     is only compared with the top of the heap,
+     *                     which it replaces if it has a lower key.
+     *                     Updates memory usage accordingly.
+     *     sortBuffer() - Sorts the heap in place.
      */
     void SortStage::addToBuffer(const SortableDataItem& item) {
         // Holds ID of working set member to be freed at end of this function.
         WorkingSetID wsidToFree = WorkingSet::INVALID_ID;
+        const WorkingSetComparator& cmp = *_sortKeyComparator;
 
         if (_limit == 0) {
             _data.push_back(item);
@@ -519,7 +630,6 @@ namespace mongo {
                 return;
             }
             wsidToFree = item.wsid;
-            const WorkingSetComparator& cmp = *_sortKeyComparator;
             // Compare new item with existing item in vector.
             if (cmp(item, _data[0])) {
                 wsidToFree = _data[0].wsid;
@@ -528,31 +638,25 @@ namespace mongo {
             }
         }
         else {
-            // Update data item set instead of vector
-            // Limit not reached - insert and return
-            vector<SortableDataItem>::size_type limit(_limit);
-            if (_dataSet->size() < limit) {
-                _dataSet->insert(item);
+            // Limit not reached - push onto the heap and return.
+            if (_data.size() < _limit) {
+                _data.push_back(item);
+                std::push_heap(_data.begin(), _data.end(), cmp);
                 _memUsage += _ws->get(item.wsid)->getMemUsage();
                 return;
             }
-            // Limit will be exceeded - compare with item with lowest key
-            // If new item does not have a lower key value than last item,
-            // do nothing.
+            // Limit will be exceeded - compare with the item with the highest key, which is at
+            // the top of the heap.  If the new item does not have a lower key, drop it right
+            // away.
             wsidToFree = item.wsid;
-            SortableDataItemSet::const_iterator lastItemIt = --(_dataSet->end());
-            const SortableDataItem& lastItem = *lastItemIt;
-            const WorkingSetComparator& cmp = *_sortKeyComparator;
-            if (cmp(item, lastItem)) {
+            if (cmp(item, _data.front())) {
+                const SortableDataItem& lastItem = _data.front();
                 _memUsage -= _ws->get(lastItem.wsid)->getMemUsage();
                 _memUsage += _ws->get(item.wsid)->getMemUsage();
                 wsidToFree = lastItem.wsid;
-                // According to std::set iterator validity rules,
-                // it does not matter which of erase()/insert() happens first.
-                // Here, we choose to erase first to release potential resources
-                // used by the last item and to keep the scope of the iterator to a minimum.
-                _dataSet->erase(lastItemIt);
-                _dataSet->insert(item);
+                std::pop_heap(_data.begin(), _data.end(), cmp);
+                _data.back() = item;
+                std::push_heap(_data.begin(), _data.end(), cmp);
             }
         }
 
@@ -568,8 +672,8 @@ namespace mongo {
     }
 
     void SortStage::sortBuffer() {
+        const WorkingSetComparator& cmp = *_sortKeyComparator;
         if (_limit == 0) {
-            const WorkingSetComparator& cmp = *_sortKeyComparator;
             std::sort(_data.begin(), _data.end(), cmp);
         }
         else if (_limit == 1) {
@@ -577,13 +681,64 @@ namespace mongo {
             return;
         }
         else {
-            // Set already contains items in sorted order, so we simply copy the items
-            // from the set to the vector.
-            // Release the memory for the set after the copy.
-            vector<SortableDataItem> newData(_dataSet->begin(), _dataSet->end());
-            _data.swap(newData);
-            _dataSet.reset();
+            std::sort_heap(_data.begin(), _data.end(), cmp);
         }
     }
 
+    // static
+    bool SortStage::canSpill(const WorkingSetMember& member) {
+        for (int i = 0; i < WSM_COMPUTED_NUM_TYPES; ++i) {
+            if (member.hasComputed(static_cast<WorkingSetComputedDataType>(i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool SortStage::spill() {
+        for (size_t i = 0; i < _data.size(); ++i) {
+            if (!canSpill(*_ws->get(_data[i].wsid))) {
+                return false;
+            }
+        }
+
+        SortOptions opts;
+        opts.limit = _limit;
+        opts.maxMemoryUsageBytes = kMaxBytes;
+        opts.extSortAllowed = true;
+        opts.tempDir = storageGlobalParams.dbpath + "/_tmp";
+
+        const SortStageSpilledResultComparator cmp(_sortKeyGen->getSortComparator());
+        _sorter.reset(ExternalSorter::make(opts, cmp));
+
+        for (size_t i = 0; i < _data.size(); ++i) {
+            addToSorter(_data[i]);
+        }
+        _data.clear();
+        _resultIterator = _data.end();
+        _wsidByDiskLoc.clear();
+
+        _specificStats.usedDisk = true;
+        return true;
+    }
+
+    void SortStage::addToSorter(const SortableDataItem& item) {
+        WorkingSetMember* member = _ws->get(item.wsid);
+
+        if (member->hasLoc()) {
+            _wsidByDiskLoc.erase(member->loc);
+        }
+
+        _sorter->add(item.sortKey.getOwned(),
+                     SortStageSpilledResult(member->obj.getOwned(), item.loc, _numSpilled++));
+        _ws->free(item.wsid);
+
+        _memUsage = _sorter->memUsed();
+    }
+
 }  // namespace mongo
+
+#include "mongo/db/sorter/sorter.cpp"
+MONGO_CREATE_SORTER(mongo::BSONObj,
+                    mongo::SortStageSpilledResult,
+                    mongo::SortStageSpilledResultComparator);
@@ -30,13 +30,13 @@
 
 #include <boost/scoped_ptr.hpp>
 #include <vector>
-#include <set>
 
 #include "mongo/db/diskloc.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/exec/working_set.h"
 #include "mongo/db/query/index_bounds.h"
+#include "mongo/db/sorter/sorter.h"
 #include "mongo/platform/unordered_map.h"
 
 
@@ -47,7 +47,7 @@ namespace mongo {
     // Parameters that must be provided to a SortStage
     class SortStageParams {
     public:
-        SortStageParams() : collection(NULL), limit(0) { }
+        SortStageParams() : collection(NULL), limit(0), allowDiskUse(false) { }
 
         // Used for resolving DiskLocs to BSON
         const Collection* collection;
@@ -60,6 +60,35 @@ namespace mongo {
 
         // Equal to 0 for no limit.
         size_t limit;
+
+        // May we write to temporary files once the buffered data exceeds our memory limit?
+        bool allowDiskUse;
+    };
+
+    /**
+     * A result that a SortStage has handed to the external sorter, and where it was read from.
+     * Implements the interface the Sorter requires of its values, see db/sorter/sorter.h.
+     */
+    struct SortStageSpilledResult {
+        struct SorterDeserializeSettings { };
+
+        SortStageSpilledResult() { }
+        SortStageSpilledResult(const BSONObj& o, const DiskLoc& l, long long s)
+            : obj(o), loc(l), seq(s) { }
+
+        void serializeForSorter(BufBuilder& buf) const;
+        static SortStageSpilledResult deserializeForSorter(BufReader& buf,
+                                                           const SorterDeserializeSettings&);
+        int memUsageForSorter() const;
+        SortStageSpilledResult getOwned() const;
+
+        BSONObj obj;
+
+        // Null if the result was invalidated before it was spilled.
+        DiskLoc loc;
+
+        // The order in which the result was given to the sorter.
+        long long seq;
     };
 
     /**
@@ -137,6 +166,14 @@ namespace mongo {
     /**
      * Sorts the input received from the child according to the sort pattern provided.
      *
+     * With a limit, only the best 'limit' results are kept, in a heap ordered on the sort key.
+     *
+     * The results are kept in the WorkingSet until they use more memory than we allow.  Then the
+     * sort fails, unless it may use the disk, in which case the buffered results and every later
+     * one are handed to an external Sorter and the sorted results are read back from it.  A
+     * spilled result that is invalidated keeps the document it had when it was spilled but loses
+     * its DiskLoc, like a buffered result that is fetched on invalidation.
+     *
      * Preconditions: For each field in 'pattern', all inputs in the child must handle a
      * getFieldDotted for that field.
      */
@@ -229,19 +266,33 @@ namespace mongo {
         };
 
         /**
-         * Inserts one item into data buffer (vector or set).
-         * If limit is exceeded, remove item with lowest key.
+         * Inserts one item into data buffer.
+         * If limit is exceeded, remove item with highest key.
          */
         void addToBuffer(const SortableDataItem& item);
 
         /**
          * Sorts data buffer.
          * Assumes no more items will be added to buffer.
-         * If data is stored in set, copy set
-         * contents to vector and clear set.
          */
         void sortBuffer();
 
+        /**
+         * Moves the buffered items into a new external sorter, which all later items go to
+         * directly.  Returns false, and leaves the buffer alone, if the items can't be spilled.
+         */
+        bool spill();
+
+        /**
+         * Hands the item's document, which is freed from the WorkingSet, to the external sorter.
+         */
+        void addToSorter(const SortableDataItem& item);
+
+        /**
+         * Can 'member' be spilled?  Computed data isn't kept by the external sorter.
+         */
+        static bool canSpill(const WorkingSetMember& member);
+
         // Comparator for data buffer
         // Initialization follows sort key generator
         scoped_ptr<WorkingSetComparator> _sortKeyComparator;
@@ -250,12 +301,9 @@ namespace mongo {
         // _data will contain sorted data when all data is gathered
         // and sorted.
         // When _limit is greater than 1 and not all data has been gathered from child stage,
-        // _dataSet is used instead to maintain an ordered set of the incomplete data set.
-        // When the data set is complete, we copy the items from _dataSet to _data which will
-        // be used to provide the results of this stage through _resultIterator.
+        // _data is a max-heap of at most _limit items, so that the item to drop when a better
+        // one arrives is always at the front.
         std::vector<SortableDataItem> _data;
-        typedef std::set<SortableDataItem, WorkingSetComparator> SortableDataItemSet;
-        scoped_ptr<SortableDataItemSet> _dataSet;
 
         // Iterates through _data post-sort returning it.
         std::vector<SortableDataItem>::iterator _resultIterator;
@@ -264,6 +312,31 @@ namespace mongo {
         typedef unordered_map<DiskLoc, WorkingSetID, DiskLoc::Hasher> DataMap;
         DataMap _wsidByDiskLoc;
 
+        //
+        // External sort
+        //
+
+        // May we spill to disk?
+        bool _allowDiskUse;
+
+        typedef Sorter<BSONObj, SortStageSpilledResult> ExternalSorter;
+
+        // Non-NULL once we have spilled.  Everything read from the child goes here from then on.
+        boost::scoped_ptr<ExternalSorter> _sorter;
+
+        // Iterates through the external sorter's output, once our child is EOF.
+        boost::scoped_ptr<ExternalSorter::Iterator> _spilledResults;
+
+        // The number of results given to the sorter so far.
+        long long _numSpilled;
+
+        // Maps each DiskLoc invalidated since we spilled to '_numSpilled' at its last
+        // invalidation.  Results read back with that DiskLoc lose it if they were given to the
+        // sorter before then.  A later result with the same DiskLoc is a newer document and
+        // keeps it.
+        typedef unordered_map<DiskLoc, long long, DiskLoc::Hasher> InvalidationMap;
+        InvalidationMap _invalidatedSinceSpill;
+
         //
         // Stats
         //
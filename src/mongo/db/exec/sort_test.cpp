@@ -203,6 +203,18 @@ namespace {
                  "{output: [{a: 3}, {a: 2}]}");
     }
 
+    TEST(SortStageTest, SortAscendingWithLimitKeepsSmallestKeys) {
+        testWork("{a: 1}", "{}", 3,
+                 "{input: [{a: 5}, {a: 8}, {a: 2}, {a: 7}, {a: 1}, {a: 9}, {a: 2}, {a: 4}]}",
+                 "{output: [{a: 1}, {a: 2}, {a: 2}]}");
+    }
+
+    TEST(SortStageTest, SortDescendingWithLimitKeepsLargestKeys) {
+        testWork("{a: -1}", "{}", 3,
+                 "{input: [{a: 5}, {a: 8}, {a: 2}, {a: 7}, {a: 1}, {a: 9}, {a: 2}, {a: 4}]}",
+                 "{output: [{a: 9}, {a: 8}, {a: 7}]}");
+    }
+
     //
     // Sorting with limit > size of data set
     // Implementation should retain top N items
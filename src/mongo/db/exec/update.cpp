@@ -495,7 +495,11 @@ namespace mongo {
         {
             WriteUnitOfWork wunit(request->getOpCtx());
 
-            if (inPlace && !driver->modsAffectIndices()) {
+            // Record stores that can't patch a record in place get the whole document instead,
+            // unless there is nothing to write.
+            if (inPlace && !driver->modsAffectIndices() &&
+                (_damages.empty() ||
+                 _collection->getRecordStore()->updateWithDamagesSupported())) {
                 // If a set of modifiers were all no-ops, we are still 'in place', but there
                 // is no work to do, in which case we want to consider the object unchanged.
                 if (!_damages.empty() ) {
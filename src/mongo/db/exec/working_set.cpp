@@ -28,30 +28,37 @@
 
 #include "mongo/db/exec/working_set.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "mongo/db/index/index_descriptor.h"
 
 namespace mongo {
 
+    // static
+    const size_t WorkingSet::kMembersPerSlab = 32;
+
     WorkingSet::MemberHolder::MemberHolder() : member(NULL) { }
     WorkingSet::MemberHolder::~MemberHolder() {}
 
     WorkingSet::WorkingSet() : _freeList(INVALID_ID) { }
 
     WorkingSet::~WorkingSet() {
-        for (size_t i = 0; i < _data.size(); i++) {
-            delete _data[i].member;
-        }
+        freeSlabs();
     }
 
     WorkingSetID WorkingSet::allocate() {
         if (_freeList == INVALID_ID) {
-            // The free list is empty so we need to make a single new WSM to return. This relies on
+            // The free list is empty so we need to hand out a new WSM. This relies on
             // vector::resize being amortized O(1) for efficient allocation. Note that the free list
             // remains empty until something is returned by a call to free().
             WorkingSetID id = _data.size();
+            if (0 == id % kMembersPerSlab) {
+                _slabs.push_back(new WorkingSetMember[kMembersPerSlab]);
+            }
             _data.resize(_data.size() + 1);
             _data.back().nextFreeOrSelf = id;
-            _data.back().member = new WorkingSetMember();
+            _data.back().member = &_slabs.back()[id % kMembersPerSlab];
             return id;
         }
 
@@ -89,9 +96,7 @@ namespace mongo {
     }
 
     void WorkingSet::clear() {
-        for (size_t i = 0; i < _data.size(); i++) {
-            delete _data[i].member;
-        }
+        freeSlabs();
         _data.clear();
 
         // Since working set is now empty, the free list pointer should
@@ -101,7 +106,16 @@ namespace mongo {
         _flagged.clear();
     }
 
-    WorkingSetMember::WorkingSetMember() : state(WorkingSetMember::INVALID) { }
+    void WorkingSet::freeSlabs() {
+        for (size_t i = 0; i < _slabs.size(); i++) {
+            delete[] _slabs[i];
+        }
+        _slabs.clear();
+    }
+
+    WorkingSetMember::WorkingSetMember() : state(WorkingSetMember::INVALID),
+                                           _keyStorageSize(0),
+                                           _keyStorageUsed(0) { }
 
     WorkingSetMember::~WorkingSetMember() { }
 
@@ -111,10 +125,39 @@ namespace mongo {
         }
 
         keyData.clear();
+        _keyStorageUsed = 0;
         obj = BSONObj();
         state = WorkingSetMember::INVALID;
     }
 
+    void WorkingSetMember::addKeyData(const BSONObj& keyPattern, const BSONObj& key) {
+        const size_t keySize = key.objsize();
+
+        if (_keyStorageUsed + keySize > _keyStorageSize) {
+            size_t newSize = std::max(_keyStorageSize * 2, _keyStorageUsed + keySize);
+            char* newStorage = new char[newSize];
+            if (_keyStorageUsed > 0) {
+                memcpy(newStorage, _keyStorage.get(), _keyStorageUsed);
+            }
+
+            // Keys already in our storage have moved.
+            for (size_t i = 0; i < keyData.size(); ++i) {
+                const char* data = keyData[i].keyData.objdata();
+                if (data >= _keyStorage.get() && data < _keyStorage.get() + _keyStorageUsed) {
+                    keyData[i].keyData = BSONObj(newStorage + (data - _keyStorage.get()));
+                }
+            }
+
+            _keyStorage.reset(newStorage);
+            _keyStorageSize = newSize;
+        }
+
+        char* dest = _keyStorage.get() + _keyStorageUsed;
+        memcpy(dest, key.objdata(), keySize);
+        _keyStorageUsed += keySize;
+        keyData.push_back(IndexKeyDatum(keyPattern, BSONObj(dest)));
+    }
+
     bool WorkingSetMember::hasLoc() const {
         return state == LOC_AND_IDX || state == LOC_AND_UNOWNED_OBJ;
     }
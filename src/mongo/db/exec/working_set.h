@@ -28,6 +28,7 @@
 
 #pragma once
 
+#include <boost/scoped_array.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <vector>
 
@@ -114,14 +115,27 @@ namespace mongo {
             // Free list link if freed. Points to self if in use.
             WorkingSetID nextFreeOrSelf;
 
-            // Owning pointer
+            // Points into one of _slabs.
             WorkingSetMember* member;
         };
 
+        // How many members are allocated together in each slab.
+        static const size_t kMembersPerSlab;
+
+        /**
+         * Deletes all the slabs, and with them every member.
+         */
+        void freeSlabs();
+
         // All WorkingSetIDs are indexes into this, except for INVALID_ID.
         // Elements are added to _freeList rather than removed when freed.
         std::vector<MemberHolder> _data;
 
+        // Owned arrays of kMembersPerSlab members each.  The member for id i is element
+        // i % kMembersPerSlab of slab i / kMembersPerSlab, so members never move and are reused,
+        // along with the memory they hold on to, when their id is reallocated.
+        std::vector<WorkingSetMember*> _slabs;
+
         // Index into _data, forming a linked-list using MemberHolder::nextFreeOrSelf as the next
         // link. INVALID_ID is the list terminator since 0 is a valid index.
         // If _freeList == INVALID_ID, the free list is empty and all elements in _data are in use.
@@ -143,7 +157,8 @@ namespace mongo {
         // This is not owned and points into the IndexDescriptor's data.
         BSONObj indexKeyPattern;
 
-        // This is the BSONObj for the key that we put into the index.  Owned by us.
+        // This is the BSONObj for the key that we put into the index.  Either owned, or stored in
+        // the key storage of the WorkingSetMember holding this datum (see addKeyData()).
         BSONObj keyData;
     };
 
@@ -234,6 +249,14 @@ namespace mongo {
         bool hasOwnedObj() const;
         bool hasUnownedObj() const;
 
+        /**
+         * Appends a copy of 'key' to keyData.  The copy lives in storage this member keeps across
+         * clear(), so once a reused member has held keys this size it doesn't allocate.  The key
+         * data is only valid until the member is cleared or freed; use getOwned() to keep it
+         * longer.
+         */
+        void addKeyData(const BSONObj& keyPattern, const BSONObj& key);
+
         //
         // Computed data
         //
@@ -260,6 +283,11 @@ namespace mongo {
 
     private:
         boost::scoped_ptr<WorkingSetComputedData> _computed[WSM_COMPUTED_NUM_TYPES];
+
+        // Holds the keys added with addKeyData() back to back.  Not released by clear().
+        boost::scoped_array<char> _keyStorage;
+        size_t _keyStorageSize;
+        size_t _keyStorageUsed;
     };
 
 }  // namespace mongo
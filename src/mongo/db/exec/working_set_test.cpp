@@ -31,12 +31,15 @@
  */
 
 #include <boost/scoped_ptr.hpp>
+#include <deque>
+#include <set>
 
 #include "mongo/db/exec/working_set.h"
 #include "mongo/db/json.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/unittest/unittest.h"
 #include "mongo/util/assert_util.h"
+#include "mongo/util/mongoutils/str.h"
 
 using namespace mongo;
 
@@ -147,4 +150,97 @@ namespace {
         ASSERT_FALSE(member->getFieldDotted("y", &elt));
     }
 
+    TEST_F(WorkingSetFixture, addKeyDataCopiesKey) {
+        BSONObj keyPattern = BSON("x" << 1 << "y" << 1);
+        member->state = WorkingSetMember::LOC_AND_IDX;
+        {
+            BSONObj key = BSON("" << 5 << "" << "foo");
+            member->addKeyData(keyPattern, key);
+            ASSERT_NOT_EQUALS(key.objdata(), member->keyData[0].keyData.objdata());
+        }
+
+        BSONElement elt;
+        ASSERT_TRUE(member->getFieldDotted("x", &elt));
+        ASSERT_EQUALS(elt.numberInt(), 5);
+        ASSERT_TRUE(member->getFieldDotted("y", &elt));
+        ASSERT_EQUALS(elt.str(), "foo");
+    }
+
+    TEST_F(WorkingSetFixture, addKeyDataGrowsStorage) {
+        // Enough keys that the storage has to grow, moving the keys added before.
+        const int numKeys = 100;
+        member->state = WorkingSetMember::LOC_AND_IDX;
+        for (int i = 0; i < numKeys; ++i) {
+            string fieldName = str::stream() << "f" << i;
+            member->addKeyData(BSON(fieldName << 1), BSON("" << i));
+        }
+
+        // Mixing in an owned key doesn't confuse it.
+        member->keyData.push_back(IndexKeyDatum(BSON("owned" << 1), BSON("" << -1)));
+        member->addKeyData(BSON("last" << 1), BSON("" << numKeys));
+
+        BSONElement elt;
+        for (int i = 0; i < numKeys; ++i) {
+            ASSERT_TRUE(member->getFieldDotted(str::stream() << "f" << i, &elt));
+            ASSERT_EQUALS(elt.numberInt(), i);
+        }
+        ASSERT_TRUE(member->getFieldDotted("owned", &elt));
+        ASSERT_EQUALS(elt.numberInt(), -1);
+        ASSERT_TRUE(member->getFieldDotted("last", &elt));
+        ASSERT_EQUALS(elt.numberInt(), numKeys);
+    }
+
+    TEST(WorkingSetTest, MembersStayPutWhileAllocating) {
+        WorkingSet ws;
+        vector<WorkingSetMember*> members;
+        for (size_t i = 0; i < 1000; ++i) {
+            WorkingSetID id = ws.allocate();
+            ASSERT_EQUALS(i, id);
+            WorkingSetMember* member = ws.get(id);
+            member->addKeyData(BSON("x" << 1), BSON("" << static_cast<int>(i)));
+            members.push_back(member);
+        }
+
+        for (size_t i = 0; i < members.size(); ++i) {
+            ASSERT_EQUALS(members[i], ws.get(i));
+            BSONObj key = members[i]->keyData[0].keyData;
+            ASSERT_EQUALS(static_cast<int>(i), key.firstElement().numberInt());
+        }
+    }
+
+    //
+    // The allocate(), addKeyData(), free() cycle of a covered index scan reuses its members and
+    // key buffers instead of allocating new ones per document.
+    //
+    TEST(WorkingSetTest, AllocationsPerCoveredDocument) {
+        const int numDocs = 100 * 1000;
+        const int numOutstanding = 4;
+        WorkingSet ws;
+        BSONObj keyPattern = BSON("a" << 1 << "b" << 1);
+
+        // Every member and key buffer we see had to be allocated at some point.
+        std::set<const WorkingSetMember*> members;
+        std::set<const char*> keyBuffers;
+
+        std::deque<WorkingSetID> outstanding;
+        for (int i = 0; i < numDocs; ++i) {
+            WorkingSetID id = ws.allocate();
+            WorkingSetMember* member = ws.get(id);
+            member->addKeyData(keyPattern, BSON("" << i << "" << "some string value"));
+            member->state = WorkingSetMember::LOC_AND_IDX;
+            members.insert(member);
+            keyBuffers.insert(member->keyData[0].keyData.objdata());
+
+            outstanding.push_back(id);
+            if (outstanding.size() > static_cast<size_t>(numOutstanding)) {
+                ws.free(outstanding.front());
+                outstanding.pop_front();
+            }
+        }
+
+        // Members and their key storage are reused rather than reallocated.
+        ASSERT_LESS_THAN_OR_EQUALS(members.size(), static_cast<size_t>(numOutstanding + 1));
+        ASSERT_LESS_THAN_OR_EQUALS(keyBuffers.size(), static_cast<size_t>(numOutstanding + 1));
+    }
+
 }  // namespace
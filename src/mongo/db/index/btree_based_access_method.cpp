@@ -198,12 +198,7 @@ namespace mongo {
     Status BtreeBasedAccessMethod::touch(OperationContext* txn, const BSONObj& obj) {
         BSONObjSet keys;
         getKeys(obj, &keys);
-
-        boost::scoped_ptr<SortedDataInterface::Cursor> cursor(_newInterface->newCursor(txn, 1));
-        for (BSONObjSet::const_iterator i = keys.begin(); i != keys.end(); ++i) {
-            cursor->locate(*i, DiskLoc());
-        }
-
+        _newInterface->prefetchKeys(txn, keys);
         return Status::OK();
     }
 
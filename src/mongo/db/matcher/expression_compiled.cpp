@@ -0,0 +1,296 @@
+/**
+ *    Copyright (C) 2014 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/db/matcher/expression_compiled.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "mongo/bson/bsonobjiterator.h"
+#include "mongo/db/matcher/expression_leaf.h"
+#include "mongo/util/mongoutils/str.h"
+
+namespace mongo {
+
+    namespace {
+
+        /**
+         * Estimates how much work a top-level predicate takes to rule out a document, with the
+         * most selective kinds of predicates being the cheapest.
+         */
+        int estimateCost(const MatchExpression* expr, bool compiled) {
+            if (!compiled) {
+                // Whole-document evaluation, with $where by far the most expensive.
+                return MatchExpression::WHERE == expr->matchType() ? 100 : 10;
+            }
+
+            switch (expr->matchType()) {
+            case MatchExpression::EQ:
+                return 1;
+            case MatchExpression::MATCH_IN:
+                return 2;
+            case MatchExpression::LT:
+            case MatchExpression::LTE:
+            case MatchExpression::GT:
+            case MatchExpression::GTE:
+                return 3;
+            case MatchExpression::MOD:
+                return 4;
+            case MatchExpression::REGEX:
+                return 5;
+            case MatchExpression::EXISTS:
+                return 6;
+            default:
+                return 10;
+            }
+        }
+
+        /**
+         * Can 'expr' be evaluated with LeafMatchExpression::matchesSingleElement on a top-level
+         * field?
+         */
+        bool isCompilableLeaf(const MatchExpression* expr) {
+            switch (expr->matchType()) {
+            case MatchExpression::EQ:
+            case MatchExpression::LT:
+            case MatchExpression::LTE:
+            case MatchExpression::GT:
+            case MatchExpression::GTE:
+            case MatchExpression::REGEX:
+            case MatchExpression::MOD:
+            case MatchExpression::EXISTS:
+            case MatchExpression::MATCH_IN:
+                break;
+            default:
+                return false;
+            }
+
+            // Dotted paths keep ElementPath's handling of arrays along the way.
+            return std::string::npos == expr->path().find('.');
+        }
+
+        bool isComparison(MatchExpression::MatchType type) {
+            return MatchExpression::EQ == type
+                || MatchExpression::LT == type
+                || MatchExpression::LTE == type
+                || MatchExpression::GT == type
+                || MatchExpression::GTE == type;
+        }
+
+        bool comparisonMatches(MatchExpression::MatchType type, int cmp) {
+            switch (type) {
+            case MatchExpression::LT:
+                return cmp < 0;
+            case MatchExpression::LTE:
+                return cmp <= 0;
+            case MatchExpression::EQ:
+                return cmp == 0;
+            case MatchExpression::GT:
+                return cmp > 0;
+            case MatchExpression::GTE:
+                return cmp >= 0;
+            default:
+                invariant(false);
+                return false;
+            }
+        }
+
+        struct PredicateCostLess {
+            template <typename P>
+            bool operator()(const P& lhs, const P& rhs) const {
+                return lhs.cost < rhs.cost;
+            }
+        };
+
+    }  // namespace
+
+    // static
+    CompiledMatchExpression* CompiledMatchExpression::compile(const MatchExpression* expr) {
+        if (NULL == expr) {
+            return NULL;
+        }
+
+        std::auto_ptr<CompiledMatchExpression> compiled(new CompiledMatchExpression());
+
+        if (MatchExpression::AND == expr->matchType()) {
+            for (size_t i = 0; i < expr->numChildren(); ++i) {
+                if (!compiled->addPredicate(expr->getChild(i))) {
+                    return NULL;
+                }
+            }
+        }
+        else if (!compiled->addPredicate(expr)) {
+            return NULL;
+        }
+
+        if (0 == compiled->numCompiledPredicates()) {
+            return NULL;
+        }
+
+        // Stable, so that predicates of the same cost keep the order the query gave them.
+        std::stable_sort(compiled->_predicates.begin(),
+                         compiled->_predicates.end(),
+                         PredicateCostLess());
+
+        return compiled.release();
+    }
+
+    bool CompiledMatchExpression::addPredicate(const MatchExpression* expr) {
+        Predicate pred;
+        pred.expr = expr;
+
+        if (isCompilableLeaf(expr)) {
+            const StringData path = expr->path();
+            std::vector<StringData>::const_iterator it =
+                std::find(_fields.begin(), _fields.end(), path);
+            if (_fields.end() == it) {
+                if (_fields.size() >= kMaxFields) {
+                    return false;
+                }
+                _fields.push_back(path);
+                it = _fields.end() - 1;
+            }
+            pred.field = it - _fields.begin();
+            pred.kind = LEAF;
+
+            if (isComparison(expr->matchType())) {
+                const BSONElement& rhs =
+                    static_cast<const ComparisonMatchExpression*>(expr)->getRHS();
+                if (NumberInt == rhs.type() || NumberLong == rhs.type()) {
+                    pred.kind = INTEGRAL_COMPARISON;
+                    pred.rhsType = rhs.type();
+                    pred.integralRHS = rhs.numberLong();
+                }
+                else if (String == rhs.type()) {
+                    pred.kind = STRING_COMPARISON;
+                    pred.rhsType = String;
+                    pred.stringRHS = StringData(rhs.valuestr(), rhs.valuestrsize());
+                }
+            }
+        }
+
+        pred.cost = estimateCost(expr, RESIDUAL != pred.kind);
+        _predicates.push_back(pred);
+        return true;
+    }
+
+    size_t CompiledMatchExpression::numCompiledPredicates() const {
+        size_t count = 0;
+        for (size_t i = 0; i < _predicates.size(); ++i) {
+            if (RESIDUAL != _predicates[i].kind) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    bool CompiledMatchExpression::matchesBSON(const BSONObj& doc) const {
+        // Look up every field the predicates need in one pass over the document.  Like
+        // BSONObj::getField, the first of several fields with the same name wins.  Missing
+        // fields stay EOO, which is what ElementPath hands a leaf for them.
+        BSONElement elts[kMaxFields];
+        const size_t numFields = _fields.size();
+        size_t numFound = 0;
+
+        BSONObjIterator it(doc);
+        while (numFound < numFields && it.more()) {
+            BSONElement elt = it.next();
+            const StringData name = elt.fieldNameStringData();
+            for (size_t i = 0; i < numFields; ++i) {
+                if (elts[i].eoo() && _fields[i] == name) {
+                    elts[i] = elt;
+                    ++numFound;
+                    break;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < _predicates.size(); ++i) {
+            const Predicate& pred = _predicates[i];
+
+            bool matched;
+            if (RESIDUAL == pred.kind || Array == elts[pred.field].type()) {
+                // Array fields match if any of their elements does, or the array as a whole.
+                matched = pred.expr->matchesBSON(doc);
+            }
+            else {
+                matched = matchesPredicate(pred, elts[pred.field]);
+            }
+
+            if (!matched) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool CompiledMatchExpression::matchesPredicate(const Predicate& pred,
+                                                   const BSONElement& elt) const {
+        if (INTEGRAL_COMPARISON == pred.kind && pred.rhsType == elt.type()) {
+            const long long lhs = elt.numberLong();
+            const int cmp = lhs < pred.integralRHS ? -1 : (lhs == pred.integralRHS ? 0 : 1);
+            return comparisonMatches(pred.expr->matchType(), cmp);
+        }
+
+        if (STRING_COMPARISON == pred.kind && String == elt.type()) {
+            // Same as compareElementValues: memcmp, then the longer string is the greater one.
+            const int lsz = elt.valuestrsize();
+            const int rsz = pred.stringRHS.size();
+            int cmp = memcmp(elt.valuestr(), pred.stringRHS.rawData(), std::min(lsz, rsz));
+            if (0 == cmp) {
+                cmp = lsz - rsz;
+            }
+            return comparisonMatches(pred.expr->matchType(), cmp);
+        }
+
+        return static_cast<const LeafMatchExpression*>(pred.expr)->matchesSingleElement(elt);
+    }
+
+    std::string CompiledMatchExpression::toString() const {
+        mongoutils::str::stream ss;
+        ss << "fields:";
+        for (size_t i = 0; i < _fields.size(); ++i) {
+            ss << " " << _fields[i];
+        }
+        ss << "\n";
+        for (size_t i = 0; i < _predicates.size(); ++i) {
+            const Predicate& pred = _predicates[i];
+            if (RESIDUAL == pred.kind) {
+                ss << "residual";
+            }
+            else {
+                ss << "field " << pred.field;
+            }
+            // Ends with a newline.
+            ss << ", cost " << pred.cost << ": " << pred.expr->toString();
+        }
+        return ss;
+    }
+
+}  // namespace mongo
@@ -0,0 +1,132 @@
+/**
+ *    Copyright (C) 2014 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/base/string_data.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/db/matcher/expression.h"
+
+namespace mongo {
+
+    /**
+     * A flattened form of a MatchExpression for filters that are tested against many documents.
+     *
+     * The top-level conjuncts of the expression become a list of predicates, ordered so that the
+     * ones most likely to reject a document run first.  Predicates on top-level fields read their
+     * field from a table filled in by a single pass over the document, and comparisons of ints,
+     * longs and strings are evaluated inline.  Anything else, and any field holding an array, is
+     * handed to the original MatchExpression node, so results always agree with
+     * MatchExpression::matchesBSON.
+     *
+     * Does not own the expression, which must outlive the compiled form.
+     */
+    class CompiledMatchExpression {
+        MONGO_DISALLOW_COPYING(CompiledMatchExpression);
+    public:
+        /**
+         * Returns NULL if none of the top-level conjuncts of 'expr' can be evaluated any faster
+         * than by the expression itself.  The caller owns the result.
+         */
+        static CompiledMatchExpression* compile(const MatchExpression* expr);
+
+        /**
+         * Same as expr->matchesBSON(doc), for the expression this was compiled from.
+         */
+        bool matchesBSON(const BSONObj& doc) const;
+
+        /**
+         * The number of top-level predicates that read their field from the field table.
+         */
+        size_t numCompiledPredicates() const;
+
+        std::string toString() const;
+
+        // The most distinct top-level fields a compiled expression looks up.
+        static const size_t kMaxFields = 16;
+
+    private:
+        enum PredicateKind {
+            // Compare a NumberInt or NumberLong field with a constant of the same type.
+            INTEGRAL_COMPARISON,
+
+            // Compare a String field with a String constant.
+            STRING_COMPARISON,
+
+            // Any other leaf: matchesSingleElement() on the field.
+            LEAF,
+
+            // Not compiled: matchesBSON() on the whole document.
+            RESIDUAL
+        };
+
+        struct Predicate {
+            Predicate() : expr(NULL),
+                          kind(RESIDUAL),
+                          field(-1),
+                          cost(0),
+                          rhsType(EOO),
+                          integralRHS(0) { }
+
+            const MatchExpression* expr;
+            PredicateKind kind;
+
+            // Index into the field table, or -1 for residual predicates.
+            int field;
+
+            // Rough guess at the work needed to rule a document out; lower runs first.
+            int cost;
+
+            // The constant of INTEGRAL_COMPARISON and STRING_COMPARISON predicates.  The string
+            // includes its terminating NUL, as BSON string comparisons do.
+            BSONType rhsType;
+            long long integralRHS;
+            StringData stringRHS;
+        };
+
+        CompiledMatchExpression() { }
+
+        /**
+         * Adds the predicate for the top-level conjunct 'expr'.  Returns false if the field
+         * table is full.
+         */
+        bool addPredicate(const MatchExpression* expr);
+
+        bool matchesPredicate(const Predicate& pred, const BSONElement& elt) const;
+
+        // The distinct top-level fields the predicates read.
+        std::vector<StringData> _fields;
+
+        // In evaluation order.
+        std::vector<Predicate> _predicates;
+    };
+
+}  // namespace mongo
@@ -0,0 +1,178 @@
+/**
+ *    Copyright (C) 2014 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+/** Unit tests for CompiledMatchExpression. */
+
+#include "mongo/unittest/unittest.h"
+
+#include <boost/scoped_ptr.hpp>
+
+#include "mongo/db/json.h"
+#include "mongo/db/matcher/expression_compiled.h"
+#include "mongo/db/matcher/expression_parser.h"
+
+namespace mongo {
+
+    using boost::scoped_ptr;
+
+    namespace {
+
+        // Documents every query below is tested against.
+        const char* const kDocs[] = {
+            "{}",
+            "{a: 1}",
+            "{a: 5, b: 'x'}",
+            "{a: NumberLong(5), b: 'xy'}",
+            "{a: 5.0, b: 'x\\u0000y'}",
+            "{a: null, b: 'w'}",
+            "{a: [1, 5, 9], b: ['x', 'z']}",
+            "{a: [], b: [[]]}",
+            "{a: {c: 5}, b: {c: 'x'}}",
+            "{b: 'x', a: 7, c: 3}",
+            "{a: 'x', b: 5}",
+            "{a: NaN, b: ''}",
+            "{a: 2147483648, b: 'xyz'}",
+            "{a: 5, a: 6}",
+            "{a: {$minKey: 1}, b: {$maxKey: 1}}",
+        };
+
+        MatchExpression* parse(const char* query) {
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(fromjson(query));
+            ASSERT_OK(swme.getStatus());
+            return swme.getValue();
+        }
+
+        /**
+         * Checks that the compiled form of 'query' matches the same documents as the
+         * interpreted form.
+         */
+        void assertSameResults(const char* query) {
+            scoped_ptr<MatchExpression> expr(parse(query));
+            scoped_ptr<CompiledMatchExpression> compiled(
+                CompiledMatchExpression::compile(expr.get()));
+            ASSERT(NULL != compiled.get());
+
+            for (size_t i = 0; i < sizeof(kDocs) / sizeof(kDocs[0]); ++i) {
+                BSONObj doc = fromjson(kDocs[i]);
+                if (expr->matchesBSON(doc) != compiled->matchesBSON(doc)) {
+                    FAIL(str::stream() << "query " << query << " and document " << doc
+                                       << " give different results");
+                }
+            }
+        }
+
+        TEST(CompiledMatchExpressionTest, Comparisons) {
+            assertSameResults("{a: 5}");
+            assertSameResults("{a: NumberLong(5)}");
+            assertSameResults("{a: {$lt: 5}}");
+            assertSameResults("{a: {$lte: NumberLong(5)}}");
+            assertSameResults("{a: {$gt: 1}}");
+            assertSameResults("{a: {$gte: 5.0}}");
+            assertSameResults("{a: null}");
+            assertSameResults("{a: {$gt: {$minKey: 1}}}");
+            assertSameResults("{b: 'x'}");
+            assertSameResults("{b: {$lt: 'xy'}}");
+            assertSameResults("{b: {$gte: 'x'}}");
+        }
+
+        TEST(CompiledMatchExpressionTest, OtherLeaves) {
+            assertSameResults("{a: {$in: [1, null, 'x']}}");
+            assertSameResults("{a: {$exists: true}}");
+            assertSameResults("{a: {$mod: [2, 1]}}");
+            assertSameResults("{b: /^x/}");
+            assertSameResults("{a: {c: 5}}");
+            assertSameResults("{a: []}");
+            assertSameResults("{a: [1, 5, 9]}");
+        }
+
+        TEST(CompiledMatchExpressionTest, Conjunctions) {
+            assertSameResults("{a: 5, b: 'x'}");
+            assertSameResults("{a: {$gt: 1, $lt: 9}, b: {$exists: true}}");
+            assertSameResults("{b: 'x', a: {$in: [5, 7]}}");
+            assertSameResults("{a: {$gte: 1}, 'a.c': 5}");
+            assertSameResults("{a: {$ne: 5}, b: {$type: 2}}");
+            assertSameResults("{a: {$exists: true}, $or: [{b: 'x'}, {c: 3}]}");
+            assertSameResults("{a: {$gt: 1}, b: {$elemMatch: {$eq: 'z'}}}");
+        }
+
+        TEST(CompiledMatchExpressionTest, NothingToCompile) {
+            const char* queries[] = {
+                "{}",
+                "{'a.c': 5}",
+                "{$or: [{a: 1}, {b: 2}]}",
+                "{a: {$ne: 5}}",
+                "{a: {$size: 2}}",
+            };
+            for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); ++i) {
+                scoped_ptr<MatchExpression> expr(parse(queries[i]));
+                scoped_ptr<CompiledMatchExpression> compiled(
+                    CompiledMatchExpression::compile(expr.get()));
+                ASSERT(NULL == compiled.get());
+            }
+            ASSERT(NULL == CompiledMatchExpression::compile(NULL));
+        }
+
+        TEST(CompiledMatchExpressionTest, TooManyFields) {
+            BSONObjBuilder bob;
+            for (size_t i = 0; i <= CompiledMatchExpression::kMaxFields; ++i) {
+                bob.append(std::string(str::stream() << "f" << i), 1);
+            }
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(bob.obj());
+            ASSERT_OK(swme.getStatus());
+            scoped_ptr<MatchExpression> expr(swme.getValue());
+            scoped_ptr<CompiledMatchExpression> compiled(
+                CompiledMatchExpression::compile(expr.get()));
+            ASSERT(NULL == compiled.get());
+        }
+
+        TEST(CompiledMatchExpressionTest, SelectivePredicatesFirst) {
+            scoped_ptr<MatchExpression> expr(
+                parse("{c: {$exists: true}, d: {$ne: 1}, b: {$gt: 1}, a: 5}"));
+            scoped_ptr<CompiledMatchExpression> compiled(
+                CompiledMatchExpression::compile(expr.get()));
+            ASSERT(NULL != compiled.get());
+            ASSERT_EQUALS(3U, compiled->numCompiledPredicates());
+
+            // Equality, then the range, then $exists, then the uncompiled $ne.
+            const std::string program = compiled->toString();
+            const size_t eq = program.find("a ==");
+            const size_t range = program.find("b $gt");
+            const size_t exists = program.find("c exists");
+            const size_t ne = program.find("$not");
+            ASSERT_NOT_EQUALS(std::string::npos, eq);
+            ASSERT_NOT_EQUALS(std::string::npos, range);
+            ASSERT_NOT_EQUALS(std::string::npos, exists);
+            ASSERT_NOT_EQUALS(std::string::npos, ne);
+            ASSERT_LESS_THAN(eq, range);
+            ASSERT_LESS_THAN(range, exists);
+            ASSERT_LESS_THAN(exists, ne);
+        }
+
+    }  // namespace
+
+}  // namespace mongo
@@ -40,37 +40,52 @@ namespace mongo {
     using namespace mongoutils;
 
     Position DocumentStorage::findField(StringData requested) const {
-        int reqSize = requested.size(); // get size calculation out of the way if needed
+        if (_lazy)
+            loadLazyFields();
 
-        if (_numFields >= HASH_TAB_MIN) { // hash lookup
-            const unsigned bucket = bucketForKey(requested);
+        if (_numFields >= HASH_TAB_MIN) // hash lookup
+            return findField(requested, hashKey(requested));
 
-            Position pos = _hashTab[bucket];
-            while (pos.found()) {
-                const ValueElement& elem = getField(pos);
-                if (elem.nameLen == reqSize
-                    && memcmp(requested.rawData(), elem._name, reqSize) == 0) {
-                    return pos;
-                }
-
-                // possible collision
-                pos = elem.nextCollision;
+        // linear scan
+        int reqSize = requested.size();
+        for (DocumentStorageIterator it = iteratorAll(); !it.atEnd(); it.advance()) {
+            if (it->nameLen == reqSize
+                && memcmp(requested.rawData(), it->_name, reqSize) == 0) {
+                return it.position();
             }
         }
-        else { // linear scan
-            for (DocumentStorageIterator it = iteratorAll(); !it.atEnd(); it.advance()) {
-                if (it->nameLen == reqSize
-                    && memcmp(requested.rawData(), it->_name, reqSize) == 0) {
-                    return it.position();
-                }
+
+        // if we got here, there's no such field
+        return Position();
+    }
+
+    Position DocumentStorage::findField(StringData requested, unsigned hash) const {
+        if (_lazy)
+            loadLazyFields();
+
+        if (_numFields < HASH_TAB_MIN)
+            return findField(requested);
+
+        int reqSize = requested.size();
+        Position pos = _hashTab[hash & _hashTabMask];
+        while (pos.found()) {
+            const ValueElement& elem = getField(pos);
+            if (elem.nameLen == reqSize
+                && memcmp(requested.rawData(), elem._name, reqSize) == 0) {
+                return pos;
             }
+
+            // possible collision
+            pos = elem.nextCollision;
         }
 
-        // if we got here, there's no such field
         return Position();
     }
 
     Value& DocumentStorage::appendField(StringData name) {
+        if (_lazy)
+            loadLazyFields();
+
         Position pos = getNextPosition();
         const int nameSize = name.size();
 
@@ -182,6 +197,9 @@ namespace mongo {
     }
 
     intrusive_ptr<DocumentStorage> DocumentStorage::clone() const {
+        if (_lazy)
+            loadLazyFields();
+
         intrusive_ptr<DocumentStorage> out (new DocumentStorage());
 
         // Make a copy of the buffer.
@@ -209,11 +227,77 @@ namespace mongo {
     DocumentStorage::~DocumentStorage() {
         boost::scoped_array<char> deleteBufferAtScopeEnd (_buffer);
 
-        for (DocumentStorageIterator it = iteratorAll(); !it.atEnd(); it.advance()) {
+        // Not iteratorAll(), which would convert the fields of a lazy storage.
+        for (DocumentStorageIterator it(_firstElement, end(), true); !it.atEnd(); it.advance()) {
             it->val.~Value(); // explicit destructor call
         }
     }
 
+    DocumentStorage::DocumentStorage(const BSONObj& bson)
+        : _buffer(NULL)
+        , _bufferEnd(NULL)
+        , _usedBytes(0)
+        , _numFields(0)
+        , _hashTabMask(0)
+        , _hasTextScore(false)
+        , _textScore(0)
+        , _lazy(true)
+        , _bson(bson)
+    {
+        dassert(bson.isOwned());
+    }
+
+    Value DocumentStorage::getLazyField(StringData name) const {
+        if (_lazyFields.empty()) {
+            _lazyFields.reserve(_bson.nFields());
+            BSONObjIterator it(_bson);
+            while (it.more()) {
+                _lazyFields.push_back(LazyField(it.next()));
+            }
+        }
+
+        // Like BSONObj::getField, the first of several fields with the same name wins.
+        for (size_t i = 0; i < _lazyFields.size(); i++) {
+            LazyField& field = _lazyFields[i];
+            if (field.elem.fieldNameStringData() == name) {
+                if (field.val.missing())
+                    field.val = Value(field.elem);
+                return field.val;
+            }
+        }
+
+        return Value();
+    }
+
+    void DocumentStorage::loadLazyFields() const {
+        // Only storages made with new are ever lazy, so this is not really const.
+        DocumentStorage* self = const_cast<DocumentStorage*>(this);
+
+        // Appending fields needs the storage to look loaded. The BSON stays alive until the end
+        // of this function since field names point into it.
+        const BSONObj bson = _bson;
+        std::vector<LazyField> lazyFields;
+        lazyFields.swap(_lazyFields);
+        _lazy = false;
+        _bson = BSONObj();
+
+        self->reserveFields(bson.nFields());
+        if (lazyFields.empty()) {
+            BSONObjIterator it(bson);
+            while (it.more()) {
+                BSONElement elem(it.next());
+                self->appendField(elem.fieldNameStringData()) = Value(elem);
+            }
+        }
+        else {
+            for (size_t i = 0; i < lazyFields.size(); i++) {
+                const LazyField& field = lazyFields[i];
+                self->appendField(field.elem.fieldNameStringData()) =
+                    field.val.missing() ? Value(field.elem) : field.val;
+            }
+        }
+    }
+
     Document::Document(const BSONObj& bson) {
         MutableDocument md(bson.nFields());
 
@@ -234,6 +318,12 @@ namespace mongo {
     }
 
     void Document::toBson(BSONObjBuilder* pBuilder) const {
+        if (storage().isLazy()) {
+            // The fields are unchanged from the BSON, so there is nothing to convert back.
+            pBuilder->appendElements(storage().lazyBson());
+            return;
+        }
+
         for (DocumentStorageIterator it = storage().iterator(); !it.atEnd(); it.advance()) {
             *pBuilder << it->nameSD() << it->val;
         }
@@ -275,6 +365,19 @@ namespace mongo {
         return md.freeze();
     }
 
+    Document Document::fromBsonLazy(const BSONObj& bson) {
+        // Metadata has to be parsed out, so only documents without any can stay as BSON.
+        if (bson.hasField(metaFieldTextScore))
+            return fromBsonWithMetaData(bson);
+
+        return Document(new DocumentStorage(bson.getOwned()));
+    }
+
+    void Document::loadLazyFields() const {
+        if (_storage && _storage->isLazy())
+            _storage->loadLazyFields();
+    }
+
     MutableDocument::MutableDocument(size_t expectedFields)
         : _storageHolder(NULL)
         , _storage(_storageHolder)
@@ -353,6 +456,9 @@ namespace mongo {
         size_t size = sizeof(DocumentStorage);
         size += storage().allocatedBytes();
 
+        if (storage().isLazy())
+            return size; // Values made by lookups are small next to the BSON they came from.
+
         for (DocumentStorageIterator it = storage().iterator(); !it.atEnd(); it.advance()) {
             size += it->val.getApproximateSize();
             size -= sizeof(Value); // already accounted for above
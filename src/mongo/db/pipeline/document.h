@@ -77,6 +77,14 @@ namespace mongo {
         const Value operator[] (StringData key) const { return getField(key); }
         const Value getField(StringData key) const { return storage().getField(key); }
 
+        /** Same as getField(key), where 'hash' is hashFieldName(key).  Saves hashing a name that is
+         *  looked up in many Documents.
+         */
+        const Value getField(StringData key, unsigned hash) const {
+            return storage().getField(key, hash);
+        }
+        static unsigned hashFieldName(StringData key) { return DocumentStorage::hashKey(key); }
+
         /// Look up a field by Position. See positionOf and getNestedField.
         const Value operator[] (Position pos) const { return getField(pos); }
         const Value getField(Position pos) const { return storage().getField(pos).val; }
@@ -94,7 +102,11 @@ namespace mongo {
         size_t size() const { return storage().size(); }
 
         /// True if this document has no fields.
-        bool empty() const { return !_storage || storage().iterator().atEnd(); }
+        bool empty() const {
+            if (_storage && storage().isLazy())
+                return storage().lazyBson().isEmpty();
+            return !_storage || storage().iterator().atEnd();
+        }
 
         /// Create a new FieldIterator that can be used to examine the Document's fields in order.
         FieldIterator fieldIterator() const;
@@ -155,6 +167,20 @@ namespace mongo {
          */
         static Document fromBsonWithMetaData(const BSONObj& bson);
 
+        /**
+         * Like fromBsonWithMetaData, but keeps a copy of the BSON and only converts a field to a
+         * Value when it is looked up by name.  Iterating or modifying the Document converts all
+         * of its fields.  A Document that is never changed goes back to BSON by copying the
+         * original.
+         */
+        static Document fromBsonLazy(const BSONObj& bson);
+
+        /**
+         * Converts any fields still held as BSON.  Call before sharing a Document made with
+         * fromBsonLazy between threads.
+         */
+        void loadLazyFields() const;
+
         // Support BSONObjBuilder and BSONArrayBuilder "stream" API
         friend BSONObjBuilder& operator << (BSONObjBuilderValueStream& builder, const Document& d);
 
@@ -29,6 +29,7 @@
 #pragma once
 
 #include <third_party/murmurhash3/MurmurHash3.h>
+#include <vector>
 
 #include "mongo/util/intrusive_counter.h"
 #include "mongo/db/pipeline/value.h"
@@ -157,7 +158,14 @@ namespace mongo {
         bool _includeMissing;
     };
 
-    /// Storage class used by both Document and MutableDocument
+    /** Storage class used by both Document and MutableDocument
+     *
+     *  A DocumentStorage may be lazy: it wraps a BSONObj and only converts fields to Values when
+     *  they are looked up by name.  Anything else that needs the fields (iteration, Positions,
+     *  modification) converts all of them first, after which the storage is like any other.
+     *  Since that happens inside const methods, a lazy DocumentStorage must not be read from
+     *  several threads at once; see Document::loadLazyFields().
+     */
     class DocumentStorage :  public RefCountable {
     public:
         // Note: default constructor should zero-init to support emptyDoc()
@@ -168,7 +176,12 @@ namespace mongo {
                           , _hashTabMask(0)
                           , _hasTextScore(false)
                           , _textScore(0)
+                          , _lazy(false)
         {}
+
+        /// Lazy storage for the fields of 'bson', which must be owned.
+        explicit DocumentStorage(const BSONObj& bson);
+
         ~DocumentStorage();
 
         static const DocumentStorage& emptyDoc() {
@@ -177,6 +190,9 @@ namespace mongo {
         }
 
         size_t size() const {
+            if (_lazy)
+                return _bson.nFields();
+
             // can't use _numFields because it includes removed Fields
             size_t count = 0;
             for (DocumentStorageIterator it = iterator(); !it.atEnd(); it.advance())
@@ -190,21 +206,38 @@ namespace mongo {
         /// Returns the position of the named field (may be missing) or Position()
         Position findField(StringData name) const;
 
+        /// Same as findField(name), where 'hash' is hashKey(name).
+        Position findField(StringData name, unsigned hash) const;
+
         // Document uses these
         const ValueElement& getField(Position pos) const {
             verify(pos.found());
+            if (_lazy)
+                loadLazyFields();
             return *(_firstElement->plusBytes(pos.index));
         }
         Value getField(StringData name) const {
+            if (_lazy)
+                return getLazyField(name);
             Position pos = findField(name);
             if (!pos.found())
                 return Value();
             return getField(pos).val;
         }
+        Value getField(StringData name, unsigned hash) const {
+            if (_lazy)
+                return getLazyField(name);
+            Position pos = findField(name, hash);
+            if (!pos.found())
+                return Value();
+            return getField(pos).val;
+        }
 
         // MutableDocument uses these
         ValueElement& getField(Position pos) {
             verify(pos.found());
+            if (_lazy)
+                loadLazyFields();
             return *(_firstElement->plusBytes(pos.index));
         }
         Value& getField(StringData name) {
@@ -224,11 +257,15 @@ namespace mongo {
 
         /// This skips missing values
         DocumentStorageIterator iterator() const {
+            if (_lazy)
+                loadLazyFields();
             return DocumentStorageIterator(_firstElement, end(), false);
         }
 
         /// This includes missing values
         DocumentStorageIterator iteratorAll() const {
+            if (_lazy)
+                loadLazyFields();
             return DocumentStorageIterator(_firstElement, end(), true);
         }
 
@@ -236,9 +273,31 @@ namespace mongo {
         intrusive_ptr<DocumentStorage> clone() const;
 
         size_t allocatedBytes() const {
+            if (_lazy)
+                return _bson.objsize() + _lazyFields.capacity() * sizeof(LazyField);
             return !_buffer ? 0 : (_bufferEnd - _buffer + hashTabBytes());
         }
 
+        /// True while the fields still live in the BSON this storage was made from.
+        bool isLazy() const { return _lazy; }
+
+        /// The BSON the fields of a lazy storage come from.
+        const BSONObj& lazyBson() const {
+            verify(_lazy);
+            return _bson;
+        }
+
+        /// Converts every field of a lazy storage, in BSON order.
+        void loadLazyFields() const;
+
+        /// The hash that places a field named 'name' in the hash table.
+        static unsigned hashKey(StringData name) {
+            // TODO consider FNV-1a once we have a better benchmark corpus
+            unsigned out;
+            MurmurHash3_x86_32(name.rawData(), name.size(), 0, &out);
+            return out;
+        }
+
         /**
          * Copies all metadata from source if it has any.
          * Note: does not clear metadata from this.
@@ -258,6 +317,9 @@ namespace mongo {
 
     private:
 
+        /// Named lookup in a lazy storage.  Converts only the field looked up.
+        Value getLazyField(StringData name) const;
+
         /// Same as lastElement->next() or firstElement() if empty.
         const ValueElement* end() const { return _firstElement->plusBytes(_usedBytes); }
 
@@ -277,13 +339,6 @@ namespace mongo {
         /// Initialize empty hash table
         void hashTabInit() { memset(_hashTab, -1, hashTabBytes()); }
 
-        static unsigned hashKey(StringData name) {
-            // TODO consider FNV-1a once we have a better benchmark corpus
-            unsigned out;
-            MurmurHash3_x86_32(name.rawData(), name.size(), 0, &out);
-            return out;
-        }
-
         unsigned bucketForKey(StringData name) const {
             return hashKey(name) & _hashTabMask;
         }
@@ -327,6 +382,19 @@ namespace mongo {
 
         bool _hasTextScore; // When adding more metadata fields, this should become a bitvector
         double _textScore;
+
+        // A field of a lazy storage, and its Value once it has been looked up.
+        struct LazyField {
+            explicit LazyField(const BSONElement& e) : elem(e) {}
+            BSONElement elem;
+            Value val; // missing until converted
+        };
+
+        // Lazy storage. Only touched if _lazy, since emptyDoc() is all zeros.
+        mutable bool _lazy;
+        mutable BSONObj _bson;
+        mutable std::vector<LazyField> _lazyFields; // field-offset cache, filled on first lookup
+
         // When adding a field, make sure to update clone() method
     };
 }
@@ -155,6 +155,13 @@ namespace mongo {
         /// Returns true if doesn't require an input source (most DocumentSources do).
         virtual bool isValidInitialSource() const { return false; }
 
+        /**
+         * Returns a sort pattern that this source's output is known to follow, with documents
+         * whose values for its fields are equal next to each other. The default is an empty
+         * object, meaning no order is known.
+         */
+        virtual BSONObj getOutputSort() const { return BSONObj(); }
+
     protected:
         /**
            Base constructor.
@@ -351,6 +358,7 @@ namespace mongo {
         virtual bool coalesce(const intrusive_ptr<DocumentSource>& nextSource);
         virtual bool isValidInitialSource() const { return true; }
         virtual void dispose();
+        virtual BSONObj getOutputSort() const { return _providedSort; }
 
         /**
          * Create a document source based on a passed-in PlanExecutor.
@@ -389,6 +397,14 @@ namespace mongo {
          */
         void setSort(const BSONObj& sort) { _sort = sort; }
 
+        /**
+         * Record that the cursor returns documents ordered by sort with documents whose sort keys
+         * are equal next to each other, so later stages can rely on that order. This does not
+         * hold for every sort the cursor provides: a multikey index orders a document by one
+         * element of an array rather than by the whole array.
+         */
+        void setProvidedSort(const BSONObj& sort) { _providedSort = sort; }
+
         /**
          * Informs this object of projection and dependency information.
          *
@@ -414,6 +430,7 @@ namespace mongo {
         // BSONObj members must outlive _projection and cursor.
         BSONObj _query;
         BSONObj _sort;
+        BSONObj _providedSort;
         BSONObj _projection;
         boost::optional<ParsedDeps> _dependencies;
         intrusive_ptr<DocumentSourceLimit> _limit;
@@ -424,6 +441,12 @@ namespace mongo {
     };
 
 
+    /**
+     * Number of worker threads a $group hash-partitions its input across. Below 2, $group runs on
+     * the thread executing the pipeline.
+     */
+    extern int internalDocumentSourceGroupThreads;
+
     class DocumentSourceGroup : public DocumentSource
                               , public SplittableDocumentSource {
     public:
@@ -463,6 +486,29 @@ namespace mongo {
         /// Tell this source if it is doing a merge from shards. Defaults to false.
         void setDoingMerge(bool doingMerge) { _doingMerge = doingMerge; }
 
+        /**
+         * Returns true if input ordered by sortPattern has all documents of each group next to
+         * each other. That is the case when the _id is made of field paths which, taken as a set,
+         * are the leading fields of sortPattern.
+         */
+        bool isGroupedBySort(const BSONObj& sortPattern) const;
+
+        /**
+         * Tell this source to output each group as soon as the _id of its input changes, rather
+         * than hashing all of its input first. Only valid for input ordered such that
+         * isGroupedBySort() is true. Defaults to false.
+         */
+        void setStreaming(bool streaming) { _streaming = streaming; }
+        bool isStreaming() const { return _streaming; }
+
+        /**
+         * Returns true if the output only depends on one document of each group: the _id is a
+         * single field path, and every accumulator is $first or every one is $last (*useLast).
+         * Given input ordered by a sort that starts with that field, only the first (or last)
+         * document of each group is needed. Sets *idField to the path.
+         */
+        bool isFirstOrLastPerGroup(std::string* idField, bool* useLast) const;
+
         /**
           Create a grouping DocumentSource from BSON.
 
@@ -487,12 +533,6 @@ namespace mongo {
     private:
         DocumentSourceGroup(const intrusive_ptr<ExpressionContext> &pExpCtx);
 
-        /// Spill groups map to disk and returns an iterator to the file.
-        shared_ptr<Sorter<Value, Value>::Iterator> spill();
-
-        // Only used by spill. Would be function-local if that were legal in C++03.
-        class SpillSTLComparator;
-
         /*
           Before returning anything, this source must fetch everything from
           the underlying source and group it.  populate() is used to do that
@@ -502,6 +542,9 @@ namespace mongo {
         void populate();
         bool populated;
 
+        /// getNext() when _streaming.
+        boost::optional<Document> getNextStreaming();
+
         /**
          * Parses the raw id expression into _idExpressions and possibly _idFieldNames.
          */
@@ -523,6 +566,62 @@ namespace mongo {
         typedef boost::unordered_map<Value, Accumulators, Value::Hash> GroupsMap;
         GroupsMap groups;
 
+        /**
+         * Finds or creates the group for id in groupsMap and feeds its accumulators the document
+         * that is ROOT in vars. memoryUsageBytes is kept up to date with the map's size.
+         *
+         * @returns true if the group was created by this call
+         */
+        bool accumulate(GroupsMap* groupsMap, Variables* vars, const Value& id,
+                        int* memoryUsageBytes);
+
+        /// Spill groups map to disk and returns an iterator to the file.
+        shared_ptr<Sorter<Value, Value>::Iterator> spill(GroupsMap* groupsMap);
+
+        // Only used by spill. Would be function-local if that were legal in C++03.
+        class SpillSTLComparator;
+
+        /// Sets up getNext() to merge the spilled sortedFiles.
+        void startMerging(const std::vector<shared_ptr<Sorter<Value, Value>::Iterator> >& files);
+
+        /**
+         * The share of a parallel $group built by one worker. Input documents are assigned to a
+         * partition by the hash of their _id, so every group lives in exactly one partition.
+         */
+        struct Partition {
+            explicit Partition(size_t numVars);
+
+            GroupsMap groups;
+            Variables variables;
+            std::vector<std::pair<Value, Document> > batch; // (_id, input) waiting for a worker
+            std::vector<shared_ptr<Sorter<Value, Value>::Iterator> > sortedFiles;
+            int memoryUsageBytes;
+
+            // stats
+            long long nDocuments;
+            long long nGroups;
+            long long nSpills;
+        };
+
+        // Only used by runPartitions. Defined in document_source_group.cpp.
+        class PartitionRound;
+
+        /**
+         * populate() when _numPartitions > 1. This thread computes each input's _id and hands it
+         * to the partition's worker; workers accumulate and spill their own groups.
+         */
+        void populateParallel();
+
+        /**
+         * Runs a worker for every partition with buffered input and waits for them. With
+         * finalSpill, workers instead spill whatever groups they hold.
+         */
+        void runPartitions(bool finalSpill);
+        void processPartition(Partition* partition, PartitionRound* round, bool finalSpill);
+
+        const size_t _numPartitions;
+        std::vector<boost::shared_ptr<Partition> > _partitions;
+
         /*
           The field names for the result documents and the accumulator
           factories for the result documents.  The Expressions are the
@@ -543,6 +642,7 @@ namespace mongo {
         Document makeDocument(const Value& id, const Accumulators& accums, bool mergeableOutput);
 
         bool _doingMerge;
+        bool _streaming;
         bool _spilled;
         const bool _extSortAllowed;
         const int _maxMemoryUsageBytes;
@@ -558,6 +658,10 @@ namespace mongo {
         std::pair<Value, Value> _firstPartOfNextGroup;
         Value _currentId;
         Accumulators _currentAccumulators;
+
+        // only used when _streaming. The input that ended the last group output, and its _id.
+        boost::optional<Document> _firstDocOfNextGroup;
+        Value _firstIdOfNextGroup;
     };
 
 
@@ -796,6 +900,7 @@ namespace mongo {
         virtual void serializeToArray(std::vector<Value>& array, bool explain = false) const;
         virtual bool coalesce(const intrusive_ptr<DocumentSource> &pNextSource);
         virtual void dispose();
+        virtual BSONObj getOutputSort() const;
 
         virtual GetDepsReturn getDependencies(DepsTracker* deps) const;
 
@@ -92,7 +92,8 @@ namespace mongo {
                 _currentBatch.push_back(_dependencies->extractFields(obj));
             }
             else {
-                _currentBatch.push_back(Document::fromBsonWithMetaData(obj));
+                // Most stages only look at a few fields, if any, so convert them as needed.
+                _currentBatch.push_back(Document::fromBsonLazy(obj));
             }
 
             if (_limit) {
@@ -28,16 +28,25 @@
 
 #include "mongo/pch.h"
 
+#include <boost/make_shared.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "mongo/db/jsobj.h"
 #include "mongo/db/pipeline/accumulator.h"
 #include "mongo/db/pipeline/document.h"
 #include "mongo/db/pipeline/document_source.h"
 #include "mongo/db/pipeline/expression.h"
+#include "mongo/db/pipeline/expression_compiled.h"
 #include "mongo/db/pipeline/expression_context.h"
 #include "mongo/db/pipeline/value.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/stdx/functional.h"
+#include "mongo/util/concurrency/thread_pool.h"
 
 namespace mongo {
+    MONGO_EXPORT_SERVER_PARAMETER(internalDocumentSourceGroupThreads, int, 0);
+
     const char DocumentSourceGroup::groupName[] = "$group";
 
     const char *DocumentSourceGroup::getSourceName() const {
@@ -47,6 +56,9 @@ namespace mongo {
     boost::optional<Document> DocumentSourceGroup::getNext() {
         pExpCtx->checkForInterrupt();
 
+        if (_streaming)
+            return getNextStreaming();
+
         if (!populated)
             populate();
 
@@ -109,10 +121,74 @@ namespace mongo {
         }
     }
 
+    boost::optional<Document> DocumentSourceGroup::getNextStreaming() {
+        const size_t numAccumulators = vpAccumulatorFactory.size();
+
+        if (!populated) {
+            // Read the first input ahead, so that every call starts with the first document of
+            // the group it outputs.
+            _firstDocOfNextGroup = pSource->getNext();
+            if (_firstDocOfNextGroup) {
+                _variables->setRoot(*_firstDocOfNextGroup);
+                _firstIdOfNextGroup = computeId(_variables.get());
+                _variables->clearRoot();
+            }
+
+            _currentAccumulators.reserve(numAccumulators);
+            for (size_t i = 0; i < numAccumulators; i++) {
+                _currentAccumulators.push_back(vpAccumulatorFactory[i]());
+            }
+
+            populated = true;
+        }
+
+        if (!_firstDocOfNextGroup)
+            return boost::none;
+
+        for (size_t i = 0; i < numAccumulators; i++) {
+            _currentAccumulators[i]->reset(); // prep accumulators for a new group
+        }
+
+        /* treat missing values the same as NULL SERVER-4674 */
+        _currentId = _firstIdOfNextGroup.missing() ? Value(BSONNULL) : _firstIdOfNextGroup;
+
+        // The input is ordered so that a group's documents are adjacent. Accumulate until the
+        // first document of the next group, which is kept for the next call.
+        _variables->setRoot(*_firstDocOfNextGroup);
+        while (true) {
+            for (size_t i = 0; i < numAccumulators; i++) {
+                _currentAccumulators[i]->process(vpExpression[i]->evaluate(_variables.get()),
+                                                 _doingMerge);
+            }
+
+            _firstDocOfNextGroup = pSource->getNext();
+            if (!_firstDocOfNextGroup) {
+                dispose();
+                break;
+            }
+
+            _variables->setRoot(*_firstDocOfNextGroup);
+            _firstIdOfNextGroup = computeId(_variables.get());
+            const Value nextId =
+                _firstIdOfNextGroup.missing() ? Value(BSONNULL) : _firstIdOfNextGroup;
+            if (Value::compare(nextId, _currentId) != 0)
+                break;
+        }
+
+        // We are done with the ROOT document so release it.
+        _variables->clearRoot();
+
+        return makeDocument(_currentId, _currentAccumulators, pExpCtx->inShard);
+    }
+
     void DocumentSourceGroup::dispose() {
         // free our resources
         GroupsMap().swap(groups);
         _sorterIterator.reset();
+        for (size_t i = 0; i < _partitions.size(); i++) {
+            GroupsMap().swap(_partitions[i]->groups);
+            _partitions[i]->sortedFiles.clear();
+        }
 
         // make us look done
         groupsIterator = groups.end();
@@ -126,11 +202,11 @@ namespace mongo {
         // will only be one group. We should take advantage of that to avoid going through the hash
         // table.
         for (size_t i = 0; i < _idExpressions.size(); i++) {
-            _idExpressions[i] = _idExpressions[i]->optimize();
+            _idExpressions[i] = ExpressionCompiled::compile(_idExpressions[i]->optimize());
         }
 
         for (size_t i = 0; i < vFieldName.size(); i++) {
-             vpExpression[i] = vpExpression[i]->optimize();
+             vpExpression[i] = ExpressionCompiled::compile(vpExpression[i]->optimize());
         }
     }
 
@@ -167,6 +243,30 @@ namespace mongo {
             insides["$doingMerge"] = Value(true);
         }
 
+        if (explain && _streaming) {
+            return Value(DOC(getSourceName() << insides.freeze() << "streaming" << true));
+        }
+
+        if (explain && _numPartitions > 1) {
+            MutableDocument out;
+            out[getSourceName()] = insides.freezeToValue();
+            out["numPartitions"] = Value(static_cast<long long>(_numPartitions));
+
+            // Only filled in once the $group has consumed its input.
+            if (!_partitions.empty()) {
+                vector<Value> partitionStats;
+                for (size_t i = 0; i < _partitions.size(); i++) {
+                    const Partition& partition = *_partitions[i];
+                    partitionStats.push_back(Value(DOC("documents" << partition.nDocuments
+                                                    << "groups" << partition.nGroups
+                                                    << "spills" << partition.nSpills)));
+                }
+                out["partitionStats"] = Value::consume(partitionStats);
+            }
+
+            return out.freezeToValue();
+        }
+
         return Value(DOC(getSourceName() << insides.freeze()));
     }
 
@@ -195,7 +295,11 @@ namespace mongo {
     DocumentSourceGroup::DocumentSourceGroup(const intrusive_ptr<ExpressionContext>& pExpCtx)
         : DocumentSource(pExpCtx)
         , populated(false)
+        , _numPartitions(internalDocumentSourceGroupThreads > 1
+                            ? static_cast<size_t>(internalDocumentSourceGroupThreads)
+                            : 1)
         , _doingMerge(false)
+        , _streaming(false)
         , _spilled(false)
         , _extSortAllowed(pExpCtx->extSortAllowed && !pExpCtx->inRouter)
         , _maxMemoryUsageBytes(100*1024*1024)
@@ -345,11 +449,44 @@ namespace mongo {
                 return Value::compare(lhs.first, rhs.first);
             }
         };
+
+        // The workers of all parallel $group stages, and the number of threads they were made
+        // with.
+        boost::mutex groupWorkerPoolMutex;
+        boost::shared_ptr<ThreadPool> groupWorkerPool;
+        int groupWorkerPoolThreads = 0;
+
+        /**
+         * Returns the worker pool, replacing it first if internalDocumentSourceGroupThreads has
+         * changed since it was made. The caller must hold on to the pool until its tasks are done.
+         */
+        boost::shared_ptr<ThreadPool> getGroupWorkerPool() {
+            const int numThreads = std::max(internalDocumentSourceGroupThreads, 1);
+            boost::lock_guard<boost::mutex> lock(groupWorkerPoolMutex);
+            if (!groupWorkerPool || groupWorkerPoolThreads != numThreads) {
+                groupWorkerPool.reset(new ThreadPool(numThreads));
+                groupWorkerPoolThreads = numThreads;
+            }
+            return groupWorkerPool;
+        }
+
+        // How many input documents are buffered per partition before the workers are run.
+        const size_t kDocumentsPerPartitionRound = 1024;
+
+        size_t partitionForId(const Value& id, size_t numPartitions) {
+            // Value::Hash also picks the bucket within each partition's GroupsMap, so scramble it
+            // first to keep the partitions' maps from seeing only one residue class of hashes.
+            const unsigned long long hash = Value::Hash()(id) * 0x9E3779B97F4A7C15ULL;
+            return static_cast<size_t>(hash >> 32) % numPartitions;
+        }
     }
 
     void DocumentSourceGroup::populate() {
-        const size_t numAccumulators = vpAccumulatorFactory.size();
-        dassert(numAccumulators == vpExpression.size());
+        if (_numPartitions > 1) {
+            populateParallel();
+            populated = true;
+            return;
+        }
 
         // pushed to on spill()
         vector<shared_ptr<Sorter<Value, Value>::Iterator> > sortedFiles;
@@ -361,7 +498,7 @@ namespace mongo {
                 uassert(16945, "Exceeded memory limit for $group, but didn't allow external sort."
                                " Pass allowDiskUse:true to opt in.",
                         _extSortAllowed);
-                sortedFiles.push_back(spill());
+                sortedFiles.push_back(spill(&groups));
                 memoryUsageBytes = 0;
             }
 
@@ -374,35 +511,7 @@ namespace mongo {
             if (id.missing())
                 id = Value(BSONNULL);
 
-            /*
-              Look for the _id value in the map; if it's not there, add a
-              new entry with a blank accumulator.
-            */
-            const size_t oldSize = groups.size();
-            vector<intrusive_ptr<Accumulator> >& group = groups[id];
-            const bool inserted = groups.size() != oldSize;
-
-            if (inserted) {
-                memoryUsageBytes += id.getApproximateSize();
-
-                // Add the accumulators
-                group.reserve(numAccumulators);
-                for (size_t i = 0; i < numAccumulators; i++) {
-                    group.push_back(vpAccumulatorFactory[i]());
-                }
-            } else {
-                for (size_t i = 0; i < numAccumulators; i++) {
-                    // subtract old mem usage. New usage added back after processing.
-                    memoryUsageBytes -= group[i]->memUsageForSorter();
-                }
-            }
-
-            /* tickle all the accumulators for the group we found */
-            dassert(numAccumulators == group.size());
-            for (size_t i = 0; i < numAccumulators; i++) {
-                group[i]->process(vpExpression[i]->evaluate(_variables.get()), _doingMerge);
-                memoryUsageBytes += group[i]->memUsageForSorter();
-            }
+            const bool inserted = accumulate(&groups, _variables.get(), id, &memoryUsageBytes);
 
             // We are done with the ROOT document so release it.
             _variables->clearRoot();
@@ -414,39 +523,254 @@ namespace mongo {
                         && !_extSortAllowed // don't change behavior when testing external sort
                         && sortedFiles.size() < 20 // don't open too many FDs
                         ) {
-                    sortedFiles.push_back(spill());
+                    sortedFiles.push_back(spill(&groups));
                 }
             }
         }
 
         // These blocks do any final steps necessary to prepare to output results.
         if (!sortedFiles.empty()) {
-            _spilled = true;
             if (!groups.empty()) {
-                sortedFiles.push_back(spill());
+                sortedFiles.push_back(spill(&groups));
             }
 
-            // We won't be using groups again so free its memory.
-            GroupsMap().swap(groups);
+            startMerging(sortedFiles);
+        } else {
+            // start the group iterator
+            groupsIterator = groups.begin();
+        }
+
+        populated = true;
+    }
+
+    bool DocumentSourceGroup::accumulate(GroupsMap* groupsMap,
+                                         Variables* vars,
+                                         const Value& id,
+                                         int* memoryUsageBytes) {
+        const size_t numAccumulators = vpAccumulatorFactory.size();
+        dassert(numAccumulators == vpExpression.size());
 
-            _sorterIterator.reset(
-                    Sorter<Value,Value>::Iterator::merge(
-                        sortedFiles, SortOptions(), SorterComparator()));
+        /*
+          Look for the _id value in the map; if it's not there, add a
+          new entry with a blank accumulator.
+        */
+        const size_t oldSize = groupsMap->size();
+        vector<intrusive_ptr<Accumulator> >& group = (*groupsMap)[id];
+        const bool inserted = groupsMap->size() != oldSize;
 
-            // prepare current to accumulate data
-            _currentAccumulators.reserve(numAccumulators);
+        if (inserted) {
+            *memoryUsageBytes += id.getApproximateSize();
+
+            // Add the accumulators
+            group.reserve(numAccumulators);
             for (size_t i = 0; i < numAccumulators; i++) {
-                _currentAccumulators.push_back(vpAccumulatorFactory[i]());
+                group.push_back(vpAccumulatorFactory[i]());
             }
+        } else {
+            for (size_t i = 0; i < numAccumulators; i++) {
+                // subtract old mem usage. New usage added back after processing.
+                *memoryUsageBytes -= group[i]->memUsageForSorter();
+            }
+        }
+
+        /* tickle all the accumulators for the group we found */
+        dassert(numAccumulators == group.size());
+        for (size_t i = 0; i < numAccumulators; i++) {
+            group[i]->process(vpExpression[i]->evaluate(vars), _doingMerge);
+            *memoryUsageBytes += group[i]->memUsageForSorter();
+        }
+
+        return inserted;
+    }
 
-            verify(_sorterIterator->more()); // we put data in, we should get something out.
-            _firstPartOfNextGroup = _sorterIterator->next();
+    void DocumentSourceGroup::startMerging(
+            const vector<shared_ptr<Sorter<Value, Value>::Iterator> >& sortedFiles) {
+        _spilled = true;
+
+        // We won't be using groups again so free its memory.
+        GroupsMap().swap(groups);
+
+        _sorterIterator.reset(
+                Sorter<Value,Value>::Iterator::merge(
+                    sortedFiles, SortOptions(), SorterComparator()));
+
+        // prepare current to accumulate data
+        const size_t numAccumulators = vpAccumulatorFactory.size();
+        _currentAccumulators.reserve(numAccumulators);
+        for (size_t i = 0; i < numAccumulators; i++) {
+            _currentAccumulators.push_back(vpAccumulatorFactory[i]());
+        }
+
+        verify(_sorterIterator->more()); // we put data in, we should get something out.
+        _firstPartOfNextGroup = _sorterIterator->next();
+    }
+
+    DocumentSourceGroup::Partition::Partition(size_t numVars)
+        : variables(numVars)
+        , memoryUsageBytes(0)
+        , nDocuments(0)
+        , nGroups(0)
+        , nSpills(0)
+    {}
+
+    class DocumentSourceGroup::PartitionRound {
+    public:
+        explicit PartitionRound(size_t numTasks) : tasksRunning(numTasks), status(Status::OK()) {}
+
+        boost::mutex mutex;
+        boost::condition_variable done;
+        size_t tasksRunning; // guarded by mutex
+        Status status; // guarded by mutex. The first failure of any worker.
+    };
+
+    void DocumentSourceGroup::populateParallel() {
+        const size_t numVars = _variables->getNumVars();
+        for (size_t i = 0; i < _numPartitions; i++) {
+            _partitions.push_back(boost::make_shared<Partition>(numVars));
+            _partitions.back()->batch.reserve(kDocumentsPerPartitionRound);
+        }
+
+        // Computing the _id here rather than in the workers is what lets every group be owned by
+        // a single partition. The accumulator expressions, usually the bulk of the work, and the
+        // hash table are left to the workers.
+        const size_t roundSize = kDocumentsPerPartitionRound * _numPartitions;
+        size_t numBuffered = 0;
+        while (boost::optional<Document> input = pSource->getNext()) {
+            _variables->setRoot(*input);
+            Value id = computeId(_variables.get());
+            _variables->clearRoot();
+
+            /* treat missing values the same as NULL SERVER-4674 */
+            if (id.missing())
+                id = Value(BSONNULL);
+
+            Partition& partition = *_partitions[partitionForId(id, _numPartitions)];
+            partition.batch.push_back(make_pair(id, *input));
+
+            if (++numBuffered == roundSize) {
+                runPartitions(/*finalSpill=*/false);
+                numBuffered = 0;
+            }
+        }
+        if (numBuffered > 0) {
+            runPartitions(/*finalSpill=*/false);
+        }
+
+        bool anySpilled = false;
+        size_t numGroups = 0;
+        for (size_t i = 0; i < _partitions.size(); i++) {
+            anySpilled = anySpilled || !_partitions[i]->sortedFiles.empty();
+            numGroups += _partitions[i]->groups.size();
+        }
+
+        if (anySpilled) {
+            // The merge below only sees spilled groups, so the rest have to go to disk as well.
+            runPartitions(/*finalSpill=*/true);
+
+            vector<shared_ptr<Sorter<Value, Value>::Iterator> > sortedFiles;
+            for (size_t i = 0; i < _partitions.size(); i++) {
+                Partition& partition = *_partitions[i];
+                sortedFiles.insert(sortedFiles.end(),
+                                   partition.sortedFiles.begin(),
+                                   partition.sortedFiles.end());
+                partition.sortedFiles.clear();
+            }
+
+            startMerging(sortedFiles);
         } else {
-            // start the group iterator
+            // The partitions hold disjoint sets of _ids, so their groups are output as they are.
+            groups.rehash(numGroups);
+            for (size_t i = 0; i < _partitions.size(); i++) {
+                GroupsMap& partitionGroups = _partitions[i]->groups;
+                groups.insert(partitionGroups.begin(), partitionGroups.end());
+                GroupsMap().swap(partitionGroups);
+            }
+
             groupsIterator = groups.begin();
         }
+    }
 
-        populated = true;
+    void DocumentSourceGroup::runPartitions(bool finalSpill) {
+        vector<Partition*> work;
+        for (size_t i = 0; i < _partitions.size(); i++) {
+            Partition* partition = _partitions[i].get();
+            if (finalSpill ? !partition->groups.empty() : !partition->batch.empty()) {
+                work.push_back(partition);
+            }
+        }
+        if (work.empty())
+            return;
+
+        PartitionRound round(work.size());
+        // Keeps the pool alive for the round even if the knob changes meanwhile.
+        const boost::shared_ptr<ThreadPool> pool = getGroupWorkerPool();
+        for (size_t i = 0; i < work.size(); i++) {
+            pool->schedule(stdx::bind(&DocumentSourceGroup::processPartition,
+                                      this, work[i], &round, finalSpill));
+        }
+
+        {
+            boost::unique_lock<boost::mutex> lock(round.mutex);
+            while (round.tasksRunning > 0) {
+                round.done.wait(lock);
+            }
+        }
+
+        uassertStatusOK(round.status);
+    }
+
+    void DocumentSourceGroup::processPartition(Partition* partition,
+                                               PartitionRound* round,
+                                               bool finalSpill) {
+        Status status = Status::OK();
+        try {
+            if (finalSpill) {
+                partition->sortedFiles.push_back(spill(&partition->groups));
+                partition->nSpills++;
+                partition->memoryUsageBytes = 0;
+            }
+            else {
+                // Each partition gets an even share of the memory allowed for the whole $group.
+                const int maxMemoryUsageBytes =
+                    _maxMemoryUsageBytes / static_cast<int>(_numPartitions);
+                for (size_t i = 0; i < partition->batch.size(); i++) {
+                    if (partition->memoryUsageBytes > maxMemoryUsageBytes) {
+                        uassert(16945, "Exceeded memory limit for $group, but didn't allow external"
+                                       " sort. Pass allowDiskUse:true to opt in.",
+                                _extSortAllowed);
+                        partition->sortedFiles.push_back(spill(&partition->groups));
+                        partition->nSpills++;
+                        partition->memoryUsageBytes = 0;
+                    }
+
+                    partition->variables.setRoot(partition->batch[i].second);
+                    if (accumulate(&partition->groups, &partition->variables,
+                                   partition->batch[i].first, &partition->memoryUsageBytes)) {
+                        partition->nGroups++;
+                    }
+                    partition->variables.clearRoot();
+                    partition->nDocuments++;
+                }
+            }
+        }
+        catch (const DBException& e) {
+            status = e.toStatus();
+        }
+        catch (const std::exception& e) {
+            status = Status(ErrorCodes::InternalError,
+                            str::stream() << "$group worker failed: " << e.what());
+        }
+
+        // Release the inputs before letting the pipeline's thread continue.
+        partition->batch.clear();
+
+        boost::lock_guard<boost::mutex> lock(round->mutex);
+        if (!status.isOK() && round->status.isOK()) {
+            round->status = status;
+        }
+        if (0 == --round->tasksRunning) {
+            round->done.notify_all();
+        }
     }
 
     class DocumentSourceGroup::SpillSTLComparator {
@@ -456,10 +780,11 @@ namespace mongo {
         }
     };
 
-    shared_ptr<Sorter<Value, Value>::Iterator> DocumentSourceGroup::spill() {
+    shared_ptr<Sorter<Value, Value>::Iterator> DocumentSourceGroup::spill(GroupsMap* groupsMap) {
         vector<const GroupsMap::value_type*> ptrs; // using pointers to speed sorting
-        ptrs.reserve(groups.size());
-        for (GroupsMap::const_iterator it=groups.begin(), end=groups.end(); it != end; ++it) {
+        ptrs.reserve(groupsMap->size());
+        for (GroupsMap::const_iterator it=groupsMap->begin(), end=groupsMap->end();
+                it != end; ++it) {
             ptrs.push_back(&*it);
         }
 
@@ -491,7 +816,7 @@ namespace mongo {
             break;
         }
 
-        groups.clear();
+        groupsMap->clear();
 
         return shared_ptr<Sorter<Value, Value>::Iterator>(writer.done());
     }
@@ -587,6 +912,63 @@ namespace mongo {
         return out.freeze();
     }
 
+    bool DocumentSourceGroup::isGroupedBySort(const BSONObj& sortPattern) const {
+        // The _id must be made of paths into the input document.
+        set<string> idFields;
+        for (size_t i = 0; i < _idExpressions.size(); i++) {
+            const ExpressionFieldPath* path =
+                dynamic_cast<const ExpressionFieldPath*>(_idExpressions[i].get());
+            if (!path || path->getVariableId() != Variables::ROOT_ID)
+                return false;
+
+            // The first component names the variable, either CURRENT or ROOT.
+            const FieldPath& fieldPath = path->getFieldPath();
+            if (fieldPath.getPathLength() < 2)
+                return false;
+
+            idFields.insert(fieldPath.tail().getPath(false));
+        }
+
+        // Equal _ids are adjacent if the sort starts with exactly those fields, in any order and
+        // either direction.
+        BSONObjIterator sortFields(sortPattern);
+        for (size_t i = 0; i < idFields.size(); i++) {
+            if (!sortFields.more() || !idFields.count(sortFields.next().fieldName()))
+                return false;
+        }
+        return true;
+    }
+
+    bool DocumentSourceGroup::isFirstOrLastPerGroup(string* idField, bool* useLast) const {
+        // When merging, the input is partial groups rather than documents.
+        if (_doingMerge || _idExpressions.size() != 1)
+            return false;
+
+        const ExpressionFieldPath* path =
+            dynamic_cast<const ExpressionFieldPath*>(_idExpressions[0].get());
+        if (!path
+                || path->getVariableId() != Variables::ROOT_ID
+                || path->getFieldPath().getPathLength() < 2)
+            return false;
+
+        size_t numFirst = 0;
+        size_t numLast = 0;
+        for (size_t i = 0; i < vpAccumulatorFactory.size(); i++) {
+            if (vpAccumulatorFactory[i] == AccumulatorFirst::create)
+                numFirst++;
+            else if (vpAccumulatorFactory[i] == AccumulatorLast::create)
+                numLast++;
+            else
+                return false;
+        }
+        if (numFirst > 0 && numLast > 0)
+            return false;
+
+        *idField = path->getFieldPath().tail().getPath(false);
+        *useLast = numLast > 0;
+        return true;
+    }
+
     intrusive_ptr<DocumentSource> DocumentSourceGroup::getShardSource() {
         return this; // No modifications necessary when on shard
     }
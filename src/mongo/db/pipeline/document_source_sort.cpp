@@ -99,6 +99,21 @@ namespace mongo {
         }
     }
 
+    BSONObj DocumentSourceSort::getOutputSort() const {
+        // When merging the output of shards, a shard may have ordered arrays by the index it
+        // used rather than as whole Values.
+        if (_mergingPresorted)
+            return BSONObj();
+
+        // Computed keys cannot be named in a sort pattern.
+        for (size_t i = 0; i < vSortKey.size(); i++) {
+            if (!dynamic_cast<ExpressionFieldPath*>(vSortKey[i].get()))
+                return BSONObj();
+        }
+
+        return serializeSortKey(/*explain*/false).toBson();
+    }
+
     void DocumentSourceSort::addKey(const string& fieldPath, bool ascending) {
         VariablesIdGenerator idGenerator;
         VariablesParseState vps(&idGenerator);
@@ -37,6 +37,7 @@
 #include "mongo/base/init.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/pipeline/document.h"
+#include "mongo/db/pipeline/expression_compiled.h"
 #include "mongo/db/pipeline/expression_context.h"
 #include "mongo/db/pipeline/value.h"
 #include "mongo/stdx/functional.h"
@@ -712,6 +713,29 @@ namespace {
 
     /* ----------------------- ExpressionCond ------------------------------ */
 
+    intrusive_ptr<Expression> ExpressionCond::optimize() {
+        intrusive_ptr<Expression> pE(ExpressionNary::optimize());
+
+        ExpressionCond* pCond = dynamic_cast<ExpressionCond*>(pE.get());
+        if (!pCond)
+            return pE;
+
+        // A constant condition always picks the same branch, and the other is never evaluated.
+        const ExpressionConstant* pConst =
+            dynamic_cast<ExpressionConstant*>(pCond->vpOperand[0].get());
+        if (!pConst)
+            return pE;
+
+        // An object in place of the $cond would be taken for a nested projection by
+        // ExpressionObject::addToDocument.
+        const intrusive_ptr<Expression>& branch =
+            pCond->vpOperand[pConst->getValue().coerceToBool() ? 1 : 2];
+        if (dynamic_cast<ExpressionObject*>(branch.get()))
+            return pE;
+
+        return branch;
+    }
+
     Value ExpressionCond::evaluateInternal(Variables* vars) const {
         Value pCond(vpOperand[0]->evaluateInternal(vars));
         int idx = pCond.coerceToBool() ? 1 : 2;
@@ -1070,7 +1094,7 @@ namespace {
     intrusive_ptr<Expression> ExpressionObject::optimize() {
         for (FieldMap::iterator it(_expressions.begin()); it!=_expressions.end(); ++it) {
             if (it->second)
-                it->second = it->second->optimize();
+                it->second = ExpressionCompiled::compile(it->second->optimize());
         }
 
         return intrusive_ptr<Expression>(this);
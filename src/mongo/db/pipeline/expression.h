@@ -84,6 +84,9 @@ namespace mongo {
          */
         Document getDocument(Id id) const;
 
+        /// The numVars passed to the constructor.
+        size_t getNumVars() const { return _numVars; }
+
     private:
         Document _root;
         const boost::scoped_array<Value> _rest;
@@ -321,6 +324,8 @@ namespace mongo {
             BSONElement bsonExpr,
             const VariablesParseState& vps);
 
+        const ExpressionVector& getOperands() const { return vpOperand; }
+
     protected:
         ExpressionNary() {}
 
@@ -406,6 +411,7 @@ namespace mongo {
         static intrusive_ptr<ExpressionCoerceToBool> create(
             const intrusive_ptr<Expression> &pExpression);
 
+        const intrusive_ptr<Expression>& getExpression() const { return pExpression; }
 
     private:
         ExpressionCoerceToBool(const intrusive_ptr<Expression> &pExpression);
@@ -441,6 +447,8 @@ namespace mongo {
 
         ExpressionCompare(CmpOp cmpOp);
 
+        CmpOp getCmpOp() const { return cmpOp; }
+
     private:
         CmpOp cmpOp;
     };
@@ -458,6 +466,7 @@ namespace mongo {
         typedef ExpressionFixedArity<ExpressionCond, 3> Base;
     public:
         // virtuals from ExpressionNary
+        virtual intrusive_ptr<Expression> optimize();
         virtual Value evaluateInternal(Variables* vars) const;
         virtual const char *getOpName() const;
 
@@ -594,6 +603,7 @@ namespace mongo {
             const VariablesParseState& vps);
 
         const FieldPath& getFieldPath() const { return _fieldPath; }
+        Variables::Id getVariableId() const { return _variable; }
 
     private:
         ExpressionFieldPath(const std::string& fieldPath, Variables::Id variable);
@@ -0,0 +1,474 @@
+/**
+ *    Copyright (C) 2014 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/pch.h"
+
+#include "mongo/db/pipeline/expression_compiled.h"
+
+#include <cmath>
+
+namespace mongo {
+
+    namespace {
+
+        // The numeric operands of $add, $multiply, $subtract and $divide are widened the way
+        // Value::getWidestNumeric() does: NumberInt, then NumberLong, then NumberDouble.
+
+        double toDouble(const Value& val) {
+            switch (val.getType()) {
+            case NumberInt: return val.getInt();
+            case NumberLong: return static_cast<double>(val.getLong());
+            default: return val.getDouble();
+            }
+        }
+
+        long long toLong(const Value& val) {
+            switch (val.getType()) {
+            case NumberInt: return val.getInt();
+            case NumberLong: return val.getLong();
+            default: return static_cast<long long>(val.getDouble());
+            }
+        }
+
+        /**
+         * Same as ExpressionAdd (or ExpressionMultiply if 'multiply') of 'operands'.  Returns false
+         * for a Date or for the operands of an error.
+         */
+        bool addOrMultiply(const Value* operands, int n, bool multiply, Value* result) {
+            double doubleTotal = multiply ? 1 : 0;
+            long long longTotal = multiply ? 1 : 0;
+            BSONType totalType = NumberInt;
+
+            for (int i = 0; i < n; ++i) {
+                const Value& val = operands[i];
+                double doubleVal;
+                long long longVal;
+                switch (val.getType()) {
+                case NumberInt:
+                    doubleVal = longVal = val.getInt();
+                    break;
+                case NumberLong:
+                    longVal = val.getLong();
+                    doubleVal = static_cast<double>(longVal);
+                    if (totalType == NumberInt)
+                        totalType = NumberLong;
+                    break;
+                case NumberDouble:
+                    doubleVal = val.getDouble();
+                    longVal = static_cast<long long>(doubleVal);
+                    totalType = NumberDouble;
+                    break;
+                case EOO:
+                case jstNULL:
+                case Undefined:
+                    // The later operands are not looked at.
+                    *result = Value(BSONNULL);
+                    return true;
+                default:
+                    return false;
+                }
+
+                if (multiply) {
+                    doubleTotal *= doubleVal;
+                    longTotal *= longVal;
+                }
+                else {
+                    doubleTotal += doubleVal;
+                    longTotal += longVal;
+                }
+            }
+
+            if (totalType == NumberDouble)
+                *result = Value(doubleTotal);
+            else if (totalType == NumberLong)
+                *result = Value(longTotal);
+            else
+                *result = Value::createIntOrLong(longTotal);
+            return true;
+        }
+
+        bool subtract(const Value& lhs, const Value& rhs, Value* result) {
+            if (!lhs.numeric() || !rhs.numeric()) {
+                if (!lhs.nullish() && !rhs.nullish())
+                    return false; // Dates, or an error
+                *result = Value(BSONNULL);
+                return true;
+            }
+
+            switch (Value::getWidestNumeric(lhs.getType(), rhs.getType())) {
+            case NumberDouble:
+                *result = Value(toDouble(lhs) - toDouble(rhs));
+                break;
+            case NumberLong:
+                *result = Value(toLong(lhs) - toLong(rhs));
+                break;
+            default:
+                *result = Value::createIntOrLong(toLong(lhs) - toLong(rhs));
+                break;
+            }
+            return true;
+        }
+
+        bool divide(const Value& lhs, const Value& rhs, Value* result) {
+            if (!lhs.numeric() || !rhs.numeric()) {
+                if (!lhs.nullish() && !rhs.nullish())
+                    return false;
+                *result = Value(BSONNULL);
+                return true;
+            }
+
+            const double denom = toDouble(rhs);
+            if (denom == 0)
+                return false;
+
+            *result = Value(toDouble(lhs) / denom);
+            return true;
+        }
+
+        bool mod(const Value& lhs, const Value& rhs, Value* result) {
+            if (!lhs.numeric() || !rhs.numeric()) {
+                if (!lhs.nullish() && !rhs.nullish())
+                    return false;
+                *result = Value(BSONNULL);
+                return true;
+            }
+
+            const double right = toDouble(rhs);
+            if (right == 0)
+                return false;
+
+            const BSONType leftType = lhs.getType();
+            const BSONType rightType = rhs.getType();
+            if (leftType == NumberDouble
+                || (rightType == NumberDouble && static_cast<int>(right) != right)) {
+                *result = Value(fmod(toDouble(lhs), right));
+            }
+            else if (leftType == NumberLong || rightType == NumberLong) {
+                *result = Value(toLong(lhs) % toLong(rhs));
+            }
+            else {
+                *result = Value(static_cast<int>(toLong(lhs)) % static_cast<int>(right));
+            }
+            return true;
+        }
+
+        Value compare(const Value& lhs, const Value& rhs, ExpressionCompare::CmpOp op) {
+            int cmp;
+            if (lhs.getType() == NumberInt && rhs.getType() == NumberInt) {
+                const int l = lhs.getInt();
+                const int r = rhs.getInt();
+                cmp = l < r ? -1 : (l == r ? 0 : 1);
+            }
+            else {
+                cmp = Value::compare(lhs, rhs);
+            }
+
+            switch (op) {
+            case ExpressionCompare::EQ: return Value(cmp == 0);
+            case ExpressionCompare::NE: return Value(cmp != 0);
+            case ExpressionCompare::GT: return Value(cmp > 0);
+            case ExpressionCompare::GTE: return Value(cmp >= 0);
+            case ExpressionCompare::LT: return Value(cmp < 0);
+            case ExpressionCompare::LTE: return Value(cmp <= 0);
+            case ExpressionCompare::CMP: return Value(cmp < 0 ? -1 : (cmp > 0 ? 1 : 0));
+            }
+            verify(false);
+        }
+
+    }  // namespace
+
+    ExpressionCompiled::ExpressionCompiled(const intrusive_ptr<Expression>& original)
+        : _original(original)
+        , _depth(0)
+        , _maxDepth(0)
+    {}
+
+    intrusive_ptr<Expression> ExpressionCompiled::compile(const intrusive_ptr<Expression>& expr) {
+        if (dynamic_cast<ExpressionCompiled*>(expr.get()))
+            return expr;
+
+        // A lone constant or field path is already as cheap as it gets.
+        if (!dynamic_cast<ExpressionNary*>(expr.get())
+                && !dynamic_cast<ExpressionCoerceToBool*>(expr.get())) {
+            return expr;
+        }
+
+        intrusive_ptr<ExpressionCompiled> compiled(new ExpressionCompiled(expr));
+        if (!compiled->compileExpression(expr.get()) || compiled->_maxDepth > kMaxStackDepth)
+            return expr;
+
+        verify(compiled->_depth == 1);
+        return compiled;
+    }
+
+    bool ExpressionCompiled::compileExpression(const Expression* expr) {
+        if (const ExpressionConstant* constant = dynamic_cast<const ExpressionConstant*>(expr)) {
+            emitConstant(constant->getValue());
+            return true;
+        }
+
+        if (const ExpressionFieldPath* fieldPath =
+                dynamic_cast<const ExpressionFieldPath*>(expr)) {
+            const FieldPath& path = fieldPath->getFieldPath();
+            if (fieldPath->getVariableId() != Variables::ROOT_ID || path.getPathLength() == 1)
+                return false;
+
+            FieldLoad field;
+            for (size_t i = 1; i < path.getPathLength(); ++i) {
+                field.names.push_back(path.getFieldName(i));
+                field.hashes.push_back(Document::hashFieldName(path.getFieldName(i)));
+            }
+            _fields.push_back(field);
+            emit(LOAD_FIELD, _fields.size() - 1);
+            push();
+            return true;
+        }
+
+        if (const ExpressionCoerceToBool* coerce =
+                dynamic_cast<const ExpressionCoerceToBool*>(expr)) {
+            if (!compileExpression(coerce->getExpression().get()))
+                return false;
+            emit(COERCE_TO_BOOL);
+            return true;
+        }
+
+        const ExpressionNary* nary = dynamic_cast<const ExpressionNary*>(expr);
+        if (!nary)
+            return false;
+        const ExpressionVector& operands = nary->getOperands();
+
+        if (dynamic_cast<const ExpressionAnd*>(expr))
+            return compileAndOr(operands, true);
+        if (dynamic_cast<const ExpressionOr*>(expr))
+            return compileAndOr(operands, false);
+
+        OpCode op;
+        int arg = 0;
+        if (dynamic_cast<const ExpressionAdd*>(expr)) {
+            op = ADD;
+            arg = operands.size();
+        }
+        else if (dynamic_cast<const ExpressionMultiply*>(expr)) {
+            op = MULTIPLY;
+            arg = operands.size();
+        }
+        else if (dynamic_cast<const ExpressionSubtract*>(expr)) {
+            op = SUBTRACT;
+        }
+        else if (dynamic_cast<const ExpressionDivide*>(expr)) {
+            op = DIVIDE;
+        }
+        else if (dynamic_cast<const ExpressionMod*>(expr)) {
+            op = MOD;
+        }
+        else if (const ExpressionCompare* cmp = dynamic_cast<const ExpressionCompare*>(expr)) {
+            op = COMPARE;
+            arg = cmp->getCmpOp();
+        }
+        else if (dynamic_cast<const ExpressionNot*>(expr)) {
+            op = NOT;
+        }
+        else {
+            return false;
+        }
+
+        if (!compileOperands(operands))
+            return false;
+
+        emit(op, arg);
+        pop(operands.size());
+        push();
+        return true;
+    }
+
+    bool ExpressionCompiled::compileOperands(const ExpressionVector& operands) {
+        for (size_t i = 0; i < operands.size(); ++i) {
+            if (!compileExpression(operands[i].get()))
+                return false;
+        }
+        return true;
+    }
+
+    bool ExpressionCompiled::compileAndOr(const ExpressionVector& operands, bool isAnd) {
+        // Each operand is tested as soon as it is evaluated, and the first one that decides the
+        // result skips the rest, as ExpressionAnd and ExpressionOr do.
+        std::vector<size_t> decidingJumps;
+        for (size_t i = 0; i < operands.size(); ++i) {
+            if (!compileExpression(operands[i].get()))
+                return false;
+            decidingJumps.push_back(_program.size());
+            emit(isAnd ? JUMP_IF_FALSE : JUMP_IF_TRUE);
+            pop();
+        }
+
+        emitConstant(Value(isAnd));
+        const size_t jumpToEnd = _program.size();
+        emit(JUMP);
+        pop();
+
+        for (size_t i = 0; i < decidingJumps.size(); ++i) {
+            _program[decidingJumps[i]].arg = _program.size();
+        }
+        emitConstant(Value(!isAnd));
+
+        _program[jumpToEnd].arg = _program.size();
+        return true;
+    }
+
+    void ExpressionCompiled::emitConstant(const Value& value) {
+        _constants.push_back(value);
+        emit(PUSH_CONSTANT, _constants.size() - 1);
+        push();
+    }
+
+    void ExpressionCompiled::emit(OpCode op, int arg) {
+        _program.push_back(Instruction(op, arg));
+    }
+
+    void ExpressionCompiled::push(size_t n) {
+        _depth += n;
+        if (_depth > _maxDepth)
+            _maxDepth = _depth;
+    }
+
+    void ExpressionCompiled::pop(size_t n) {
+        verify(_depth >= n);
+        _depth -= n;
+    }
+
+    bool ExpressionCompiled::run(Variables* vars, Value* result) const {
+        Value stack[kMaxStackDepth];
+        size_t sp = 0;
+
+        const size_t end = _program.size();
+        size_t pc = 0;
+        while (pc < end) {
+            const Instruction& ins = _program[pc++];
+            switch (ins.op) {
+            case PUSH_CONSTANT:
+                stack[sp++] = _constants[ins.arg];
+                break;
+
+            case LOAD_FIELD: {
+                // Same as ExpressionFieldPath::evaluatePath, except for arrays, which it fans out
+                // over.
+                const FieldLoad& field = _fields[ins.arg];
+                const size_t last = field.names.size() - 1;
+                Value val = vars->getRoot().getField(field.names[0], field.hashes[0]);
+                for (size_t i = 1; i <= last; ++i) {
+                    if (val.getType() == Array)
+                        return false;
+                    if (val.getType() != Object) {
+                        val = Value();
+                        break;
+                    }
+                    val = val.getDocument().getField(field.names[i], field.hashes[i]);
+                }
+                stack[sp++] = val;
+                break;
+            }
+
+            case ADD:
+            case MULTIPLY: {
+                sp -= ins.arg;
+                Value val;
+                if (!addOrMultiply(stack + sp, ins.arg, ins.op == MULTIPLY, &val))
+                    return false;
+                stack[sp++] = val;
+                break;
+            }
+
+            case SUBTRACT:
+            case DIVIDE:
+            case MOD: {
+                sp -= 2;
+                Value val;
+                const bool done = ins.op == SUBTRACT ? subtract(stack[sp], stack[sp + 1], &val)
+                                : ins.op == DIVIDE ? divide(stack[sp], stack[sp + 1], &val)
+                                : mod(stack[sp], stack[sp + 1], &val);
+                if (!done)
+                    return false;
+                stack[sp++] = val;
+                break;
+            }
+
+            case COMPARE:
+                sp--;
+                stack[sp - 1] = compare(stack[sp - 1], stack[sp],
+                                        static_cast<ExpressionCompare::CmpOp>(ins.arg));
+                break;
+
+            case NOT:
+                stack[sp - 1] = Value(!stack[sp - 1].coerceToBool());
+                break;
+
+            case COERCE_TO_BOOL:
+                stack[sp - 1] = Value(stack[sp - 1].coerceToBool());
+                break;
+
+            case JUMP_IF_FALSE:
+                if (!stack[--sp].coerceToBool())
+                    pc = ins.arg;
+                break;
+
+            case JUMP_IF_TRUE:
+                if (stack[--sp].coerceToBool())
+                    pc = ins.arg;
+                break;
+
+            case JUMP:
+                pc = ins.arg;
+                break;
+            }
+        }
+
+        dassert(sp == 1);
+        *result = stack[0];
+        return true;
+    }
+
+    intrusive_ptr<Expression> ExpressionCompiled::optimize() {
+        return compile(_original->optimize());
+    }
+
+    void ExpressionCompiled::addDependencies(DepsTracker* deps, vector<string>* path) const {
+        _original->addDependencies(deps, path);
+    }
+
+    Value ExpressionCompiled::serialize(bool explain) const {
+        return _original->serialize(explain);
+    }
+
+    Value ExpressionCompiled::evaluateInternal(Variables* vars) const {
+        Value result;
+        if (run(vars, &result))
+            return result;
+        return _original->evaluateInternal(vars);
+    }
+
+}  // namespace mongo
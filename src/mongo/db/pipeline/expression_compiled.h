@@ -0,0 +1,155 @@
+/**
+ *    Copyright (C) 2014 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "mongo/db/pipeline/expression.h"
+
+namespace mongo {
+
+    /**
+     * An arithmetic, comparison or boolean Expression tree flattened into a program for a small
+     * stack machine.
+     *
+     * Constants, field paths on ROOT, $add, $subtract, $multiply, $divide, $mod, the comparisons
+     * and $and, $or and $not become instructions run in one loop over a fixed-size stack of
+     * Values.  Field names are hashed once, when the program is built.  Arithmetic is done on
+     * the operands' own numeric types, without the tree's virtual calls and temporaries.
+     *
+     * Anything the program does not handle itself, such as Dates, arrays in a field path, or
+     * the operands of an error, makes it evaluate the original tree instead, so results and
+     * errors are always those of the tree.  The program holds no per-evaluation state, so it
+     * may be evaluated by several threads at once.
+     *
+     * Serializes and reports dependencies as the tree it was built from.
+     */
+    class ExpressionCompiled : public Expression {
+    public:
+        /**
+         * Returns an ExpressionCompiled for 'expr', or 'expr' itself if it is not an operator
+         * that can be compiled or has an operand that can't.  Call on optimized expressions,
+         * since constants are not folded again here.
+         */
+        static intrusive_ptr<Expression> compile(const intrusive_ptr<Expression>& expr);
+
+        // virtuals from Expression
+        virtual intrusive_ptr<Expression> optimize();
+        virtual void addDependencies(DepsTracker* deps, std::vector<std::string>* path=NULL) const;
+        virtual Value serialize(bool explain) const;
+        virtual Value evaluateInternal(Variables* vars) const;
+
+        /// The tree this was compiled from.
+        const intrusive_ptr<Expression>& getOriginal() const { return _original; }
+
+        size_t getNumInstructions() const { return _program.size(); }
+
+        // The deepest stack a program may use.
+        static const size_t kMaxStackDepth = 16;
+
+    private:
+        enum OpCode {
+            // Push _constants[arg].
+            PUSH_CONSTANT,
+
+            // Push the value of _fields[arg] in ROOT.
+            LOAD_FIELD,
+
+            // Replace the top 'arg' values with the result of the operator.
+            ADD,
+            MULTIPLY,
+
+            // Replace the top two values with the result of the operator.
+            SUBTRACT,
+            DIVIDE,
+            MOD,
+
+            // Replace the top two values with the result of ExpressionCompare::CmpOp 'arg'.
+            COMPARE,
+
+            // Replace the top value with its negation or truth value.
+            NOT,
+            COERCE_TO_BOOL,
+
+            // Pop the top value and jump to instruction 'arg' if it is false or true.
+            JUMP_IF_FALSE,
+            JUMP_IF_TRUE,
+
+            // Jump to instruction 'arg'.
+            JUMP
+        };
+
+        struct Instruction {
+            Instruction(OpCode op, int arg) : op(op), arg(arg) {}
+            OpCode op;
+            int arg;
+        };
+
+        // A field path below ROOT, with each of its field names hashed for Document::getField.
+        struct FieldLoad {
+            std::vector<std::string> names;
+            std::vector<unsigned> hashes;
+        };
+
+        explicit ExpressionCompiled(const intrusive_ptr<Expression>& original);
+
+        /**
+         * Appends the instructions that push the value of 'expr'.  Returns false if 'expr'
+         * can't be compiled.
+         */
+        bool compileExpression(const Expression* expr);
+
+        bool compileOperands(const ExpressionVector& operands);
+
+        /// Appends the instructions for $and ('isAnd') or $or of 'operands'.
+        bool compileAndOr(const ExpressionVector& operands, bool isAnd);
+
+        void emitConstant(const Value& value);
+        void emit(OpCode op, int arg = 0);
+        void push(size_t n = 1);
+        void pop(size_t n = 1);
+
+        /**
+         * Runs the program.  Returns false, leaving 'result' unset, if part of it has to be
+         * evaluated by the original tree.
+         */
+        bool run(Variables* vars, Value* result) const;
+
+        const intrusive_ptr<Expression> _original;
+        std::vector<Instruction> _program;
+        std::vector<Value> _constants;
+        std::vector<FieldLoad> _fields;
+
+        // The stack depth at the end of the program so far, and the deepest it gets.
+        size_t _depth;
+        size_t _maxDepth;
+    };
+
+}  // namespace mongo
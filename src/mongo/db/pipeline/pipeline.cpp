@@ -319,6 +319,20 @@ namespace mongo {
         }
     }
 
+    void Pipeline::Optimizations::Local::streamGroupsOnSortedInput(Pipeline* pipeline) {
+        SourceContainer& sources = pipeline->sources;
+        for (size_t i = 1; i < sources.size(); i++) {
+            DocumentSourceGroup* group = dynamic_cast<DocumentSourceGroup*>(sources[i].get());
+            if (!group)
+                continue;
+
+            const BSONObj inputSort = sources[i - 1]->getOutputSort();
+            if (!inputSort.isEmpty() && group->isGroupedBySort(inputSort)) {
+                group->setStreaming(true);
+            }
+        }
+    }
+
     void Pipeline::addRequiredPrivileges(Command* commandTemplate,
                                          const string& db,
                                          BSONObj cmdObj,
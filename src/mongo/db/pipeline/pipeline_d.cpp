@@ -30,12 +30,17 @@
 
 #include "mongo/db/pipeline/pipeline_d.h"
 
+#include <limits>
+
 #include "mongo/client/dbclientinterface.h"
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/catalog/database.h"
+#include "mongo/db/catalog/index_catalog.h"
 #include "mongo/db/dbdirectclient.h"
+#include "mongo/db/index/index_descriptor.h"
 #include "mongo/db/pipeline/document_source.h"
 #include "mongo/db/pipeline/pipeline.h"
+#include "mongo/db/pipeline/pipeline_optimizations.h"
 #include "mongo/db/query/get_executor.h"
 #include "mongo/db/query/query_planner.h"
 #include "mongo/s/d_state.h"
@@ -72,6 +77,40 @@ namespace {
         intrusive_ptr<ExpressionContext> _ctx;
         DBDirectClient _client;
     };
+
+    /**
+     * Returns true if an index over a field of sortPattern is multikey. The query layer provides
+     * a sort from such an index in the order of single array elements, so documents holding equal
+     * arrays need not come out next to each other.
+     */
+    bool sortMayUseMultikeyIndex(OperationContext* txn,
+                                 Collection* collection,
+                                 const BSONObj& sortPattern) {
+        if (!collection)
+            return false;
+
+        IndexCatalog::IndexIterator ii =
+            collection->getIndexCatalog()->getIndexIterator(txn, false);
+        while (ii.more()) {
+            const IndexDescriptor* desc = ii.next();
+            if (!desc->isMultikey(txn))
+                continue;
+
+            BSONForEach(sortField, sortPattern) {
+                if (desc->keyPattern().hasField(sortField.fieldName()))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    BSONObj reverseSortPattern(const BSONObj& sortPattern) {
+        BSONObjBuilder bob;
+        BSONForEach(sortField, sortPattern) {
+            bob.append(sortField.fieldName(), sortField.number() >= 0 ? -1 : 1);
+        }
+        return bob.obj();
+    }
 }
 
     boost::shared_ptr<PlanExecutor> PipelineD::prepareCursorSource(
@@ -163,19 +202,52 @@ namespace {
         const size_t runnerOptions = QueryPlannerParams::DEFAULT
                                    | QueryPlannerParams::INCLUDE_SHARD_FILTER
                                    | QueryPlannerParams::NO_BLOCKING_SORT
+                                   | QueryPlannerParams::PARALLEL_COLLSCAN
                                    ;
         boost::shared_ptr<PlanExecutor> exec;
         bool sortInRunner = false;
 
         const WhereCallbackReal whereCallback(pExpCtx->opCtx, pExpCtx->ns.db());
 
-        if (sortStage) {
+        // A $group right after the $sort may only need the first or last document of each group,
+        // as in [{$sort: {a: 1, b: 1}}, {$group: {_id: "$a", x: {$first: "$b"}}}]. Then a distinct
+        // scan over an index on the sort can skip from each group's first document to the next
+        // group. For $last the index is scanned in reverse, so each group starts with its last
+        // document.
+        if (sortStage && !sortStage->getLimitSrc() && sources.size() >= 2 && !deps.needTextScore) {
+            DocumentSourceGroup* group = dynamic_cast<DocumentSourceGroup*>(sources[1].get());
+            string idField;
+            bool useLast = false;
+            if (group
+                    && group->isFirstOrLastPerGroup(&idField, &useLast)
+                    && idField == sortObj.firstElementFieldName()) {
+                const BSONObj scanSort = useLast ? reverseSortPattern(sortObj) : sortObj;
+                PlanExecutor* rawExec;
+                if (getExecutorFirstPerKey(txn, collection, queryObj, scanSort, &rawExec).isOK()) {
+                    exec.reset(rawExec);
+                    sortInRunner = true;
+                    sortObj = scanSort;
+                    sources.pop_front();
+                }
+            }
+        }
+
+        if (sortStage && !exec.get()) {
+            // With a $limit, only that many documents are needed from the index, so the limit is
+            // passed down as a hard limit.
+            const long long limit = sortStage->getLimit();
+            const int queryLimit = limit > 0 && limit <= std::numeric_limits<int>::max()
+                                 ? -static_cast<int>(limit)
+                                 : 0;
+
             CanonicalQuery* cq;
             Status status =
                 CanonicalQuery::canonicalize(pExpCtx->ns,
                                              queryObj,
                                              sortObj,
                                              projectionForQuery,
+                                             0,
+                                             queryLimit,
                                              &cq,
                                              whereCallback);
             PlanExecutor* rawExec;
@@ -218,9 +290,14 @@ namespace {
 
         // Note the query, sort, and projection for explain.
         pSource->setQuery(queryObj);
-        if (sortInRunner)
+        if (sortInRunner) {
             pSource->setSort(sortObj);
 
+            // NO_BLOCKING_SORT means an index provided the sort.
+            if (!sortMayUseMultikeyIndex(txn, collection, sortObj))
+                pSource->setProvidedSort(sortObj);
+        }
+
         pSource->setProjection(deps.toProjection(), deps.toParsedDeps());
 
         while (!sources.empty() && pSource->coalesce(sources.front())) {
@@ -229,6 +306,9 @@ namespace {
 
         pPipeline->addInitialSource(pSource);
 
+        // Now that the order of the cursor is known.
+        Pipeline::Optimizations::Local::streamGroupsOnSortedInput(pPipeline.get());
+
         return exec;
     }
 
@@ -87,6 +87,18 @@ namespace mongo {
          * BSONObjs converted to Documents.
          */
         static void duplicateMatchBeforeInitalRedact(Pipeline* pipeline);
+
+        /**
+         * Puts each $group whose input is already ordered by its _id into streaming mode, so it
+         * outputs a group as soon as the next one starts and holds only one group in memory.
+         *
+         * The input order is known after a $sort, or from the initial cursor when the query
+         * layer provides the sort from an index. For that reason this is applied by PipelineD
+         * after it adds the cursor, rather than with the other local optimizations.
+         *
+         * NOTE: uses DocumentSourceGroup::isGroupedBySort()
+         */
+        static void streamGroupsOnSortedInput(Pipeline* pipeline);
     };
 
     /**
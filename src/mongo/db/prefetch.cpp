@@ -38,6 +38,7 @@
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/repl/rs.h"
+#include "mongo/db/storage/record_store.h"
 #include "mongo/db/stats/timer_stats.h"
 #include "mongo/db/commands/server_status_metric.h"
 #include "mongo/util/log.h"
@@ -63,7 +64,7 @@ namespace mongo {
                             const repl::ReplSetImpl::IndexPrefetchConfig& prefetchConfig,
                             const BSONObj& obj);
 
-    void prefetchRecordPages(OperationContext* txn, const char* ns, const BSONObj& obj);
+    void prefetchRecordPages(OperationContext* txn, Collection* collection, const BSONObj& obj);
 
 
     // prefetch for an oplog operation
@@ -124,7 +125,7 @@ namespace mongo {
             // do not prefetch the data for capped collections because
             // they typically do not have an _id index for findById() to use.
             !collection->isCapped()) {
-            prefetchRecordPages(txn, ns, obj);
+            prefetchRecordPages(txn, collection, obj);
         }
     }
 
@@ -188,26 +189,18 @@ namespace mongo {
     }
 
     // page in the data pages for a record associated with an object
-    void prefetchRecordPages(OperationContext* txn, const char* ns, const BSONObj& obj) {
+    void prefetchRecordPages(OperationContext* txn, Collection* collection, const BSONObj& obj) {
         BSONElement _id;
         if( obj.getObjectID(_id) ) {
             TimerHolder timer(&prefetchDocStats);
             BSONObjBuilder builder;
             builder.append(_id);
-            BSONObj result;
             try {
-                // we can probably use Client::Context here instead of ReadContext as we
-                // have locked higher up the call stack already
-                Client::ReadContext ctx(txn, ns);
-                if( Helpers::findById(txn, ctx.ctx().db(), ns, builder.done(), result) ) {
-                    // do we want to use Record::touch() here?  it's pretty similar.
-                    volatile char _dummy_char = '\0';
-                    // Touch the first word on every page in order to fault it into memory
-                    for (int i = 0; i < result.objsize(); i += g_minOSPageSizeBytes) {
-                        _dummy_char += *(result.objdata() + i);
-                    }
-                    // hit the last page, in case we missed it above
-                    _dummy_char += *(result.objdata() + result.objsize() - 1);
+                // the _id index lookup pages in the index; the record store decides how best to
+                // bring in the record itself
+                DiskLoc loc = Helpers::findById(txn, collection, builder.done());
+                if ( !loc.isNull() ) {
+                    collection->getRecordStore()->prefetch(txn, std::vector<DiskLoc>(1, loc));
                 }
             }
             catch(const DBException& e) {
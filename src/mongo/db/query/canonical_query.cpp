@@ -47,6 +47,7 @@ namespace {
     const char kEncodeChildrenSeparator = ',';
     const char kEncodeSortSection = '~';
     const char kEncodeProjectionSection = '|';
+    const char kEncodeSelectivitySection = '#';
 
     /**
      * Encode user-provided string. Cache key delimiters seen in the
@@ -61,6 +62,7 @@ namespace {
             case kEncodeChildrenSeparator:
             case kEncodeSortSection:
             case kEncodeProjectionSection:
+            case kEncodeSelectivitySection:
             case '\\':
                   *os << '\\';
                 // Fall through to default case.
@@ -577,12 +579,31 @@ namespace mongo {
         return _cacheKey;
     }
 
+    const PlanCacheKey& CanonicalQuery::getQueryShapeKey() const {
+        return _shapeKey;
+    }
+
+    void CanonicalQuery::setSelectivityBuckets(const std::string& buckets) {
+        mongoutils::str::stream ss;
+        ss << _shapeKey << kEncodeSelectivitySection << buckets;
+        _cacheKey = ss;
+    }
+
+    // static
+    bool CanonicalQuery::isSelectivityVariant(const PlanCacheKey& shapeKey,
+                                              const PlanCacheKey& key) {
+        return key.size() > shapeKey.size()
+            && key[shapeKey.size()] == kEncodeSelectivitySection
+            && 0 == key.compare(0, shapeKey.size(), shapeKey);
+    }
+
     void CanonicalQuery::generateCacheKey(void) {
         mongoutils::str::stream ss;
         encodePlanCacheKeyTree(_root.get(), &ss);
         encodePlanCacheKeySort(_pq->getSort(), &ss);
         encodePlanCacheKeyProj(_pq->getProj(), &ss);
-        _cacheKey = ss;
+        _shapeKey = ss;
+        _cacheKey = _shapeKey;
     }
 
     // static
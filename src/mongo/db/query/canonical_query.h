@@ -157,10 +157,30 @@ namespace mongo {
         const ParsedProjection* getProj() const { return _proj.get(); }
 
         /**
-         * Get the cache key for this canonical query.
+         * Get the cache key for this canonical query.  This is the query shape, followed by the
+         * selectivity buckets if any have been set.
          */
         const PlanCacheKey& getPlanCacheKey() const;
 
+        /**
+         * Get the cache key for the shape of this query alone, ignoring any selectivity buckets.
+         * Index filters are keyed by shape.
+         */
+        const PlanCacheKey& getQueryShapeKey() const;
+
+        /**
+         * Distinguishes queries of the same shape whose predicates select very different amounts
+         * of data, so that the plan cache keeps a separate entry for each.  'buckets' is an
+         * opaque encoding of the selectivity classes; see getExecutor().
+         */
+        void setSelectivityBuckets(const std::string& buckets);
+
+        /**
+         * Returns true if 'key' is the cache key of a query with shape 'shapeKey' and some
+         * selectivity buckets set.
+         */
+        static bool isSelectivityVariant(const PlanCacheKey& shapeKey, const PlanCacheKey& key);
+
         // Debugging
         std::string toString() const;
         std::string toStringShort() const;
@@ -233,6 +253,9 @@ namespace mongo {
          * for minimal user comprehension.
          */
         PlanCacheKey _cacheKey;
+
+        // The cache key without the selectivity buckets.
+        PlanCacheKey _shapeKey;
     };
 
 }  // namespace mongo
@@ -606,6 +606,32 @@ namespace {
         testGetPlanCacheKey("{}", "{}", "{a: 'foo,[]~|'}", "an|\"foo\\,\\[\\]\\~\\|\"a");
     }
 
+    // The selectivity section delimiter must be escaped too, so that a bucketed key can never
+    // collide with the key of another shape.
+    TEST(PlanCacheTest, GetPlanCacheKeyEscapedSelectivitySection) {
+        testGetPlanCacheKey("{'a#': 1}", "{}", "{}", "eqa\\#");
+    }
+
+    TEST(PlanCacheTest, GetPlanCacheKeySelectivityBuckets) {
+        auto_ptr<CanonicalQuery> cq(canonicalize("{a: {$in: [1, 2]}, b: {$gt: 5}}"));
+        PlanCacheKey shapeKey = cq->getPlanCacheKey();
+        ASSERT_EQUALS(shapeKey, cq->getQueryShapeKey());
+
+        cq->setSelectivityBuckets("i1r3");
+        ASSERT_EQUALS(shapeKey, cq->getQueryShapeKey());
+        ASSERT_EQUALS(shapeKey + "#i1r3", cq->getPlanCacheKey());
+        ASSERT_TRUE(CanonicalQuery::isSelectivityVariant(shapeKey, cq->getPlanCacheKey()));
+        ASSERT_FALSE(CanonicalQuery::isSelectivityVariant(shapeKey, shapeKey));
+
+        // Setting the buckets again replaces them rather than appending.
+        cq->setSelectivityBuckets("i2r3");
+        ASSERT_EQUALS(shapeKey + "#i2r3", cq->getPlanCacheKey());
+
+        // Another shape whose key extends this one is not a variant.
+        auto_ptr<CanonicalQuery> other(canonicalize("{a: {$in: [1, 2]}, b: {$gt: 5}, c: 1}"));
+        ASSERT_FALSE(CanonicalQuery::isSelectivityVariant(shapeKey, other->getPlanCacheKey()));
+    }
+
     // Cache keys for $geoWithin queries with legacy and GeoJSON coordinates should
     // not be the same.
     TEST(PlanCacheTest, GetPlanCacheKeyGeoWithin) {
@@ -148,6 +148,11 @@ namespace {
             const CollectionScanStats* spec = static_cast<const CollectionScanStats*>(specific);
             return spec->docsTested;
         }
+        else if (STAGE_PARALLEL_COLLSCAN == type) {
+            const ParallelCollectionScanStats* spec =
+                static_cast<const ParallelCollectionScanStats*>(specific);
+            return spec->docsTested;
+        }
 
         return 0;
     }
@@ -239,6 +244,8 @@ namespace mongo {
             if (verbosity >= Explain::EXEC_STATS) {
                 bob->appendNumber("memUsage", spec->memUsage);
                 bob->appendNumber("memLimit", spec->memLimit);
+                bob->appendNumber("maxMemUsage", spec->maxMemUsage);
+                bob->appendBool("usedDisk", spec->usedDisk);
             }
 
             // Extra info at full verbosity.
@@ -264,6 +271,12 @@ namespace mongo {
                 }
             }
         }
+        else if (STAGE_CACHED_PLAN == stats.stageType) {
+            CachedPlanStats* spec = static_cast<CachedPlanStats*>(stats.specific.get());
+            if (verbosity >= Explain::EXEC_STATS) {
+                bob->appendBool("replanned", spec->replanned);
+            }
+        }
         else if (STAGE_COLLSCAN == stats.stageType) {
             CollectionScanStats* spec = static_cast<CollectionScanStats*>(stats.specific.get());
             bob->append("direction", spec->direction > 0 ? "forward" : "backward");
@@ -271,6 +284,16 @@ namespace mongo {
                 bob->appendNumber("docsExamined", spec->docsTested);
             }
         }
+        else if (STAGE_PARALLEL_COLLSCAN == stats.stageType) {
+            ParallelCollectionScanStats* spec =
+                static_cast<ParallelCollectionScanStats*>(stats.specific.get());
+            bob->appendNumber("threads", spec->numThreads);
+            if (verbosity >= Explain::EXEC_STATS) {
+                bob->appendNumber("docsExamined", spec->docsTested);
+                bob->appendNumber("partitions", spec->numPartitions);
+                bob->appendNumber("rounds", spec->rounds);
+            }
+        }
         else if (STAGE_COUNT == stats.stageType) {
             CountStats* spec = static_cast<CountStats*>(stats.specific.get());
 
@@ -289,6 +312,16 @@ namespace mongo {
             bob->append("keyPattern", spec->keyPattern);
             bob->appendBool("isMultiKey", spec->isMultiKey);
         }
+        else if (STAGE_DISTINCT == stats.stageType) {
+            DistinctScanStats* spec = static_cast<DistinctScanStats*>(stats.specific.get());
+
+            if (verbosity >= Explain::EXEC_STATS) {
+                bob->appendNumber("keysExamined", spec->keysExamined);
+                bob->appendNumber("matchTested", spec->matchTested);
+            }
+
+            bob->append("keyPattern", spec->keyPattern);
+        }
         else if (STAGE_DELETE == stats.stageType) {
             DeleteStats* spec = static_cast<DeleteStats*>(stats.specific.get());
 
@@ -305,6 +338,7 @@ namespace mongo {
             // Extra info at full verbosity.
             if (verbosity == Explain::FULL) {
                 bob->appendNumber("alreadyHasObj", spec->alreadyHasObj);
+                bob->appendNumber("prefetched", spec->prefetched);
             }
         }
         else if (STAGE_GROUP == stats.stageType) {
@@ -383,6 +417,8 @@ namespace mongo {
             if (verbosity >= Explain::EXEC_STATS) {
                 bob->appendNumber("memUsage", spec->memUsage);
                 bob->appendNumber("memLimit", spec->memLimit);
+                bob->appendNumber("maxMemUsage", spec->maxMemUsage);
+                bob->appendBool("usedDisk", spec->usedDisk);
             }
 
             if (spec->limit > 0) {
@@ -685,6 +721,11 @@ namespace mongo {
             }
             if (STAGE_SORT == stages[i]->stageType()) {
                 statsOut->hasSortStage = true;
+
+                const SortStats* sortStats =
+                    static_cast<const SortStats*>(stages[i]->getSpecificStats());
+                statsOut->sortMemUsage += sortStats->maxMemUsage;
+                statsOut->sortUsedDisk = statsOut->sortUsedDisk || sortStats->usedDisk;
             }
         }
     }
@@ -51,6 +51,8 @@ namespace mongo {
                              totalDocsExamined(0),
                              isIdhack(false),
                              hasSortStage(false),
+                             sortMemUsage(0),
+                             sortUsedDisk(false),
                              summaryStr("") { }
 
         // The number of results returned by the plan.
@@ -71,6 +73,12 @@ namespace mongo {
         // Did this plan use an in-memory sort stage?
         bool hasSortStage;
 
+        // The most memory held at once by the plan's sort stages, in bytes.
+        size_t sortMemUsage;
+
+        // Did any sort stage spill data to disk?
+        bool sortUsedDisk;
+
         // A string summarizing the plan selected.
         std::string summaryStr;
     };
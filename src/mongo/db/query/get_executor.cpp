@@ -42,11 +42,14 @@
 #include "mongo/db/exec/eof.h"
 #include "mongo/db/exec/group.h"
 #include "mongo/db/exec/idhack.h"
+#include "mongo/db/exec/index_scan.h"
 #include "mongo/db/exec/multi_plan.h"
 #include "mongo/db/exec/projection.h"
 #include "mongo/db/exec/shard_filter.h"
 #include "mongo/db/exec/subplan.h"
 #include "mongo/db/exec/update.h"
+#include "mongo/db/exec/working_set.h"
+#include "mongo/db/matcher/expression_leaf.h"
 #include "mongo/db/query/canonical_query.h"
 #include "mongo/db/query/explain.h"
 #include "mongo/db/query/query_settings.h"
@@ -61,9 +64,11 @@
 #include "mongo/db/query/query_planner.h"
 #include "mongo/db/query/query_planner_common.h"
 #include "mongo/db/query/stage_builder.h"
+#include "mongo/db/global_environment_experiment.h"
 #include "mongo/db/index_names.h"
 #include "mongo/db/server_options.h"
 #include "mongo/db/server_parameters.h"
+#include "mongo/db/storage/storage_engine.h"
 #include "mongo/s/d_state.h"
 #include "mongo/scripting/engine.h"
 #include "mongo/util/log.h"
@@ -100,6 +105,7 @@ namespace mongo {
     namespace {
         // The body is below in the "count hack" section but getExecutor calls it.
         bool turnIxscanIntoCount(QuerySolution* soln);
+        bool removeFetchForCount(QuerySolution* soln);
     }  // namespace
 
 
@@ -165,12 +171,169 @@ namespace mongo {
             plannerParams->options |= QueryPlannerParams::INDEX_INTERSECTION;
         }
 
+        if (internalQueryPlannerEnableIndexSkipScan) {
+            plannerParams->options |= QueryPlannerParams::INDEX_SKIP_SCAN;
+        }
+
+        // The workers of a parallel collection scan read the record store without locking it,
+        // so the caller's lock must keep writers out of the collection.  Storage engines with
+        // document-level locking don't.  Capped collections can't be split.
+        if ((plannerParams->options & QueryPlannerParams::PARALLEL_COLLSCAN)
+            && (internalQueryParallelCollectionScanThreads < 2
+                || collection->isCapped()
+                || getGlobalEnvironment()->getGlobalStorageEngine()->supportsDocLocking())) {
+            plannerParams->options &= ~QueryPlannerParams::PARALLEL_COLLSCAN;
+        }
+
         plannerParams->options |= QueryPlannerParams::KEEP_MUTATIONS;
         plannerParams->options |= QueryPlannerParams::SPLIT_LIMITED_SORT;
     }
 
     namespace {
 
+        /**
+         * Buckets 'n' by its order of magnitude: 0 for zero, 1 for 1-9, 2 for 10-99 and so on.
+         */
+        char selectivityClass(size_t n) {
+            char bucket = '0';
+            while (n > 0 && bucket < '9') {
+                ++bucket;
+                n /= 10;
+            }
+            return bucket;
+        }
+
+        bool isRangePredicate(const MatchExpression* expr) {
+            switch (expr->matchType()) {
+            case MatchExpression::LT:
+            case MatchExpression::LTE:
+            case MatchExpression::GT:
+            case MatchExpression::GTE:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        /**
+         * Counts the keys of the btree index 'index' that fall within the intersection of the
+         * range predicates 'preds' over the index's leading field, stopping once
+         * internalQueryCacheSelectivityProbeKeys keys have been seen.
+         */
+        size_t probeRangeKeys(OperationContext* txn,
+                              Collection* collection,
+                              const IndexEntry& index,
+                              const std::vector<const MatchExpression*>& preds) {
+            IndexScanParams params;
+            params.descriptor =
+                collection->getIndexCatalog()->findIndexByKeyPattern(txn, index.keyPattern);
+            if (NULL == params.descriptor) {
+                return 0;
+            }
+            params.doNotDedup = true;
+
+            BSONObjIterator kpIt(index.keyPattern);
+            BSONElement leading = kpIt.next();
+            OrderedIntervalList oil(leading.fieldName());
+            IndexBoundsBuilder::BoundsTightness tightness;
+            IndexBoundsBuilder::translate(preds[0], leading, index, &oil, &tightness);
+            for (size_t i = 1; i < preds.size(); ++i) {
+                IndexBoundsBuilder::translateAndIntersect(preds[i], leading, index, &oil,
+                                                          &tightness);
+            }
+            params.bounds.fields.push_back(oil);
+            while (kpIt.more()) {
+                BSONElement elt = kpIt.next();
+                OrderedIntervalList rest(elt.fieldName());
+                IndexBoundsBuilder::allValuesForField(elt, &rest);
+                params.bounds.fields.push_back(rest);
+            }
+            IndexBoundsBuilder::alignBounds(&params.bounds, index.keyPattern);
+
+            const size_t maxKeys = static_cast<size_t>(internalQueryCacheSelectivityProbeKeys);
+            WorkingSet ws;
+            IndexScan scan(txn, params, &ws, NULL);
+            size_t keys = 0;
+            // The scan may need a few extra works to get going and to notice it is done.
+            for (size_t works = 0; keys < maxKeys && works < 2 * maxKeys + 2; ++works) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                PlanStage::StageState state = scan.work(&id);
+                if (PlanStage::ADVANCED == state) {
+                    ws.free(id);
+                    ++keys;
+                }
+                else if (PlanStage::NEED_TIME != state) {
+                    break;
+                }
+            }
+            return keys;
+        }
+
+        /**
+         * Computes the selectivity buckets of the top-level predicates of 'cq': a size class for
+         * each $in list, and, for each field with range predicates that leads a btree index, a
+         * class for how many keys of that index the ranges cover.  Returns the empty string if
+         * no predicate qualifies.
+         */
+        std::string computeSelectivityBuckets(OperationContext* txn,
+                                              Collection* collection,
+                                              const CanonicalQuery& cq,
+                                              const QueryPlannerParams& params) {
+            std::vector<const MatchExpression*> preds;
+            const MatchExpression* root = cq.root();
+            if (MatchExpression::AND == root->matchType()) {
+                for (size_t i = 0; i < root->numChildren(); ++i) {
+                    preds.push_back(root->getChild(i));
+                }
+            }
+            else {
+                preds.push_back(root);
+            }
+
+            mongoutils::str::stream buckets;
+            bool any = false;
+            std::set<StringData> probedPaths;
+            for (size_t i = 0; i < preds.size(); ++i) {
+                const MatchExpression* pred = preds[i];
+                if (MatchExpression::MATCH_IN == pred->matchType()) {
+                    const InMatchExpression* in = static_cast<const InMatchExpression*>(pred);
+                    buckets << 'i' << selectivityClass(in->getData().size());
+                    any = true;
+                    continue;
+                }
+                if (!isRangePredicate(pred) || !probedPaths.insert(pred->path()).second) {
+                    continue;
+                }
+
+                const IndexEntry* index = NULL;
+                for (size_t j = 0; j < params.indices.size(); ++j) {
+                    const IndexEntry& candidate = params.indices[j];
+                    if (INDEX_BTREE == candidate.type &&
+                        pred->path() == candidate.keyPattern.firstElementFieldName()) {
+                        index = &candidate;
+                        break;
+                    }
+                }
+                if (NULL == index) {
+                    continue;
+                }
+
+                // Intersect every range predicate over this path; the tree is sorted by path
+                // within each match type, but $gt and $lt on the same path are not adjacent.
+                std::vector<const MatchExpression*> ranges;
+                for (size_t j = i; j < preds.size(); ++j) {
+                    if (isRangePredicate(preds[j]) && preds[j]->path() == pred->path()) {
+                        ranges.push_back(preds[j]);
+                    }
+                }
+                buckets << 'r' << selectivityClass(probeRangeKeys(txn, collection, *index,
+                                                                  ranges));
+                any = true;
+            }
+
+            return any ? std::string(buckets) : std::string();
+        }
+
         /**
          * Build an execution tree for the query described in 'canonicalQuery'.  Does not take
          * ownership of arguments.
@@ -264,6 +427,17 @@ namespace mongo {
                 }
             }
 
+            // Cache queries of the same shape separately if their predicates are likely to
+            // favor different plans.  Index filters were looked up above by shape alone.
+            if (internalQueryCacheSelectivityBuckets &&
+                PlanCache::shouldCacheQuery(*canonicalQuery)) {
+                std::string buckets = computeSelectivityBuckets(opCtx, collection,
+                                                                *canonicalQuery, plannerParams);
+                if (!buckets.empty()) {
+                    canonicalQuery->setSelectivityBuckets(buckets);
+                }
+            }
+
             // Try to look up a cached solution for the query.
             CachedSolution* rawCS;
             if (PlanCache::shouldCacheQuery(*canonicalQuery) &&
@@ -276,11 +450,20 @@ namespace mongo {
 
                 if (status.isOK()) {
                     PlanStage *backupRoot = NULL;
+                    bool isFastCount = false;
+                    if (plannerParams.options & QueryPlannerParams::PRIVATE_IS_COUNT) {
+                        isFastCount = turnIxscanIntoCount(qs);
+                        if (!isFastCount) {
+                            removeFetchForCount(qs);
+                            if (NULL != backupQs) {
+                                removeFetchForCount(backupQs);
+                            }
+                        }
+                    }
+
                     // The working set is shared by the root and backupRoot plans.
                     verify(StageBuilder::build(opCtx, collection, *qs, ws, rootOut));
-                    if ((plannerParams.options & QueryPlannerParams::PRIVATE_IS_COUNT)
-                        && turnIxscanIntoCount(qs)) {
-
+                    if (isFastCount) {
                         LOG(2) << "Using fast count: " << canonicalQuery->toStringShort()
                                << ", planSummary: " << Explain::getPlanSummary(*rootOut);
                     }
@@ -290,9 +473,17 @@ namespace mongo {
 
                     // Add a CachedPlanStage on top of the previous root. Takes ownership of
                     // '*rootOut', 'backupRoot', 'qs', and 'backupQs'.
-                    *rootOut = new CachedPlanStage(collection, canonicalQuery,
-                                                   *rootOut, qs,
-                                                   backupRoot, backupQs);
+                    CachedPlanStage* cachedPlanStage =
+                        new CachedPlanStage(opCtx, collection, ws, canonicalQuery, plannerParams,
+                                            cs->decisionWorks, *rootOut, qs,
+                                            backupRoot, backupQs);
+                    *rootOut = cachedPlanStage;
+
+                    // Check the cached plan still does as well as it did when it was cached.
+                    // A fast count has nothing to compare with.
+                    if (!isFastCount) {
+                        cachedPlanStage->pickBestPlan();
+                    }
                     return Status::OK();
                 }
             }
@@ -355,6 +546,12 @@ namespace mongo {
                         return Status::OK();
                     }
                 }
+
+                // No fast count, but the candidates can still count index keys instead of
+                // documents wherever the index alone answers the predicate.
+                for (size_t i = 0; i < solutions.size(); ++i) {
+                    removeFetchForCount(solutions[i]);
+                }
             }
 
             if (1 == solutions.size()) {
@@ -751,11 +948,56 @@ namespace mongo {
             return true;
         }
 
+        /**
+         * Returns 'true' if the provided count solution 'soln' had a FETCH without a filter at
+         * its root, which has been removed.  Mutates the tree in 'soln->root'.
+         *
+         * A count only needs one result per matching document, not the document itself, so when
+         * all of the predicates are answered by the index (including by an index scan filter
+         * over any of its fields), nothing has to be fetched.
+         *
+         * Otherwise, returns 'false'.
+         */
+        bool removeFetchForCount(QuerySolution* soln) {
+            QuerySolutionNode* root = soln->root.get();
+
+            if (STAGE_FETCH != root->getType()) {
+                return false;
+            }
+
+            if (NULL != root->filter.get()) {
+                return false;
+            }
+
+            // The fetch's child becomes the new root.
+            invariant(1 == root->children.size());
+            QuerySolutionNode* child = root->children[0];
+            root->children.clear();
+            soln->root.reset(child);
+            return true;
+        }
+
+        /**
+         * Returns the position of 'field' in 'keyPattern', or -1 if the index does not have it.
+         */
+        int getDistinctFieldNo(const BSONObj& keyPattern, const std::string& field) {
+            int fieldNo = 0;
+            BSONObjIterator it(keyPattern);
+            while (it.more()) {
+                if (field == it.next().fieldName()) {
+                    return fieldNo;
+                }
+                fieldNo++;
+            }
+            return -1;
+        }
+
         /**
          * Returns true if indices contains an index that can be
          * used with DistinctNode. Sets indexOut to the array index
          * of PlannerParams::indices.
-         * Look for the index for the fewest fields.
+         * Look for the index with 'field' nearest the front of the key pattern, as every distinct
+         * value of the fields before it is a separate skip, and then for the fewest fields.
          * Criteria for suitable index is that the index cannot be special
          * (geo, hashed, text, ...).
          *
@@ -772,6 +1014,7 @@ namespace mongo {
                                   const std::string& field, size_t* indexOut) {
             invariant(indexOut);
             bool isDottedField = str::contains(field, '.');
+            int minFieldNo = std::numeric_limits<int>::max();
             int minFields = std::numeric_limits<int>::max();
             for (size_t i = 0; i < indices.size(); ++i) {
                 // Skip special indices.
@@ -782,9 +1025,14 @@ namespace mongo {
                 if (indices[i].multikey && isDottedField) {
                     continue;
                 }
+                int fieldNo = getDistinctFieldNo(indices[i].keyPattern, field);
+                if (fieldNo < 0) {
+                    continue;
+                }
                 int nFields = indices[i].keyPattern.nFields();
-                // Pick the index with the lowest number of fields.
-                if (nFields < minFields) {
+                // Pick the index with the field earliest and the lowest number of fields.
+                if (fieldNo < minFieldNo || (fieldNo == minFieldNo && nFields < minFields)) {
+                    minFieldNo = fieldNo;
                     minFields = nFields;
                     *indexOut = i;
                 }
@@ -906,7 +1154,8 @@ namespace mongo {
 
         auto_ptr<CanonicalQuery> cq(rawCq);
 
-        const size_t plannerOptions = QueryPlannerParams::PRIVATE_IS_COUNT;
+        const size_t plannerOptions = QueryPlannerParams::PRIVATE_IS_COUNT
+                                    | QueryPlannerParams::PARALLEL_COLLSCAN;
         Status prepStatus = prepareExecution(txn, collection, ws.get(), cq.get(), plannerOptions,
                                              &root, &querySolution);
         if (!prepStatus.isOK()) {
@@ -927,6 +1176,165 @@ namespace mongo {
     // Distinct hack
     //
 
+    namespace {
+
+        /**
+         * Returns true if 'sort' names the leading fields of 'keyPattern', with every direction the
+         * same as in the index or every direction reversed.
+         */
+        bool isIndexPrefixSort(const BSONObj& keyPattern, const BSONObj& sort) {
+            if (sort.isEmpty()) {
+                return false;
+            }
+
+            int direction = 0;
+            BSONObjIterator kpIt(keyPattern);
+            BSONObjIterator sortIt(sort);
+            while (sortIt.more()) {
+                if (!kpIt.more()) {
+                    return false;
+                }
+                const BSONElement kpElt = kpIt.next();
+                const BSONElement sortElt = sortIt.next();
+                if (!str::equals(kpElt.fieldName(), sortElt.fieldName())) {
+                    return false;
+                }
+
+                const int sameDirection =
+                    (kpElt.number() >= 0) == (sortElt.number() >= 0) ? 1 : -1;
+                if (0 == direction) {
+                    direction = sameDirection;
+                }
+                else if (direction != sameDirection) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * If 'soln' is an unfiltered fetch over an index scan, replaces the index scan with a
+         * distinct scan over the first field of the index and returns true. Any filter of the index
+         * scan moves to the distinct scan, which applies it before skipping.
+         */
+        bool turnFetchedIxscanIntoDistinctIxscan(QuerySolution* soln) {
+            QuerySolutionNode* root = soln->root.get();
+            if (STAGE_FETCH != root->getType() || NULL != root->filter.get()
+                || STAGE_IXSCAN != root->children[0]->getType()) {
+                return false;
+            }
+
+            IndexScanNode* isn = static_cast<IndexScanNode*>(root->children[0]);
+            if (isn->bounds.isSimpleRange) {
+                return false;
+            }
+
+            DistinctNode* dn = new DistinctNode();
+            dn->indexKeyPattern = isn->indexKeyPattern;
+            dn->direction = isn->direction;
+            dn->bounds = isn->bounds;
+            dn->filter.swap(isn->filter);
+            dn->fieldNo = 0;
+
+            delete root->children[0];
+            root->children[0] = dn;
+            return true;
+        }
+
+    }  // namespace
+
+    Status getExecutorFirstPerKey(OperationContext* txn,
+                                  Collection* collection,
+                                  const BSONObj& query,
+                                  const BSONObj& sort,
+                                  PlanExecutor** out) {
+        if (NULL == collection) {
+            return Status(ErrorCodes::BadValue, "no collection to distinct scan");
+        }
+
+        // Orphans are filtered out above the scan, and one could hide the rest of its key's
+        // documents.
+        if (shardingState.needCollectionMetadata(collection->ns().ns())) {
+            return Status(ErrorCodes::BadValue, "cannot distinct scan a sharded collection");
+        }
+
+        // The first key of a value has to be the first document in sort order. A multikey index
+        // orders documents by single array elements, a sparse one leaves documents out, and a
+        // special one does not keep the values themselves.
+        QueryPlannerParams plannerParams;
+        plannerParams.options = QueryPlannerParams::NO_TABLE_SCAN
+                              | QueryPlannerParams::NO_BLOCKING_SORT;
+        IndexCatalog::IndexIterator ii =
+            collection->getIndexCatalog()->getIndexIterator(txn, false);
+        while (ii.more()) {
+            const IndexDescriptor* desc = ii.next();
+            if (desc->isMultikey(txn)
+                || desc->isSparse()
+                || !IndexNames::findPluginName(desc->keyPattern()).empty()
+                || !isIndexPrefixSort(desc->keyPattern(), sort)) {
+                continue;
+            }
+
+            plannerParams.indices.push_back(IndexEntry(desc->keyPattern(),
+                                                       desc->getAccessMethodName(),
+                                                       false,
+                                                       false,
+                                                       desc->indexName(),
+                                                       desc->infoObj()));
+        }
+
+        if (plannerParams.indices.empty()) {
+            return Status(ErrorCodes::BadValue, "no index to distinct scan");
+        }
+
+        const WhereCallbackReal whereCallback(txn, collection->ns().db());
+        CanonicalQuery* rawCq;
+        Status status = CanonicalQuery::canonicalize(collection->ns().ns(),
+                                                     query,
+                                                     sort,
+                                                     BSONObj(),
+                                                     &rawCq,
+                                                     whereCallback);
+        if (!status.isOK()) {
+            return status;
+        }
+
+        auto_ptr<CanonicalQuery> cq(rawCq);
+
+        vector<QuerySolution*> solutions;
+        status = QueryPlanner::plan(*cq, plannerParams, &solutions);
+        if (!status.isOK()) {
+            return status;
+        }
+
+        // A filter the fetch applies could reject the first key of a value after the scan has
+        // skipped the rest, so only predicates over the index keys are allowed.
+        QuerySolution* soln = NULL;
+        for (size_t i = 0; i < solutions.size(); ++i) {
+            if (NULL == soln && turnFetchedIxscanIntoDistinctIxscan(solutions[i])) {
+                soln = solutions[i];
+            }
+            else {
+                delete solutions[i];
+            }
+        }
+
+        if (NULL == soln) {
+            return Status(ErrorCodes::BadValue, "no plan can distinct scan");
+        }
+
+        WorkingSet* ws = new WorkingSet();
+        PlanStage* root;
+        verify(StageBuilder::build(txn, collection, *soln, ws, &root));
+
+        LOG(2) << "Using distinct scan for first document per key: " << cq->toStringShort()
+               << ", planSummary: " << Explain::getPlanSummary(root);
+
+        // Takes ownership of its arguments (except for 'collection').
+        *out = new PlanExecutor(ws, root, soln, cq.release(), collection);
+        return Status::OK();
+    }
+
     bool turnIxscanIntoDistinctIxscan(QuerySolution* soln, const string& field) {
         QuerySolutionNode* root = soln->root.get();
 
@@ -934,13 +1342,6 @@ namespace mongo {
         if (STAGE_PROJECTION == root->getType() && (STAGE_IXSCAN == root->children[0]->getType())) {
             IndexScanNode* isn = static_cast<IndexScanNode*>(root->children[0]);
 
-            // An additional filter must be applied to the data in the key, so we can't just skip
-            // all the keys with a given value; we must examine every one to find the one that (may)
-            // pass the filter.
-            if (NULL != isn->filter.get()) {
-                return false;
-            }
-
             // We only set this when we have special query modifiers (.max() or .min()) or other
             // special cases.  Don't want to handle the interactions between those and distinct.
             // Don't think this will ever really be true but if it somehow is, just ignore this
@@ -955,17 +1356,14 @@ namespace mongo {
             dn->direction = isn->direction;
             dn->bounds = isn->bounds;
 
-            // Figure out which field we're skipping to the next value of.  TODO: We currently only
-            // try to distinct-hack when there is an index prefixed by the field we're distinct-ing
-            // over.  Consider removing this code if we stick with that policy.
-            dn->fieldNo = 0;
-            BSONObjIterator it(isn->indexKeyPattern);
-            while (it.more()) {
-                if (field == it.next().fieldName()) {
-                    break;
-                }
-                dn->fieldNo++;
-            }
+            // An additional filter must be applied to the data in the key, so we can't just skip
+            // all the keys with a given value; the distinct scan examines keys one at a time until
+            // one passes the filter, and only then skips.
+            dn->filter.swap(isn->filter);
+
+            // Figure out which field we're skipping to the next value of.
+            dn->fieldNo = getDistinctFieldNo(isn->indexKeyPattern, field);
+            invariant(dn->fieldNo >= 0);
 
             // Delete the old index scan, set the child of project to the fast distinct scan.
             delete root->children[0];
@@ -998,12 +1396,25 @@ namespace mongo {
         QueryPlannerParams plannerParams;
         plannerParams.options = QueryPlannerParams::NO_TABLE_SCAN;
 
-        IndexCatalog::IndexIterator ii = collection->getIndexCatalog()->getIndexIterator(txn,false);
-        while (ii.more()) {
-            const IndexDescriptor* desc = ii.next();
-            // The distinct hack can work if any field is in the index but it's not always clear
-            // if it's a win unless it's the first field.
-            if (desc->keyPattern().firstElement().fieldName() == field) {
+        // The distinct hack can work if any field is in the index but it's not always clear if
+        // it's a win unless it's the first field: for a later field we skip once per distinct
+        // value of the fields before it.  So only fall back on those indices when no index is
+        // prefixed by the field.
+        for (int pass = 0; pass < 2 && plannerParams.indices.empty(); ++pass) {
+            IndexCatalog::IndexIterator ii =
+                collection->getIndexCatalog()->getIndexIterator(txn, false);
+            while (ii.more()) {
+                const IndexDescriptor* desc = ii.next();
+                int fieldNo = getDistinctFieldNo(desc->keyPattern(), field);
+                if (fieldNo < 0 || (0 == pass) != (0 == fieldNo)) {
+                    continue;
+                }
+
+                // Special indices don't keep the field's values in their keys.
+                if (!IndexNames::findPluginName(desc->keyPattern()).empty()) {
+                    continue;
+                }
+
                 plannerParams.indices.push_back(IndexEntry(desc->keyPattern(),
                                                            desc->getAccessMethodName(),
                                                            desc->isMultikey(txn),
@@ -1030,7 +1441,7 @@ namespace mongo {
         }
 
         //
-        // If we're here, we have an index prefixed by the field we're distinct-ing over.
+        // If we're here, we have an index containing the field we're distinct-ing over.
         //
 
         // Applying a projection allows the planner to try to give us covered plans that we can turn
@@ -1062,7 +1473,7 @@ namespace mongo {
             dn->indexKeyPattern = plannerParams.indices[distinctNodeIndex].keyPattern;
             dn->direction = 1;
             IndexBoundsBuilder::allValuesBounds(dn->indexKeyPattern, &dn->bounds);
-            dn->fieldNo = 0;
+            dn->fieldNo = getDistinctFieldNo(dn->indexKeyPattern, field);
 
             QueryPlannerParams params;
 
@@ -115,6 +115,20 @@ namespace mongo {
                                const std::string& field,
                                PlanExecutor** out);
 
+    /**
+     * Get an executor that returns, for each distinct value of the first field of 'sort', only the
+     * first document matching 'query' in 'sort' order. This is a distinct scan over an index whose
+     * key pattern starts with 'sort', skipping to the next value once a key has matched.
+     *
+     * Returns a non-OK status, and no executor, if no index or plan is suitable. The caller then
+     * has to plan the query normally.
+     */
+    Status getExecutorFirstPerKey(OperationContext* txn,
+                                  Collection* collection,
+                                  const BSONObj& query,
+                                  const BSONObj& sort,
+                                  PlanExecutor** out);
+
     /*
      * Get a PlanExecutor for a query executing as part of a count command.
      *
@@ -449,6 +449,7 @@ namespace mongo {
         this->showDiskLoc = false;
         this->snapshot = false;
         this->hasReadPref = false;
+        this->allowDiskUse = false;
         this->tailable = false;
         this->slaveOk = false;
         this->oplogReplay = false;
@@ -558,6 +559,14 @@ namespace mongo {
 
                 out->snapshot = el.boolean();
             }
+            else if (mongoutils::str::equals(fieldName, "allowDiskUse")) {
+                Status status = checkFieldType(el, Bool);
+                if (!status.isOK()) {
+                    return status;
+                }
+
+                out->allowDiskUse = el.boolean();
+            }
             else if (mongoutils::str::equals(fieldName, "tailable")) {
                 Status status = checkFieldType(el, Bool);
                 if (!status.isOK()) {
@@ -809,6 +818,10 @@ namespace mongo {
                     // Won't throw.
                     _options.maxScan = e.numberInt();
                 }
+                else if (str::equals("allowDiskUse", name)) {
+                    // Won't throw.
+                    _options.allowDiskUse = e.trueValue();
+                }
                 else if (str::equals("showDiskLoc", name)) {
                     // Won't throw.
                     if (e.trueValue()) {
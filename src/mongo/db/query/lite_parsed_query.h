@@ -97,6 +97,9 @@ namespace mongo {
             bool snapshot;
             bool hasReadPref;
 
+            // May a blocking sort write to temporary files once it exceeds its memory limit?
+            bool allowDiskUse;
+
             // Options that can be specified in the OP_QUERY 'flags' header.
             bool tailable;
             bool slaveOk;
@@ -198,6 +201,7 @@ namespace mongo {
         bool isSnapshot() const { return _options.snapshot; }
         bool returnKey() const { return _options.returnKey; }
         bool showDiskLoc() const { return _options.showDiskLoc; }
+        bool allowDiskUse() const { return _options.allowDiskUse; }
 
         const BSONObj& getMin() const { return _options.min; }
         const BSONObj& getMax() const { return _options.max; }
@@ -45,6 +45,7 @@
 #include "mongo/db/query/get_executor.h"
 #include "mongo/db/query/internal_plans.h"
 #include "mongo/db/query/qlog.h"
+#include "mongo/db/query/query_knobs.h"
 #include "mongo/db/query/query_planner_params.h"
 #include "mongo/db/repl/repl_coordinator_global.h"
 #include "mongo/db/server_options.h"
@@ -579,6 +580,8 @@ namespace mongo {
             if (shardingState.needCollectionMetadata(pq.ns())) {
                 options |= QueryPlannerParams::INCLUDE_SHARD_FILTER;
             }
+            // Queries don't write, so their collection scans may be split across threads.
+            options |= QueryPlannerParams::PARALLEL_COLLSCAN;
             // Takes ownership of 'cq'.
             status = getExecutor(txn, collection, cq, &rawExec, options);
         }
@@ -672,6 +675,12 @@ namespace mongo {
         // The executor registers itself with the active executors list in ClientCursor.
         auto_ptr<ScopedExecutorRegistration> safety(new ScopedExecutorRegistration(exec.get()));
 
+        // Now that the executor hears about deletions and mutations, it can buffer results.  It
+        // stays batched if it's saved in a ClientCursor for getMore.
+        if (internalQueryExecBatched) {
+            exec->setBatchedExecution(true);
+        }
+
         BSONObj obj;
         PlanExecutor::ExecState state;
         // uint64_t numMisplacedDocs = 0;
@@ -769,6 +778,10 @@ namespace mongo {
             curop.debug().ntoskip = pq.getSkip();
             curop.debug().nreturned = numResults;
             curop.debug().scanAndOrder = newStats.hasSortStage;
+            if (newStats.hasSortStage) {
+                curop.debug().sortMemUsage = newStats.sortMemUsage;
+                curop.debug().sortUsedDisk = newStats.sortUsedDisk;
+            }
             curop.debug().nscanned = newStats.totalKeysExamined;
             curop.debug().nscannedObjects = newStats.totalDocsExamined;
             curop.debug().idhack = newStats.isIdhack;
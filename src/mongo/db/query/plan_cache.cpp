@@ -109,6 +109,7 @@ namespace mongo {
         : plannerData(entry.plannerData.size()),
           backupSoln(entry.backupSoln),
           key(key),
+          decisionWorks(0),
           query(entry.query.getOwned()),
           sort(entry.sort.getOwned()),
           projection(entry.projection.getOwned()) {
@@ -118,6 +119,11 @@ namespace mongo {
             verify(entry.plannerData[i]);
             plannerData[i] = entry.plannerData[i]->clone();
         }
+
+        // The winner's stats come first.
+        if (entry.decision.get() && !entry.decision->stats.empty()) {
+            decisionWorks = entry.decision->stats.vector()[0]->common.works;
+        }
     }
 
     CachedSolution::~CachedSolution() {
@@ -280,6 +286,12 @@ namespace mongo {
         case COLLSCAN_SOLN:
             ss << "(collection scan)";
             break;
+        case SKIP_IXSCAN_SOLN:
+            verify(this->tree.get());
+            ss << "(skip index scan solution: "
+               << "tree=" << this->tree->toString()
+               << ")";
+            break;
         case USE_INDEX_TAGS_SOLN:
             verify(this->tree.get());
             ss << "(index-tagged expression tree: "
@@ -344,6 +356,7 @@ namespace mongo {
         std::auto_ptr<PlanCacheEntry> evictedEntry = _cache.add(query.getPlanCacheKey(), entry);
 
         if (NULL != evictedEntry.get()) {
+            ++_counters.evictedLeastRecentlyUsed;
             LOG(1) << _ns << ": plan cache maximum size exceeded - "
                    << "removed least recently used entry "
                    << evictedEntry->toString();
@@ -442,6 +455,7 @@ namespace mongo {
                 LOG(1) << _ns << ": removing plan cache entry " << entry->toString()
                        << " - detected degradation in performance of cached solution.";
                 _cache.remove(ck);
+                ++_counters.evictedDegraded;
             }
         }
         else {
@@ -454,7 +468,37 @@ namespace mongo {
 
     Status PlanCache::remove(const CanonicalQuery& canonicalQuery) {
         boost::lock_guard<boost::mutex> cacheLock(_cacheMutex);
-        return _cache.remove(canonicalQuery.getPlanCacheKey());
+        Status status = _cache.remove(canonicalQuery.getPlanCacheKey());
+
+        // Removing by shape also removes the entries for each selectivity bucket of the shape.
+        const PlanCacheKey& shapeKey = canonicalQuery.getQueryShapeKey();
+        if (!internalQueryCacheSelectivityBuckets || shapeKey != canonicalQuery.getPlanCacheKey()) {
+            return status;
+        }
+        std::vector<PlanCacheKey> variants;
+        getSelectivityVariants(shapeKey, &variants);
+        for (size_t i = 0; i < variants.size(); ++i) {
+            _cache.remove(variants[i]);
+        }
+        return variants.empty() ? status : Status::OK();
+    }
+
+    void PlanCache::getSelectivityVariants(const PlanCacheKey& shapeKey,
+                                           std::vector<PlanCacheKey>* out) const {
+        typedef std::list< std::pair<PlanCacheKey, PlanCacheEntry*> >::const_iterator ConstIterator;
+        for (ConstIterator i = _cache.begin(); i != _cache.end(); ++i) {
+            if (CanonicalQuery::isSelectivityVariant(shapeKey, i->first)) {
+                out->push_back(i->first);
+            }
+        }
+    }
+
+    void PlanCache::notifyOfReplan(const CanonicalQuery& cq) {
+        boost::lock_guard<boost::mutex> cacheLock(_cacheMutex);
+        ++_counters.replans;
+        if (_cache.remove(cq.getPlanCacheKey()).isOK()) {
+            ++_counters.evictedReplanned;
+        }
     }
 
     void PlanCache::clear() {
@@ -494,7 +538,16 @@ namespace mongo {
 
     bool PlanCache::contains(const CanonicalQuery& cq) const {
         boost::lock_guard<boost::mutex> cacheLock(_cacheMutex);
-        return _cache.hasKey(cq.getPlanCacheKey());
+        if (_cache.hasKey(cq.getPlanCacheKey())) {
+            return true;
+        }
+        const PlanCacheKey& shapeKey = cq.getQueryShapeKey();
+        if (!internalQueryCacheSelectivityBuckets || shapeKey != cq.getPlanCacheKey()) {
+            return false;
+        }
+        std::vector<PlanCacheKey> variants;
+        getSelectivityVariants(shapeKey, &variants);
+        return !variants.empty();
     }
 
     size_t PlanCache::size() const {
@@ -512,7 +565,16 @@ namespace mongo {
         LOG(1) << _ns << ": clearing collection plan cache - "
                << internalQueryCacheWriteOpsBetweenFlush
                << " write operations detected since last refresh.";
-        clear();
+
+        boost::lock_guard<boost::mutex> cacheLock(_cacheMutex);
+        _counters.evictedWriteOps += _cache.size();
+        _cache.clear();
+        _writeOperations.store(0);
+    }
+
+    PlanCacheCounters PlanCache::getCounters() const {
+        boost::lock_guard<boost::mutex> cacheLock(_cacheMutex);
+        return _counters;
     }
 
 }  // namespace mongo
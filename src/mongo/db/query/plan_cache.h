@@ -150,6 +150,11 @@ namespace mongo {
             // The cached plan is a collection scan.
             COLLSCAN_SOLN,
 
+            // Indicates that the plan should skip-scan
+            // the index in 'tree', which the query
+            // does not constrain on its leading field.
+            SKIP_IXSCAN_SOLN,
+
             // Build the solution by using 'tree'
             // to tag the match expression.
             USE_INDEX_TAGS_SOLN
@@ -186,6 +191,10 @@ namespace mongo {
         // Key used to provide feedback on the entry.
         PlanCacheKey key;
 
+        // How many works the winning plan took during ranking.  A cached run which needs many more
+        // than this to produce the same results gets replanned.
+        size_t decisionWorks;
+
         // For debugging.
         std::string toString() const;
 
@@ -268,6 +277,33 @@ namespace mongo {
         static const double kMinDeviation;
     };
 
+    /**
+     * Counts of how often cached plans were replanned and why entries left a PlanCache.  Reported
+     * by planCacheListPlans.
+     */
+    struct PlanCacheCounters {
+        PlanCacheCounters() : replans(0),
+                              evictedLeastRecentlyUsed(0),
+                              evictedDegraded(0),
+                              evictedReplanned(0),
+                              evictedWriteOps(0) { }
+
+        // How many times a CachedPlanStage gave up on a cached plan and replanned.
+        long long replans;
+
+        // Entries pushed out of the cache by newer entries.
+        long long evictedLeastRecentlyUsed;
+
+        // Entries removed because feedback showed the cached plan doing worse than usual.
+        long long evictedDegraded;
+
+        // Entries removed because a query using them was replanned.
+        long long evictedReplanned;
+
+        // Entries flushed by notifyOfWriteOp().
+        long long evictedWriteOps;
+    };
+
     /**
      * Caches the best solution to a query.  Aside from the (CanonicalQuery -> QuerySolution)
      * mapping, the cache contains information on why that mapping was made and statistics on the
@@ -341,9 +377,19 @@ namespace mongo {
         /**
          * Remove the entry corresponding to 'ck' from the cache.  Returns Status::OK() if the plan
          * was present and removed and an error status otherwise.
+         *
+         * If internalQueryCacheSelectivityBuckets is on and 'canonicalQuery' has no selectivity
+         * buckets set, the entries for every selectivity bucket of its shape are removed as well.
          */
         Status remove(const CanonicalQuery& canonicalQuery);
 
+        /**
+         * The CachedPlanStage calls this when the cached plan for 'cq' performs badly enough that
+         * it replans the query.  Removes the entry for 'cq' if it is still cached, so that the
+         * new plan can be cached in its place.
+         */
+        void notifyOfReplan(const CanonicalQuery& cq);
+
         /**
          * Remove *all* entries.
          */
@@ -370,7 +416,8 @@ namespace mongo {
 
         /**
          * Returns true if there is an entry in the cache for the 'query'.
-         * Internally calls hasKey() on the LRU cache.
+         * Internally calls hasKey() on the LRU cache.  If internalQueryCacheSelectivityBuckets is
+         * on, an entry for any selectivity bucket of the shape counts if 'cq' has no buckets set.
          */
         bool contains(const CanonicalQuery& cq) const;
 
@@ -386,6 +433,11 @@ namespace mongo {
          */
         void notifyOfWriteOp();
 
+        /**
+         * Returns a copy of the replanning and eviction counters.
+         */
+        PlanCacheCounters getCounters() const;
+
     private:
 
         /**
@@ -395,8 +447,20 @@ namespace mongo {
          */
         void _clear();
 
+        /**
+         * Appends to 'out' the keys of all cached entries for selectivity buckets of 'shapeKey',
+         * most recently used first.  Caller must hold _cacheMutex.
+         */
+        void getSelectivityVariants(const PlanCacheKey& shapeKey,
+                                    std::vector<PlanCacheKey>* out) const;
+
         LRUKeyValue<PlanCacheKey, PlanCacheEntry> _cache;
 
+        /**
+         * Protected by _cacheMutex.  Survives clear().
+         */
+        PlanCacheCounters _counters;
+
         /**
          * Protects _cache.
          */
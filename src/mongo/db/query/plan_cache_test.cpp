@@ -378,6 +378,62 @@ namespace {
         ASSERT_EQUALS(planCache.size(), 1U);
     }
 
+    /**
+     * Restores internalQueryCacheSelectivityBuckets when it goes out of scope.
+     */
+    class SelectivityBucketsGuard {
+    public:
+        SelectivityBucketsGuard() : _old(internalQueryCacheSelectivityBuckets) { }
+        ~SelectivityBucketsGuard() { internalQueryCacheSelectivityBuckets = _old; }
+    private:
+        bool _old;
+    };
+
+    // Queries of the same shape in different selectivity buckets get separate entries.  With
+    // internalQueryCacheSelectivityBuckets on, contains() and remove() by shape see all of them.
+    TEST(PlanCacheTest, SelectivityBuckets) {
+        SelectivityBucketsGuard guard;
+        internalQueryCacheSelectivityBuckets = true;
+
+        PlanCache planCache;
+        auto_ptr<CanonicalQuery> narrow(canonicalize("{a: {$gt: 5}}"));
+        auto_ptr<CanonicalQuery> wide(canonicalize("{a: {$gt: 5}}"));
+        auto_ptr<CanonicalQuery> shape(canonicalize("{a: {$gt: 5}}"));
+        narrow->setSelectivityBuckets("r1");
+        wide->setSelectivityBuckets("r3");
+        QuerySolution qs;
+        qs.cacheData.reset(new SolutionCacheData());
+        qs.cacheData->tree.reset(new PlanCacheIndexTree());
+        std::vector<QuerySolution*> solns;
+        solns.push_back(&qs);
+
+        ASSERT_OK(planCache.add(*narrow, solns, createDecision(1U)));
+        ASSERT_TRUE(planCache.contains(*narrow));
+        ASSERT_FALSE(planCache.contains(*wide));
+        ASSERT_TRUE(planCache.contains(*shape));
+
+        ASSERT_OK(planCache.add(*wide, solns, createDecision(1U)));
+        ASSERT_EQUALS(planCache.size(), 2U);
+
+        // getEntry() only returns the entry for the query's own bucket.
+        PlanCacheEntry* rawEntry;
+        ASSERT_NOT_OK(planCache.getEntry(*shape, &rawEntry));
+        ASSERT_OK(planCache.getEntry(*wide, &rawEntry));
+        delete rawEntry;
+
+        // With the knob off, shape-level operations only look at the shape's own entry.
+        internalQueryCacheSelectivityBuckets = false;
+        ASSERT_FALSE(planCache.contains(*shape));
+        ASSERT_NOT_OK(planCache.remove(*shape));
+        ASSERT_EQUALS(planCache.size(), 2U);
+
+        // Removing by shape removes every bucket.
+        internalQueryCacheSelectivityBuckets = true;
+        ASSERT_OK(planCache.remove(*shape));
+        ASSERT_EQUALS(planCache.size(), 0U);
+        ASSERT_NOT_OK(planCache.remove(*shape));
+    }
+
     TEST(PlanCacheTest, NotifyOfWriteOp) {
         PlanCache planCache;
         auto_ptr<CanonicalQuery> cq(canonicalize("{a: 1}"));
@@ -28,6 +28,8 @@
 
 #include "mongo/db/query/plan_executor.h"
 
+#include <algorithm>
+
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/exec/plan_stats.h"
@@ -36,13 +38,22 @@
 
 namespace mongo {
 
+    namespace {
+        // The largest number of works that one workBatch() call made by getNext() may do.
+        const size_t kMaxBatchSize = 128;
+    }
+
     PlanExecutor::PlanExecutor(WorkingSet* ws, PlanStage* rt, const Collection* collection)
         : _collection(collection),
           _cq(NULL),
           _workingSet(ws),
           _qs(NULL),
           _root(rt),
-          _killed(false) {
+          _killed(false),
+          _batched(false),
+          _batchSize(1),
+          _batchFailed(false),
+          _batchFailedId(WorkingSet::INVALID_ID) {
         initNs();
     }
 
@@ -53,7 +64,11 @@ namespace mongo {
           _qs(NULL),
           _root(rt),
           _ns(ns),
-          _killed(false) { }
+          _killed(false),
+          _batched(false),
+          _batchSize(1),
+          _batchFailed(false),
+          _batchFailedId(WorkingSet::INVALID_ID) { }
 
     PlanExecutor::PlanExecutor(WorkingSet* ws, PlanStage* rt, CanonicalQuery* cq,
                                const Collection* collection)
@@ -62,7 +77,11 @@ namespace mongo {
           _workingSet(ws),
           _qs(NULL),
           _root(rt),
-          _killed(false) {
+          _killed(false),
+          _batched(false),
+          _batchSize(1),
+          _batchFailed(false),
+          _batchFailedId(WorkingSet::INVALID_ID) {
         initNs();
     }
 
@@ -73,7 +92,11 @@ namespace mongo {
           _workingSet(ws),
           _qs(qs),
           _root(rt),
-          _killed(false) {
+          _killed(false),
+          _batched(false),
+          _batchSize(1),
+          _batchFailed(false),
+          _batchFailedId(WorkingSet::INVALID_ID) {
         initNs();
     }
 
@@ -121,7 +144,74 @@ namespace mongo {
     }
 
     void PlanExecutor::invalidate(const DiskLoc& dl, InvalidationType type) {
-        if (!_killed) { _root->invalidate(dl, type); }
+        if (_killed) { return; }
+
+        _root->invalidate(dl, type);
+
+        // Results we've buffered are no longer in the tree, so fix them up the same way a stage
+        // that holds on to results would.
+        std::deque<WorkingSetID>::iterator it = _batch.begin();
+        while (it != _batch.end()) {
+            WorkingSetMember* member = _workingSet->get(*it);
+            if (!member->hasLoc() || member->loc != dl) {
+                ++it;
+            }
+            else if (member->hasObj()) {
+                // Keep the version of the document we had.
+                member->obj = member->obj.getOwned();
+                member->state = WorkingSetMember::OWNED_OBJ;
+                member->loc = DiskLoc();
+                ++it;
+            }
+            else if (INVALIDATION_DELETION == type) {
+                // Nothing left to return.
+                _workingSet->free(*it);
+                it = _batch.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    void PlanExecutor::setBatchedExecution(bool batched) {
+        // Turning batching off would strand anything that is buffered.
+        invariant(batched || (_batch.empty() && !_batchFailed));
+        _batched = batched;
+    }
+
+    PlanStage::StageState PlanExecutor::workRoot(WorkingSetID* out) {
+        if (!_batched) {
+            return _root->work(out);
+        }
+
+        PlanStage::StageState code = PlanStage::NEED_TIME;
+        if (_batch.empty() && !_batchFailed) {
+            std::vector<WorkingSetID> ids;
+            code = _root->workBatch(_batchSize, &ids);
+            if (PlanStage::FAILURE == code) {
+                _batchFailed = true;
+                _batchFailedId = ids.back();
+                ids.pop_back();
+            }
+            _batch.insert(_batch.end(), ids.begin(), ids.end());
+            _batchSize = std::min(_batchSize * 2, kMaxBatchSize);
+        }
+
+        if (!_batch.empty()) {
+            *out = _batch.front();
+            _batch.pop_front();
+            return PlanStage::ADVANCED;
+        }
+
+        if (_batchFailed) {
+            _batchFailed = false;
+            *out = _batchFailedId;
+            return PlanStage::FAILURE;
+        }
+
+        // EOF isn't remembered, a tailable cursor may have more to return later.
+        return code;
     }
 
     PlanExecutor::ExecState PlanExecutor::getNext(BSONObj* objOut, DiskLoc* dlOut) {
@@ -129,7 +219,7 @@ namespace mongo {
 
         for (;;) {
             WorkingSetID id = WorkingSet::INVALID_ID;
-            PlanStage::StageState code = _root->work(&id);
+            PlanStage::StageState code = workRoot(&id);
 
             if (PlanStage::ADVANCED == code) {
                 // Fast count.
@@ -197,7 +287,7 @@ namespace mongo {
     }
 
     bool PlanExecutor::isEOF() {
-        return _killed || _root->isEOF();
+        return _killed || (_batch.empty() && !_batchFailed && _root->isEOF());
     }
 
     void PlanExecutor::registerExecInternalPlan() {
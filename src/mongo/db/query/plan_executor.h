@@ -29,8 +29,10 @@
 #pragma once
 
 #include <boost/scoped_ptr.hpp>
+#include <deque>
 
 #include "mongo/base/status.h"
+#include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/invalidation_type.h"
 #include "mongo/db/query/query_solution.h"
 
@@ -39,7 +41,6 @@ namespace mongo {
     class BSONObj;
     class Collection;
     class DiskLoc;
-    class PlanStage;
     class PlanExecutor;
     struct PlanStageStats;
     class WorkingSet;
@@ -190,12 +191,29 @@ namespace mongo {
         // Running Support
         //
 
-        /** TODO document me */
+        /**
+         * Produces the next result, setting *objOut and *dlOut if they're not NULL.
+         *
+         * *objOut is not owned: it may point at a document on disk, or at index key data held by
+         * the WorkingSet, so it's only good until the next call to getNext() or saveState().  Call
+         * getOwned() on it to keep it any longer.
+         */
         ExecState getNext(BSONObj* objOut, DiskLoc* dlOut);
 
         /** TOOD document me */
         bool isEOF();
 
+        /**
+         * If 'batched' is true, getNext() pulls results out of the stage tree a batch at a time
+         * with PlanStage::workBatch() and hands them out from a buffer.  Batches start at one
+         * result and grow, so queries which only want a few results don't overproduce.
+         *
+         * Results sitting in the buffer are only protected against deletions and mutations if
+         * this executor is told about them, so only turn this on for executors that are
+         * registered or owned by a ClientCursor.
+         */
+        void setBatchedExecution(bool batched);
+
         /**
          * Register this plan executor with the collection cursor cache so that it
          * receives event notifications.
@@ -236,6 +254,11 @@ namespace mongo {
          */
         void initNs();
 
+        /**
+         * Like _root->work(), but serves results from _batch when batched execution is on.
+         */
+        PlanStage::StageState workRoot(WorkingSetID* out);
+
         // Collection over which this plan executor runs. Used to resolve record ids retrieved by
         // the plan stages. The collection must not be destroyed while there are active plans.
         const Collection* _collection;
@@ -253,6 +276,20 @@ namespace mongo {
         // Did somebody drop an index we care about or the namespace we're looking at?  If so,
         // we'll be killed.
         bool _killed;
+
+        // See setBatchedExecution().
+        bool _batched;
+
+        // How many works the next call to workBatch() may do.
+        size_t _batchSize;
+
+        // Results produced by the last workBatch() that getNext() hasn't returned yet.
+        std::deque<WorkingSetID> _batch;
+
+        // The last workBatch() failed after producing the results still in _batch.  The failure
+        // is reported once they've been returned.
+        bool _batchFailed;
+        WorkingSetID _batchFailedId;
     };
 
 }  // namespace mongo
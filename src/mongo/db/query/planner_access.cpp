@@ -37,6 +37,7 @@
 #include "mongo/db/query/indexability.h"
 #include "mongo/db/query/index_bounds_builder.h"
 #include "mongo/db/query/index_tag.h"
+#include "mongo/db/query/planner_ixselect.h"
 #include "mongo/db/query/qlog.h"
 #include "mongo/db/query/query_knobs.h"
 #include "mongo/db/query/query_planner.h"
@@ -81,14 +82,24 @@ namespace mongo {
 
         // The sort can specify $natural as well. The sort direction should override the hint
         // direction if both are specified.
+        bool naturalOrder = false;
         const BSONObj& sortObj = query.getParsed().getSort();
         if (!sortObj.isEmpty()) {
             BSONElement natural = sortObj.getFieldDotted("$natural");
             if (!natural.eoo()) {
                 csn->direction = natural.numberInt() >= 0 ? 1 : -1;
+                naturalOrder = true;
             }
         }
 
+        // A parallel scan returns documents in no particular order, stops only at the end of
+        // the collection, and evaluates the filter on several threads at once.
+        csn->parallel = (params.options & QueryPlannerParams::PARALLEL_COLLSCAN)
+                        && !tailable
+                        && !naturalOrder
+                        && 0 == csn->maxScan
+                        && 0 == CanonicalQuery::countNodes(query.root(), MatchExpression::WHERE);
+
         return csn;
     }
 
@@ -873,6 +884,10 @@ namespace mongo {
                 andResult = asn;
             }
             else if (internalQueryPlannerEnableHashIntersection) {
+                // Hash-based intersection stays off by default even though an AND_HASH under a
+                // FETCH only hashes DiskLocs.  Plans are raced by calls to work(), and an AND_HASH
+                // reads all of its first child before it returns anything, so the single index
+                // plan over that child always hits EOF first.
                 AndHashNode* ahn = new AndHashNode();
                 ahn->children.swap(ixscanNodes);
                 andResult = ahn;
@@ -1194,6 +1209,92 @@ namespace mongo {
         return solnRoot;
     }
 
+    // static
+    QuerySolutionNode* QueryPlannerAccess::makeSkipScan(const IndexEntry& index,
+                                                        const CanonicalQuery& query,
+                                                        const QueryPlannerParams& params) {
+        // Sparse indices are missing documents, multikey indices can't intersect bounds, and
+        // special indices don't order their keys by value.
+        if (INDEX_BTREE != index.type || index.sparse || index.multikey) {
+            return NULL;
+        }
+
+        // Only predicates that must hold for every result can bound the scan.
+        MatchExpression* root = query.root();
+        vector<MatchExpression*> preds;
+        if (MatchExpression::AND == root->matchType()) {
+            for (size_t i = 0; i < root->numChildren(); ++i) {
+                preds.push_back(root->getChild(i));
+            }
+        }
+        else {
+            preds.push_back(root);
+        }
+
+        IndexScanNode* isn = new IndexScanNode();
+        isn->indexKeyPattern = index.keyPattern;
+        isn->indexIsMultiKey = index.multikey;
+        isn->maxScan = query.getParsed().getMaxScan();
+        isn->addKeyMetadata = query.getParsed().returnKey();
+        isn->bounds.isSimpleRange = false;
+
+        bool hasBoundedField = false;
+        size_t fieldNo = 0;
+        BSONObjIterator it(index.keyPattern);
+        while (it.more()) {
+            BSONElement elt = it.next();
+            OrderedIntervalList oil(elt.fieldName());
+            bool hasBounds = false;
+
+            for (size_t i = 0; i < preds.size(); ++i) {
+                MatchExpression* pred = preds[i];
+                if (!pred->isLeaf()
+                    || StringData(elt.fieldName()) != pred->path()
+                    || !Indexability::nodeCanUseIndexOnOwnField(pred)
+                    || !QueryPlannerIXSelect::compatible(elt, index, pred)) {
+                    continue;
+                }
+
+                // A predicate over the leading field makes the index relevant, and the regular
+                // access planner does better with it than we can.
+                if (0 == fieldNo) {
+                    delete isn;
+                    return NULL;
+                }
+
+                // The whole query is applied after the scan, so the bounds need not be exact.
+                IndexBoundsBuilder::BoundsTightness tightness;
+                if (hasBounds) {
+                    IndexBoundsBuilder::translateAndIntersect(pred, elt, index, &oil, &tightness);
+                }
+                else {
+                    IndexBoundsBuilder::translate(pred, elt, index, &oil, &tightness);
+                    hasBounds = true;
+                }
+            }
+
+            if (!hasBounds) {
+                IndexBoundsBuilder::allValuesForField(elt, &oil);
+            }
+            hasBoundedField = hasBoundedField || hasBounds;
+
+            isn->bounds.fields.push_back(oil);
+            ++fieldNo;
+        }
+
+        if (!hasBoundedField) {
+            delete isn;
+            return NULL;
+        }
+
+        IndexBoundsBuilder::alignBounds(&isn->bounds, index.keyPattern);
+
+        FetchNode* fetch = new FetchNode();
+        fetch->filter.reset(root->shallowClone());
+        fetch->children.push_back(isn);
+        return fetch;
+    }
+
     // static
     void QueryPlannerAccess::addFilterToSolutionNode(QuerySolutionNode* node,
                                                      MatchExpression* match,
@@ -199,6 +199,18 @@ namespace mongo {
                                                  const QueryPlannerParams& params,
                                                  int direction = 1);
 
+        /**
+         * Return a plan that skip-scans the provided index.  The leading field of the index, which
+         * the query does not constrain, is scanned over all of its values, and later fields are
+         * bounded by the top-level predicates of 'query' over them.  The index scan then seeks
+         * past the keys outside of those bounds once per distinct leading prefix.
+         *
+         * Returns NULL if there are no such predicates or the index can't be skip-scanned.
+         */
+        static QuerySolutionNode* makeSkipScan(const IndexEntry& index,
+                                               const CanonicalQuery& query,
+                                               const QueryPlannerParams& params);
+
         /**
          * Return a plan that scans the provided index from [startKey to endKey).
          */
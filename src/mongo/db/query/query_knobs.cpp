@@ -46,6 +46,31 @@ namespace mongo {
 
     MONGO_EXPORT_SERVER_PARAMETER(internalQueryCacheWriteOpsBetweenFlush, int, 1000);
 
+    double internalQueryCacheReplanRatio = 10.0;
+
+    class InternalQueryCacheReplanRatioParameter : public ExportedServerParameter<double> {
+    public:
+        InternalQueryCacheReplanRatioParameter() :
+            ExportedServerParameter<double>(ServerParameterSet::getGlobal(),
+                                            "internalQueryCacheReplanRatio",
+                                            &internalQueryCacheReplanRatio,
+                                            true,
+                                            true) {}
+
+        virtual Status validate( const double& potentialNewValue ) {
+            // Also rejects NaN.
+            if (!(potentialNewValue > 0)) {
+                return Status(ErrorCodes::BadValue,
+                              "internalQueryCacheReplanRatio must be greater than 0");
+            }
+            return Status::OK();
+        }
+    } internalQueryCacheReplanRatioParameter;
+
+    MONGO_EXPORT_SERVER_PARAMETER(internalQueryCacheSelectivityBuckets, bool, false);
+
+    MONGO_EXPORT_SERVER_PARAMETER(internalQueryCacheSelectivityProbeKeys, int, 100);
+
     MONGO_EXPORT_SERVER_PARAMETER(internalQueryPlannerMaxIndexedSolutions, int, 64);
 
     MONGO_EXPORT_SERVER_PARAMETER(internalQueryEnumerationMaxOrSolutions, int, 10);
@@ -58,6 +83,12 @@ namespace mongo {
 
     MONGO_EXPORT_SERVER_PARAMETER(internalQueryPlannerEnableHashIntersection, bool, false);
 
+    MONGO_EXPORT_SERVER_PARAMETER(internalQueryPlannerEnableIndexSkipScan, bool, false);
+
+    MONGO_EXPORT_SERVER_PARAMETER(internalQueryParallelCollectionScanThreads, int, 0);
+
+    MONGO_EXPORT_SERVER_PARAMETER(internalQueryExecBatched, bool, false);
+
     MONGO_EXPORT_SERVER_PARAMETER(internalQueryPlanOrChildrenIndependently, bool, true);
 
     MONGO_EXPORT_SERVER_PARAMETER(internalQueryMaxScansToExplode, int, 200);
@@ -54,6 +54,16 @@ namespace mongo {
     // Do we use hash-based intersection for rooted $and queries?
     extern bool internalQueryPlannerEnableHashIntersection;
 
+    // Do we consider skip-scanning indices whose leading field the query doesn't constrain?
+    extern bool internalQueryPlannerEnableIndexSkipScan;
+
+    // How many threads may a collection scan use?  Below 2, collection scans are not split.  The
+    // threads are shared by all queries, and their pool is remade when this changes.
+    extern int internalQueryParallelCollectionScanThreads;
+
+    // Do finds pull results out of their plan a batch at a time with PlanStage::workBatch()?
+    extern bool internalQueryExecBatched;
+
     //
     // plan cache
     //
@@ -72,6 +82,17 @@ namespace mongo {
     // How many write ops should we allow in a collection before tossing all cache entries?
     extern int internalQueryCacheWriteOpsBetweenFlush;
 
+    // How many times the works the winning plan needed during ranking may a cached plan take to
+    // produce the same results before we replan the query?
+    extern double internalQueryCacheReplanRatio;
+
+    // Should queries of the same shape be cached separately by the size of their $in lists and
+    // by how many index keys their range predicates cover?
+    extern bool internalQueryCacheSelectivityBuckets;
+
+    // How many index keys may we examine when estimating the selectivity of a range predicate?
+    extern int internalQueryCacheSelectivityProbeKeys;
+
     //
     // Planning and enumeration.
     //
@@ -97,7 +97,13 @@ namespace mongo {
             ss << "INDEX_INTERSECTION ";
         }
         if (options & QueryPlannerParams::KEEP_MUTATIONS) {
-            ss << "KEEP_MUTATIONS";
+            ss << "KEEP_MUTATIONS ";
+        }
+        if (options & QueryPlannerParams::PARALLEL_COLLSCAN) {
+            ss << "PARALLEL_COLLSCAN ";
+        }
+        if (options & QueryPlannerParams::INDEX_SKIP_SCAN) {
+            ss << "INDEX_SKIP_SCAN";
         }
 
         return ss;
@@ -231,6 +237,17 @@ namespace mongo {
         return QueryPlannerAnalysis::analyzeDataAccess(query, params, solnRoot);
     }
 
+    QuerySolution* buildSkipScanSoln(const IndexEntry& index,
+                                     const CanonicalQuery& query,
+                                     const QueryPlannerParams& params) {
+
+        QuerySolutionNode* solnRoot = QueryPlannerAccess::makeSkipScan(index, query, params);
+        if (NULL == solnRoot) {
+            return NULL;
+        }
+        return QueryPlannerAnalysis::analyzeDataAccess(query, params, solnRoot);
+    }
+
     bool providesSort(const CanonicalQuery& query, const BSONObj& kp) {
         BSONObjIterator sortIt(query.getParsed().getSort());
         BSONObjIterator kpIt(kp);
@@ -365,6 +382,16 @@ namespace mongo {
                 return Status::OK();
             }
         }
+        else if (SolutionCacheData::SKIP_IXSCAN_SOLN == cacheData.solnType) {
+            QuerySolution* soln = buildSkipScanSoln(*cacheData.tree->entry, query, params);
+            if (soln == NULL) {
+                return Status(ErrorCodes::BadValue, "plan cache error: skip index scan soln");
+            }
+            else {
+                *out = soln;
+                return Status::OK();
+            }
+        }
         else if (SolutionCacheData::COLLSCAN_SOLN == cacheData.solnType) {
             // The cached solution is a collection scan. We don't cache collscans
             // with tailable==true, hence the false below.
@@ -930,6 +957,31 @@ namespace mongo {
         // No indexed plans?  We must provide a collscan if possible or else we can't run the query.
         bool collscanNeeded = (0 == out->size() && canTableScan);
 
+        // If no index is relevant, an index whose leading field isn't constrained by the query may
+        // still be skip-scanned.  That is only a win when the leading field has few distinct
+        // values, so the skip scans compete with the collscan that we output below.
+        if (0 == out->size()
+            && (params.options & QueryPlannerParams::INDEX_SKIP_SCAN)
+            && possibleToCollscan) {
+            for (size_t i = 0; i < params.indices.size(); ++i) {
+                QuerySolution* soln = buildSkipScanSoln(params.indices[i], query, params);
+                if (NULL == soln) {
+                    continue;
+                }
+
+                PlanCacheIndexTree* indexTree = new PlanCacheIndexTree();
+                indexTree->setIndexEntry(params.indices[i]);
+                SolutionCacheData* scd = new SolutionCacheData();
+                scd->tree.reset(indexTree);
+                scd->solnType = SolutionCacheData::SKIP_IXSCAN_SOLN;
+                soln->cacheData.reset(scd);
+
+                QLOG() << "Planner: outputting soln that skip-scans index:" << endl
+                       << soln->toString();
+                out->push_back(soln);
+            }
+        }
+
         if (possibleToCollscan && (collscanRequested || collscanNeeded)) {
             QuerySolution* collscan = buildCollscanSoln(query, false, params);
             if (NULL != collscan) {
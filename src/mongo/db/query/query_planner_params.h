@@ -81,7 +81,15 @@ namespace mongo {
             // Set this if you want to handle batchSize properly with sort(). If limits on SORT
             // stages are always actually limits, then this should be left off. If they are
             // sometimes to be interpreted as batchSize, then this should be turned on.
-            SPLIT_LIMITED_SORT = 1 << 7
+            SPLIT_LIMITED_SORT = 1 << 7,
+
+            // Set this if a collection scan may be split across several threads.  The storage
+            // engine must keep writers out of the collection while the caller holds its lock.
+            PARALLEL_COLLSCAN = 1 << 8,
+
+            // Set this if you want indices whose leading field the query does not constrain to be
+            // skip-scanned when no index is otherwise relevant.
+            INDEX_SKIP_SCAN = 1 << 9
         };
 
         // See Options enum above.
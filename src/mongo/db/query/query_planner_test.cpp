@@ -4911,6 +4911,87 @@ namespace {
                                    "{ixscan: {pattern: {b: 1}}}}}}}}}");
     }
 
+    //
+    // Index skip scan
+    //
+
+    TEST_F(QueryPlannerTest, SkipScanNonLeadingField) {
+        params.options = QueryPlannerParams::INDEX_SKIP_SCAN;
+        addIndex(BSON("tenant" << 1 << "ts" << 1));
+
+        runQuery(fromjson("{ts: {$gte: 5, $lt: 10}}"));
+
+        // The skip scan competes with a collscan.
+        assertNumSolutions(2U);
+        assertSolutionExists("{cscan: {dir: 1, filter: {ts: {$gte: 5, $lt: 10}}}}");
+        assertSolutionExists("{fetch: {filter: {ts: {$gte: 5, $lt: 10}}, node: "
+                                "{ixscan: {pattern: {tenant: 1, ts: 1}, bounds: "
+                                "{tenant: [['MinKey','MaxKey',true,true]], "
+                                "ts: [[5,10,true,false]]}}}}}");
+    }
+
+    TEST_F(QueryPlannerTest, SkipScanLaterFieldsAndDirection) {
+        params.options = QueryPlannerParams::INDEX_SKIP_SCAN;
+        addIndex(BSON("a" << 1 << "b" << 1 << "c" << -1));
+
+        runQuery(fromjson("{c: {$in: [1, 4]}, d: 2}"));
+
+        assertNumSolutions(2U);
+        assertSolutionExists("{cscan: {dir: 1}}");
+        assertSolutionExists("{fetch: {filter: {c: {$in: [1, 4]}, d: 2}, node: "
+                                "{ixscan: {pattern: {a: 1, b: 1, c: -1}, bounds: "
+                                "{a: [['MinKey','MaxKey',true,true]], "
+                                "b: [['MinKey','MaxKey',true,true]], "
+                                "c: [[4,4,true,true], [1,1,true,true]]}}}}}");
+    }
+
+    TEST_F(QueryPlannerTest, SkipScanNotUsedWhenIndexRelevant) {
+        params.options = QueryPlannerParams::INDEX_SKIP_SCAN;
+        addIndex(BSON("tenant" << 1 << "ts" << 1));
+        addIndex(BSON("x" << 1));
+
+        runQuery(fromjson("{ts: 3, x: 1}"));
+
+        assertNumSolutions(1U);
+        assertSolutionExists("{fetch: {filter: {ts: 3}, node: {ixscan: {pattern: {x: 1}}}}}");
+    }
+
+    TEST_F(QueryPlannerTest, SkipScanRequiresOption) {
+        params.options = QueryPlannerParams::INCLUDE_COLLSCAN;
+        addIndex(BSON("tenant" << 1 << "ts" << 1));
+
+        runQuery(fromjson("{ts: 3}"));
+
+        assertNumSolutions(1U);
+        assertSolutionExists("{cscan: {dir: 1, filter: {ts: 3}}}");
+    }
+
+    TEST_F(QueryPlannerTest, SkipScanNotForMultikeyOrSparse) {
+        params.options = QueryPlannerParams::INDEX_SKIP_SCAN;
+        // true means multikey
+        addIndex(BSON("a" << 1 << "ts" << 1), true);
+        addIndex(BSON("b" << 1 << "ts" << 1), false, true);
+
+        runQuery(fromjson("{ts: 3}"));
+
+        assertNumSolutions(1U);
+        assertSolutionExists("{cscan: {dir: 1, filter: {ts: 3}}}");
+    }
+
+    TEST_F(QueryPlannerTest, SkipScanNoTableScan) {
+        params.options = QueryPlannerParams::INDEX_SKIP_SCAN |
+                         QueryPlannerParams::NO_TABLE_SCAN;
+        addIndex(BSON("tenant" << 1 << "ts" << 1));
+
+        runQuery(fromjson("{ts: 3}"));
+
+        assertNumSolutions(1U);
+        assertSolutionExists("{fetch: {filter: {ts: 3}, node: "
+                                "{ixscan: {pattern: {tenant: 1, ts: 1}, bounds: "
+                                "{tenant: [['MinKey','MaxKey',true,true]], "
+                                "ts: [[3,3,true,true]]}}}}}");
+    }
+
     //
     // Test bad input to query planner helpers.
     //
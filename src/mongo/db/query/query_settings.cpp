@@ -86,7 +86,7 @@ namespace mongo {
                                           AllowedIndices** allowedIndicesOut) const {
         invariant(allowedIndicesOut);
 
-        const PlanCacheKey& key = query.getPlanCacheKey();
+        const PlanCacheKey& key = query.getQueryShapeKey();
 
         boost::lock_guard<boost::mutex> cacheLock(_mutex);
         AllowedIndexEntryMap::const_iterator cacheIter = _allowedIndexEntryMap.find(key);
@@ -123,7 +123,7 @@ namespace mongo {
         const BSONObj& projection = lpq.getProj();
         AllowedIndexEntry* entry = new AllowedIndexEntry(query, sort, projection, indexes);
 
-        const PlanCacheKey& key = canonicalQuery.getPlanCacheKey();
+        const PlanCacheKey& key = canonicalQuery.getQueryShapeKey();
         boost::lock_guard<boost::mutex> cacheLock(_mutex);
         AllowedIndexEntryMap::iterator i = _allowedIndexEntryMap.find(key);
         // Replace existing entry.
@@ -135,7 +135,7 @@ namespace mongo {
     }
 
     void QuerySettings::removeAllowedIndices(const CanonicalQuery& canonicalQuery) {
-        const PlanCacheKey& key = canonicalQuery.getPlanCacheKey();
+        const PlanCacheKey& key = canonicalQuery.getQueryShapeKey();
         boost::lock_guard<boost::mutex> cacheLock(_mutex);
         AllowedIndexEntryMap::iterator i = _allowedIndexEntryMap.find(key);
 
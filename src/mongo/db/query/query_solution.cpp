@@ -98,13 +98,18 @@ namespace mongo {
     // CollectionScanNode
     //
 
-    CollectionScanNode::CollectionScanNode() : tailable(false), direction(1), maxScan(0) { }
+    CollectionScanNode::CollectionScanNode()
+        : tailable(false), direction(1), maxScan(0), parallel(false) { }
 
     void CollectionScanNode::appendToString(mongoutils::str::stream* ss, int indent) const {
         addIndent(ss, indent);
         *ss << "COLLSCAN\n";
         addIndent(ss, indent + 1);
         *ss <<  "ns = " << name << '\n';
+        if (parallel) {
+            addIndent(ss, indent + 1);
+            *ss << "parallel = true\n";
+        }
         if (NULL != filter) {
             addIndent(ss, indent + 1);
             *ss << "filter = " << filter->toString();
@@ -121,6 +126,7 @@ namespace mongo {
         copy->tailable = this->tailable;
         copy->direction = this->direction;
         copy->maxScan = this->maxScan;
+        copy->parallel = this->parallel;
 
         return copy;
     }
@@ -623,6 +629,10 @@ namespace mongo {
         *ss << "query for bounds = " << query.toString() << '\n';
         addIndent(ss, indent + 1);
         *ss << "limit = " << limit << '\n';
+        if (allowDiskUse) {
+            addIndent(ss, indent + 1);
+            *ss << "allowDiskUse = true\n";
+        }
         addCommon(ss, indent);
         addIndent(ss, indent + 1);
         *ss << "Child:" << '\n';
@@ -637,6 +647,7 @@ namespace mongo {
         copy->pattern = this->pattern;
         copy->query = this->query;
         copy->limit = this->limit;
+        copy->allowDiskUse = this->allowDiskUse;
 
         return copy;
     }
@@ -822,6 +833,12 @@ namespace mongo {
         addIndent(ss, indent + 1);
         *ss << "direction = " << direction << '\n';
         addIndent(ss, indent + 1);
+        *ss << "fieldNo = " << fieldNo << '\n';
+        if (NULL != filter) {
+            addIndent(ss, indent + 1);
+            *ss << "filter = " << filter->toString();
+        }
+        addIndent(ss, indent + 1);
         *ss << "bounds = " << bounds.toString() << '\n';
     }
 
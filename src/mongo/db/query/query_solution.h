@@ -270,6 +270,9 @@ namespace mongo {
 
         // maxScan option to .find() limits how many docs we look at.
         int maxScan;
+
+        // Should the scan be split across several threads?
+        bool parallel;
     };
 
     struct AndHashNode : public QuerySolutionNode {
@@ -495,7 +498,7 @@ namespace mongo {
     };
 
     struct SortNode : public QuerySolutionNode {
-        SortNode() : limit(0) { }
+        SortNode() : limit(0), allowDiskUse(false) { }
         virtual ~SortNode() { }
 
         virtual StageType getType() const { return STAGE_SORT; }
@@ -526,6 +529,9 @@ namespace mongo {
 
         // Sum of both limit and skip count in the parsed query.
         size_t limit;
+
+        // May the sort spill to disk once it exceeds its memory limit?
+        bool allowDiskUse;
     };
 
     struct LimitNode : public QuerySolutionNode {
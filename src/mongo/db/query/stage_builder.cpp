@@ -41,6 +41,7 @@
 #include "mongo/db/exec/limit.h"
 #include "mongo/db/exec/merge_sort.h"
 #include "mongo/db/exec/or.h"
+#include "mongo/db/exec/parallel_collection_scan.h"
 #include "mongo/db/exec/projection.h"
 #include "mongo/db/exec/shard_filter.h"
 #include "mongo/db/exec/sort.h"
@@ -49,6 +50,7 @@
 #include "mongo/db/index/fts_access_method.h"
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/catalog/database.h"
+#include "mongo/db/query/query_knobs.h"
 #include "mongo/util/log.h"
 
 namespace mongo {
@@ -60,6 +62,11 @@ namespace mongo {
                            WorkingSet* ws) {
         if (STAGE_COLLSCAN == root->getType()) {
             const CollectionScanNode* csn = static_cast<const CollectionScanNode*>(root);
+            if (csn->parallel && internalQueryParallelCollectionScanThreads > 1) {
+                return new ParallelCollectionScan(txn, collection, ws, csn->filter.get(),
+                                                  internalQueryParallelCollectionScanThreads);
+            }
+
             CollectionScanParams params;
             params.collection = collection;
             params.tailable = csn->tailable;
@@ -96,6 +103,10 @@ namespace mongo {
             const FetchNode* fn = static_cast<const FetchNode*>(root);
             PlanStage* childStage = buildStages(txn, collection, qsol, fn->children[0], ws);
             if (NULL == childStage) { return NULL; }
+            if (STAGE_AND_HASH == childStage->stageType()) {
+                // We fetch the results of the AND, so it needn't keep the children's index keys.
+                static_cast<AndHashStage*>(childStage)->setLocsOnly();
+            }
             return new FetchStage(txn, ws, childStage, fn->filter.get(), collection);
         }
         else if (STAGE_SORT == root->getType()) {
@@ -107,6 +118,7 @@ namespace mongo {
             params.pattern = sn->pattern;
             params.query = sn->query;
             params.limit = sn->limit;
+            params.allowDiskUse = sn->allowDiskUse;
             return new SortStage(txn, params, ws, childStage);
         }
         else if (STAGE_PROJECTION == root->getType()) {
@@ -297,6 +309,7 @@ namespace mongo {
             params.direction = dn->direction;
             params.bounds = dn->bounds;
             params.fieldNo = dn->fieldNo;
+            params.filter = dn->filter.get();
             return new DistinctScan(txn, params, ws);
         }
         else if (STAGE_COUNT_SCAN == root->getType()) {
@@ -30,11 +30,14 @@
 
 #include "mongo/db/storage/heap1/heap1_btree_impl.h"
 
+#include <map>
 #include <set>
 
 #include "mongo/db/catalog/index_catalog_entry.h"
-#include "mongo/db/storage/heap1/heap1_recovery_unit.h"
+#include "mongo/db/concurrency/write_conflict_exception.h"
+#include "mongo/db/operation_context.h"
 #include "mongo/db/storage/index_entry_comparison.h"
+#include "mongo/util/concurrency/simplerwlock.h"
 #include "mongo/util/mongoutils/str.h"
 
 namespace mongo {
@@ -63,6 +66,42 @@ namespace {
 
     typedef std::set<IndexKeyEntry, IndexEntryComparison> IndexSet;
 
+    /**
+     * An insert or removal of an entry by a unit of work that hasn't committed yet.
+     */
+    struct PendingEntry {
+        PendingEntry(const RecoveryUnit* owner, bool insert) : owner(owner), insert(insert) {}
+
+        const RecoveryUnit* owner;
+        bool insert;
+    };
+
+    typedef std::map<IndexKeyEntry, PendingEntry, IndexEntryComparison> PendingEntries;
+
+    /**
+     * The contents of an index, shared by every Heap1BtreeImpl over it.  Readers hold 'lock'
+     * shared and writers exclusive.  Cursors can't hold the lock between calls, so every change
+     * to 'set' bumps 'version', and a cursor that sees a new version finds its place again from
+     * the entry it is on before touching its iterator.
+     *
+     * 'set' only holds committed entries, which is all cursors see.  Inserts and removals wait in
+     * 'pending' until their unit of work commits, just like the records they are for, so an
+     * entry never leads to a record that isn't visible yet.  The duplicate key checks look at
+     * both.
+     */
+    struct IndexData {
+        explicit IndexData(const Ordering& ordering)
+            : set(IndexEntryComparison(ordering)),
+              pending(IndexEntryComparison(ordering)),
+              version(0) {
+        }
+
+        IndexSet set;
+        PendingEntries pending;
+        mutable SimpleRWLock lock;
+        unsigned long long version;
+    };
+
     // taken from btree_logic.cpp
     Status dupKeyError(const BSONObj& key) {
         StringBuilder sb;
@@ -81,13 +120,52 @@ namespace {
         return it->loc != loc;
     }
 
+    /**
+     * Returns a DuplicateKey error if 'data' holds an entry for 'key' at another location than
+     * 'loc' once the changes of 'owner' are applied.  Throws a WriteConflictException if that
+     * depends on whether another unit of work commits.  The caller must hold the lock.
+     */
+    Status checkDup(const IndexData& data,
+                    const BSONObj& key,
+                    const DiskLoc& loc,
+                    const RecoveryUnit* owner) {
+        // A null DiskLoc compares equal to every location of the key.
+        const IndexKeyEntry anyLoc(key, DiskLoc());
+
+        const std::pair<IndexSet::const_iterator, IndexSet::const_iterator> committed =
+            data.set.equal_range(anyLoc);
+        for (IndexSet::const_iterator it = committed.first; it != committed.second; ++it) {
+            if (it->loc == loc)
+                continue;
+
+            const PendingEntries::const_iterator removal = data.pending.find(*it);
+            if (removal == data.pending.end())
+                return dupKeyError(key);
+            if (removal->second.owner != owner)
+                throw WriteConflictException();
+        }
+
+        const std::pair<PendingEntries::const_iterator, PendingEntries::const_iterator> pending =
+            data.pending.equal_range(anyLoc);
+        for (PendingEntries::const_iterator it = pending.first; it != pending.second; ++it) {
+            if (it->first.loc == loc || !it->second.insert)
+                continue;
+            if (it->second.owner != owner)
+                throw WriteConflictException();
+            return dupKeyError(key);
+        }
+
+        return Status::OK();
+    }
+
     class Heap1BtreeBuilderImpl : public SortedDataBuilderInterface {
     public:
-        Heap1BtreeBuilderImpl(IndexSet* data, long long* currentKeySize, bool dupsAllowed)
+        Heap1BtreeBuilderImpl(IndexData* data, long long* currentKeySize, bool dupsAllowed)
                 : _data(data),
                   _currentKeySize( currentKeySize ),
                   _dupsAllowed(dupsAllowed) {
-            invariant(_data->empty());
+            SimpleRWLock::Shared lk(_data->lock);
+            invariant(_data->set.empty());
         }
 
         Status addKey(const BSONObj& key, const DiskLoc& loc) {
@@ -102,31 +180,55 @@ namespace {
             invariant(loc.isValid());
             invariant(!hasFieldNames(key));
 
+            BSONObj owned = key.getOwned();
+            SimpleRWLock::Exclusive lk(_data->lock);
+
             // TODO optimization: dup check can assume dup is only possible with last inserted key
             // and avoid the log(n) lookup.
-            if (!_dupsAllowed && isDup(*_data, key, loc))
+            if (!_dupsAllowed && isDup(_data->set, key, loc))
                 return dupKeyError(key);
 
-            BSONObj owned = key.getOwned();
-            _data->insert(_data->end(), IndexKeyEntry(owned, loc));
+            _data->set.insert(_data->set.end(), IndexKeyEntry(owned, loc));
+            _data->version++;
             *_currentKeySize += key.objsize();
 
             return Status::OK();
         }
 
     private:
-        IndexSet* const _data;
+        IndexData* const _data;
         long long* _currentKeySize;
         const bool _dupsAllowed;
     };
 
     class Heap1BtreeImpl : public SortedDataInterface {
     public:
-        Heap1BtreeImpl(IndexSet* data)
+        Heap1BtreeImpl(IndexData* data)
             : _data(data) {
             _currentKeySize = 0;
         }
 
+        /**
+         * Applies or drops a pending entry when its unit of work ends.
+         */
+        class PendingEntryChange : public RecoveryUnit::Change {
+        public:
+            PendingEntryChange(Heap1BtreeImpl* idx,
+                               const IndexKeyEntry& entry,
+                               const RecoveryUnit* owner)
+                : _idx(idx), _entry(entry), _owner(owner) {
+            }
+
+            virtual void commit() { _idx->endPending(_entry, _owner, true); }
+
+            virtual void rollback() { _idx->endPending(_entry, _owner, false); }
+
+        private:
+            Heap1BtreeImpl* const _idx;
+            const IndexKeyEntry _entry;
+            const RecoveryUnit* const _owner;
+        };
+
         virtual SortedDataBuilderInterface* getBulkBuilder(OperationContext* txn, bool dupsAllowed) {
             return new Heap1BtreeBuilderImpl(_data, &_currentKeySize, dupsAllowed);
         }
@@ -147,15 +249,40 @@ namespace {
                 return Status(ErrorCodes::KeyTooLong, msg);
             }
 
-            // TODO optimization: save the iterator from the dup-check to speed up insert
-            if (!dupsAllowed && isDup(*_data, key, loc))
-                return dupKeyError(key);
+            const IndexKeyEntry entry(key.getOwned(), loc);
+            const RecoveryUnit* owner = txn ? txn->recoveryUnit() : NULL;
+            {
+                SimpleRWLock::Exclusive lk(_data->lock);
 
-            BSONObj owned = key.getOwned();
-            if ( _data->insert(IndexKeyEntry(owned, loc)).second ) {
-                _currentKeySize += key.objsize();
-                Heap1RecoveryUnit::notifyIndexInsert( txn, this, owned, loc );
+                const PendingEntries::iterator pending = _data->pending.find(entry);
+                if (pending != _data->pending.end()) {
+                    if (pending->second.owner != owner)
+                        throw WriteConflictException();
+
+                    // Takes back a removal by the same unit of work.
+                    if (!pending->second.insert)
+                        _data->pending.erase(pending);
+                    return Status::OK();
+                }
+
+                if (_data->set.count(entry))
+                    return Status::OK();
+
+                // TODO optimization: save the iterator from the dup-check to speed up insert
+                if (!dupsAllowed) {
+                    const Status status = checkDup(*_data, key, loc, owner);
+                    if (!status.isOK())
+                        return status;
+                }
+
+                if (!owner) {
+                    apply(entry, true);
+                    return Status::OK();
+                }
+                _data->pending.insert(std::make_pair(entry, PendingEntry(owner, true)));
             }
+
+            txn->recoveryUnit()->registerChange(new PendingEntryChange(this, entry, owner));
             return Status::OK();
         }
 
@@ -164,34 +291,57 @@ namespace {
             invariant(loc.isValid());
             invariant(!hasFieldNames(key));
 
-            const size_t numDeleted = _data->erase(IndexKeyEntry(key, loc));
-            invariant(numDeleted <= 1);
-            if ( numDeleted == 1 ) {
-                _currentKeySize -= key.objsize();
-                Heap1RecoveryUnit::notifyIndexRemove( txn, this, key, loc );
+            const IndexKeyEntry entry(key.getOwned(), loc);
+            const RecoveryUnit* owner = txn ? txn->recoveryUnit() : NULL;
+            {
+                SimpleRWLock::Exclusive lk(_data->lock);
+
+                const PendingEntries::iterator pending = _data->pending.find(entry);
+                if (pending != _data->pending.end()) {
+                    if (pending->second.owner != owner)
+                        throw WriteConflictException();
+                    if (!pending->second.insert)
+                        return false;
+
+                    // Takes back an insert by the same unit of work.
+                    _data->pending.erase(pending);
+                    return true;
+                }
+
+                if (!_data->set.count(entry))
+                    return false;
+
+                if (!owner) {
+                    apply(entry, false);
+                    return true;
+                }
+                _data->pending.insert(std::make_pair(entry, PendingEntry(owner, false)));
             }
 
-            return numDeleted == 1;
+            txn->recoveryUnit()->registerChange(new PendingEntryChange(this, entry, owner));
+            return true;
         }
 
         virtual void fullValidate(OperationContext* txn, long long *numKeysOut) const {
             // TODO check invariants?
-            *numKeysOut = _data->size();
+            SimpleRWLock::Shared lk(_data->lock);
+            *numKeysOut = _data->set.size();
         }
 
         virtual long long getSpaceUsedBytes( OperationContext* txn ) const {
-            return _currentKeySize + ( sizeof(IndexKeyEntry) * _data->size() );
+            SimpleRWLock::Shared lk(_data->lock);
+            return _currentKeySize + ( sizeof(IndexKeyEntry) * _data->set.size() );
         }
 
         virtual Status dupKeyCheck(OperationContext* txn, const BSONObj& key, const DiskLoc& loc) {
             invariant(!hasFieldNames(key));
-            if (isDup(*_data, key, loc))
-                return dupKeyError(key);
-            return Status::OK();
+            SimpleRWLock::Shared lk(_data->lock);
+            return checkDup(*_data, key, loc, txn ? txn->recoveryUnit() : NULL);
         }
 
         virtual bool isEmpty(OperationContext* txn) {
-            return _data->empty();
+            SimpleRWLock::Shared lk(_data->lock);
+            return _data->set.empty();
         }
 
         virtual Status touch(OperationContext* txn) const{
@@ -201,22 +351,26 @@ namespace {
 
         class ForwardCursor : public SortedDataInterface::Cursor {
         public:
-            ForwardCursor(const IndexSet& data, OperationContext* txn)
+            ForwardCursor(const IndexData& data, OperationContext* txn)
                 : _txn(txn),
                   _data(data),
-                  _it(data.end())
+                  _it(data.set.end()),
+                  _version(0),
+                  _isEOF(true)
             {}
 
             virtual int getDirection() const { return 1; }
 
             virtual bool isEOF() const {
-                return _it == _data.end();
+                return _isEOF;
             }
 
             virtual bool pointsToSamePlaceAs(const SortedDataInterface::Cursor& otherBase) const {
                 const ForwardCursor& other = static_cast<const ForwardCursor&>(otherBase);
                 invariant(&_data == &other._data); // iterators over same index
-                return _it == other._it;
+                if (_isEOF || other._isEOF)
+                    return _isEOF == other._isEOF;
+                return _loc == other._loc && _key.binaryEqual(other._key);
             }
 
             virtual void aboutToDeleteBucket(const DiskLoc& bucket) {
@@ -225,16 +379,18 @@ namespace {
 
             virtual bool locate(const BSONObj& keyRaw, const DiskLoc& loc) {
                 const BSONObj key = stripFieldNames(keyRaw);
-                _it = _data.lower_bound(IndexKeyEntry(key, loc)); // lower_bound is >= key
-                if ( _it == _data.end() ) {
+                SimpleRWLock::Shared lk(_data.lock);
+                _it = _data.set.lower_bound(IndexKeyEntry(key, loc)); // lower_bound is >= key
+                updatePosition();
+                if ( _isEOF ) {
                     return false;
                 }
 
-                if ( _it->key != key ) {
+                if ( _key != key ) {
                     return false;
                 }
 
-                return _it->loc == loc;
+                return _loc == loc;
             }
 
             virtual void customLocate(const BSONObj& keyBegin,
@@ -243,14 +399,17 @@ namespace {
                                       const vector<const BSONElement*>& keyEnd,
                                       const vector<bool>& keyEndInclusive) {
                 // makeQueryObject handles stripping of fieldnames for us.
-                _it = _data.lower_bound(IndexKeyEntry(IndexEntryComparison::makeQueryObject(
-                                                        keyBegin,
-                                                        keyBeginLen,
-                                                        afterKey,
-                                                        keyEnd,
-                                                        keyEndInclusive,
-                                                        1), // forward
-                                                   DiskLoc()));
+                const IndexKeyEntry query(IndexEntryComparison::makeQueryObject(
+                                            keyBegin,
+                                            keyBeginLen,
+                                            afterKey,
+                                            keyEnd,
+                                            keyEndInclusive,
+                                            1), // forward
+                                          DiskLoc());
+                SimpleRWLock::Shared lk(_data.lock);
+                _it = _data.set.lower_bound(query);
+                updatePosition();
             }
 
             void advanceTo(const BSONObj &keyBegin,
@@ -263,69 +422,96 @@ namespace {
             }
 
             virtual BSONObj getKey() const {
-                return _it->key;
+                return _key;
             }
 
             virtual DiskLoc getDiskLoc() const {
-                return _it->loc;
+                return _loc;
             }
 
             virtual void advance() {
-                if (_it != _data.end())
+                if (_isEOF)
+                    return;
+
+                SimpleRWLock::Shared lk(_data.lock);
+                if (_version != _data.version) {
+                    // _it may be gone, carry on from the first entry after the one we were on.
+                    _it = _data.set.lower_bound(IndexKeyEntry(_key, _loc));
+                    if (_it != _data.set.end() && isCurrent(*_it))
+                        ++_it;
+                }
+                else {
                     ++_it;
+                }
+                updatePosition();
             }
 
             virtual void savePosition() {
-                if (_it == _data.end()) {
-                    _savedAtEnd = true;
+                // Nothing to do, the current entry is always saved in _key and _loc.
+            }
+
+            virtual void restorePosition(OperationContext* txn) {
+                if (_isEOF)
                     return;
-                }
 
-                _savedAtEnd = false;
-                _savedKey = _it->key.getOwned();
-                _savedLoc = _it->loc;
+                SimpleRWLock::Shared lk(_data.lock);
+                _it = _data.set.lower_bound(IndexKeyEntry(_key, _loc));
+                updatePosition();
             }
 
-            virtual void restorePosition(OperationContext* txn) {
-                if (_savedAtEnd) {
-                    _it = _data.end();
-                }
-                else {
-                    locate(_savedKey, _savedLoc);
+        private:
+            /**
+             * Copies out the entry _it is on.  Must be called with the lock held whenever _it
+             * changes, so that _it is only ever used while _data hasn't changed since.
+             */
+            void updatePosition() {
+                _version = _data.version;
+                _isEOF = _it == _data.set.end();
+                if (!_isEOF) {
+                    _key = _it->key;
+                    _loc = _it->loc;
                 }
             }
 
-        private:
+            bool isCurrent(const IndexKeyEntry& entry) const {
+                return entry.loc == _loc
+                    && _data.set.key_comp().compare(entry, IndexKeyEntry(_key, _loc)) == 0;
+            }
+
             OperationContext* _txn; // not owned
-            const IndexSet& _data;
+            const IndexData& _data;
             IndexSet::const_iterator _it;
+            unsigned long long _version; // of _data when _it was last set
 
-            // For save/restorePosition since _it may be invalidated durring a yield.
-            bool _savedAtEnd;
-            BSONObj _savedKey;
-            DiskLoc _savedLoc;
-
+            // The entry the cursor is on.  Still valid when _it isn't.
+            bool _isEOF;
+            BSONObj _key;
+            DiskLoc _loc;
         };
 
         // TODO see if this can share any code with ForwardIterator
         class ReverseCursor : public SortedDataInterface::Cursor {
         public:
-            ReverseCursor(const IndexSet& data, OperationContext* txn)
+            ReverseCursor(const IndexData& data, OperationContext* txn)
                 : _txn(txn),
                   _data(data),
-                  _it(data.rend())
+                  _it(data.set.rend()),
+                  _version(0),
+                  _isEOF(true)
             {}
 
             virtual int getDirection() const { return -1; }
 
             virtual bool isEOF() const {
-                return _it == _data.rend();
+                return _isEOF;
             }
 
             virtual bool pointsToSamePlaceAs(const SortedDataInterface::Cursor& otherBase) const {
                 const ReverseCursor& other = static_cast<const ReverseCursor&>(otherBase);
                 invariant(&_data == &other._data); // iterators over same index
-                return _it == other._it;
+                if (_isEOF || other._isEOF)
+                    return _isEOF == other._isEOF;
+                return _loc == other._loc && _key.binaryEqual(other._key);
             }
 
             virtual void aboutToDeleteBucket(const DiskLoc& bucket) {
@@ -334,18 +520,18 @@ namespace {
 
             virtual bool locate(const BSONObj& keyRaw, const DiskLoc& loc) {
                 const BSONObj key = stripFieldNames(keyRaw);
+                SimpleRWLock::Shared lk(_data.lock);
                 _it = lower_bound(IndexKeyEntry(key, loc)); // lower_bound is <= query
-
-                if ( _it == _data.rend() ) {
+                updatePosition();
+                if ( _isEOF ) {
                     return false;
                 }
 
-
-                if ( _it->key != key ) {
+                if ( _key != key ) {
                     return false;
                 }
 
-                return _it->loc == loc;
+                return _loc == loc;
             }
 
             virtual void customLocate(const BSONObj& keyBegin,
@@ -354,14 +540,17 @@ namespace {
                                       const vector<const BSONElement*>& keyEnd,
                                       const vector<bool>& keyEndInclusive) {
                 // makeQueryObject handles stripping of fieldnames for us.
-                _it = lower_bound(IndexKeyEntry(IndexEntryComparison::makeQueryObject(
-                                                  keyBegin,
-                                                  keyBeginLen,
-                                                  afterKey,
-                                                  keyEnd,
-                                                  keyEndInclusive,
-                                                  -1), // reverse
-                                             DiskLoc()));
+                const IndexKeyEntry query(IndexEntryComparison::makeQueryObject(
+                                            keyBegin,
+                                            keyBeginLen,
+                                            afterKey,
+                                            keyEnd,
+                                            keyEndInclusive,
+                                            -1), // reverse
+                                          DiskLoc());
+                SimpleRWLock::Shared lk(_data.lock);
+                _it = lower_bound(query);
+                updatePosition();
             }
 
             void advanceTo(const BSONObj &keyBegin,
@@ -374,46 +563,51 @@ namespace {
             }
 
             virtual BSONObj getKey() const {
-                return _it->key;
+                return _key;
             }
 
             virtual DiskLoc getDiskLoc() const {
-                return _it->loc;
+                return _loc;
             }
 
             virtual void advance() {
-                if (_it != _data.rend())
+                if (_isEOF)
+                    return;
+
+                SimpleRWLock::Shared lk(_data.lock);
+                if (_version != _data.version) {
+                    // _it may be gone, carry on from the first entry before the one we were on.
+                    _it = lower_bound(IndexKeyEntry(_key, _loc));
+                    if (_it != _data.set.rend() && isCurrent(*_it))
+                        ++_it;
+                }
+                else {
                     ++_it;
+                }
+                updatePosition();
             }
 
             virtual void savePosition() {
-                if (_it == _data.rend()) {
-                    _savedAtEnd = true;
-                    return;
-                }
-
-                _savedAtEnd = false;
-                _savedKey = _it->key.getOwned();
-                _savedLoc = _it->loc;
+                // Nothing to do, the current entry is always saved in _key and _loc.
             }
 
             virtual void restorePosition(OperationContext* txn) {
-                if (_savedAtEnd) {
-                    _it = _data.rend();
-                }
-                else {
-                    locate(_savedKey, _savedLoc);
-                }
+                if (_isEOF)
+                    return;
+
+                SimpleRWLock::Shared lk(_data.lock);
+                _it = lower_bound(IndexKeyEntry(_key, _loc));
+                updatePosition();
             }
 
         private:
             /**
              * Returns the first entry <= query. This is equivalent to ForwardCursors use of
-             * _data.lower_bound which returns the first entry >= query.
+             * _data.set.lower_bound which returns the first entry >= query.
              */
             IndexSet::const_reverse_iterator lower_bound(const IndexKeyEntry& query) const {
                 // using upper_bound since we want to the right-most entry matching the query.
-                IndexSet::const_iterator it = _data.upper_bound(query);
+                IndexSet::const_iterator it = _data.set.upper_bound(query);
 
                 // upper_bound returns the entry to the right of the one we want. Helpfully,
                 // converting to a reverse_iterator moves one to the left. This also correctly
@@ -422,14 +616,32 @@ namespace {
                 return IndexSet::const_reverse_iterator(it);
             }
 
+            /**
+             * See ForwardCursor::updatePosition().
+             */
+            void updatePosition() {
+                _version = _data.version;
+                _isEOF = _it == _data.set.rend();
+                if (!_isEOF) {
+                    _key = _it->key;
+                    _loc = _it->loc;
+                }
+            }
+
+            bool isCurrent(const IndexKeyEntry& entry) const {
+                return entry.loc == _loc
+                    && _data.set.key_comp().compare(entry, IndexKeyEntry(_key, _loc)) == 0;
+            }
+
             OperationContext* _txn; // not owned
-            const IndexSet& _data;
+            const IndexData& _data;
             IndexSet::const_reverse_iterator _it;
+            unsigned long long _version; // of _data when _it was last set
 
-            // For save/restorePosition since _it may be invalidated durring a yield.
-            bool _savedAtEnd;
-            BSONObj _savedKey;
-            DiskLoc _savedLoc;
+            // The entry the cursor is on.  Still valid when _it isn't.
+            bool _isEOF;
+            BSONObj _key;
+            DiskLoc _loc;
         };
 
         virtual SortedDataInterface::Cursor* newCursor(OperationContext* txn, int direction) const {
@@ -446,7 +658,41 @@ namespace {
         }
 
     private:
-        IndexSet* _data;
+        /**
+         * Inserts 'entry' into the committed entries, or removes it.  The caller must hold the
+         * lock exclusively.
+         */
+        void apply(const IndexKeyEntry& entry, bool insert) {
+            if (insert) {
+                if (!_data->set.insert(entry).second)
+                    return;
+                _currentKeySize += entry.key.objsize();
+            }
+            else {
+                if (!_data->set.erase(entry))
+                    return;
+                _currentKeySize -= entry.key.objsize();
+            }
+            _data->version++;
+        }
+
+        /**
+         * Applies the change 'owner' has pending for 'entry' if 'commit', and drops it either
+         * way.  Nothing is left to do if the unit of work took the change back.
+         */
+        void endPending(const IndexKeyEntry& entry, const RecoveryUnit* owner, bool commit) {
+            SimpleRWLock::Exclusive lk(_data->lock);
+            const PendingEntries::iterator it = _data->pending.find(entry);
+            if (it == _data->pending.end() || it->second.owner != owner)
+                return;
+
+            const bool insert = it->second.insert;
+            _data->pending.erase(it);
+            if (commit)
+                apply(entry, insert);
+        }
+
+        IndexData* _data;
         long long _currentKeySize;
     };
 } // namespace
@@ -457,9 +703,9 @@ namespace {
                                            boost::shared_ptr<void>* dataInOut) {
         invariant(dataInOut);
         if (!*dataInOut) {
-            *dataInOut = boost::make_shared<IndexSet>(IndexEntryComparison(ordering));
+            *dataInOut = boost::make_shared<IndexData>(ordering);
         }
-        return new Heap1BtreeImpl(static_cast<IndexSet*>(dataInOut->get()));
+        return new Heap1BtreeImpl(static_cast<IndexData*>(dataInOut->get()));
     }
 
 }  // namespace mongo
@@ -29,6 +29,7 @@
  */
 
 #include "mongo/db/storage/heap1/heap1_btree_impl.h"
+#include "mongo/db/concurrency/write_conflict_exception.h"
 #include "mongo/db/storage/heap1/heap1_recovery_unit.h"
 #include "mongo/db/storage/sorted_data_interface_test_harness.h"
 #include "mongo/unittest/unittest.h"
@@ -58,4 +59,51 @@ namespace mongo {
         return new MyHarnessHelper();
     }
 
+    TEST( Heap1BtreeImpl, ChangesAreSeenByOthersOnCommit ) {
+        MyHarnessHelper harnessHelper;
+        scoped_ptr<SortedDataInterface> sorted( harnessHelper.newSortedDataInterface() );
+        scoped_ptr<OperationContext> writer( harnessHelper.newOperationContext() );
+        scoped_ptr<OperationContext> reader( harnessHelper.newOperationContext() );
+
+        {
+            WriteUnitOfWork uow( writer.get() );
+            ASSERT_OK( sorted->insert( writer.get(), BSON( "" << 1 ), DiskLoc( 1, 2 ), false ) );
+            ASSERT( sorted->isEmpty( reader.get() ) );
+
+            // Another unique insert of the key depends on whether this one commits.
+            {
+                WriteUnitOfWork uow2( reader.get() );
+                ASSERT_THROWS( sorted->insert( reader.get(), BSON( "" << 1 ), DiskLoc( 1, 4 ),
+                                               false ),
+                               WriteConflictException );
+            }
+            uow.commit();
+        }
+        ASSERT_EQUALS( 1, sorted->numEntries( reader.get() ) );
+
+        {
+            WriteUnitOfWork uow( writer.get() );
+            ASSERT( sorted->unindex( writer.get(), BSON( "" << 1 ), DiskLoc( 1, 2 ) ) );
+
+            scoped_ptr<SortedDataInterface::Cursor> cursor( sorted->newCursor( reader.get(), 1 ) );
+            ASSERT( cursor->locate( BSON( "" << 1 ), DiskLoc( 1, 2 ) ) );
+
+            // The writer can put back the key it removed, at another location.
+            ASSERT_OK( sorted->insert( writer.get(), BSON( "" << 1 ), DiskLoc( 1, 6 ), false ) );
+            uow.commit();
+        }
+
+        scoped_ptr<SortedDataInterface::Cursor> cursor( sorted->newCursor( reader.get(), 1 ) );
+        ASSERT_FALSE( cursor->locate( BSON( "" << 1 ), DiskLoc( 1, 2 ) ) );
+        ASSERT( cursor->locate( BSON( "" << 1 ), DiskLoc( 1, 6 ) ) );
+        ASSERT_EQUALS( 1, sorted->numEntries( reader.get() ) );
+
+        {
+            WriteUnitOfWork uow( writer.get() );
+            ASSERT_OK( sorted->insert( writer.get(), BSON( "" << 2 ), DiskLoc( 1, 8 ), false ) );
+            // no commit
+        }
+        ASSERT_EQUALS( 1, sorted->numEntries( reader.get() ) );
+    }
+
 }
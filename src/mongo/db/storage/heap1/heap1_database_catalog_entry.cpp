@@ -167,10 +167,12 @@ namespace mongo {
     }
 
     int Heap1DatabaseCatalogEntry::Entry::getTotalIndexCount( OperationContext* txn ) const {
+        boost::mutex::scoped_lock lk( _indexesMutex );
         return static_cast<int>( indexes.size() );
     }
 
     int Heap1DatabaseCatalogEntry::Entry::getCompletedIndexCount( OperationContext* txn ) const {
+        boost::mutex::scoped_lock lk( _indexesMutex );
         int ready = 0;
         for ( Indexes::const_iterator i = indexes.begin(); i != indexes.end(); ++i )
             if ( i->second->ready )
@@ -180,12 +182,14 @@ namespace mongo {
 
     void Heap1DatabaseCatalogEntry::Entry::getAllIndexes( OperationContext* txn,
                                                           std::vector<std::string>* names ) const {
+        boost::mutex::scoped_lock lk( _indexesMutex );
         for ( Indexes::const_iterator i = indexes.begin(); i != indexes.end(); ++i )
             names->push_back( i->second->name );
     }
 
     BSONObj Heap1DatabaseCatalogEntry::Entry::getIndexSpec( OperationContext* txn,
                                                             const StringData& idxName ) const {
+        boost::mutex::scoped_lock lk( _indexesMutex );
         Indexes::const_iterator i = indexes.find( idxName.toString() );
         invariant( i != indexes.end() );
         return i->second->spec; 
@@ -193,6 +197,7 @@ namespace mongo {
 
     bool Heap1DatabaseCatalogEntry::Entry::isIndexMultikey( OperationContext* txn,
                                                             const StringData& idxName) const {
+        boost::mutex::scoped_lock lk( _indexesMutex );
         Indexes::const_iterator i = indexes.find( idxName.toString() );
         invariant( i != indexes.end() );
         return i->second->isMultikey;
@@ -201,6 +206,7 @@ namespace mongo {
     bool Heap1DatabaseCatalogEntry::Entry::setIndexIsMultikey(OperationContext* txn,
                                                               const StringData& idxName,
                                                               bool multikey ) {
+        boost::mutex::scoped_lock lk( _indexesMutex );
         Indexes::const_iterator i = indexes.find( idxName.toString() );
         invariant( i != indexes.end() );
         if (i->second->isMultikey == multikey)
@@ -212,6 +218,7 @@ namespace mongo {
 
     DiskLoc Heap1DatabaseCatalogEntry::Entry::getIndexHead( OperationContext* txn,
                                                             const StringData& idxName ) const {
+        boost::mutex::scoped_lock lk( _indexesMutex );
         Indexes::const_iterator i = indexes.find( idxName.toString() );
         invariant( i != indexes.end() );
         return i->second->head;
@@ -220,6 +227,7 @@ namespace mongo {
     void Heap1DatabaseCatalogEntry::Entry::setIndexHead( OperationContext* txn,
                                                          const StringData& idxName,
                                                          const DiskLoc& newHead ) {
+        boost::mutex::scoped_lock lk( _indexesMutex );
         Indexes::const_iterator i = indexes.find( idxName.toString() );
         invariant( i != indexes.end() );
         i->second->head = newHead;
@@ -227,6 +235,7 @@ namespace mongo {
 
     bool Heap1DatabaseCatalogEntry::Entry::isIndexReady( OperationContext* txn,
                                                          const StringData& idxName ) const {
+        boost::mutex::scoped_lock lk( _indexesMutex );
         Indexes::const_iterator i = indexes.find( idxName.toString() );
         invariant( i != indexes.end() );
         return i->second->ready;
@@ -234,12 +243,14 @@ namespace mongo {
 
     Status Heap1DatabaseCatalogEntry::Entry::removeIndex( OperationContext* txn,
                                                           const StringData& idxName ) {
+        boost::mutex::scoped_lock lk( _indexesMutex );
         indexes.erase( idxName.toString() );
         return Status::OK();
     }
 
     Status Heap1DatabaseCatalogEntry::Entry::prepareForIndexBuild( OperationContext* txn,
                                                                    const IndexDescriptor* spec ) {
+        boost::mutex::scoped_lock lk( _indexesMutex );
         auto_ptr<IndexEntry> newEntry( new IndexEntry() );
         newEntry->name = spec->indexName();
         newEntry->spec = spec->infoObj();
@@ -252,6 +263,7 @@ namespace mongo {
 
     void Heap1DatabaseCatalogEntry::Entry::indexBuildSuccess( OperationContext* txn,
                                                               const StringData& idxName ) {
+        boost::mutex::scoped_lock lk( _indexesMutex );
         Indexes::const_iterator i = indexes.find( idxName.toString() );
         invariant( i != indexes.end() );
         i->second->ready = true;
@@ -260,6 +272,7 @@ namespace mongo {
     void Heap1DatabaseCatalogEntry::Entry::updateTTLSetting( OperationContext* txn,
                                                              const StringData& idxName,
                                                              long long newExpireSeconds ) {
+        boost::mutex::scoped_lock lk( _indexesMutex );
         Indexes::const_iterator i = indexes.find( idxName.toString() );
         invariant( i != indexes.end() );
 
@@ -161,6 +161,11 @@ namespace mongo {
             scoped_ptr<HeapRecordStore> rs;
             typedef std::map<std::string,IndexEntry*> Indexes;
             Indexes indexes;
+
+        private:
+            // Guards 'indexes' in the methods above.  With document locking, writers that set an
+            // index multikey only hold the collection in MODE_IX, alongside readers.
+            mutable boost::mutex _indexesMutex;
         };
 
         bool _everHadACollection;
@@ -52,7 +52,7 @@ namespace mongo {
         virtual DatabaseCatalogEntry* getDatabaseCatalogEntry( OperationContext* opCtx,
                                                                const StringData& db );
 
-        virtual bool supportsDocLocking() const { return false; }
+        virtual bool supportsDocLocking() const { return true; }
 
         virtual Status closeDatabase(OperationContext* txn, const StringData& db );
 
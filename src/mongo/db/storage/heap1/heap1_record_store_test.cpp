@@ -29,6 +29,10 @@
  */
 
 #include "mongo/db/storage/heap1/record_store_heap.h"
+#include "mongo/db/concurrency/lock_state.h"
+#include "mongo/db/concurrency/write_conflict_exception.h"
+#include "mongo/db/operation_context.h"
+#include "mongo/db/operation_context_noop.h"
 #include "mongo/db/storage/heap1/heap1_recovery_unit.h"
 #include "mongo/db/storage/record_store_test_harness.h"
 #include "mongo/unittest/unittest.h"
@@ -53,4 +57,305 @@ namespace mongo {
         return new MyHarnessHelper();
     }
 
+    // OperationContextNoop has no Locker, which would leave the documents unlocked.
+    class LockingOperationContext : public OperationContextNoop {
+    public:
+        LockingOperationContext() : OperationContextNoop( new Heap1RecoveryUnit() ) {
+            invariant( _locker.lockGlobal( newlm::MODE_IX ) == newlm::LOCK_OK );
+        }
+
+        virtual ~LockingOperationContext() {
+            _locker.unlockGlobal();
+        }
+
+        virtual Locker* lockState() const { return &_locker; }
+
+    private:
+        mutable LockState _locker;
+    };
+
+    TEST( HeapRecordStore, PagesAreReused ) {
+        MyHarnessHelper harnessHelper;
+        HeapRecordStore rs( "a.b" );
+        scoped_ptr<OperationContext> opCtx( harnessHelper.newOperationContext() );
+
+        const std::string s( 100, 'x' );
+        std::vector<DiskLoc> locs;
+        for ( int i = 0; i < 10000; i++ ) {
+            StatusWith<DiskLoc> res = rs.insertRecord( opCtx.get(), s.c_str(), s.size() + 1, false );
+            ASSERT_OK( res.getStatus() );
+            locs.push_back( res.getValue() );
+        }
+
+        const int64_t fullSize = rs.storageSize( opCtx.get() );
+        ASSERT_LESS_THAN( 10000LL * 100, fullSize );
+
+        // Removing every other record leaves every page partly in use.
+        for ( size_t i = 0; i < locs.size(); i += 2 ) {
+            rs.deleteRecord( opCtx.get(), locs[i] );
+        }
+        ASSERT_EQUALS( 5000, rs.numRecords( opCtx.get() ) );
+        ASSERT_EQUALS( fullSize, rs.storageSize( opCtx.get() ) );
+
+        // Removing the rest gives the pages back.
+        for ( size_t i = 1; i < locs.size(); i += 2 ) {
+            rs.deleteRecord( opCtx.get(), locs[i] );
+        }
+        ASSERT_EQUALS( 0, rs.numRecords( opCtx.get() ) );
+        ASSERT_EQUALS( 0, rs.dataSize( opCtx.get() ) );
+        ASSERT_LESS_THAN( rs.storageSize( opCtx.get() ), fullSize / 10 );
+
+        BSONObjBuilder b;
+        rs.appendCustomStats( opCtx.get(), &b, 1 );
+        BSONObj stats = b.obj();
+        ASSERT_LESS_THAN_OR_EQUALS( stats["numPages"].numberLong(), 1 );
+    }
+
+    TEST( HeapRecordStore, UpdateKeepsLocation ) {
+        MyHarnessHelper harnessHelper;
+        HeapRecordStore rs( "a.b" );
+        scoped_ptr<OperationContext> opCtx( harnessHelper.newOperationContext() );
+
+        const std::string small( 10, 'a' );
+        const std::string big( 10000, 'b' );
+
+        StatusWith<DiskLoc> first = rs.insertRecord( opCtx.get(), small.c_str(), small.size() + 1, false );
+        ASSERT_OK( first.getStatus() );
+        StatusWith<DiskLoc> second = rs.insertRecord( opCtx.get(), small.c_str(), small.size() + 1, false );
+        ASSERT_OK( second.getStatus() );
+
+        StatusWith<DiskLoc> res = rs.updateRecord( opCtx.get(), first.getValue(),
+                                                   big.c_str(), big.size() + 1, false, NULL );
+        ASSERT_OK( res.getStatus() );
+        ASSERT_EQUALS( first.getValue(), res.getValue() );
+        ASSERT_EQUALS( big, rs.dataFor( opCtx.get(), first.getValue() ).data() );
+        ASSERT_EQUALS( small, rs.dataFor( opCtx.get(), second.getValue() ).data() );
+
+        // Scans still return records in insertion order.
+        scoped_ptr<RecordIterator> it( rs.getIterator( opCtx.get(), DiskLoc(), false,
+                                                       CollectionScanParams::FORWARD ) );
+        ASSERT_EQUALS( first.getValue(), it->getNext() );
+        ASSERT_EQUALS( second.getValue(), it->getNext() );
+        ASSERT( it->isEOF() );
+
+        scoped_ptr<RecordIterator> rit( rs.getIterator( opCtx.get(), second.getValue(), false,
+                                                        CollectionScanParams::BACKWARD ) );
+        ASSERT_EQUALS( second.getValue(), rit->getNext() );
+        ASSERT_EQUALS( first.getValue(), rit->getNext() );
+        ASSERT( rit->isEOF() );
+    }
+
+    TEST( HeapRecordStore, RollbackUndoesChanges ) {
+        MyHarnessHelper harnessHelper;
+        HeapRecordStore rs( "a.b" );
+        scoped_ptr<OperationContext> opCtx( harnessHelper.newOperationContext() );
+
+        const std::string small( 10, 'a' );
+        const std::string big( 1000, 'b' );
+
+        DiskLoc updated;
+        DiskLoc deleted;
+        {
+            WriteUnitOfWork uow( opCtx.get() );
+            StatusWith<DiskLoc> res = rs.insertRecord( opCtx.get(), small.c_str(), small.size() + 1, false );
+            ASSERT_OK( res.getStatus() );
+            updated = res.getValue();
+            res = rs.insertRecord( opCtx.get(), small.c_str(), small.size() + 1, false );
+            ASSERT_OK( res.getStatus() );
+            deleted = res.getValue();
+            uow.commit();
+        }
+
+        {
+            WriteUnitOfWork uow( opCtx.get() );
+            ASSERT_OK( rs.insertRecord( opCtx.get(), big.c_str(), big.size() + 1, false ).getStatus() );
+            ASSERT_OK( rs.updateRecord( opCtx.get(), updated, big.c_str(), big.size() + 1,
+                                        false, NULL ).getStatus() );
+            rs.deleteRecord( opCtx.get(), updated );
+            rs.deleteRecord( opCtx.get(), deleted );
+            ASSERT_EQUALS( 1, rs.numRecords( opCtx.get() ) );
+            // no commit
+        }
+
+        ASSERT_EQUALS( 2, rs.numRecords( opCtx.get() ) );
+        ASSERT_EQUALS( static_cast<long long>( 2 * ( small.size() + 1 ) ), rs.dataSize( opCtx.get() ) );
+        ASSERT_EQUALS( small, rs.dataFor( opCtx.get(), updated ).data() );
+        ASSERT_EQUALS( small, rs.dataFor( opCtx.get(), deleted ).data() );
+
+        scoped_ptr<RecordIterator> it( rs.getIterator( opCtx.get(), DiskLoc(), false,
+                                                       CollectionScanParams::FORWARD ) );
+        ASSERT_EQUALS( updated, it->getNext() );
+        ASSERT_EQUALS( deleted, it->getNext() );
+        ASSERT( it->isEOF() );
+    }
+
+    TEST( HeapRecordStore, WritesAreSeenByOthersOnCommit ) {
+        HeapRecordStore rs( "a.b" );
+        LockingOperationContext writer;
+        LockingOperationContext reader;
+
+        const std::string a( 10, 'a' );
+        const std::string b( 10, 'b' );
+
+        DiskLoc loc;
+        {
+            WriteUnitOfWork uow( &writer );
+            StatusWith<DiskLoc> res = rs.insertRecord( &writer, a.c_str(), a.size() + 1, false );
+            ASSERT_OK( res.getStatus() );
+            loc = res.getValue();
+
+            // Only the writer sees the insert before it commits.
+            ASSERT_EQUALS( a, rs.dataFor( &writer, loc ).data() );
+            ASSERT_FALSE( rs.hasRecord( loc ) );
+            scoped_ptr<RecordIterator> it( rs.getIterator( &reader, DiskLoc(), false,
+                                                           CollectionScanParams::FORWARD ) );
+            ASSERT( it->isEOF() );
+            uow.commit();
+        }
+        ASSERT_EQUALS( a, rs.dataFor( &reader, loc ).data() );
+
+        // A record read before an update commits keeps its bytes afterwards.
+        RecordData before = rs.dataFor( &reader, loc );
+        ASSERT_FALSE( before.isOwned() );
+        {
+            WriteUnitOfWork uow( &writer );
+            ASSERT_OK( rs.updateRecord( &writer, loc, b.c_str(), b.size() + 1, false,
+                                        NULL ).getStatus() );
+            ASSERT_EQUALS( b, rs.dataFor( &writer, loc ).data() );
+            ASSERT_EQUALS( a, rs.dataFor( &reader, loc ).data() );
+            uow.commit();
+        }
+        ASSERT_EQUALS( b, rs.dataFor( &reader, loc ).data() );
+        ASSERT_EQUALS( a, before.data() );
+
+        {
+            WriteUnitOfWork uow( &writer );
+            rs.deleteRecord( &writer, loc );
+            ASSERT( rs.hasRecord( loc ) );
+            uow.commit();
+        }
+        ASSERT_FALSE( rs.hasRecord( loc ) );
+        ASSERT_EQUALS( a, before.data() );
+    }
+
+    TEST( HeapRecordStore, WriteConflictOnLockedRecord ) {
+        HeapRecordStore rs( "a.b" );
+        LockingOperationContext first;
+        LockingOperationContext second;
+
+        const std::string s( 10, 'a' );
+
+        DiskLoc loc;
+        {
+            WriteUnitOfWork uow( &first );
+            StatusWith<DiskLoc> res = rs.insertRecord( &first, s.c_str(), s.size() + 1, false );
+            ASSERT_OK( res.getStatus() );
+            loc = res.getValue();
+            uow.commit();
+        }
+
+        {
+            WriteUnitOfWork uow( &first );
+            ASSERT_OK( rs.updateRecord( &first, loc, s.c_str(), s.size() + 1, false,
+                                        NULL ).getStatus() );
+            {
+                // 'first' holds the document lock until its unit of work ends.
+                WriteUnitOfWork uow2( &second );
+                ASSERT_THROWS( rs.updateRecord( &second, loc, s.c_str(), s.size() + 1, false,
+                                                NULL ),
+                               WriteConflictException );
+                ASSERT_THROWS( rs.deleteRecord( &second, loc ), WriteConflictException );
+            }
+            uow.commit();
+        }
+
+        {
+            WriteUnitOfWork uow( &second );
+            rs.deleteRecord( &second, loc );
+            uow.commit();
+        }
+        ASSERT_EQUALS( 0, rs.numRecords( &first ) );
+    }
+
+    TEST( HeapRecordStore, WriteConflictOnStaleRead ) {
+        HeapRecordStore rs( "a.b" );
+        LockingOperationContext first;
+        LockingOperationContext second;
+
+        const std::string a( 10, 'a' );
+        const std::string b( 10, 'b' );
+
+        DiskLoc loc;
+        {
+            WriteUnitOfWork uow( &first );
+            StatusWith<DiskLoc> res = rs.insertRecord( &first, a.c_str(), a.size() + 1, false );
+            ASSERT_OK( res.getStatus() );
+            loc = res.getValue();
+            uow.commit();
+        }
+
+        // 'second' reads the record, then 'first' changes it.
+        ASSERT_EQUALS( a, rs.dataFor( &second, loc ).data() );
+        {
+            WriteUnitOfWork uow( &first );
+            ASSERT_OK( rs.updateRecord( &first, loc, b.c_str(), b.size() + 1, false,
+                                        NULL ).getStatus() );
+            uow.commit();
+        }
+
+        // Writes based on what 'second' read would lose the update of 'first'.
+        {
+            WriteUnitOfWork uow( &second );
+            ASSERT_THROWS( rs.updateRecord( &second, loc, a.c_str(), a.size() + 1, false,
+                                            NULL ),
+                           WriteConflictException );
+            ASSERT_THROWS( rs.deleteRecord( &second, loc ), WriteConflictException );
+        }
+        ASSERT_EQUALS( b, rs.dataFor( &first, loc ).data() );
+
+        // Once its unit of work has ended, 'second' reads the new version and can write.
+        ASSERT_EQUALS( b, rs.dataFor( &second, loc ).data() );
+        {
+            WriteUnitOfWork uow( &second );
+            ASSERT_OK( rs.updateRecord( &second, loc, a.c_str(), a.size() + 1, false,
+                                        NULL ).getStatus() );
+            uow.commit();
+        }
+        ASSERT_EQUALS( a, rs.dataFor( &first, loc ).data() );
+
+        // Without a recovery unit to pin the page, the data shares ownership of it.
+        RecordData unpinned = rs.dataFor( NULL, loc );
+        ASSERT( unpinned.isOwned() );
+        ASSERT_EQUALS( a, unpinned.data() );
+    }
+
+    // A full scan returns every record once, with all of its data.  perftests.cpp times it.
+    TEST( HeapRecordStore, ScanReturnsAllData ) {
+        MyHarnessHelper harnessHelper;
+        HeapRecordStore rs( "a.b" );
+        scoped_ptr<OperationContext> opCtx( harnessHelper.newOperationContext() );
+
+        const int numRecords = 20 * 1000;
+        const std::string s( 50, 'x' );
+        for ( int i = 0; i < numRecords; i++ ) {
+            ASSERT_OK( rs.insertRecord( opCtx.get(), s.c_str(), s.size() + 1, false ).getStatus() );
+        }
+
+        ASSERT_LESS_THAN( rs.dataSize( opCtx.get() ), rs.storageSize( opCtx.get() ) );
+
+        int64_t found = 0;
+        int64_t bytes = 0;
+        scoped_ptr<RecordIterator> it( rs.getIterator( opCtx.get(), DiskLoc(), false,
+                                                       CollectionScanParams::FORWARD ) );
+        while ( !it->isEOF() ) {
+            DiskLoc loc = it->getNext();
+            RecordData data = it->dataFor( loc );
+            ASSERT_EQUALS( s, data.data() );
+            bytes += data.size();
+            found++;
+        }
+        ASSERT_EQUALS( numRecords, found );
+        ASSERT_EQUALS( rs.dataSize( opCtx.get() ), bytes );
+    }
+
 }
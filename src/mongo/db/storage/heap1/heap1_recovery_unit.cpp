@@ -30,74 +30,71 @@
 
 #include "mongo/db/storage/heap1/heap1_recovery_unit.h"
 
-#include "mongo/db/storage/sorted_data_interface.h"
-
 namespace mongo {
 
     Heap1RecoveryUnit::~Heap1RecoveryUnit() {
         invariant( _frames.empty() );
+        invariant( _changes.empty() );
     }
 
     void Heap1RecoveryUnit::beginUnitOfWork() {
-        _frames.push_back( Frame() );
+        _frames.push_back( _changes.size() );
     }
 
     void Heap1RecoveryUnit::commitUnitOfWork() {
         if ( _frames.size() == 1 ) {
             _rollbackPossible = true;
+
+            for ( size_t i = 0; i < _changes.size(); i++ ) {
+                _changes[i]->commit();
+                delete _changes[i];
+            }
+            _changes.clear();
         }
-        else {
-            size_t last = _frames.size() - 1;
-            size_t next = last - 1;
-            _frames[next].indexMods.insert( _frames[next].indexMods.end(),
-                                            _frames[last].indexMods.begin(),
-                                            _frames[last].indexMods.end() );
-        }
-        _frames.back().indexMods.clear();
+
+        // A nested unit of work leaves its changes to the enclosing one.
+        _frames.back() = _changes.size();
     }
 
     void Heap1RecoveryUnit::endUnitOfWork() {
 
         // invariant( _rollbackPossible ); // todo
 
-        const Frame& frame = _frames.back();
-        for ( size_t i = frame.indexMods.size() ; i > 0; i-- ) {
-            const IndexInfo& ii = frame.indexMods[i-1];
-            SortedDataInterface* idx = ii.idx;
-            if ( ii.insert )
-                idx->unindex( NULL, ii.obj, ii.loc );
-            else
-                idx->insert( NULL, ii.obj, ii.loc, true );
+        const size_t begin = _frames.back();
+        for ( size_t i = _changes.size() ; i > begin; i-- ) {
+            _changes[i-1]->rollback();
+            delete _changes[i-1];
         }
+        _changes.resize( begin );
 
         _frames.pop_back();
-    }
 
-    void Heap1RecoveryUnit::notifyIndexMod( SortedDataInterface* idx,
-                                            const BSONObj& obj, const DiskLoc& loc, bool insert ) {
-        IndexInfo ii = { idx, obj, loc, insert };
-        _frames.back().indexMods.push_back( ii );
+        if ( _frames.empty() )
+            _readSnapshot = 0;
     }
 
-    // static
-    void Heap1RecoveryUnit::notifyIndexInsert( OperationContext* ctx, SortedDataInterface* idx,
-                                               const BSONObj& obj, const DiskLoc& loc ) {
-        if ( !ctx )
+    void Heap1RecoveryUnit::registerChange( Change* change ) {
+        if ( _frames.empty() ) {
+            change->commit();
+            delete change;
             return;
+        }
 
-        Heap1RecoveryUnit* ru = dynamic_cast<Heap1RecoveryUnit*>( ctx->recoveryUnit() );
-        ru->notifyIndexMod( idx, obj, loc, true );
+        _changes.push_back( change );
     }
 
-    // static
-    void Heap1RecoveryUnit::notifyIndexRemove( OperationContext* ctx, SortedDataInterface* idx,
-                                               const BSONObj& obj, const DiskLoc& loc ) {
-        if ( !ctx )
+    void Heap1RecoveryUnit::pinPage( const boost::shared_array<char>& page ) {
+        if ( page.get() == _lastPinnedPage )
             return;
 
-        Heap1RecoveryUnit* ru = dynamic_cast<Heap1RecoveryUnit*>( ctx->recoveryUnit() );
-        ru->notifyIndexMod( idx, obj, loc, false );
+        _pinnedPages.insert( std::make_pair( page.get(), page ) );
+        _lastPinnedPage = page.get();
     }
 
+    uint64_t Heap1RecoveryUnit::readSnapshot( uint64_t lastCommit ) {
+        if ( _readSnapshot == 0 )
+            _readSnapshot = lastCommit;
+        return _readSnapshot;
+    }
 
 }
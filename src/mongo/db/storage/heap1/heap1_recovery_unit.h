@@ -30,18 +30,30 @@
 
 #pragma once
 
+#include <boost/shared_array.hpp>
+#include <map>
 #include <vector>
 
 #include "mongo/db/diskloc.h"
+#include "mongo/db/storage/heap1/record_store_heap.h"
 #include "mongo/db/storage/recovery_unit.h"
 
 namespace mongo {
 
-    class SortedDataInterface;
-
-    class Heap1RecoveryUnit : public RecoveryUnit {
+    /**
+     * Changes are kept until the outermost unit of work commits or ends.  Committing a nested
+     * unit of work hands its changes to the enclosing one, ending a unit of work without
+     * committing it rolls its changes back in reverse order.  Changes made outside of any unit of
+     * work are committed immediately.
+     *
+     * Pages of HeapRecordStores the operation read from are kept until the recovery unit goes
+     * away, so the records it was handed stay valid however they are changed in the meantime.
+     * The read snapshot lasts from the first read after a unit of work ends until the next one
+     * ends.
+     */
+    class Heap1RecoveryUnit : public RecoveryUnit, public HeapReadState {
     public:
-        Heap1RecoveryUnit() {
+        Heap1RecoveryUnit() : _readSnapshot(0), _lastPinnedPage(NULL) {
             _rollbackPossible = true;
         }
 
@@ -55,8 +67,7 @@ namespace mongo {
             return true;
         }
 
-        virtual void registerChange(Change* change) {
-        }
+        virtual void registerChange(Change* change);
 
         virtual void* writingPtr(void* data, size_t len) {
             return data;
@@ -64,33 +75,30 @@ namespace mongo {
 
         virtual void syncDataAndTruncateJournal() {}
 
-        // -------------
+        virtual void pinPage(const boost::shared_array<char>& page);
 
-        void rollbackImpossible() { _rollbackPossible = false; }
+        virtual uint64_t readSnapshot(uint64_t lastCommit);
 
-        void notifyIndexMod( SortedDataInterface* idx,
-                             const BSONObj& obj, const DiskLoc& loc, bool insert );
+        // -------------
 
-        static void notifyIndexInsert( OperationContext* ctx, SortedDataInterface* idx,
-                                       const BSONObj& obj, const DiskLoc& loc );
-        static void notifyIndexRemove( OperationContext* ctx, SortedDataInterface* idx,
-                                       const BSONObj& obj, const DiskLoc& loc );
+        void rollbackImpossible() { _rollbackPossible = false; }
 
     private:
         bool _rollbackPossible;
 
-        struct IndexInfo {
-            SortedDataInterface* idx;
-            BSONObj obj;
-            DiskLoc loc;
-            bool insert;
-        };
+        // Changes of all open units of work, oldest first.  Owned.
+        std::vector<Change*> _changes;
+
+        // For each open unit of work, the number of entries in _changes when it began.
+        std::vector<size_t> _frames;
 
-        struct Frame {
-            std::vector<IndexInfo> indexMods;
-        };
+        // 0 until the first read since the last unit of work ended.
+        uint64_t _readSnapshot;
 
-        std::vector<Frame> _frames;
+        // Keyed by the start of the page.  Scans read a page at a time, so _lastPinnedPage saves
+        // most of the lookups.
+        std::map<const char*, boost::shared_array<char> > _pinnedPages;
+        const char* _lastPinnedPage;
     };
 
 }
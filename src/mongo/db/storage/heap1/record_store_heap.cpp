@@ -29,11 +29,75 @@
 
 #include "mongo/db/storage/heap1/record_store_heap.h"
 
+#include <algorithm>
+
+#include "mongo/db/concurrency/locker.h"
+#include "mongo/db/concurrency/write_conflict_exception.h"
+#include "mongo/db/operation_context.h"
+#include "mongo/platform/atomic_word.h"
 #include "mongo/util/log.h"
 #include "mongo/util/mongoutils/str.h"
 
 namespace mongo {
 
+    namespace {
+        // New pages start small so that tiny collections stay tiny, and double up to MaxPageSize.
+        const int MinPageSize = 16 * 1024;
+        const int MaxPageSize = 1024 * 1024;
+
+        // Records bigger than this get a page of their own rather than wasting the tail page.
+        const int MaxSharedPageRecordSize = MaxPageSize / 4;
+
+        // How long a writer waits for another operation's document lock before giving up with a
+        // WriteConflictException.
+        const unsigned DocumentLockTimeoutMillis = 500;
+
+        // Number of the last commit to any HeapRecordStore.  Only changed under the
+        // _structureMutex of the store committing, together with the record it numbers.  Starts
+        // at 1 so that 0 can mean no snapshot.
+        AtomicUInt64 lastCommit(1);
+
+        HeapReadState* readStateFor(OperationContext* txn) {
+            return txn ? dynamic_cast<HeapReadState*>(txn->recoveryUnit()) : NULL;
+        }
+    }
+
+    //
+    // Changes
+    //
+
+    /**
+     * Publishes or discards the version of a record written by a unit of work.
+     */
+    class HeapRecordStore::PendingChange : public RecoveryUnit::Change {
+    public:
+        PendingChange(HeapRecordStore* rs, int64_t id) : _rs(rs), _id(id) {}
+
+        virtual void commit() { _rs->commitPending(_id); }
+
+        virtual void rollback() { _rs->rollbackPending(_id); }
+
+    private:
+        HeapRecordStore* const _rs;
+        const int64_t _id;
+    };
+
+    /**
+     * Frees or puts back a record taken by a capped delete.
+     */
+    class HeapRecordStore::CappedDeleteChange : public RecoveryUnit::Change {
+    public:
+        CappedDeleteChange(HeapRecordStore* rs, int64_t id) : _rs(rs), _id(id) {}
+
+        virtual void commit() { _rs->commitCappedDelete(_id); }
+
+        virtual void rollback() { _rs->rollbackCappedDelete(_id); }
+
+    private:
+        HeapRecordStore* const _rs;
+        const int64_t _id;
+    };
+
     //
     // RecordStore
     //
@@ -44,11 +108,17 @@ namespace mongo {
                                      int64_t cappedMaxDocs,
                                      CappedDocumentDeleteCallback* cappedDeleteCallback)
             : RecordStore(ns),
+              _lockHash(newlm::ResourceId(newlm::RESOURCE_COLLECTION, ns).getHashId()),
               _isCapped(isCapped),
               _cappedMaxSize(cappedMaxSize),
               _cappedMaxDocs(cappedMaxDocs),
               _cappedDeleteCallback(cappedDeleteCallback),
               _dataSize(0),
+              _numRecords(0),
+              _tailPage(NULL),
+              _pageBytes(0),
+              _numSlotChunks(0),
+              _firstId(0),
               _nextId(1) { // DiskLoc(0,0) isn't valid for records.
 
         if (_isCapped) {
@@ -64,22 +134,212 @@ namespace mongo {
     const char* HeapRecordStore::name() const { return "heap"; }
 
     RecordData HeapRecordStore::dataFor( OperationContext* txn, const DiskLoc& loc ) const {
-        return recordFor(loc)->toRecordData();
+        boost::mutex::scoped_lock lk(_structureMutex);
+        const int64_t id = locToId(loc);
+        const HeapRecord* rec = visibleRecord(txn, id);
+        if (!rec && !_cappedDeletes.empty()) {
+            CappedDeletes::const_iterator it = _cappedDeletes.find(id);
+            if (it != _cappedDeletes.end())
+                rec = it->second;
+        }
+        uassert(18904,
+                mongoutils::str::stream() << "record " << loc.toString() << " in " << ns()
+                                          << " was deleted by a concurrent operation",
+                rec);
+
+        return toRecordData(txn, rec);
     }
 
     HeapRecordStore::HeapRecord* HeapRecordStore::recordFor(const DiskLoc& loc) const {
-        Records::const_iterator it = _records.find(loc);
-        if ( it == _records.end() ) {
-            error() << "HeapRecordStore::recordFor cannot find record for " << ns() << ":" << loc;
+        return slotFor(locToId(loc));
+    }
+
+    bool HeapRecordStore::hasRecord(const DiskLoc& loc) const {
+        boost::mutex::scoped_lock lk(_structureMutex);
+        return recordFor(loc);
+    }
+
+    HeapRecordStore::HeapRecord* HeapRecordStore::visibleRecord(OperationContext* txn,
+                                                                int64_t id) const {
+        if (txn && !_pendingVersions.empty()) {
+            PendingVersions::const_iterator it = _pendingVersions.find(id);
+            if (it != _pendingVersions.end() && it->second.owner == txn->recoveryUnit())
+                return it->second.rec;
+        }
+        return slotFor(id);
+    }
+
+    HeapRecordStore::HeapRecord* HeapRecordStore::recordToWrite(OperationContext* txn,
+                                                                 int64_t id) const {
+        if (txn && !_pendingVersions.empty()) {
+            PendingVersions::const_iterator it = _pendingVersions.find(id);
+            if (it != _pendingVersions.end() && it->second.owner == txn->recoveryUnit())
+                return it->second.rec;
+        }
+
+        HeapRecord* rec = slotFor(id);
+        if (!rec && _cappedDeletes.count(id))
+            throw WriteConflictException();
+
+        HeapReadState* readState = readStateFor(txn);
+        if (rec && readState && rec->version() > readState->readSnapshot(lastCommit.load()))
+            throw WriteConflictException();
+
+        return rec;
+    }
+
+    RecordData HeapRecordStore::toRecordData(OperationContext* txn, const HeapRecord* rec) const {
+        const boost::shared_array<char>& page = pageFor(rec)->buf;
+
+        HeapReadState* readState = readStateFor(txn);
+        if (!readState) {
+            // Shares ownership of the page, but points at the record as RecordData requires.
+            const boost::shared_array<char> data(page, const_cast<char*>(rec->data()));
+            return RecordData(rec->data(), rec->netLength(), data);
         }
-        invariant(it != _records.end());
-        return reinterpret_cast<HeapRecord*>(it->second.get());
+
+        // Taken while holding _structureMutex, so that the snapshot counts every commit of the
+        // records this operation reads from here on.
+        readState->readSnapshot(lastCommit.load());
+        readState->pinPage(page);
+        return RecordData(rec->data(), rec->netLength());
+    }
+
+    void HeapRecordStore::lockRecord(OperationContext* txn, const DiskLoc& loc) const {
+        Locker* locker = txn ? txn->lockState() : NULL;
+        if (!locker)
+            return;
+
+        // Spread consecutive ids over the whole hash space.
+        const uint64_t id = static_cast<uint64_t>(locToId(loc)) * 0x9E3779B97F4A7C15ULL;
+        const newlm::ResourceId resId(newlm::RESOURCE_DOCUMENT, _lockHash ^ id);
+
+        // There is no deadlock detection, so two writers waiting on each other's records are
+        // broken up by the timeout.
+        if (locker->lock(resId, newlm::MODE_X, DocumentLockTimeoutMillis) != newlm::LOCK_OK)
+            throw WriteConflictException();
+
+        // Inside a write unit of work the lock manager holds on to exclusive locks until the
+        // unit of work ends.
+        locker->unlock(resId);
+    }
+
+    bool HeapRecordStore::writeVersion(OperationContext* txn, int64_t id, HeapRecord* rec) {
+        const HeapRecord* old = visibleRecord(txn, id);
+        _dataSize += (rec ? rec->netLength() : 0) - (old ? old->netLength() : 0);
+        _numRecords += (rec ? 1 : 0) - (old ? 1 : 0);
+
+        if (!txn) {
+            publish(id, rec);
+            return false;
+        }
+
+        PendingVersions::iterator it = _pendingVersions.find(id);
+        if (it != _pendingVersions.end()) {
+            // The document lock keeps other operations away until this one's unit of work ends.
+            invariant(it->second.owner == txn->recoveryUnit());
+            if (it->second.rec)
+                freeRecord(it->second.rec);
+            it->second.rec = rec;
+            return false;
+        }
+
+        const HeapRecord* committed = slotFor(id);
+        PendingVersion& pending = _pendingVersions[id];
+        pending.owner = txn->recoveryUnit();
+        pending.rec = rec;
+        pending.committedLength = committed ? committed->netLength() : -1;
+        return true;
+    }
+
+    void HeapRecordStore::publish(int64_t id, HeapRecord* rec) {
+        if (HeapRecord* old = slotFor(id))
+            freeRecord(old);
+        if (rec)
+            rec->version() = lastCommit.addAndFetch(1);
+        setSlot(id, rec);
+    }
+
+    void HeapRecordStore::commitPending(int64_t id) {
+        boost::mutex::scoped_lock lk(_structureMutex);
+        PendingVersions::iterator it = _pendingVersions.find(id);
+        if (it == _pendingVersions.end())
+            return; // truncated
+
+        const PendingVersion pending = it->second;
+        _pendingVersions.erase(it);
+
+        if (pending.committedLength >= 0 && !slotFor(id)) {
+            // A capped delete, which doesn't wait for document locks, got to the record first.
+            if (pending.rec)
+                freeRecord(pending.rec);
+            return;
+        }
+
+        publish(id, pending.rec);
+    }
+
+    void HeapRecordStore::rollbackPending(int64_t id) {
+        boost::mutex::scoped_lock lk(_structureMutex);
+        PendingVersions::iterator it = _pendingVersions.find(id);
+        if (it == _pendingVersions.end())
+            return; // truncated
+
+        const PendingVersion pending = it->second;
+        _pendingVersions.erase(it);
+
+        const bool hadCommitted = pending.committedLength >= 0;
+        _dataSize += (hadCommitted ? pending.committedLength : 0)
+                   - (pending.rec ? pending.rec->netLength() : 0);
+        _numRecords += (hadCommitted ? 1 : 0) - (pending.rec ? 1 : 0);
+
+        if (pending.rec)
+            freeRecord(pending.rec);
     }
 
     void HeapRecordStore::deleteRecord(OperationContext* txn, const DiskLoc& loc) {
-        HeapRecord* rec = recordFor(loc);
-        _dataSize -= rec->netLength();
-        invariant(_records.erase(loc) == 1);
+        lockRecord(txn, loc);
+
+        const int64_t id = locToId(loc);
+        bool newPending;
+        {
+            boost::mutex::scoped_lock lk(_structureMutex);
+            if (!recordToWrite(txn, id)) {
+                error() << "HeapRecordStore::deleteRecord cannot find record for " << ns() << ":"
+                        << loc;
+            }
+            invariant(visibleRecord(txn, id));
+            newPending = writeVersion(txn, id, NULL);
+        }
+
+        if (newPending)
+            txn->recoveryUnit()->registerChange(new PendingChange(this, id));
+    }
+
+    void HeapRecordStore::commitCappedDelete(int64_t id) {
+        boost::mutex::scoped_lock lk(_structureMutex);
+        CappedDeletes::iterator it = _cappedDeletes.find(id);
+        if (it == _cappedDeletes.end())
+            return; // truncated
+
+        freeRecord(it->second);
+        _cappedDeletes.erase(it);
+    }
+
+    void HeapRecordStore::rollbackCappedDelete(int64_t id) {
+        boost::mutex::scoped_lock lk(_structureMutex);
+        CappedDeletes::iterator it = _cappedDeletes.find(id);
+        if (it == _cappedDeletes.end())
+            return; // truncated
+
+        // Nobody could write to the record in the meantime, so it goes back unchanged, version
+        // and all.
+        HeapRecord* rec = it->second;
+        _cappedDeletes.erase(it);
+        invariant(!slotFor(id));
+        setSlot(id, rec);
+        _dataSize += rec->netLength();
+        _numRecords++;
     }
 
     bool HeapRecordStore::cappedAndNeedDelete(OperationContext* txn) const {
@@ -96,15 +356,42 @@ namespace mongo {
     }
 
     void HeapRecordStore::cappedDeleteAsNeeded(OperationContext* txn) {
+        if (!_isCapped)
+            return;
+
+        // Capped deletes don't take document locks: the oldest record may belong to any writer,
+        // and waiting for it while holding our own locks could deadlock.
+        boost::mutex::scoped_lock cappedLk(_cappedDeleteMutex);
         while (cappedAndNeedDelete(txn)) {
-            invariant(!_records.empty());
+            invariant(_numRecords > 0);
 
-            DiskLoc oldest = _records.begin()->first;
+            DiskLoc oldest = firstLoc();
+            if (oldest.isNull())
+                break; // the rest hasn't been committed yet
 
             if (_cappedDeleteCallback)
                 uassertStatusOK(_cappedDeleteCallback->aboutToDeleteCapped(txn, oldest));
 
-            deleteRecord(txn, oldest);
+            const int64_t id = locToId(oldest);
+            {
+                boost::mutex::scoped_lock lk(_structureMutex);
+                HeapRecord* rec = slotFor(id);
+                if (!rec)
+                    continue;
+
+                _dataSize -= rec->netLength();
+                _numRecords--;
+                setSlot(id, NULL);
+                if (!txn) {
+                    freeRecord(rec);
+                    continue;
+                }
+
+                // Kept until the delete commits, for readers coming from an index.
+                _cappedDeletes[id] = rec;
+            }
+
+            txn->recoveryUnit()->registerChange(new CappedDeleteChange(this, id));
         }
     }
 
@@ -119,16 +406,22 @@ namespace mongo {
                                        "object to insert exceeds cappedMaxSize");
         }
 
-        // TODO padding?
-        const int lengthWithHeaders = len + HeapRecord::HeaderSize;
-        boost::shared_array<char> buf(new char[lengthWithHeaders]);
-        HeapRecord* rec = reinterpret_cast<HeapRecord*>(buf.get());
-        rec->lengthWithHeaders() = lengthWithHeaders;
-        memcpy(rec->data(), data, len);
+        // Nobody else knows about the new record before it commits, so it needs no document lock.
+        DiskLoc loc;
+        bool newPending;
+        {
+            boost::mutex::scoped_lock lk(_structureMutex);
+
+            // TODO padding?
+            HeapRecord* rec = allocRecord(len);
+            memcpy(rec->data(), data, len);
+
+            loc = allocateLoc();
+            newPending = writeVersion(txn, locToId(loc), rec);
+        }
 
-        const DiskLoc loc = allocateLoc();
-        _records[loc] = buf;
-        _dataSize += len;
+        if (newPending)
+            txn->recoveryUnit()->registerChange(new PendingChange(this, locToId(loc)));
 
         cappedDeleteAsNeeded(txn);
 
@@ -146,16 +439,21 @@ namespace mongo {
                                        "object to insert exceeds cappedMaxSize");
         }
 
-        // TODO padding?
-        const int lengthWithHeaders = len + HeapRecord::HeaderSize;
-        boost::shared_array<char> buf(new char[lengthWithHeaders]);
-        HeapRecord* rec = reinterpret_cast<HeapRecord*>(buf.get());
-        rec->lengthWithHeaders() = lengthWithHeaders;
-        doc->writeDocument(rec->data());
+        DiskLoc loc;
+        bool newPending;
+        {
+            boost::mutex::scoped_lock lk(_structureMutex);
+
+            // TODO padding?
+            HeapRecord* rec = allocRecord(len);
+            doc->writeDocument(rec->data());
 
-        const DiskLoc loc = allocateLoc();
-        _records[loc] = buf;
-        _dataSize += len;
+            loc = allocateLoc();
+            newPending = writeVersion(txn, locToId(loc), rec);
+        }
+
+        if (newPending)
+            txn->recoveryUnit()->registerChange(new PendingChange(this, locToId(loc)));
 
         cappedDeleteAsNeeded(txn);
 
@@ -168,34 +466,29 @@ namespace mongo {
                                                       int len,
                                                       bool enforceQuota,
                                                       UpdateMoveNotifier* notifier ) {
-        HeapRecord* oldRecord = recordFor( oldLocation );
-        int oldLen = oldRecord->netLength();
-
-        // If the length of the new data is <= the length of the old data then just
-        // memcopy into the old space
-        if ( len <= oldLen) {
-            memcpy(oldRecord->data(), data, len);
-            _dataSize += len - oldLen;
-            return StatusWith<DiskLoc>(oldLocation);
-        }
+        lockRecord(txn, oldLocation);
+
+        // The new version always goes to new space, but keeps the record's location.
+        const int64_t id = locToId(oldLocation);
+        bool newPending;
+        {
+            boost::mutex::scoped_lock lk(_structureMutex);
+            const HeapRecord* oldRecord = recordToWrite(txn, id);
+            invariant(oldRecord);
+
+            if ( _isCapped && len > oldRecord->netLength() ) {
+                return StatusWith<DiskLoc>( ErrorCodes::InternalError,
+                                            "failing update: objects in a capped ns cannot grow",
+                                            10003 );
+            }
 
-        if ( _isCapped ) {
-            return StatusWith<DiskLoc>( ErrorCodes::InternalError,
-                                        "failing update: objects in a capped ns cannot grow",
-                                        10003 );
+            HeapRecord* rec = allocRecord(len);
+            memcpy(rec->data(), data, len);
+            newPending = writeVersion(txn, id, rec);
         }
 
-        // If the length of the new data exceeds the size of the old Record, we need to allocate
-        // a new Record, and delete the old one
-
-        const int lengthWithHeaders = len + HeapRecord::HeaderSize;
-        boost::shared_array<char> buf(new char[lengthWithHeaders]);
-        HeapRecord* rec = reinterpret_cast<HeapRecord*>(buf.get());
-        rec->lengthWithHeaders() = lengthWithHeaders;
-        memcpy(rec->data(), data, len);
-
-        _records[oldLocation] = buf;
-        _dataSize += len - oldLen;
+        if (newPending)
+            txn->recoveryUnit()->registerChange(new PendingChange(this, id));
 
         cappedDeleteAsNeeded(txn);
 
@@ -206,18 +499,36 @@ namespace mongo {
                                                const DiskLoc& loc,
                                                const char* damangeSource,
                                                const mutablebson::DamageVector& damages ) {
-        HeapRecord* rec = recordFor( loc );
-        char* root = rec->data();
+        lockRecord(txn, loc);
+
+        const int64_t id = locToId(loc);
+        bool newPending;
+        {
+            boost::mutex::scoped_lock lk(_structureMutex);
+            // The damages were worked out from the version 'txn' read, which this checks is still
+            // the one they apply to.
+            const HeapRecord* oldRecord = recordToWrite(txn, id);
+            invariant(oldRecord);
+
+            // Readers may be looking at the old version, so the damages go to a copy of it.
+            HeapRecord* rec = allocRecord(oldRecord->netLength());
+            memcpy(rec->data(), oldRecord->data(), oldRecord->netLength());
+            char* root = rec->data();
+
+            mutablebson::DamageVector::const_iterator where = damages.begin();
+            const mutablebson::DamageVector::const_iterator end = damages.end();
+            for( ; where != end; ++where ) {
+                const char* sourcePtr = damangeSource + where->sourceOffset;
+                char* targetPtr = root + where->targetOffset;
+                std::memcpy(targetPtr, sourcePtr, where->size);
+            }
 
-        // All updates were in place. Apply them via durability and writing pointer.
-        mutablebson::DamageVector::const_iterator where = damages.begin();
-        const mutablebson::DamageVector::const_iterator end = damages.end();
-        for( ; where != end; ++where ) {
-            const char* sourcePtr = damangeSource + where->sourceOffset;
-            char* targetPtr = root + where->targetOffset;
-            std::memcpy(targetPtr, sourcePtr, where->size);
+            newPending = writeVersion(txn, id, rec);
         }
 
+        if (newPending)
+            txn->recoveryUnit()->registerChange(new PendingChange(this, id));
+
         return Status::OK();
     }
 
@@ -229,39 +540,48 @@ namespace mongo {
             invariant(_isCapped && dir == CollectionScanParams::FORWARD);
 
         if (dir == CollectionScanParams::FORWARD) {
-            return new HeapRecordIterator(txn, _records, *this, start, tailable);
+            return new HeapRecordIterator(txn, *this, start, tailable);
         }
         else {
-            return new HeapRecordReverseIterator(txn, _records, *this, start);
+            return new HeapRecordReverseIterator(txn, *this, start);
         }
     }
 
     RecordIterator* HeapRecordStore::getIteratorForRepair(OperationContext* txn) const {
         // TODO maybe make different from HeapRecordIterator
-        return new HeapRecordIterator(txn, _records, *this);
+        return new HeapRecordIterator(txn, *this);
     }
 
     std::vector<RecordIterator*> HeapRecordStore::getManyIterators(OperationContext* txn) const {
         std::vector<RecordIterator*> out;
         // TODO maybe find a way to return multiple iterators.
-        out.push_back(new HeapRecordIterator(txn, _records, *this));
+        out.push_back(new HeapRecordIterator(txn, *this));
         return out;
     }
 
     Status HeapRecordStore::truncate(OperationContext* txn) {
-        _records.clear();
+        boost::mutex::scoped_lock lk(_structureMutex);
+        _pages.clear();
+        _tailPage = NULL;
+        _pageBytes = 0;
+        _slots.clear();
+        _numSlotChunks = 0;
+        _pendingVersions.clear();
+        _cappedDeletes.clear();
+        _firstId = _nextId - _nextId % SlotsPerChunk;
         _dataSize = 0;
+        _numRecords = 0;
         return Status::OK();
     }
 
     void HeapRecordStore::temp_cappedTruncateAfter(OperationContext* txn,
                                                    DiskLoc end,
                                                    bool inclusive) {
-        Records::iterator it = inclusive ? _records.lower_bound(end)
-                                         : _records.upper_bound(end);
-        while(it != _records.end()) {
-            _dataSize -= reinterpret_cast<HeapRecord*>(it->second.get())->netLength();
-            _records.erase(it++);
+        DiskLoc loc = lastLoc();
+        while (!loc.isNull() && (end < loc || (inclusive && loc == end))) {
+            const DiskLoc prev = locBefore(loc);
+            deleteRecord(txn, loc);
+            loc = prev;
         }
     }
 
@@ -284,10 +604,9 @@ namespace mongo {
                                      BSONObjBuilder* output) const {
         results->valid = true;
         if (scanData && full) {
-            for (Records::const_iterator it = _records.begin(); it != _records.end(); ++it) {
-                HeapRecord* rec = reinterpret_cast<HeapRecord*>(it->second.get());
+            for (DiskLoc loc = firstLoc(); !loc.isNull(); loc = locAfter(loc)) {
                 size_t dataSize;
-                const Status status = adaptor->validate(rec->toRecordData(), &dataSize);
+                const Status status = adaptor->validate(dataFor(txn, loc), &dataSize);
                 if (!status.isOK()) {
                     results->valid = false;
                     results->errors.push_back("invalid object detected (see logs)");
@@ -296,7 +615,7 @@ namespace mongo {
             }
         }
 
-        output->appendNumber( "nrecords", _records.size() );
+        output->appendNumber( "nrecords", static_cast<long long>( _numRecords ) );
 
         return Status::OK();
 
@@ -310,6 +629,10 @@ namespace mongo {
             result->appendIntOrLL( "max", _cappedMaxDocs );
             result->appendIntOrLL( "maxSize", _cappedMaxSize );
         }
+
+        boost::mutex::scoped_lock lk(_structureMutex);
+        result->appendIntOrLL( "numPages", _pages.size() );
+        result->appendIntOrLL( "pageBytes", static_cast<long long>( _pageBytes / scale ) );
     }
 
     Status HeapRecordStore::touch(OperationContext* txn, BSONObjBuilder* output) const {
@@ -320,6 +643,10 @@ namespace mongo {
         return Status::OK();
     }
 
+    void HeapRecordStore::prefetch(OperationContext* txn, const std::vector<DiskLoc>& locs) const {
+        // already in memory...
+    }
+
     Status HeapRecordStore::setCustomOption(
                 OperationContext* txn, const BSONElement& option, BSONObjBuilder* info) {
         StringData name = option.fieldName();
@@ -343,24 +670,224 @@ namespace mongo {
                                          BSONObjBuilder* extraInfo,
                                          int infoLevel) const {
         // Note: not making use of extraInfo or infoLevel since we don't have extents
-        const int64_t recordOverhead = numRecords(txn) * HeapRecord::HeaderSize;
-        return _dataSize + recordOverhead;
+        boost::mutex::scoped_lock lk(_structureMutex);
+        const int64_t directoryOverhead = _numSlotChunks * sizeof(SlotChunk)
+                                        + _slots.size() * sizeof(Slots::value_type);
+        return _pageBytes + directoryOverhead;
     }
 
     DiskLoc HeapRecordStore::allocateLoc() {
-        const int64_t id = _nextId++;
+        return idToLoc(_nextId++);
+    }
+
+    DiskLoc HeapRecordStore::idToLoc(int64_t id) {
         // This is a hack, but both the high and low order bits of DiskLoc offset must be 0, and the
         // file must fit in 23 bits. This gives us a total of 30 + 23 == 53 bits.
         invariant(id < (1LL << 53));
         return DiskLoc(int(id >> 30), int((id << 1) & ~(1<<31)));
     }
 
+    int64_t HeapRecordStore::locToId(const DiskLoc& loc) {
+        return (static_cast<int64_t>(loc.a()) << 30) | (loc.getOfs() >> 1);
+    }
+
+    HeapRecordStore::HeapRecord* HeapRecordStore::slotFor(int64_t id) const {
+        if (id < _firstId)
+            return NULL;
+
+        const size_t chunk = static_cast<size_t>((id - _firstId) / SlotsPerChunk);
+        if (chunk >= _slots.size() || !_slots[chunk])
+            return NULL;
+
+        return _slots[chunk]->slots[(id - _firstId) % SlotsPerChunk];
+    }
+
+    void HeapRecordStore::setSlot(int64_t id, HeapRecord* rec) {
+        if (!rec && !slotFor(id))
+            return;
+
+        if (_slots.empty())
+            _firstId = id - id % SlotsPerChunk;
+
+        while (id < _firstId) {
+            _slots.push_front(boost::shared_ptr<SlotChunk>());
+            _firstId -= SlotsPerChunk;
+        }
+
+        const size_t chunk = static_cast<size_t>((id - _firstId) / SlotsPerChunk);
+        if (chunk >= _slots.size())
+            _slots.resize(chunk + 1);
+
+        if (!_slots[chunk]) {
+            _slots[chunk].reset(new SlotChunk());
+            _numSlotChunks++;
+        }
+
+        SlotChunk* slotChunk = _slots[chunk].get();
+        HeapRecord*& slot = slotChunk->slots[(id - _firstId) % SlotsPerChunk];
+        slotChunk->live += (rec ? 1 : 0) - (slot ? 1 : 0);
+        slot = rec;
+
+        if (slotChunk->live > 0)
+            return;
+
+        _slots[chunk].reset();
+        _numSlotChunks--;
+
+        // Keep the directory free of empty chunks at its ends.
+        while (!_slots.empty() && !_slots.front()) {
+            _slots.pop_front();
+            _firstId += SlotsPerChunk;
+        }
+        while (!_slots.empty() && !_slots.back()) {
+            _slots.pop_back();
+        }
+    }
+
+    DiskLoc HeapRecordStore::firstLocFrom(int64_t id) const {
+        id = std::max(id, _firstId);
+        size_t chunk = static_cast<size_t>((id - _firstId) / SlotsPerChunk);
+        int slot = static_cast<int>((id - _firstId) % SlotsPerChunk);
+        for (; chunk < _slots.size(); chunk++, slot = 0) {
+            const SlotChunk* slotChunk = _slots[chunk].get();
+            if (!slotChunk)
+                continue;
+
+            for (; slot < SlotsPerChunk; slot++) {
+                if (slotChunk->slots[slot])
+                    return idToLoc(_firstId + chunk * SlotsPerChunk + slot);
+            }
+        }
+        return DiskLoc();
+    }
+
+    DiskLoc HeapRecordStore::lastLocBefore(int64_t id) const {
+        const int64_t endId = _firstId + static_cast<int64_t>(_slots.size()) * SlotsPerChunk;
+        id = std::min(id, endId) - 1;
+        if (id < _firstId)
+            return DiskLoc();
+
+        int64_t chunk = (id - _firstId) / SlotsPerChunk;
+        int slot = static_cast<int>((id - _firstId) % SlotsPerChunk);
+        for (; chunk >= 0; chunk--, slot = SlotsPerChunk - 1) {
+            const SlotChunk* slotChunk = _slots[chunk].get();
+            if (!slotChunk)
+                continue;
+
+            for (; slot >= 0; slot--) {
+                if (slotChunk->slots[slot])
+                    return idToLoc(_firstId + chunk * SlotsPerChunk + slot);
+            }
+        }
+        return DiskLoc();
+    }
+
+    DiskLoc HeapRecordStore::locAfter(const DiskLoc& loc) const {
+        boost::mutex::scoped_lock lk(_structureMutex);
+        return firstLocFrom(locToId(loc) + 1);
+    }
+
+    DiskLoc HeapRecordStore::locBefore(const DiskLoc& loc) const {
+        boost::mutex::scoped_lock lk(_structureMutex);
+        return lastLocBefore(locToId(loc));
+    }
+
+    DiskLoc HeapRecordStore::firstLoc() const {
+        boost::mutex::scoped_lock lk(_structureMutex);
+        return firstLocFrom(_firstId);
+    }
+
+    DiskLoc HeapRecordStore::lastLoc() const {
+        boost::mutex::scoped_lock lk(_structureMutex);
+        return lastLocBefore(_nextId);
+    }
+
+    HeapRecordStore::Page* HeapRecordStore::newPage(int size) {
+        boost::shared_ptr<Page> page(new Page(size));
+        _pages[page->buf.get()] = page;
+        _pageBytes += size;
+        return page.get();
+    }
+
+    HeapRecordStore::HeapRecord* HeapRecordStore::allocRecord(int len) {
+        // Keep records 8 byte aligned.
+        const int needed = (HeapRecord::HeaderSize + len + 7) & ~7;
+
+        Page* page;
+        if (needed > MaxSharedPageRecordSize) {
+            page = newPage(needed);
+        }
+        else {
+            if (!_tailPage || _tailPage->size - _tailPage->used < needed) {
+                const int size = std::max(needed, _tailPage ? std::min(_tailPage->size * 2,
+                                                                       MaxPageSize)
+                                                            : MinPageSize);
+                Page* oldTail = _tailPage;
+                _tailPage = newPage(size);
+
+                if (oldTail && oldTail->live == 0) {
+                    _pageBytes -= oldTail->size;
+                    _pages.erase(oldTail->buf.get());
+                }
+            }
+            page = _tailPage;
+        }
+
+        HeapRecord* rec = reinterpret_cast<HeapRecord*>(page->buf.get() + page->used);
+        page->used += needed;
+        page->live += needed;
+
+        rec->netLength() = len;
+        rec->allocatedLength() = needed;
+        return rec;
+    }
+
+    const HeapRecordStore::Page* HeapRecordStore::pageFor(const HeapRecord* rec) const {
+        const char* p = reinterpret_cast<const char*>(rec);
+
+        Pages::const_iterator it = _pages.upper_bound(p);
+        invariant(it != _pages.begin());
+        --it;
+
+        const Page* page = it->second.get();
+        invariant(p < page->buf.get() + page->used);
+        return page;
+    }
+
+    void HeapRecordStore::freeRecord(HeapRecord* rec) {
+        const char* p = reinterpret_cast<const char*>(rec);
+
+        Pages::iterator it = _pages.upper_bound(p);
+        invariant(it != _pages.begin());
+        --it;
+
+        Page* page = it->second.get();
+        invariant(p < page->buf.get() + page->used);
+
+        page->live -= rec->allocatedLength();
+        invariant(page->live >= 0);
+        if (page->live > 0)
+            return;
+
+        if (page == _tailPage) {
+            if (page->size <= MinPageSize && page->buf.use_count() == 1) {
+                // Nothing left in a small tail page and nobody reading from it, start filling it
+                // again from the front rather than allocating a new one for the next insert.
+                page->used = 0;
+                return;
+            }
+            _tailPage = NULL;
+        }
+
+        _pageBytes -= page->size;
+        _pages.erase(it);
+    }
+
     //
     // Forward Iterator
     //
 
     HeapRecordIterator::HeapRecordIterator(OperationContext* txn,
-                                           const HeapRecordStore::Records& records,
                                            const HeapRecordStore& rs,
                                            DiskLoc start,
                                            bool tailable)
@@ -368,25 +895,22 @@ namespace mongo {
               _tailable(tailable),
               _lastLoc(minDiskLoc),
               _killedByInvalidate(false),
-              _records(records),
               _rs(rs) {
         if (start.isNull()) {
-            _it = _records.begin();
+            _curr = _rs.firstLoc();
         }
         else {
-            _it = _records.find(start);
-            invariant(_it != _records.end());
+            invariant(_rs.hasRecord(start));
+            _curr = start;
         }
     }
 
     bool HeapRecordIterator::isEOF() {
-        return _it == _records.end();
+        return _curr.isNull();
     }
 
     DiskLoc HeapRecordIterator::curr() {
-        if (isEOF())
-            return DiskLoc();
-        return _it->first;
+        return _curr;
     }
 
     DiskLoc HeapRecordIterator::getNext() {
@@ -394,23 +918,17 @@ namespace mongo {
             if (!_tailable)
                 return DiskLoc();
 
-            if (_records.empty())
-                return DiskLoc();
-
             invariant(!_killedByInvalidate);
 
-            // recover to last returned record
-            invariant(!_lastLoc.isNull());
-            _it = _records.find(_lastLoc);
-            invariant(_it != _records.end());
-
-            if (++_it == _records.end())
+            // recover to the record after the last one returned
+            _curr = _rs.locAfter(_lastLoc);
+            if (isEOF())
                 return DiskLoc();
         }
 
-        const DiskLoc out = _it->first;
-        ++_it;
-        if (_tailable && _it == _records.end())
+        const DiskLoc out = _curr;
+        _curr = _rs.locAfter(out);
+        if (_tailable && isEOF())
             _lastLoc = out;
         return out;
     }
@@ -423,15 +941,15 @@ namespace mongo {
                     _killedByInvalidate = true;
                 }
             } 
-            else if (_it->first == loc) {
+            else if (_curr == loc) {
                 _killedByInvalidate = true;
             }
 
             return;
         }
 
-        if (_it != _records.end() && _it->first == loc)
-            ++_it;
+        if (_curr == loc)
+            _curr = _rs.locAfter(loc);
     }
 
     void HeapRecordIterator::saveState() {
@@ -451,38 +969,34 @@ namespace mongo {
     //
 
     HeapRecordReverseIterator::HeapRecordReverseIterator(OperationContext* txn,
-                                                         const HeapRecordStore::Records& records,
                                                          const HeapRecordStore& rs,
                                                          DiskLoc start)
             : _txn(txn),
               _killedByInvalidate(false),
-              _records(records),
               _rs(rs) {
         if (start.isNull()) {
-            _it = _records.rbegin();
+            _curr = _rs.lastLoc();
         }
         else {
-            _it = HeapRecordStore::Records::const_reverse_iterator(_records.find(start));
-            invariant(_it != _records.rend());
+            invariant(_rs.hasRecord(start));
+            _curr = start;
         }
     }
 
     bool HeapRecordReverseIterator::isEOF() {
-        return _it == _records.rend();
+        return _curr.isNull();
     }
 
     DiskLoc HeapRecordReverseIterator::curr() {
-        if (isEOF())
-            return DiskLoc();
-        return _it->first;
+        return _curr;
     }
 
     DiskLoc HeapRecordReverseIterator::getNext() {
         if (isEOF())
             return DiskLoc();
 
-        const DiskLoc out = _it->first;
-        ++_it;
+        const DiskLoc out = _curr;
+        _curr = _rs.locBefore(out);
         return out;
     }
 
@@ -490,13 +1004,13 @@ namespace mongo {
         if (isEOF())
             return;
 
-        if (_it->first == loc) {
+        if (_curr == loc) {
             if (_rs.isCapped()) {
                 // Capped iterators die on invalidation rather than advancing.
                 _killedByInvalidate = true;
                 return;
             }
-            ++_it;
+            _curr = _rs.locBefore(loc);
         }
     }
 
@@ -30,7 +30,11 @@
 
 #pragma once
 
+#include <algorithm>
 #include <boost/shared_array.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <deque>
 #include <map>
 
 #include "mongo/db/storage/capped_callback.h"
@@ -39,10 +43,58 @@
 namespace mongo {
 
     class HeapRecordIterator;
+    class RecoveryUnit;
+
+    /**
+     * What HeapRecordStores keep track of for the reads of an operation.  Implemented by the
+     * RecoveryUnit of the engine.
+     */
+    class HeapReadState {
+    public:
+        virtual ~HeapReadState() {}
+
+        /**
+         * Keeps 'page' until the operation goes away, so that HeapRecordStore::dataFor() can hand
+         * out a record's own bytes without them being freed while the operation still uses them.
+         */
+        virtual void pinPage(const boost::shared_array<char>& page) = 0;
+
+        /**
+         * Returns the number of the last commit to any HeapRecordStore as of the operation's
+         * first read since its last unit of work ended.  'lastCommit' is the current one, which
+         * becomes the snapshot if this is that first read.
+         */
+        virtual uint64_t readSnapshot(uint64_t lastCommit) = 0;
+    };
 
     /**
      * A RecordStore that stores all data on the heap.
      *
+     * Records are carved out of large pages, back to back in insertion order, so a collection scan
+     * walks memory sequentially and a record costs 16 bytes of header plus 8 bytes of directory
+     * rather than a map node and an allocation of its own.  DiskLocs encode a dense, increasing
+     * record id which indexes straight into the directory.  A page is freed once every record in
+     * it has been deleted or moved by a growing update, and the directory is kept in chunks which
+     * are freed the same way.
+     *
+     * Safe for concurrent use under collection intent locks.  Writers take an exclusive document
+     * lock on the record they update or delete, which the lock manager holds until the end of the
+     * write unit of work, and throw a WriteConflictException if they can't get it in time.  A
+     * write never changes a record in place: it makes a new version, which only the writing
+     * operation sees until its unit of work commits and the version replaces the record in the
+     * directory.  Other operations keep reading the committed record in the meantime.
+     *
+     * Every committed record carries the number of the commit that made it.  An operation's
+     * reads are compared against the last commit number when it first read since its last unit
+     * of work ended, and a write to a record committed after that throws a
+     * WriteConflictException, since the writer may have based it on an older version.
+     *
+     * Since a committed record is never written to, dataFor() hands out the record's own bytes.
+     * The page holding them is pinned by the reading operation's HeapReadState, or else shared
+     * with the returned RecordData, so the bytes stay valid after the record is replaced or
+     * deleted.  A page is only reused once nobody holds on to it.
+     * _structureMutex guards the pages, the directory, the pending versions and the counters.
+     *
      * @param cappedMaxSize - required if isCapped. limit uses dataSize() in this impl.
      */
     class HeapRecordStore : public RecordStore {
@@ -110,6 +162,8 @@ namespace mongo {
                                         double scale ) const;
 
         virtual Status touch( OperationContext* txn, BSONObjBuilder* output ) const;
+
+        virtual void prefetch( OperationContext* txn, const std::vector<DiskLoc>& locs ) const;
         
         virtual Status setCustomOption( OperationContext* txn,
                                         const BSONElement& option,
@@ -123,62 +177,249 @@ namespace mongo {
 
         virtual long long dataSize( OperationContext* txn ) const { return _dataSize; }
 
-        virtual long long numRecords( OperationContext* txn ) const { return _records.size(); }
+        virtual long long numRecords( OperationContext* txn ) const { return _numRecords; }
 
     protected:
         class HeapRecord {
         public:
             enum HeaderSizeValue { HeaderSize = 16 };
 
-            int lengthWithHeaders() const {  return _lengthWithHeaders; }
-            int& lengthWithHeaders() {  return _lengthWithHeaders; }
+            int netLength() const { return _netLength; }
+            int& netLength() { return _netLength; }
 
-            const char* data() const { return _data; }
-            char* data() { return _data; }
+            // Bytes reserved for this record in its page, including the header.
+            int allocatedLength() const { return _allocatedLength; }
+            int& allocatedLength() { return _allocatedLength; }
 
-            int netLength() const { return _lengthWithHeaders - HeaderSize; }
+            // Number of the commit that made this the committed record.
+            uint64_t version() const { return _version; }
+            uint64_t& version() { return _version; }
 
-            RecordData toRecordData() const { return RecordData(_data, netLength()); }
+            const char* data() const { return _data; }
+            char* data() { return _data; }
 
         private:
-            int _lengthWithHeaders;
+            int _netLength;
+            int _allocatedLength;
+            uint64_t _version;
             char _data[4];
         };
 
-        virtual HeapRecord* recordFor( const DiskLoc& loc ) const;
+        /**
+         * Returns the committed record at 'loc', or NULL if there is none.  The caller must hold
+         * _structureMutex.
+         */
+        HeapRecord* recordFor( const DiskLoc& loc ) const;
 
     public:
         //
         // Not in RecordStore interface
         //
 
-        typedef std::map<DiskLoc, boost::shared_array<char> > Records;
-
         bool isCapped() const { return _isCapped; }
         void setCappedDeleteCallback(CappedDocumentDeleteCallback* cb) { _cappedDeleteCallback = cb; }
         bool cappedMaxDocs() const { invariant(_isCapped); return _cappedMaxDocs; }
         bool cappedMaxSize() const { invariant(_isCapped); return _cappedMaxSize; }
 
+        /**
+         * Returns the location of the first record after 'loc' in insertion order, or a null
+         * DiskLoc if there is none.  'loc' doesn't need to hold a record.
+         */
+        DiskLoc locAfter( const DiskLoc& loc ) const;
+
+        /**
+         * Returns the location of the last record before 'loc' in insertion order, or a null
+         * DiskLoc if there is none.  'loc' doesn't need to hold a record.
+         */
+        DiskLoc locBefore( const DiskLoc& loc ) const;
+
+        DiskLoc firstLoc() const;
+        DiskLoc lastLoc() const;
+
+        bool hasRecord( const DiskLoc& loc ) const;
+
     private:
+        class PendingChange;
+        class CappedDeleteChange;
+
+        /**
+         * A contiguous piece of memory records are allocated from, front to back.
+         */
+        struct Page {
+            explicit Page(int size) : buf(new char[size]), size(size), used(0), live(0) { }
+
+            // Shared with the RecordData returned by dataFor(), so that the memory outlives the
+            // page while anybody still reads from it.
+            const boost::shared_array<char> buf;
+            const int size;
+
+            // Bytes handed out so far, whether or not they still hold a record.
+            int used;
+
+            // Bytes held by records still in use.
+            int live;
+        };
+
+        // Keyed by the start of the page's buffer, so the page owning a record can be found.
+        typedef std::map<const char*, boost::shared_ptr<Page> > Pages;
+
+        enum { SlotsPerChunk = 512 };
+
+        /**
+         * The directory entries for SlotsPerChunk consecutive record ids, NULL for ids without a
+         * record.
+         */
+        struct SlotChunk {
+            SlotChunk() : live(0) { std::fill(slots, slots + SlotsPerChunk, (HeapRecord*)NULL); }
+
+            HeapRecord* slots[SlotsPerChunk];
+
+            // Number of non-NULL entries in 'slots'.
+            int live;
+        };
+
+        // Directory from record id to record.  A chunk is freed, and left NULL, as soon as its
+        // last record goes, so deleted ranges anywhere in the collection give their space back.
+        // The front chunk starts at record id _firstId, which is a multiple of SlotsPerChunk,
+        // and there are no NULL chunks at either end.
+        typedef std::deque<boost::shared_ptr<SlotChunk> > Slots;
+
+        /**
+         * The version of a record written by a unit of work that hasn't committed yet.  'rec' is
+         * NULL if the unit of work deleted the record.
+         */
+        struct PendingVersion {
+            const RecoveryUnit* owner;
+            HeapRecord* rec;
+
+            // Length of the committed record when the unit of work first wrote to it, -1 if
+            // there was none, as for an insert.
+            int committedLength;
+        };
+
+        // Keyed by record id.
+        typedef std::map<int64_t, PendingVersion> PendingVersions;
+
+        // Records taken out of the directory by capped deletes that haven't committed yet, keyed
+        // by record id.  Their index entries only go when the delete commits, so until then
+        // dataFor() still finds them.
+        typedef std::map<int64_t, HeapRecord*> CappedDeletes;
+
+        /**
+         * Takes an exclusive document lock on 'loc' for the rest of the write unit of work.
+         * Throws a WriteConflictException if another operation holds on to it for too long.
+         * Must be called without holding _structureMutex, since it can block.
+         */
+        void lockRecord(OperationContext* txn, const DiskLoc& loc) const;
+
+        /**
+         * Returns the version of the record with id 'id' seen by 'txn': its own pending version
+         * if it has one, otherwise the committed record.  Returns NULL if there is none.
+         */
+        HeapRecord* visibleRecord(OperationContext* txn, int64_t id) const;
+
+        /**
+         * Returns the version of the record with id 'id' that 'txn' is about to replace, like
+         * visibleRecord().  Throws a WriteConflictException if the committed record is newer than
+         * what 'txn' read, or was taken by a capped delete.  The caller must hold the record's
+         * document lock and _structureMutex.
+         */
+        HeapRecord* recordToWrite(OperationContext* txn, int64_t id) const;
+
+        /**
+         * Returns RecordData for the bytes of 'rec', pinning its page for 'txn'.
+         */
+        RecordData toRecordData(OperationContext* txn, const HeapRecord* rec) const;
+
+        /**
+         * Makes 'rec' the version of record 'id' written by 'txn', or deletes the record if 'rec'
+         * is NULL, and updates the counters.  Without a 'txn' the version is committed right
+         * away.  Returns true if the caller must register a PendingChange for 'id' once it has
+         * released _structureMutex.
+         */
+        bool writeVersion(OperationContext* txn, int64_t id, HeapRecord* rec);
+
+        /**
+         * Replaces the committed record 'id' with 'rec', or removes it if 'rec' is NULL.
+         */
+        void publish(int64_t id, HeapRecord* rec);
+
+        void commitPending(int64_t id);
+        void rollbackPending(int64_t id);
+
+        void commitCappedDelete(int64_t id);
+        void rollbackCappedDelete(int64_t id);
+
         DiskLoc allocateLoc();
         bool cappedAndNeedDelete(OperationContext* txn) const;
         void cappedDeleteAsNeeded(OperationContext* txn);
 
+        /**
+         * Reserves room for a record of 'len' bytes.  The returned record has its lengths set
+         * but its data uninitialized.
+         */
+        HeapRecord* allocRecord(int len);
+        void freeRecord(HeapRecord* rec);
+
+        /**
+         * Returns the page 'rec' was allocated from.
+         */
+        const Page* pageFor(const HeapRecord* rec) const;
+
+        Page* newPage(int size);
+
+        /**
+         * Returns the record with id 'id', or NULL if there is none.
+         */
+        HeapRecord* slotFor(int64_t id) const;
+
+        /**
+         * Makes 'rec' the record with id 'id', or removes the record for 'id' if 'rec' is NULL.
+         * Allocates and frees directory chunks as needed.
+         */
+        void setSlot(int64_t id, HeapRecord* rec);
+
+        /**
+         * Returns the location of the first record with an id of at least 'id', or of the last
+         * record with an id less than 'id', or a null DiskLoc if there is none.
+         */
+        DiskLoc firstLocFrom(int64_t id) const;
+        DiskLoc lastLocBefore(int64_t id) const;
+
+        static int64_t locToId(const DiskLoc& loc);
+        static DiskLoc idToLoc(int64_t id);
+
+        mutable boost::mutex _structureMutex;
+
+        // Only one thread trims a capped collection at a time.
+        boost::mutex _cappedDeleteMutex;
+
+        // Mixed into the ids of document locks to keep collections apart.
+        const uint64_t _lockHash;
+
         // TODO figure out a proper solution to metadata
         const bool _isCapped;
         const int64_t _cappedMaxSize;
         const int64_t _cappedMaxDocs;
         CappedDocumentDeleteCallback* _cappedDeleteCallback;
         int64_t _dataSize;
+        int64_t _numRecords;
+
+        Pages _pages;
+        Page* _tailPage; // page new records are allocated from, owned by _pages
+        int64_t _pageBytes;
 
-        Records _records;
+        Slots _slots;
+        int64_t _numSlotChunks; // non-NULL entries in _slots
+        PendingVersions _pendingVersions;
+        CappedDeletes _cappedDeletes;
+        int64_t _firstId;
         int64_t _nextId;
     };
 
     class HeapRecordIterator : public RecordIterator {
     public:
         HeapRecordIterator(OperationContext* txn,
-                           const HeapRecordStore::Records& records,
                            const HeapRecordStore& rs,
                            DiskLoc start = DiskLoc(),
                            bool tailable = false);
@@ -199,19 +440,17 @@ namespace mongo {
 
     private:
         OperationContext* _txn; // not owned
-        HeapRecordStore::Records::const_iterator _it;
+        DiskLoc _curr;
         bool _tailable;
         DiskLoc _lastLoc; // only for restarting tailable
         bool _killedByInvalidate;
 
-        const HeapRecordStore::Records& _records;
         const HeapRecordStore& _rs;
     };
 
     class HeapRecordReverseIterator : public RecordIterator {
     public:
         HeapRecordReverseIterator(OperationContext* txn,
-                                  const HeapRecordStore::Records& records,
                                   const HeapRecordStore& rs,
                                   DiskLoc start = DiskLoc());
 
@@ -231,10 +470,9 @@ namespace mongo {
 
     private:
         OperationContext* _txn; // not owned
-        HeapRecordStore::Records::const_reverse_iterator _it;
+        DiskLoc _curr;
         bool _killedByInvalidate;
 
-        const HeapRecordStore::Records& _records;
         const HeapRecordStore& _rs;
     };
 
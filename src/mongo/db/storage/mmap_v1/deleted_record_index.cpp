@@ -0,0 +1,87 @@
+// deleted_record_index.cpp
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/db/storage/mmap_v1/deleted_record_index.h"
+
+#include "mongo/util/assert_util.h"
+
+namespace mongo {
+
+    DeletedRecordIndex::DeletedRecordIndex()
+        : _totalBytes(0),
+          _built(false) {
+    }
+
+    void DeletedRecordIndex::clear() {
+        _bySize.clear();
+        _prev.clear();
+        _totalBytes = 0;
+        _built = false;
+    }
+
+    void DeletedRecordIndex::insert(const DiskLoc& loc, int length, const DiskLoc& prev) {
+        const bool inserted = _bySize.insert(std::make_pair(length, loc)).second;
+        invariant(inserted);
+        _prev[loc] = prev;
+        _totalBytes += length;
+    }
+
+    void DeletedRecordIndex::erase(const DiskLoc& loc, int length) {
+        const size_t erased = _bySize.erase(std::make_pair(length, loc));
+        invariant(erased == 1);
+        _prev.erase(loc);
+        _totalBytes -= length;
+    }
+
+    void DeletedRecordIndex::setPrev(const DiskLoc& loc, const DiskLoc& prev) {
+        if (loc.isNull())
+            return;
+        PrevMap::iterator it = _prev.find(loc);
+        invariant(it != _prev.end());
+        it->second = prev;
+    }
+
+    DiskLoc DeletedRecordIndex::prev(const DiskLoc& loc) const {
+        PrevMap::const_iterator it = _prev.find(loc);
+        invariant(it != _prev.end());
+        return it->second;
+    }
+
+    DiskLoc DeletedRecordIndex::bestFit(int length) const {
+        // DiskLoc() sorts before every valid location
+        BySize::const_iterator it = _bySize.lower_bound(std::make_pair(length, DiskLoc()));
+        if (it == _bySize.end())
+            return DiskLoc();
+        return it->second;
+    }
+
+}
@@ -0,0 +1,100 @@
+// deleted_record_index.h
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#pragma once
+
+#include <set>
+#include <utility>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/db/diskloc.h"
+#include "mongo/platform/unordered_map.h"
+
+namespace mongo {
+
+    /**
+     * An in-memory index over the on-disk deleted record lists of a SimpleRecordStoreV1.
+     *
+     * The on-disk lists are singly linked and only grouped by size bucket, so finding a good fit
+     * means walking them.  This keeps every DeletedRecord ordered by (length, location) for
+     * best-fit lookups, along with its predecessor in the on-disk list so that it can be
+     * unlinked without walking to it.
+     *
+     * Nothing here is persisted.  The owning record store builds it from the on-disk lists on
+     * first use and clears it whenever the two could have diverged.  Callers must hold the lock
+     * that protects the on-disk lists.
+     */
+    class DeletedRecordIndex {
+        MONGO_DISALLOW_COPYING(DeletedRecordIndex);
+    public:
+        DeletedRecordIndex();
+
+        /** false until markBuilt(), and again after clear() */
+        bool isBuilt() const { return _built; }
+        void markBuilt() { _built = true; }
+
+        void clear();
+
+        /**
+         * Adds a DeletedRecord of 'length' bytes at 'loc', whose predecessor in its on-disk list
+         * is 'prev' (null if 'loc' is the head of the list).
+         */
+        void insert(const DiskLoc& loc, int length, const DiskLoc& prev);
+
+        /** Removes 'loc', which was added with the same 'length'. */
+        void erase(const DiskLoc& loc, int length);
+
+        /** Records that the predecessor of 'loc' is now 'prev'.  No-op if 'loc' is null. */
+        void setPrev(const DiskLoc& loc, const DiskLoc& prev);
+
+        /** @return the predecessor of 'loc' in its on-disk list, or null if it is the head */
+        DiskLoc prev(const DiskLoc& loc) const;
+
+        /**
+         * @return the smallest DeletedRecord of at least 'length' bytes, the lowest location
+         *         amongst equally sized ones, or a null DiskLoc if none is large enough.
+         */
+        DiskLoc bestFit(int length) const;
+
+        size_t numRecords() const { return _bySize.size(); }
+        long long totalBytes() const { return _totalBytes; }
+        int largestRecord() const { return _bySize.empty() ? 0 : _bySize.rbegin()->first; }
+
+    private:
+        typedef std::set< std::pair<int, DiskLoc> > BySize;
+        typedef unordered_map<DiskLoc, DiskLoc, DiskLoc::Hasher> PrevMap;
+
+        BySize _bySize;
+        PrevMap _prev;
+        long long _totalBytes;
+        bool _built;
+    };
+
+}
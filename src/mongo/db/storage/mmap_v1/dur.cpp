@@ -118,6 +118,21 @@ namespace mongo {
         // When set, the flush thread will exit
         static AtomicUInt32 shutdownRequested(0);
 
+        // Set (under flushMutex) by j:true writers in group commit mode; tells the flush thread
+        // to start the next commit as soon as the previous one has completed.
+        static bool groupCommitRequested = false;
+
+        /** Fsync-to-wake accounting for writers acknowledged through group commit.  Unlike Stats,
+            these are written by the woken writer threads, not the commit thread.
+        */
+        struct GroupCommitWakeStats {
+            AtomicUInt64 lastNotifiedMicros; // when the latest commit reached the journal
+            AtomicUInt64 writersWoken;
+            AtomicUInt64 totalWakeMicros;
+            AtomicUInt64 commitsWithWaiters; // since startup, unlike Stats::S::_commitsWithWaiters
+        };
+        static GroupCommitWakeStats groupCommitWakeStats;
+
 
         CommitJob& commitJob = *(new CommitJob()); // don't destroy
 
@@ -168,6 +183,13 @@ namespace mongo {
                        "compression" << _journaledBytes / (_uncompressedBytes+1.0) <<
                        "commitsInWriteLock" << _commitsInWriteLock <<
                        "earlyCommits" << _earlyCommits << 
+                       "groupCommit" <<
+                       BSON( "commitsWithWaiters" << _commitsWithWaiters <<
+                             "waitersNotified" << _waitersNotified <<
+                             "avgBatchSize" <<
+                                 (_commitsWithWaiters ?
+                                      _waitersNotified / (double) _commitsWithWaiters : 0.0)
+                           ) <<
                        "timeMs" <<
                        BSON( "dt" << _dtMillis <<
                              "prepLogBuffer" << (unsigned) (_prepLogBufferMicros/1000) <<
@@ -181,7 +203,19 @@ namespace mongo {
         }
 
         BSONObj Stats::asObj() {
-            return other()->_asObj();
+            BSONObjBuilder b;
+            b.appendElements(other()->_asObj());
+
+            // cumulative, since these are maintained by the writers rather than rotated
+            const unsigned long long woken = groupCommitWakeStats.writersWoken.load();
+            const unsigned long long wakeMicros = groupCommitWakeStats.totalWakeMicros.load();
+            b << "groupCommitWake" <<
+                 BSON( "enabled" << storageGlobalParams.journalGroupCommit <<
+                       "writersWoken" << static_cast<long long>(woken) <<
+                       "commitsWithWaiters" << static_cast<long long>(
+                           groupCommitWakeStats.commitsWithWaiters.load()) <<
+                       "avgFsyncToWakeMicros" << (woken ? wakeMicros / (double) woken : 0.0) );
+            return b.obj();
         }
 
         void Stats::rotate() {
@@ -241,8 +275,34 @@ namespace mongo {
             return true;
         }
 
+        /** Asks the flush thread to begin a commit as soon as the one in progress (if any) is
+            done, rather than waiting out the rest of journalCommitInterval.
+        */
+        static void requestGroupCommit() {
+            {
+                boost::mutex::scoped_lock lock(flushMutex);
+                groupCommitRequested = true;
+            }
+            flushRequested.notify_one();
+        }
+
         bool DurableImpl::awaitCommit() {
-            commitJob._notify.awaitBeyondNow();
+            if (!storageGlobalParams.journalGroupCommit) {
+                commitJob._notify.awaitBeyondNow();
+                return true;
+            }
+
+            // Our ticket is satisfied by the first commit which begins after we take it.  Every
+            // writer that arrives while a commit is being fsynced takes a ticket for the next one,
+            // so all of them are acknowledged by a single WRITETOJOURNAL.
+            NotifyAll::When ticket = commitJob._notify.now();
+            requestGroupCommit();
+            commitJob._notify.waitFor(ticket);
+
+            const unsigned long long notified = groupCommitWakeStats.lastNotifiedMicros.load();
+            const unsigned long long now = curTimeMicros64();
+            groupCommitWakeStats.writersWoken.fetchAndAdd(1);
+            groupCommitWakeStats.totalWakeMicros.fetchAndAdd(now > notified ? now - notified : 0);
             return true;
         }
 
@@ -476,6 +536,20 @@ namespace mongo {
         // reallocate, and more importantly regrow it, on every single commit.
         static AlignedBuilder __theBuilder(4 * 1024 * 1024);
 
+        /** wakes everyone waiting on the commit that is in progress (the data is in the journal)
+            and records how many writers that commit acknowledged.
+        */
+        static void notifyCommitted() {
+            const unsigned nWaiting = commitJob._notify.nWaiting();
+            if (nWaiting) {
+                stats.curr->_commitsWithWaiters++;
+                stats.curr->_waitersNotified += nWaiting;
+                groupCommitWakeStats.commitsWithWaiters.fetchAndAdd(1);
+            }
+            groupCommitWakeStats.lastNotifiedMicros.store(curTimeMicros64());
+            commitJob.committingNotifyCommitted();
+        }
+
 
         static void _groupCommit() {
             LOG(4) << "_groupCommit " << endl;
@@ -492,7 +566,7 @@ namespace mongo {
 
                 if( !commitJob.hasWritten() ) {
                     // getlasterror request could have came after the data was already committed
-                    commitJob.committingNotifyCommitted();
+                    notifyCommitted();
                 }
                 else {
                     JSectHeader h;
@@ -505,7 +579,7 @@ namespace mongo {
 
                     // data is now in the journal, which is sufficient for acknowledging getLastError.
                     // (ok to crash after that)
-                    commitJob.committingNotifyCommitted();
+                    notifyCommitted();
 
                     WRITETODATAFILES(h, ab);
                     debugValidateAllMapsMatch();
@@ -633,20 +707,30 @@ namespace mongo {
                 try {
                     stats.rotate();
 
-                    boost::mutex::scoped_lock lock(flushMutex);
+                    {
+                        boost::mutex::scoped_lock lock(flushMutex);
+
+                        // commit sooner if one or more getLastError j:true is pending
+                        for (unsigned i = 0; i <= 2; i++) {
+                            // in group commit mode writers that arrived while we were
+                            // committing go out in the next commit immediately
+                            if (groupCommitRequested)
+                                break;
+
+                            if (flushRequested.timed_wait(lock,
+                                                          Milliseconds(oneThird))) {
+                                // Someone forced a flush
+                                break;
+                            }
 
-                    // commit sooner if one or more getLastError j:true is pending
-                    for (unsigned i = 0; i <= 2; i++) {
-                        if (flushRequested.timed_wait(lock,
-                                                      Milliseconds(oneThird))) {
-                            // Someone forced a flush
-                            break;
+                            if (commitJob._notify.nWaiting())
+                                break;
+                            if (commitJob.bytes() > UncommittedBytesLimit / 2)
+                                break;
                         }
 
-                        if (commitJob._notify.nWaiting())
-                            break;
-                        if (commitJob.bytes() > UncommittedBytesLimit / 2)
-                            break;
+                        // requests made from here on are served by the commit after this one
+                        groupCommitRequested = false;
                     }
 
                     OperationContextImpl txn;
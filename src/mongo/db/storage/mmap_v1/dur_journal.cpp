@@ -37,6 +37,7 @@
 #include <boost/static_assert.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <vector>
 
 #include "mongo/base/init.h"
 #include "mongo/db/client.h"
@@ -49,6 +50,7 @@
 #include "mongo/util/alignedbuilder.h"
 #include "mongo/util/checksum.h"
 #include "mongo/util/compress.h"
+#include "mongo/util/concurrency/thread_pool.h"
 #include "mongo/util/file.h"
 #include "mongo/util/hex.h"
 #include "mongo/util/log.h"
@@ -95,6 +97,7 @@ namespace mongo {
         BOOST_STATIC_ASSERT( sizeof(JSectHeader) == 20 );
         BOOST_STATIC_ASSERT( sizeof(JSectFooter) == 32 );
         BOOST_STATIC_ASSERT( sizeof(JEntry) == 12 );
+        BOOST_STATIC_ASSERT( sizeof(JFrameHeader) == 8 );
         BOOST_STATIC_ASSERT( sizeof(LSNFile) == 88 );
 
         bool usingPreallocate = false;
@@ -165,7 +168,16 @@ namespace mongo {
 
         JHeader::JHeader(string fname) {
             magic[0] = 'j'; magic[1] = '\n';
-            _version = CurrentVersion;
+            if (storageGlobalParams.journalCompressor == "none") {
+                compressor = Compressor_None;
+            }
+            else if (storageGlobalParams.journalCompressor == "snappyFramed") {
+                compressor = Compressor_SnappyFramed;
+            }
+            else {
+                compressor = Compressor_Snappy;
+            }
+            _version = compressor == Compressor_Snappy ? CurrentVersion : CompressorVersion;
             memset(ts, 0, sizeof(ts));
             time_t t = time(0);
             strncpy(ts, time_t_to_String_short(t).c_str(), sizeof(ts)-1);
@@ -190,6 +202,7 @@ namespace mongo {
             _nextFileNumber = 0;
             _curLogFile = 0;
             _curFileId = 0;
+            _curCompressor = JHeader::Compressor_Snappy;
             _preFlushTime = 0;
             _lastFlushTime = 0;
             _writeToLSNNeeded = false;
@@ -539,6 +552,7 @@ namespace mongo {
             {
                 JHeader h(fname.string());
                 _curFileId = h.fileId;
+                _curCompressor = h.getCompressor();
                 verify(_curFileId);
                 AlignedBuilder b(8192);
                 b.appendStruct(h);
@@ -717,6 +731,94 @@ namespace mongo {
             }
         }
 
+        namespace {
+            // Compressor_SnappyFramed sections are cut into frames of this size. Sections bigger
+            // than one frame have their frames compressed concurrently.
+            const unsigned FrameSize = 1024 * 1024;
+            const int CompressorThreads = 3;
+
+            struct FrameJob {
+                const char* src;
+                size_t srcLen;
+                char* dst;       // room for maxCompressedLength(srcLen) bytes
+                size_t dstLen;   // set by compressFrame()
+            };
+
+            void compressFrame(FrameJob* job) {
+                rawCompress(job->src, job->srcLen, job->dst, &job->dstLen);
+            }
+
+            threadpool::ThreadPool& compressorPool() {
+                // only used from Journal::journal(), which the group commit mutex serializes
+                static threadpool::ThreadPool* pool =
+                    new threadpool::ThreadPool(CompressorThreads); // don't destroy
+                return *pool;
+            }
+
+            /** @return an upper bound on the encoded length of len bytes of section data */
+            unsigned maxEncodedLength(JHeader::Compressor compressor, unsigned len) {
+                switch (compressor) {
+                case JHeader::Compressor_None:
+                    return len;
+                case JHeader::Compressor_Snappy:
+                    return maxCompressedLength(len);
+                case JHeader::Compressor_SnappyFramed: {
+                    size_t max = 0;
+                    for (unsigned ofs = 0; ofs < len; ofs += FrameSize) {
+                        max += sizeof(JFrameHeader) + maxCompressedLength(min(FrameSize, len - ofs));
+                    }
+                    return max;
+                }
+                }
+                verify(false);
+                return 0;
+            }
+
+            /** appends a Compressor_SnappyFramed encoding of uncompressed to b. b must already have
+                room for maxEncodedLength() bytes.
+            */
+            void appendFrames(const AlignedBuilder& uncompressed, AlignedBuilder& b) {
+                const unsigned len = uncompressed.len();
+
+                // each frame is compressed to its own worst case position, then slid down to
+                // follow the previous frame.
+                std::vector<FrameJob> jobs;
+                char* p = b.cur();
+                for (unsigned ofs = 0; ofs < len; ofs += FrameSize) {
+                    FrameJob job;
+                    job.src = uncompressed.buf() + ofs;
+                    job.srcLen = min(FrameSize, len - ofs);
+                    job.dst = p + sizeof(JFrameHeader);
+                    job.dstLen = 0;
+                    jobs.push_back(job);
+                    p = job.dst + maxCompressedLength(job.srcLen);
+                }
+
+                for (size_t i = 1; i < jobs.size(); i++) {
+                    compressorPool().schedule(compressFrame, &jobs[i]);
+                }
+                if (!jobs.empty()) {
+                    compressFrame(&jobs[0]);
+                }
+                if (jobs.size() > 1) {
+                    compressorPool().join();
+                }
+
+                char* out = b.cur();
+                for (size_t i = 0; i < jobs.size(); i++) {
+                    verify( jobs[i].dstLen < 0xffffffff );
+                    JFrameHeader fh;
+                    fh.compressedLen = static_cast<unsigned>(jobs[i].dstLen);
+                    fh.uncompressedLen = static_cast<unsigned>(jobs[i].srcLen);
+                    memcpy(out, &fh, sizeof(fh));
+                    out += sizeof(fh);
+                    memmove(out, jobs[i].dst, jobs[i].dstLen);
+                    out += jobs[i].dstLen;
+                }
+                b.skip(out - b.cur());
+            }
+        }
+
         /** write (append) the buffer we have built to the journal and fsync it.
             outside of dbMutex lock as this could be slow.
             @param uncompressed - a buffer that will be written to the journal after compression
@@ -731,11 +833,11 @@ namespace mongo {
             static AlignedBuilder b(32*1024*1024);
             /* buffer to journal will be
                JSectHeader
-               compressed operations
+               operations, encoded as the current file's JHeader::compressor says
                JSectFooter
             */
             const unsigned headTailSize = sizeof(JSectHeader) + sizeof(JSectFooter);
-            const unsigned max = maxCompressedLength(uncompressed.len()) + headTailSize;
+            const unsigned max = maxEncodedLength(_curCompressor, uncompressed.len()) + headTailSize;
             b.reset(max);
 
             {
@@ -743,11 +845,23 @@ namespace mongo {
                 b.appendStruct(h);
             }
 
-            size_t compressedLength = 0;
-            rawCompress(uncompressed.buf(), uncompressed.len(), b.cur(), &compressedLength);
-            verify( compressedLength < 0xffffffff );
-            verify( compressedLength < max );
-            b.skip(compressedLength);
+            switch (_curCompressor) {
+            case JHeader::Compressor_None:
+                b.appendBuf(uncompressed.buf(), uncompressed.len());
+                break;
+            case JHeader::Compressor_Snappy: {
+                size_t compressedLength = 0;
+                rawCompress(uncompressed.buf(), uncompressed.len(), b.cur(), &compressedLength);
+                verify( compressedLength < 0xffffffff );
+                verify( compressedLength < max );
+                b.skip(compressedLength);
+                break;
+            }
+            case JHeader::Compressor_SnappyFramed:
+                appendFrames(uncompressed, b);
+                break;
+            }
+            verify( b.len() <= max - sizeof(JSectFooter) );
 
             // footer
             unsigned L = 0xffffffff;
@@ -58,6 +58,10 @@ namespace mongo {
 #else
             enum { CurrentVersion = 0x4149 };
 #endif
+            // files whose 'compressor' says how their sections are encoded.  only written when
+            // journalCompressor isn't "snappy", so that journals written with default settings can
+            // still be recovered by older versions.  CurrentVersion files are Compressor_Snappy.
+            enum { CompressorVersion = 0x414a };
             unsigned short _version;
 
             // these are just for diagnostic ease (make header more useful as plain text)
@@ -69,10 +73,24 @@ namespace mongo {
 
             unsigned long long fileId; // unique identifier that will be in each JSectHeader. important as we recycle prealloced files
 
-            char reserved3[8026]; // 8KB total for the file header
+            /** how the data between each JSectHeader and JSectFooter in this file is encoded */
+            enum Compressor {
+                Compressor_Snappy       = 0, // a single snappy block
+                Compressor_None         = 1, // not compressed
+                Compressor_SnappyFramed = 2  // a series of JFrameHeader + snappy block, see JFrameHeader
+            };
+            unsigned char compressor;
+
+            char reserved3[8025]; // 8KB total for the file header
             char txt2[2];         // "\n\n" at the end
 
-            bool versionOk() const { return _version == CurrentVersion; }
+            bool versionOk() const {
+                return _version == CurrentVersion || _version == CompressorVersion;
+            }
+            Compressor getCompressor() const {
+                return _version == CompressorVersion ? static_cast<Compressor>(compressor)
+                                                     : Compressor_Snappy;
+            }
             bool valid() const { return magic[0] == 'j' && txt2[1] == '\n' && fileId; }
         };
 
@@ -99,6 +117,15 @@ namespace mongo {
             }
         };
 
+        /** precedes each block of a Compressor_SnappyFramed section. frames are compressed
+            independently of each other so that the frames of a large section can be compressed
+            concurrently.
+        */
+        struct JFrameHeader {
+            unsigned compressedLen;   // length of the snappy block that follows
+            unsigned uncompressedLen;
+        };
+
         /** an individual write operation within a group commit section.  Either the entire section should
             be applied, or nothing.  (We check the md5 for the whole section before doing anything on recovery.)
         */
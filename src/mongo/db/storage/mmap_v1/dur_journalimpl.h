@@ -90,6 +90,7 @@ namespace mongo {
 
             LogFile *_curLogFile; // use _curLogFileMutex
             unsigned long long _curFileId; // current file id see JHeader::fileId
+            JHeader::Compressor _curCompressor; // JHeader::compressor of the current file
 
             struct JFile {
                 std::string filename;
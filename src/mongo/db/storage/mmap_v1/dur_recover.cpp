@@ -43,6 +43,7 @@
 #include "mongo/db/catalog/database.h"
 #include "mongo/db/db.h"
 #include "mongo/db/operation_context_impl.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/storage/storage_engine.h"
 #include "mongo/db/storage/mmap_v1/catalog/namespace.h"
 #include "mongo/db/storage/mmap_v1/dur.h"
@@ -56,9 +57,11 @@
 #include "mongo/util/bufreader.h"
 #include "mongo/util/checksum.h"
 #include "mongo/util/compress.h"
+#include "mongo/util/concurrency/thread_pool.h"
 #include "mongo/util/log.h"
 #include "mongo/util/mongoutils/str.h"
 #include "mongo/util/startup_test.h"
+#include "mongo/util/timer.h"
 
 using namespace mongoutils;
 
@@ -75,6 +78,31 @@ namespace mongo {
 
     namespace dur {
 
+        // Number of threads applying the basic writes of a section during recovery. 1 (the
+        // default) applies everything on the recovering thread.
+        int journalRecoveryThreads = 1;
+        const int kMaxJournalRecoveryThreads = 64;
+
+        class JournalRecoveryThreadsParameter : public ExportedServerParameter<int> {
+        public:
+            JournalRecoveryThreadsParameter() :
+                ExportedServerParameter<int>(ServerParameterSet::getGlobal(),
+                                             "journalRecoveryThreads",
+                                             &journalRecoveryThreads,
+                                             true,   // allowedToChangeAtStartup
+                                             false)  // allowedToChangeAtRuntime
+            {}
+
+            virtual Status validate(const int& potentialNewValue) {
+                if (potentialNewValue < 1 || potentialNewValue > kMaxJournalRecoveryThreads) {
+                    return Status(ErrorCodes::BadValue,
+                                  str::stream() << "journalRecoveryThreads must be between 1 and "
+                                                << kMaxJournalRecoveryThreads);
+                }
+                return Status::OK();
+            }
+        } journalRecoveryThreadsParameter;
+
         struct ParsedJournalEntry { /*copyable*/
             ParsedJournalEntry() : e(0) { }
 
@@ -118,6 +146,41 @@ namespace mongo {
             }
         }
 
+        /** decodes a JHeader::Compressor_SnappyFramed section
+            @return false if the frames are malformed
+        */
+        static bool uncompressFrames(const char *p, unsigned len, string *out) {
+            // first pass checks the frame headers and sizes the output
+            size_t total = 0;
+            for( unsigned ofs = 0; ofs < len; ) {
+                if( len - ofs < sizeof(JFrameHeader) )
+                    return false;
+                JFrameHeader fh;
+                memcpy(&fh, p + ofs, sizeof(fh));
+                ofs += sizeof(fh);
+                if( fh.compressedLen > len - ofs )
+                    return false;
+                size_t n;
+                if( !getUncompressedLength(p + ofs, fh.compressedLen, &n) || n != fh.uncompressedLen )
+                    return false;
+                ofs += fh.compressedLen;
+                total += fh.uncompressedLen;
+            }
+
+            out->resize(total);
+            char *dst = &(*out)[0];
+            for( unsigned ofs = 0; ofs < len; ) {
+                JFrameHeader fh;
+                memcpy(&fh, p + ofs, sizeof(fh));
+                ofs += sizeof(fh);
+                if( !rawUncompress(p + ofs, fh.compressedLen, dst) )
+                    return false;
+                ofs += fh.compressedLen;
+                dst += fh.uncompressedLen;
+            }
+            return true;
+        }
+
         /** read through the memory mapped data of a journal file (journal/j._<n> file)
             throws
         */
@@ -128,13 +191,22 @@ namespace mongo {
             const bool _doDurOps;
             string _uncompressed;
         public:
-            JournalSectionIterator(const JSectHeader& h, const void *compressed, unsigned compressedLen, bool doDurOpsRecovering) :
+            JournalSectionIterator(const JSectHeader& h, JHeader::Compressor compressor, const void *compressed, unsigned compressedLen, bool doDurOpsRecovering) :
                 _h(h),
                 _lastDbName(0)
                 , _doDurOps(doDurOpsRecovering)
             {
                 verify( doDurOpsRecovering );
-                bool ok = uncompress((const char *)compressed, compressedLen, &_uncompressed);
+                verify( compressedLen == _h.sectionLen() - sizeof(JSectFooter) - sizeof(JSectHeader) );
+
+                if( compressor == JHeader::Compressor_None ) {
+                    _entries = auto_ptr<BufReader>( new BufReader(compressed, compressedLen) );
+                    return;
+                }
+
+                bool ok = compressor == JHeader::Compressor_SnappyFramed ?
+                    uncompressFrames((const char *)compressed, compressedLen, &_uncompressed) :
+                    uncompress((const char *)compressed, compressedLen, &_uncompressed);
                 if( !ok ) { 
                     // We check the checksum before we uncompress, but this may still fail as the
                     // checksum isn't foolproof.
@@ -142,7 +214,6 @@ namespace mongo {
                     throw JournalSectionCorruptException();
                 }
                 const char *p = _uncompressed.c_str();
-                verify( compressedLen == _h.sectionLen() - sizeof(JSectFooter) - sizeof(JSectHeader) );
                 _entries = auto_ptr<BufReader>( new BufReader(p, _uncompressed.size()) );
             }
 
@@ -367,6 +438,111 @@ namespace mongo {
             return mmf;
         }
 
+        namespace {
+            // During recovery the basic writes of a section are partitioned by the chunk of
+            // mapped memory they start in. The writes of one chunk are applied in journal order
+            // by a single worker, so overlapping writes keep their order, while writes to
+            // different chunks are applied concurrently.
+            const unsigned ChunkShift = 20; // 1MB
+
+            // below this many bytes it's cheaper to apply the writes on the recovering thread
+            const size_t MinParallelBytes = 256 * 1024;
+
+            struct PendingWrite {
+                char *dest;
+                const char *src;
+                unsigned len;
+            };
+            typedef vector<PendingWrite> PendingWrites;
+
+            void applyPendingWrites(PendingWrites *writes) {
+                for( PendingWrites::const_iterator i = writes->begin(); i != writes->end(); ++i ) {
+                    memcpy(i->dest, i->src, i->len);
+                }
+            }
+
+            threadpool::ThreadPool& recoveryPool() {
+                // only used by the recovering thread
+                static threadpool::ThreadPool* pool =
+                    new threadpool::ThreadPool(journalRecoveryThreads - 1); // don't destroy
+                return *pool;
+            }
+
+            /** applies and clears the pending writes of every partition */
+            void flushPendingWrites(vector<PendingWrites> &partitions, size_t &pendingBytes) {
+                if( pendingBytes >= MinParallelBytes ) {
+                    for( size_t i = 1; i < partitions.size(); i++ ) {
+                        if( !partitions[i].empty() )
+                            recoveryPool().schedule(applyPendingWrites, &partitions[i]);
+                    }
+                    applyPendingWrites(&partitions[0]);
+                    recoveryPool().join();
+                }
+                else {
+                    for( size_t i = 0; i < partitions.size(); i++ )
+                        applyPendingWrites(&partitions[i]);
+                }
+
+                for( size_t i = 0; i < partitions.size(); i++ )
+                    partitions[i].clear();
+                stats.curr->_writeToDataFilesBytes += pendingBytes;
+                pendingBytes = 0;
+            }
+        }
+
+        /** the same as calling applyEntry() on each entry with apply set, but with basic writes
+            spread over the journalRecoveryThreads. DurOps are applied once all the writes before
+            them are done.
+        */
+        void RecoveryJob::applyEntriesInParallel(Last& last, const vector<ParsedJournalEntry> &entries) {
+            verify( _recovering );
+
+            static vector<PendingWrites> partitions;
+            partitions.resize(journalRecoveryThreads);
+            size_t pendingBytes = 0;
+
+            for( vector<ParsedJournalEntry>::const_iterator i = entries.begin(); i != entries.end(); ++i ) {
+                if( !i->e ) {
+                    flushPendingWrites(partitions, pendingBytes);
+                    applyEntry(last, *i, true, false);
+                    continue;
+                }
+
+                verify(i->dbName);
+                verify((size_t)strnlen(i->dbName, MaxDatabaseNameLen) < MaxDatabaseNameLen);
+
+                DurableMappedFile *mmf = last.newEntry(*i, *this);
+                if( (i->e->ofs + i->e->len) > mmf->length() ) {
+                    // as in write(), ok while recovering
+                    continue;
+                }
+                verify(mmf->view_write());
+                verify(i->e->srcData());
+
+                PendingWrite w;
+                w.dest = (char*)mmf->view_write() + i->e->ofs;
+                w.src = i->e->srcData();
+                w.len = i->e->len;
+                if( w.len == 0 )
+                    continue;
+
+                const size_t firstChunk = reinterpret_cast<size_t>(w.dest) >> ChunkShift;
+                const size_t lastChunk = reinterpret_cast<size_t>(w.dest + w.len - 1) >> ChunkShift;
+                if( firstChunk != lastChunk ) {
+                    // could overlap writes queued for either chunk
+                    flushPendingWrites(partitions, pendingBytes);
+                    memcpy(w.dest, w.src, w.len);
+                    stats.curr->_writeToDataFilesBytes += w.len;
+                    continue;
+                }
+
+                partitions[firstChunk % partitions.size()].push_back(w);
+                pendingBytes += w.len;
+            }
+
+            flushPendingWrites(partitions, pendingBytes);
+        }
+
         void RecoveryJob::applyEntries(const vector<ParsedJournalEntry> &entries) {
             bool apply = (storageGlobalParams.durOptions &
                           StorageGlobalParams::DurScanOnly) == 0;
@@ -376,8 +552,13 @@ namespace mongo {
                 log() << "BEGIN section" << endl;
 
             Last last;
-            for( vector<ParsedJournalEntry>::const_iterator i = entries.begin(); i != entries.end(); ++i ) {
-                applyEntry(last, *i, apply, dump);
+            if( _recovering && apply && !dump && journalRecoveryThreads > 1 ) {
+                applyEntriesInParallel(last, entries);
+            }
+            else {
+                for( vector<ParsedJournalEntry>::const_iterator i = entries.begin(); i != entries.end(); ++i ) {
+                    applyEntry(last, *i, apply, dump);
+                }
             }
 
             if( dump )
@@ -413,7 +594,7 @@ namespace mongo {
 
             auto_ptr<JournalSectionIterator> i;
             if( _recovering ) {
-                i = auto_ptr<JournalSectionIterator>(new JournalSectionIterator(*h, p, len, _recovering));
+                i = auto_ptr<JournalSectionIterator>(new JournalSectionIterator(*h, _compressor, p, len, _recovering));
             }
             else { 
                 i = auto_ptr<JournalSectionIterator>(new JournalSectionIterator(*h, /*after header*/p, /*w/out header*/len));
@@ -473,10 +654,23 @@ namespace mongo {
                         // journal files on upgrade.
                         uasserted(13536, str::stream() << "journal version number mismatch " << h._version);
                     }
+                    switch( h.getCompressor() ) {
+                    case JHeader::Compressor_Snappy:
+                    case JHeader::Compressor_None:
+                    case JHeader::Compressor_SnappyFramed:
+                        break;
+                    default:
+                        // Not using JournalSectionCurruptException, as with the version check.
+                        uasserted(18903, str::stream() << "unknown journal compressor "
+                                                       << (unsigned) h.compressor);
+                    }
+                    _compressor = h.getCompressor();
+
                     fileId = h.fileId;
                     if (storageGlobalParams.durOptions &
                         StorageGlobalParams::DurDumpJournal) {
-                        log() << "JHeader::fileId=" << fileId << endl;
+                        log() << "JHeader::fileId=" << fileId
+                              << " compressor=" << (unsigned) _compressor << endl;
                     }
                 }
 
@@ -498,6 +692,7 @@ namespace mongo {
                     const char *data = hdr + sizeof(JSectHeader);
                     const char *footer = data + dataLen;
                     processSection((const JSectHeader*) hdr, data, dataLen, (const JSectFooter*) footer);
+                    _progress.hit(h.sectionLenWithPadding());
 
                     // ctrl c check
                     uassert(ErrorCodes::Interrupted, "interrupted during journal recovery", !inShutdown());
@@ -547,6 +742,20 @@ namespace mongo {
             _lastDataSyncedFromLastRun = journalReadLSN();
             log() << "recover lsn: " << _lastDataSyncedFromLastRun << endl;
 
+            unsigned long long totalBytes = 0;
+            for( unsigned i = 0; i != files.size(); ++i ) {
+                try {
+                    totalBytes += boost::filesystem::file_size(files[i]);
+                }
+                catch(...) {
+                    // processFile() reports problems with the file
+                }
+            }
+            _progress.reset(totalBytes, 3, 1);
+            _progress.setName("recover");
+            _progress.setUnits("journal bytes");
+            Timer t;
+
             for( unsigned i = 0; i != files.size(); ++i ) {
                 bool abruptEnd = processFile(files[i]);
                 if( abruptEnd && i+1 < files.size() ) {
@@ -557,6 +766,9 @@ namespace mongo {
             }
 
             close();
+            _progress.finished();
+            log() << "recover applied " << _progress.done() / (1024 * 1024) << "MB of journal in "
+                  << t.millis() << "ms using " << journalRecoveryThreads << " thread(s)" << endl;
 
             if (storageGlobalParams.durOptions & StorageGlobalParams::DurScanOnly) {
                 uasserted(13545, str::stream() << "--durOptions "
@@ -36,6 +36,7 @@
 #include "mongo/db/storage/mmap_v1/dur_journalformat.h"
 #include "mongo/util/concurrency/mutex.h"
 #include "mongo/util/file.h"
+#include "mongo/util/progress_meter.h"
 
 namespace mongo {
     class DurableMappedFile;
@@ -57,7 +58,7 @@ namespace mongo {
             } last;        
         public:
             RecoveryJob() : _lastDataSyncedFromLastRun(0), 
-                _mx("recovery"), _recovering(false) { _lastSeqMentionedInConsoleLog = 1; }
+                _mx("recovery"), _recovering(false), _compressor(JHeader::Compressor_Snappy) { _lastSeqMentionedInConsoleLog = 1; }
             void go(std::vector<boost::filesystem::path>& files);
             ~RecoveryJob();
 
@@ -71,6 +72,7 @@ namespace mongo {
             void write(Last& last, const ParsedJournalEntry& entry); // actually writes to the file
             void applyEntry(Last& last, const ParsedJournalEntry& entry, bool apply, bool dump);
             void applyEntries(const std::vector<ParsedJournalEntry> &entries);
+            void applyEntriesInParallel(Last& last, const std::vector<ParsedJournalEntry> &entries);
             bool processFileBuffer(const void *, unsigned len);
             bool processFile(boost::filesystem::path journalfile);
             void _close(); // doesn't lock
@@ -84,6 +86,8 @@ namespace mongo {
             mongo::mutex _mx; // protects _mmfs
         private:
             bool _recovering; // are we in recovery or WRITETODATAFILES
+            JHeader::Compressor _compressor; // of the journal file being recovered
+            ProgressMeter _progress; // journal bytes processed, while recovering
 
             static RecoveryJob &_instance;
         };
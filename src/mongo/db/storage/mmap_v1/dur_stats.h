@@ -63,6 +63,12 @@ namespace mongo {
                 // - data being written faster than the normal group commit interval
                 unsigned _commitsInWriteLock;
 
+                // commits which acknowledged at least one waiting writer, and the total number of
+                // writers they acknowledged.  _waitersNotified / _commitsWithWaiters is the
+                // average group commit batch size.
+                unsigned _commitsWithWaiters;
+                unsigned _waitersNotified;
+
                 int _dtMillis;
             };
             S *curr;
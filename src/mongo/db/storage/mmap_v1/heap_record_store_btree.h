@@ -66,6 +66,8 @@ namespace mongo {
 
         virtual Status touch(OperationContext* txn, BSONObjBuilder* output) const;
 
+        virtual void prefetch(OperationContext* txn, const std::vector<DiskLoc>& locs) const {}
+
         typedef std::map<DiskLoc, HeapRecordStoreBtree::Record> Records;
 
         // public methods below here are not necessary to test btree, and will crash when called.
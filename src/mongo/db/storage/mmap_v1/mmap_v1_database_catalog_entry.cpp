@@ -609,6 +609,10 @@ namespace mongo {
             else if ( newCollectionsUsePowerOf2Sizes ) {
                 md.setUserFlag( txn, NamespaceDetails::Flag_UsePowerOf2Sizes );
             }
+
+            if ( options.compressRecords ) {
+                md.setUserFlag( txn, NamespaceDetails::Flag_CompressRecords );
+            }
         }
         else if ( options.cappedMaxDocs > 0 ) {
             txn->recoveryUnit()->writingInt( _namespaceIndex.details( ns )->maxDocsInCapped ) =
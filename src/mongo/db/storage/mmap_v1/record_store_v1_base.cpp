@@ -30,20 +30,58 @@
 
 #include "mongo/db/storage/mmap_v1/record_store_v1_base.h"
 
+#include "mongo/base/counter.h"
+#include "mongo/base/data_view.h"
 #include "mongo/db/catalog/collection.h"
+#include "mongo/db/commands/server_status_metric.h"
 #include "mongo/db/concurrency/lock_mgr.h"
 #include "mongo/db/operation_context.h"
 #include "mongo/db/storage/mmap_v1/extent.h"
 #include "mongo/db/storage/mmap_v1/extent_manager.h"
 #include "mongo/db/storage/mmap_v1/record.h"
 #include "mongo/db/storage/mmap_v1/record_store_v1_repair_iterator.h"
+#include "mongo/util/compress.h"
 #include "mongo/util/log.h"
+#include "mongo/util/mmap.h"
+#include "mongo/util/processinfo.h"
 #include "mongo/util/progress_meter.h"
 #include "mongo/util/timer.h"
 #include "mongo/util/touch_pages.h"
 
 namespace mongo {
 
+    // Records prefetch() found already in memory, or had to ask the OS for.
+    static Counter64 prefetchResident;
+    static Counter64 prefetchNotResident;
+
+    static ServerStatusMetricField<Counter64> dPrefetch1( "storage.mmapv1.prefetch.resident",
+                                                          &prefetchResident );
+    static ServerStatusMetricField<Counter64> dPrefetch2( "storage.mmapv1.prefetch.notResident",
+                                                          &prefetchNotResident );
+
+    namespace {
+
+        /**
+         * Builds what is stored for 'data' in a record store with Flag_CompressRecords set.
+         */
+        void compressRecord( const char* data, int len, std::string* out ) {
+            out->resize( sizeof(int) + maxCompressedLength( len ) );
+            size_t compressedLen;
+            rawCompress( data, len, &(*out)[sizeof(int)], &compressedLen );
+
+            if ( compressedLen < static_cast<size_t>( len ) ) {
+                out->resize( sizeof(int) + compressedLen );
+                DataView( &(*out)[0] ).writeLE<int>( compressedLen );
+            }
+            else {
+                out->resize( sizeof(int) + len );
+                DataView( &(*out)[0] ).writeLE<int>( -len );
+                memcpy( &(*out)[sizeof(int)], data, len );
+            }
+        }
+
+    }
+
     const int RecordStoreV1Base::Buckets = 19;
     const int RecordStoreV1Base::MaxBucket = 18;
 
@@ -105,7 +143,35 @@ namespace mongo {
     }
 
     RecordData RecordStoreV1Base::dataFor( OperationContext* txn, const DiskLoc& loc ) const {
-        return recordFor(loc)->toRecordData();
+        const Record* r = recordFor(loc);
+        if ( !_compressRecords() )
+            return r->toRecordData();
+
+        const char* stored = r->data();
+        const int storedLen = ConstDataView( stored ).readLE<int>();
+        if ( storedLen < 0 )
+            return RecordData( stored + sizeof(int), -storedLen );
+
+        size_t len = 0;
+        bool ok = storedLen <= r->netLength() - static_cast<int>( sizeof(int) ) &&
+            getUncompressedLength( stored + sizeof(int), storedLen, &len );
+        boost::shared_array<char> buf( new char[len] );
+        ok = ok && rawUncompress( stored + sizeof(int), storedLen, buf.get() );
+        massert( 18905,
+                 str::stream() << "corrupt compressed record " << loc.toString() << " in " << _ns,
+                 ok );
+        return RecordData( buf.get(), len, buf );
+    }
+
+    bool RecordStoreV1Base::_compressRecords() const {
+        return _details->isUserFlagSet( Flag_CompressRecords );
+    }
+
+    int RecordStoreV1Base::_storedDataSize( const Record* r ) const {
+        if ( !_compressRecords() )
+            return r->netLength();
+        const int storedLen = ConstDataView( r->data() ).readLE<int>();
+        return sizeof(int) + ( storedLen < 0 ? -storedLen : storedLen );
     }
 
     Record* RecordStoreV1Base::recordFor( const DiskLoc& loc ) const {
@@ -221,6 +287,19 @@ namespace mongo {
     StatusWith<DiskLoc> RecordStoreV1Base::insertRecord( OperationContext* txn,
                                                          const DocWriter* doc,
                                                          bool enforceQuota ) {
+        if ( _compressRecords() ) {
+            // the writer needs the whole document in hand to compress it
+            boost::scoped_array<char> buf( new char[doc->documentSize()] );
+            doc->writeDocument( buf.get() );
+            return insertRecord( txn, buf.get(), doc->documentSize(), enforceQuota );
+        }
+
+        return _insertRecord( txn, doc, enforceQuota );
+    }
+
+    StatusWith<DiskLoc> RecordStoreV1Base::_insertRecord( OperationContext* txn,
+                                                          const DocWriter* doc,
+                                                          bool enforceQuota ) {
         int docSize = doc->documentSize();
         if ( docSize < 4 ) {
             return StatusWith<DiskLoc>( ErrorCodes::InvalidLength,
@@ -259,6 +338,13 @@ namespace mongo {
                                         "record has to be >= 4 bytes" );
         }
 
+        std::string stored;
+        if ( _compressRecords() ) {
+            compressRecord( data, len, &stored );
+            data = stored.data();
+            len = stored.size();
+        }
+
         StatusWith<DiskLoc> status = _insertRecord( txn, data, len, enforceQuota );
         if ( status.isOK() )
             _paddingFits( txn );
@@ -298,6 +384,13 @@ namespace mongo {
                                                          int dataSize,
                                                          bool enforceQuota,
                                                          UpdateMoveNotifier* notifier ) {
+        std::string stored;
+        if ( _compressRecords() ) {
+            compressRecord( data, dataSize, &stored );
+            data = stored.data();
+            dataSize = stored.size();
+        }
+
         Record* oldRecord = recordFor( oldLocation );
         if ( oldRecord->netLength() >= dataSize ) {
             // we fit
@@ -321,10 +414,11 @@ namespace mongo {
 
         // insert worked, so we delete old record
         if ( notifier ) {
+            RecordData oldData = dataFor( txn, oldLocation );
             Status moveStatus = notifier->recordStoreGoingToMove( txn,
                                                                   oldLocation,
-                                                                  oldRecord->data(),
-                                                                  oldRecord->netLength() );
+                                                                  oldData.data(),
+                                                                  oldData.size() );
             if ( !moveStatus.isOK() )
                 return StatusWith<DiskLoc>( moveStatus );
         }
@@ -339,6 +433,7 @@ namespace mongo {
                                                  const DiskLoc& loc,
                                                  const char* damageSource,
                                                  const mutablebson::DamageVector& damages ) {
+        invariant( updateWithDamagesSupported() );
         _paddingFits( txn );
 
         Record* rec = recordFor( loc );
@@ -356,6 +451,11 @@ namespace mongo {
         return Status::OK();
     }
 
+    bool RecordStoreV1Base::updateWithDamagesSupported() const {
+        // the damages are relative to the uncompressed document
+        return !_compressRecords();
+    }
+
     void RecordStoreV1Base::deleteRecord( OperationContext* txn, const DiskLoc& dl ) {
 
         Record* todelete = recordFor( dl );
@@ -675,7 +775,13 @@ namespace mongo {
 
                     if (full){
                         size_t dataSize = 0;
-                        const Status status = adaptor->validate( r->toRecordData(), &dataSize );
+                        Status status = Status::OK();
+                        try {
+                            status = adaptor->validate( dataFor( txn, cl ), &dataSize );
+                        }
+                        catch ( const DBException& e ) {
+                            status = e.toStatus();
+                        }
                         if (!status.isOK()) {
                             results->valid = false;
                             if (nInvalid == 0) // only log once;
@@ -791,6 +897,8 @@ namespace mongo {
         result->append( "lastExtentSize", _details->lastExtentSize(txn) / scale );
         result->append( "paddingFactor", _details->paddingFactor() );
         result->append( "userFlags", _details->userFlags() );
+        if ( _compressRecords() )
+            result->appendBool( "compressRecords", true );
 
         if ( isCapped() ) {
             result->appendBool( "capped", true );
@@ -847,6 +955,25 @@ namespace mongo {
         return Status::OK();
     }
 
+    void RecordStoreV1Base::prefetch( OperationContext* txn,
+                                      const std::vector<DiskLoc>& locs ) const {
+        if ( !ProcessInfo::blockCheckSupported() )
+            return;
+
+        for ( std::vector<DiskLoc>::const_iterator it = locs.begin(); it != locs.end(); ++it ) {
+            // Don't read the record header, that would fault in the page we are trying not to
+            // wait for.  Readahead will usually bring in the rest of a large record.
+            char* start = reinterpret_cast<char*>( recordFor( *it ) );
+            if ( ProcessInfo::blockInMemory( start ) ) {
+                prefetchResident.increment();
+                continue;
+            }
+
+            prefetchNotResident.increment();
+            MAdvise::willNeed( start, 1 );
+        }
+    }
+
     int RecordStoreV1Base::getRecordAllocationSize( int minRecordSize ) const {
 
         if ( isCapped() )
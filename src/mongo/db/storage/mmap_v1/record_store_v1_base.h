@@ -106,7 +106,8 @@ namespace mongo {
         static const int bucketSizes[];
 
         enum UserFlags {
-            Flag_UsePowerOf2Sizes = 1 << 0
+            Flag_UsePowerOf2Sizes = 1 << 0,
+            Flag_CompressRecords = 1 << 1
         };
 
         // ------------
@@ -157,6 +158,8 @@ namespace mongo {
                                           const char* damangeSource,
                                           const mutablebson::DamageVector& damages );
 
+        virtual bool updateWithDamagesSupported() const;
+
         virtual RecordIterator* getIteratorForRepair( OperationContext* txn ) const;
 
         void increaseStorageSize( OperationContext* txn, int size, bool enforceQuota );
@@ -172,6 +175,8 @@ namespace mongo {
 
         virtual Status touch( OperationContext* txn, BSONObjBuilder* output ) const;
 
+        virtual void prefetch( OperationContext* txn, const std::vector<DiskLoc>& locs ) const;
+
         const RecordStoreV1MetaData* details() const { return _details.get(); }
 
         /**
@@ -258,6 +263,27 @@ namespace mongo {
                                            int len,
                                            bool enforceQuota );
 
+        /**
+         * internal
+         * writes the document as is, even if records are compressed
+         */
+        StatusWith<DiskLoc> _insertRecord( OperationContext* txn,
+                                           const DocWriter* doc,
+                                           bool enforceQuota );
+
+        /**
+         * With Flag_CompressRecords set, the data of every record starts with an int.  If it is
+         * positive, that many bytes of snappy compressed data follow.  If it is negative, minus
+         * that many bytes follow uncompressed, as compressing didn't make them any smaller.
+         */
+        bool _compressRecords() const;
+
+        /**
+         * @return how many bytes at the start of the record's data are in use, which for
+         *         uncompressed records is all of it
+         */
+        int _storedDataSize( const Record* r ) const;
+
         scoped_ptr<RecordStoreV1MetaData> _details;
         ExtentManager* _extentManager;
         bool _isSystemIndexes;
@@ -38,6 +38,7 @@
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/curop.h"
 #include "mongo/db/commands/server_status_metric.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/storage/mmap_v1/extent.h"
 #include "mongo/db/storage/mmap_v1/extent_manager.h"
 #include "mongo/db/storage/mmap_v1/record.h"
@@ -63,6 +64,25 @@ namespace mongo {
     static ServerStatusMetricField<Counter64> dFreelist3( "storage.freelist.search.scanned",
                                                           &freelistIterations );
 
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(useDeletedRecordIndex, bool, false);
+
+    namespace {
+        /**
+         * The DeletedRecordIndex mirrors writes to the deleted lists that may be rolled back, so
+         * on rollback it is discarded and rebuilt from the on-disk lists when next needed.
+         */
+        class ClearDeletedRecordIndexOnRollback : public RecoveryUnit::Change {
+        public:
+            explicit ClearDeletedRecordIndexOnRollback( DeletedRecordIndex* index )
+                : _index( index ) {
+            }
+            virtual void commit() {}
+            virtual void rollback() { _index->clear(); }
+        private:
+            DeletedRecordIndex* _index;
+        };
+    }
+
     SimpleRecordStoreV1::SimpleRecordStoreV1( OperationContext* txn,
                                               const StringData& ns,
                                               RecordStoreV1MetaData* details,
@@ -72,6 +92,10 @@ namespace mongo {
 
         invariant( !details->isCapped() );
         _normalCollection = NamespaceString::normal( ns );
+
+        // system.indexes never reuses deleted space, so has nothing to index
+        if ( useDeletedRecordIndex && !isSystemIndexes )
+            _deletedRecordIndex.reset( new DeletedRecordIndex() );
         if ( _details->paddingFactor() == 0 ) {
             warning() << "implicit updgrade of paddingFactor of very old collection" << endl;
             WriteUnitOfWork wunit(txn);
@@ -91,7 +115,10 @@ namespace mongo {
 
         freelistAllocs.increment();
         DiskLoc loc;
-        {
+        if ( _deletedRecordIndex ) {
+            loc = _unlinkBestFitDeletedRecord( txn, lenToAlloc );
+        }
+        else {
             DiskLoc *prev = 0;
             DiskLoc *bestprev = 0;
             DiskLoc bestmatch;
@@ -226,6 +253,64 @@ namespace mongo {
         return loc;
     }
 
+    DiskLoc SimpleRecordStoreV1::_unlinkBestFitDeletedRecord( OperationContext* txn,
+                                                              int lenToAlloc ) {
+        if ( !_deletedRecordIndex->isBuilt() )
+            _buildDeletedRecordIndex();
+
+        freelistIterations.increment();
+        const DiskLoc loc = _deletedRecordIndex->bestFit( lenToAlloc );
+        if ( loc.isNull() )
+            return loc;
+
+        DeletedRecord* d = drec(loc);
+        const DiskLoc prev = _deletedRecordIndex->prev(loc);
+        const DiskLoc next = d->nextDeleted();
+        if ( prev.isNull() ) {
+            int b = bucket(d->lengthWithHeaders());
+            invariant( _details->deletedListEntry(b) == loc );
+            _details->setDeletedListEntry(txn, b, next);
+        }
+        else {
+            *txn->recoveryUnit()->writing(&drec(prev)->nextDeleted()) = next;
+        }
+        *txn->recoveryUnit()->writing(&d->nextDeleted()) = DiskLoc().setInvalid(); // defensive.
+        invariant(d->extentOfs() < loc.getOfs());
+
+        txn->recoveryUnit()->registerChange(
+            new ClearDeletedRecordIndexOnRollback(_deletedRecordIndex.get()));
+        _deletedRecordIndex->erase(loc, d->lengthWithHeaders());
+        _deletedRecordIndex->setPrev(next, prev);
+        return loc;
+    }
+
+    void SimpleRecordStoreV1::_buildDeletedRecordIndex() {
+        Timer t;
+        _deletedRecordIndex->clear();
+        for ( int b = 0; b <= MaxBucket; b++ ) {
+            DiskLoc prev;
+            for ( DiskLoc cur = _details->deletedListEntry(b);
+                  !cur.isNull();
+                  cur = drec(cur)->nextDeleted() ) {
+                int fileNumber = cur.a();
+                int fileOffset = cur.getOfs();
+                if (fileNumber < -1 || fileNumber >= 100000 || fileOffset < 0) {
+                    log() << "Deleted record list corrupted in collection " << _ns
+                          << ", bucket " << b
+                          << ", invalid link is " << cur.toString()
+                          << ", throwing Fatal Assertion";
+                    fassertFailed(18900);
+                }
+                _deletedRecordIndex->insert(cur, drec(cur)->lengthWithHeaders(), prev);
+                prev = cur;
+            }
+        }
+        _deletedRecordIndex->markBuilt();
+
+        LOG(1) << "built deleted record index for " << _ns << " with "
+               << _deletedRecordIndex->numRecords() << " entries in " << t.millis() << "ms";
+    }
+
     StatusWith<DiskLoc> SimpleRecordStoreV1::allocRecord( OperationContext* txn,
                                                           int lengthWithHeaders,
                                                           bool enforceQuota ) {
@@ -277,8 +362,38 @@ namespace mongo {
         DEBUGGING log() << "TEMP: add deleted rec " << dloc.toString() << ' ' << hex << d->extentOfs() << endl;
 
         int b = bucket(d->lengthWithHeaders());
-        *txn->recoveryUnit()->writing(&d->nextDeleted()) = _details->deletedListEntry(b);
+        const DiskLoc oldHead = _details->deletedListEntry(b);
+        *txn->recoveryUnit()->writing(&d->nextDeleted()) = oldHead;
         _details->setDeletedListEntry(txn, b, dloc);
+
+        if ( _deletedRecordIndex && _deletedRecordIndex->isBuilt() ) {
+            txn->recoveryUnit()->registerChange(
+                new ClearDeletedRecordIndexOnRollback(_deletedRecordIndex.get()));
+            _deletedRecordIndex->insert(dloc, d->lengthWithHeaders(), DiskLoc());
+            _deletedRecordIndex->setPrev(oldHead, dloc);
+        }
+    }
+
+    void SimpleRecordStoreV1::appendCustomStats( OperationContext* txn,
+                                                 BSONObjBuilder* result,
+                                                 double scale ) const {
+        RecordStoreV1Base::appendCustomStats( txn, result, scale );
+
+        // Only reported when indexed, as walking the on-disk lists could take a long time.
+        if ( !_deletedRecordIndex || !_deletedRecordIndex->isBuilt() )
+            return;
+
+        const long long totalSize = _deletedRecordIndex->totalBytes();
+        const int largest = _deletedRecordIndex->largestRecord();
+
+        BSONObjBuilder freelist( result->subobjStart( "freelist" ) );
+        freelist.appendNumber( "count",
+                               static_cast<long long>( _deletedRecordIndex->numRecords() ) );
+        freelist.appendNumber( "size", static_cast<long long>( totalSize / scale ) );
+        freelist.appendNumber( "largest", static_cast<long long>( largest / scale ) );
+        // 0 when all free space is in one record; approaches 1 as it is split into smaller pieces
+        freelist.append( "fragmentation", totalSize ? 1.0 - double( largest ) / totalSize : 0.0 );
+        freelist.done();
     }
 
     RecordIterator* SimpleRecordStoreV1::getIterator( OperationContext* txn,
@@ -376,7 +491,7 @@ namespace mongo {
 
                 WriteUnitOfWork wunit(txn);
                 Record* recOld = recordFor(nextSourceLoc);
-                RecordData oldData = recOld->toRecordData();
+                RecordData oldData = dataFor(txn, nextSourceLoc);
                 nextSourceLoc = getNextRecordInExtent(txn, nextSourceLoc);
 
                 if ( compactOptions->validateDocuments && !adaptor->isDataValid( oldData ) ) {
@@ -386,7 +501,10 @@ namespace mongo {
                 }
                 else {
                     // How much data is in the record. Excludes padding and Record headers.
-                    const unsigned rawDataSize = adaptor->dataSize( oldData );
+                    // Compressed records are copied as they are.
+                    const unsigned rawDataSize = _compressRecords()
+                        ? _storedDataSize( recOld )
+                        : adaptor->dataSize( oldData );
 
                     nrecords++;
                     oldObjSize += rawDataSize;
@@ -421,7 +539,7 @@ namespace mongo {
                     // start of the compact, this insert will allocate a record in a new extent.
                     // See the comment in compact() for more details.
                     CompactDocWriter writer( recOld, rawDataSize, allocationSize );
-                    StatusWith<DiskLoc> status = insertRecord( txn, &writer, false );
+                    StatusWith<DiskLoc> status = _insertRecord( txn, &writer, false );
                     uassertStatusOK( status.getStatus() );
                     const Record* newRec = recordFor(status.getValue());
                     invariant(unsigned(newRec->netLength()) >= rawDataSize);
@@ -429,7 +547,7 @@ namespace mongo {
 
                     // Tells the caller that the record has been moved, so it can do things such as
                     // add it to indexes.
-                    adaptor->inserted(newRec->toRecordData(), status.getValue());
+                    adaptor->inserted(dataFor(txn, status.getValue()), status.getValue());
                 }
 
                 // Remove the old record from the linked list of records withing the sourceExtent.
@@ -503,6 +621,8 @@ namespace mongo {
             // failure mode as no data will be lost.
             log() << "compact orphan deleted lists" << endl;
             _details->orphanDeletedList(txn);
+            if ( _deletedRecordIndex )
+                _deletedRecordIndex->clear();
 
             // Start over from scratch with our extent sizing and growth
             _details->setLastExtentSize( txn, 0 );
@@ -31,12 +31,19 @@
 #pragma once
 
 #include "mongo/db/diskloc.h"
+#include "mongo/db/storage/mmap_v1/deleted_record_index.h"
 #include "mongo/db/storage/mmap_v1/record_store_v1_base.h"
 
 namespace mongo {
 
     class SimpleRecordStoreV1Iterator;
 
+    /**
+     * Startup parameter: when true, record stores constructed afterwards allocate from an
+     * in-memory DeletedRecordIndex (best fit) rather than by walking the deleted lists.
+     */
+    extern bool useDeletedRecordIndex;
+
     // used by index and original collections
     class SimpleRecordStoreV1 : public RecordStoreV1Base {
     public:
@@ -67,6 +74,10 @@ namespace mongo {
                                 const CompactOptions* options,
                                 CompactStats* stats );
 
+        virtual void appendCustomStats( OperationContext* txn,
+                                        BSONObjBuilder* result,
+                                        double scale ) const;
+
     protected:
         virtual bool isCapped() const { return false; }
 
@@ -80,6 +91,16 @@ namespace mongo {
         DiskLoc _allocFromExistingExtents( OperationContext* txn,
                                            int lengthWithHeaders );
 
+        /**
+         * Unlinks the best fitting DeletedRecord for 'lengthWithHeaders' from the deleted lists
+         * using _deletedRecordIndex, building the index first if needed.
+         * @return the unlinked record, or a null DiskLoc if none is large enough
+         */
+        DiskLoc _unlinkBestFitDeletedRecord( OperationContext* txn,
+                                             int lengthWithHeaders );
+
+        void _buildDeletedRecordIndex();
+
         void _compactExtent(OperationContext* txn,
                             const DiskLoc diskloc,
                             int extentNumber,
@@ -89,6 +110,9 @@ namespace mongo {
 
         bool _normalCollection;
 
+        // NULL unless useDeletedRecordIndex was set when this was constructed
+        scoped_ptr<DeletedRecordIndex> _deletedRecordIndex;
+
         friend class SimpleRecordStoreV1Iterator;
     };
 
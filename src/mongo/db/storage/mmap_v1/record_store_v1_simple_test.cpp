@@ -30,6 +30,7 @@
 
 #include "mongo/db/storage/mmap_v1/record_store_v1_simple.h"
 
+#include "mongo/db/jsobj.h"
 #include "mongo/db/operation_context_noop.h"
 #include "mongo/db/storage/mmap_v1/record.h"
 #include "mongo/db/storage/mmap_v1/record_store_v1_test_help.h"
@@ -772,4 +773,177 @@ namespace {
             assertStateV1RS(&txn, recs, drecs, &em, md);
         }
     }
+
+    /**
+     * Enables useDeletedRecordIndex for record stores constructed while it is in scope.
+     */
+    class DeletedRecordIndexEnabled {
+    public:
+        DeletedRecordIndexEnabled() : _old( useDeletedRecordIndex ) {
+            useDeletedRecordIndex = true;
+        }
+        ~DeletedRecordIndexEnabled() {
+            useDeletedRecordIndex = _old;
+        }
+    private:
+        bool _old;
+    };
+
+    /**
+     * With the deleted record index, inserts take the smallest deleted record that fits no matter
+     * where it is in the deleted lists, and unlink it without walking to it.
+     */
+    TEST( SimpleRecordStoreV1, DeletedRecordIndexTakesBestFit ) {
+        DeletedRecordIndexEnabled enabled;
+        OperationContextNoop txn;
+        DummyExtentManager em;
+        DummyRecordStoreV1MetaData* md = new DummyRecordStoreV1MetaData( false, 0 );
+        SimpleRecordStoreV1 rs( &txn, "test.foo", md, &em, false );
+
+        {
+            LocAndSize recs[] = {
+                {}
+            };
+            LocAndSize drecs[] = {
+                {DiskLoc(0, 1000),  50},
+                {DiskLoc(0, 1100),  75}, // taken by 2nd insert, the lowest loc of this size
+                {DiskLoc(0, 1200),  75},
+                {DiskLoc(0, 1300), 100}, // taken by 3rd insert
+                {DiskLoc(0, 1400),  80}, // exact fit in the middle of a list: 1st insert
+                {DiskLoc(0, 9000), 140}, // bigger bucket: 4th insert
+                {}
+            };
+            initializeV1RS(&txn, recs, drecs, &em, md);
+        }
+
+        rs.insertRecord(&txn, zeros, 80 - Record::HeaderSize, false);
+        rs.insertRecord(&txn, zeros, 70 - Record::HeaderSize, false);
+        rs.insertRecord(&txn, zeros, 100 - Record::HeaderSize, false);
+        rs.insertRecord(&txn, zeros, 130 - Record::HeaderSize, false);
+
+        {
+            LocAndSize recs[] = {
+                {DiskLoc(0, 1400),  80},
+                {DiskLoc(0, 1100),  75},
+                {DiskLoc(0, 1300), 100},
+                {DiskLoc(0, 9000), 140},
+                {}
+            };
+            LocAndSize drecs[] = {
+                {DiskLoc(0, 1000),  50},
+                {DiskLoc(0, 1200),  75},
+                {}
+            };
+            assertStateV1RS(&txn, recs, drecs, &em, md);
+        }
+    }
+
+    /**
+     * The remainder split off an oversized deleted record, and records freed by deletes, are
+     * indexed and reused.
+     */
+    TEST( SimpleRecordStoreV1, DeletedRecordIndexTracksSplitsAndDeletes ) {
+        DeletedRecordIndexEnabled enabled;
+        OperationContextNoop txn;
+        DummyExtentManager em;
+        DummyRecordStoreV1MetaData* md = new DummyRecordStoreV1MetaData( false, 0 );
+        SimpleRecordStoreV1 rs( &txn, "test.foo", md, &em, false );
+
+        {
+            LocAndSize recs[] = {
+                {}
+            };
+            LocAndSize drecs[] = {
+                {DiskLoc(0, 1000), 300},
+                {}
+            };
+            initializeV1RS(&txn, recs, drecs, &em, md);
+        }
+
+        // 100 is quantized to 104
+        StatusWith<DiskLoc> first = rs.insertRecord(&txn, zeros, 100 - Record::HeaderSize, false);
+        ASSERT_OK( first.getStatus() );
+        ASSERT_EQUALS( DiskLoc(0, 1000), first.getValue() );
+
+        StatusWith<DiskLoc> second = rs.insertRecord(&txn, zeros, 100 - Record::HeaderSize, false);
+        ASSERT_OK( second.getStatus() );
+        ASSERT_EQUALS( DiskLoc(0, 1104), second.getValue() );
+
+        rs.deleteRecord(&txn, first.getValue());
+
+        StatusWith<DiskLoc> third = rs.insertRecord(&txn, zeros, 104 - Record::HeaderSize, false);
+        ASSERT_OK( third.getStatus() );
+        ASSERT_EQUALS( DiskLoc(0, 1000), third.getValue() );
+
+        {
+            LocAndSize recs[] = {
+                {DiskLoc(0, 1104), 104},
+                {DiskLoc(0, 1000), 104},
+                {}
+            };
+            LocAndSize drecs[] = {
+                {DiskLoc(0, 1208), 92},
+                {}
+            };
+            assertStateV1RS(&txn, recs, drecs, &em, md);
+        }
+
+        BSONObjBuilder stats;
+        rs.appendCustomStats(&txn, &stats, 1);
+        BSONObj freelist = stats.obj()["freelist"].Obj();
+        ASSERT_EQUALS( 1, freelist["count"].numberLong() );
+        ASSERT_EQUALS( 92, freelist["size"].numberLong() );
+        ASSERT_EQUALS( 92, freelist["largest"].numberLong() );
+        ASSERT_EQUALS( 0.0, freelist["fragmentation"].numberDouble() );
+    }
+
+    TEST( SimpleRecordStoreV1, CompressRecords ) {
+        OperationContextNoop txn;
+        DummyExtentManager em;
+        DummyRecordStoreV1MetaData* md = new DummyRecordStoreV1MetaData( false, 0 );
+        md->setUserFlag( &txn, RecordStoreV1Base::Flag_CompressRecords );
+        SimpleRecordStoreV1 rs( &txn, "test.foo", md, &em, false );
+
+        {
+            LocAndSize recs[] = {
+                {}
+            };
+            LocAndSize drecs[] = {
+                {DiskLoc(0, 1000), 10000},
+                {}
+            };
+            initializeV1RS(&txn, recs, drecs, &em, md);
+        }
+
+        ASSERT( !rs.updateWithDamagesSupported() );
+
+        // Repetitive data takes much less space than its size.
+        const std::string text( 2000, 'a' );
+        StatusWith<DiskLoc> small = rs.insertRecord( &txn, text.c_str(), text.size() + 1, false );
+        ASSERT_OK( small.getStatus() );
+        ASSERT_EQUALS( text, rs.dataFor( &txn, small.getValue() ).data() );
+        ASSERT_EQUALS( static_cast<int>( text.size() + 1 ),
+                       rs.dataFor( &txn, small.getValue() ).size() );
+        ASSERT_LESS_THAN( rs.dataSize( &txn ), 200 );
+
+        // Data that doesn't compress is stored as is.
+        char noise[100];
+        for ( int i = 0; i < 100; i++ ) {
+            noise[i] = static_cast<char>( ( i * 7919 ) % 251 );
+        }
+        StatusWith<DiskLoc> raw = rs.insertRecord( &txn, noise, sizeof(noise), false );
+        ASSERT_OK( raw.getStatus() );
+        RecordData rawData = rs.dataFor( &txn, raw.getValue() );
+        ASSERT_EQUALS( 100, rawData.size() );
+        ASSERT_EQUALS( 0, memcmp( noise, rawData.data(), sizeof(noise) ) );
+
+        // A changed document that still compresses into the record is updated in place.
+        const std::string changed( 2000, 'b' );
+        StatusWith<DiskLoc> updated = rs.updateRecord( &txn, small.getValue(), changed.c_str(),
+                                                       changed.size() + 1, false, NULL );
+        ASSERT_OK( updated.getStatus() );
+        ASSERT_EQUALS( small.getValue(), updated.getValue() );
+        ASSERT_EQUALS( changed, rs.dataFor( &txn, small.getValue() ).data() );
+        ASSERT_EQUALS( 2, rs.numRecords( &txn ) );
+    }
 }
@@ -175,6 +175,13 @@ namespace mongo {
                                           const DiskLoc& loc,
                                           const char* damangeSource,
                                           const mutablebson::DamageVector& damages ) = 0;
+
+        /**
+         * @return false if records can't be patched in place with updateWithDamages, in which
+         *         case callers have to rewrite the whole record with updateRecord
+         */
+        virtual bool updateWithDamagesSupported() const { return true; }
+
         /**
          * returned iterator owned by caller
          * canonical to get all would be
@@ -253,6 +260,13 @@ namespace mongo {
          */
         virtual Status touch( OperationContext* txn, BSONObjBuilder* output ) const = 0;
 
+        /**
+         * Hint that the records at 'locs' are about to be read, so that the implementation can
+         * bring them into cache ahead of time, ideally without waiting for the I/O or else in a
+         * single batch.  A no-op is ok if there is nothing to gain.
+         */
+        virtual void prefetch( OperationContext* txn, const std::vector<DiskLoc>& locs ) const = 0;
+
         /**
          * @return Status::OK() if option hanlded
          *         InvalidOptions is option not supported
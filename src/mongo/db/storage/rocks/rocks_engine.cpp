@@ -41,8 +41,10 @@
 #include <rocksdb/db.h>
 #include <rocksdb/slice.h>
 #include <rocksdb/options.h>
+#include <rocksdb/statistics.h>
 
 #include "mongo/db/catalog/collection_options.h"
+#include "mongo/db/commands/server_status_metric.h"
 #include "mongo/db/operation_context.h"
 #include "mongo/db/storage/rocks/rocks_collection_catalog_entry.h"
 #include "mongo/db/storage/rocks/rocks_database_catalog_entry.h"
@@ -58,6 +60,32 @@
 
 namespace mongo {
 
+    namespace {
+        // Shared by every database the engine opens, so that serverStatus can report on the block
+        // cache.
+        const std::shared_ptr<rocksdb::Statistics> statistics = rocksdb::CreateDBStatistics();
+
+        class RocksTickerMetric : public ServerStatusMetric {
+        public:
+            RocksTickerMetric( const std::string& name, rocksdb::Tickers ticker )
+                : ServerStatusMetric( name ), _ticker( ticker ) {
+            }
+
+            virtual void appendAtLeaf( BSONObjBuilder& b ) const {
+                b.appendNumber( _leafName,
+                                static_cast<long long>( statistics->getTickerCount( _ticker ) ) );
+            }
+
+        private:
+            const rocksdb::Tickers _ticker;
+        };
+
+        RocksTickerMetric blockCacheHits( "storage.rocks.blockCache.hits",
+                                          rocksdb::BLOCK_CACHE_HIT );
+        RocksTickerMetric blockCacheMisses( "storage.rocks.blockCache.misses",
+                                            rocksdb::BLOCK_CACHE_MISS );
+    }
+
     RocksEngine::RocksEngine( const std::string& path ) : _path( path ), _defaultHandle( NULL ) {
         // TODO make this more fine-grained?
         boost::mutex::scoped_lock lk( _entryMapMutex );
@@ -414,6 +442,8 @@ namespace mongo {
         // create the DB if it's not already present
         options.create_if_missing = true;
 
+        options.statistics = statistics;
+
         return options;
     }
 
@@ -400,6 +400,21 @@ namespace mongo {
         return Status::OK();
     }
 
+    void RocksRecordStore::prefetch( OperationContext* txn,
+                                     const std::vector<DiskLoc>& locs ) const {
+        // A single MultiGet brings all the blocks into the block cache, so the Get()s that follow
+        // don't each wait for a read.  The values themselves are thrown away.
+        std::vector<rocksdb::ColumnFamilyHandle*> columnFamilies( locs.size(), _columnFamily );
+        std::vector<rocksdb::Slice> keys;
+        keys.reserve( locs.size() );
+        for ( std::vector<DiskLoc>::const_iterator it = locs.begin(); it != locs.end(); ++it ) {
+            keys.push_back( _makeKey( *it ) );
+        }
+
+        std::vector<std::string> values;
+        _db->MultiGet( _readOptions( txn ), columnFamilies, keys, &values );
+    }
+
     Status RocksRecordStore::setCustomOption( OperationContext* txn,
                                               const BSONElement& option,
                                               BSONObjBuilder* info ) {
@@ -131,6 +131,8 @@ namespace mongo {
 
         virtual Status touch( OperationContext* txn, BSONObjBuilder* output ) const;
 
+        virtual void prefetch( OperationContext* txn, const std::vector<DiskLoc>& locs ) const;
+
         virtual Status setCustomOption( OperationContext* txn,
                                         const BSONElement& option,
                                         BSONObjBuilder* info = NULL );
@@ -35,6 +35,8 @@
 #include <rocksdb/comparator.h>
 #include <rocksdb/db.h>
 #include <rocksdb/iterator.h>
+#include <rocksdb/options.h>
+#include <rocksdb/write_batch.h>
 
 #include "mongo/db/storage/rocks/rocks_engine.h"
 #include "mongo/db/storage/rocks/rocks_record_store.h"
@@ -88,6 +90,17 @@ namespace mongo {
             return IndexKeyEntry( key, loc );
         }
 
+        /**
+         * Creates an error code message out of a key
+         */
+        string dupKeyError( const BSONObj& key ) {
+            stringstream ss;
+            ss << "E11000 duplicate key error ";
+            // TODO figure out how to include index name without dangerous casts
+            ss << "dup key: " << key.toString();
+            return ss.str();
+        }
+
         /**
          * Rocks cursor
          */
@@ -381,6 +394,102 @@ namespace mongo {
             private:
                 const IndexEntryComparison _indexComparator;
         };
+
+        /**
+         * Bulk builder for an index being built from the sorted key stream of
+         * BtreeBasedBulkAccessMethod::commit().
+         *
+         * Keys don't go through the RocksRecoveryUnit's write batch, one document's worth at a
+         * time.  They are accumulated in a private batch that is written straight to the column
+         * family every kBulkBatchBytes, with the WAL disabled.  commit() flushes the column
+         * family's memtable so the index is durable in SST files without having been logged.  A
+         * failed build drops the column family, so nothing has to be undone here.
+         */
+        class RocksBulkSortedBuilderImpl : public RocksSortedDataBuilderImpl {
+        public:
+            RocksBulkSortedBuilderImpl( rocksdb::DB* db,
+                                        rocksdb::ColumnFamilyHandle* columnFamily,
+                                        const Ordering& order,
+                                        bool dupsAllowed )
+                : _db( db ),
+                  _columnFamily( columnFamily ),
+                  _comparator( order ),
+                  _dupsAllowed( dupsAllowed ),
+                  _numKeys( 0 ) {
+                _writeOptions.disableWAL = true;
+            }
+
+            virtual Status addKey( const BSONObj& key, const DiskLoc& loc ) {
+                const BSONObj strippedKey = stripFieldNames( key );
+
+                if ( _numKeys > 0 ) {
+                    const IndexKeyEntry last( _lastKey, _lastLoc );
+                    const int cmp = _comparator.compare( IndexKeyEntry( strippedKey, loc ), last );
+                    if ( cmp < 0 ) {
+                        return Status( ErrorCodes::InternalError,
+                                       "keys added to the rocks bulk builder out of order" );
+                    }
+
+                    if ( !_dupsAllowed
+                         && _lastKey.woCompare( strippedKey, BSONObj(), false ) == 0 ) {
+                        return Status( ErrorCodes::DuplicateKey, dupKeyError( key ) );
+                    }
+                }
+
+                _batch.Put( _columnFamily, makeString( strippedKey, loc, false ), emptyByteSlice );
+                _lastKey = strippedKey.getOwned();
+                _lastLoc = loc;
+                _numKeys++;
+
+                if ( _batch.Data().size() >= kBulkBatchBytes ) {
+                    _writeBatch();
+                }
+
+                return Status::OK();
+            }
+
+            virtual void commit( bool mayInterrupt ) {
+                _writeBatch();
+
+                // The WAL was bypassed, so the index only survives a crash once it is in SSTs.
+                const rocksdb::Status s = _db->Flush( rocksdb::FlushOptions(), _columnFamily );
+                if ( !s.ok() ) {
+                    log() << "rocks bulk index build failed to flush: " << s.ToString();
+                    fassertFailed( 18901 );
+                }
+
+                LOG(1) << "rocks bulk builder wrote " << _numKeys << " index keys";
+            }
+
+        private:
+            static const size_t kBulkBatchBytes = 4 * 1024 * 1024;
+
+            void _writeBatch() {
+                if ( _batch.Count() == 0 ) {
+                    return;
+                }
+
+                const rocksdb::Status s = _db->Write( _writeOptions, &_batch );
+                if ( !s.ok() ) {
+                    log() << "rocks bulk index build failed to write: " << s.ToString();
+                    fassertFailed( 18902 );
+                }
+                _batch.Clear();
+            }
+
+            rocksdb::DB* _db; // not owned
+            rocksdb::ColumnFamilyHandle* _columnFamily; // not owned
+            const IndexEntryComparison _comparator;
+            const bool _dupsAllowed;
+
+            rocksdb::WriteOptions _writeOptions;
+            rocksdb::WriteBatch _batch;
+
+            BSONObj _lastKey;
+            DiskLoc _lastLoc;
+            long long _numKeys;
+        };
+
     } // namespace
 
     // RocksSortedDataImpl***********
@@ -394,7 +503,7 @@ namespace mongo {
 
     SortedDataBuilderInterface* RocksSortedDataImpl::getBulkBuilder(OperationContext* txn,
                                                                     bool dupsAllowed) {
-        invariant( !"getBulkBuilder not yet implemented" );
+        return new RocksBulkSortedBuilderImpl( _db, _columnFamily, _order, dupsAllowed );
     }
 
     Status RocksSortedDataImpl::insert(OperationContext* txn,
@@ -434,14 +543,6 @@ namespace mongo {
         return true; // XXX: fix? does it matter since its so slow to check?
     }
 
-    string RocksSortedDataImpl::dupKeyError(const BSONObj& key) const {
-        stringstream ss;
-        ss << "E11000 duplicate key error ";
-        // TODO figure out how to include index name without dangerous casts
-        ss << "dup key: " << key.toString();
-        return ss.str();
-    }
-
     Status RocksSortedDataImpl::dupKeyCheck(OperationContext* txn,
                                             const BSONObj& key,
                                             const DiskLoc& loc) {
@@ -104,13 +104,8 @@ namespace mongo {
         // relevant column family
         rocksdb::ColumnFamilyHandle* _columnFamily; // not owned
 
-        // used to construct RocksCursors
+        // used to construct RocksCursors and bulk builders
         const Ordering _order;
-
-        /**
-         * Creates an error code message out of a key
-         */
-        std::string dupKeyError(const BSONObj& key) const;
     };
 
 } // namespace mongo
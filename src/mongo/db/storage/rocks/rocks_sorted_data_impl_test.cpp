@@ -924,4 +924,77 @@ namespace mongo {
             }
         }
     }
+
+    TEST( RocksRecordStoreTest, BulkBuilder ) {
+        unittest::TempDir td( _rocksSortedDataTestDir );
+        scoped_ptr<rocksdb::DB> db( getDB( td.path() ) );
+
+        rocksdb::ColumnFamilyOptions options;
+        options.comparator = _rocksComparator.get();
+        rocksdb::ColumnFamilyHandle* cfPtr;
+        ASSERT( db->CreateColumnFamily( options, "bulk", &cfPtr ).ok() );
+        scoped_ptr<rocksdb::ColumnFamilyHandle> cf( cfPtr );
+
+        {
+            const Ordering order = Ordering::make( BSON( "a" << 1 ) );
+            RocksSortedDataImpl sortedData( db.get(), cf.get(), order );
+
+            {
+                MyOperationContext opCtx( db.get() );
+                scoped_ptr<SortedDataBuilderInterface> builder(
+                        sortedData.getBulkBuilder( &opCtx, true ) );
+
+                for ( int i = 0; i < 1000; i++ ) {
+                    const DiskLoc loc( 5, 16 * ( i + 1 ) );
+                    ASSERT_OK( builder->addKey( BSON( "" << i / 2 ), loc ) );
+                }
+
+                // Keys must arrive in order.
+                ASSERT_EQUALS( ErrorCodes::InternalError,
+                               builder->addKey( BSON( "" << 0 ), DiskLoc( 5, 16 ) ).code() );
+
+                builder->commit( false );
+            }
+
+            {
+                MyOperationContext opCtx( db.get() );
+                scoped_ptr<SortedDataInterface::Cursor> cursor( sortedData.newCursor( &opCtx, 1 ) );
+                ASSERT( !cursor->locate( BSONObj(), DiskLoc() ) );
+                for ( int i = 0; i < 1000; i++ ) {
+                    ASSERT( !cursor->isEOF() );
+                    ASSERT_EQUALS( BSON( "" << i / 2 ), cursor->getKey() );
+                    ASSERT_EQUALS( DiskLoc( 5, 16 * ( i + 1 ) ), cursor->getDiskLoc() );
+                    cursor->advance();
+                }
+                ASSERT( cursor->isEOF() );
+            }
+        }
+    }
+
+    TEST( RocksRecordStoreTest, BulkBuilderNoDups ) {
+        unittest::TempDir td( _rocksSortedDataTestDir );
+        scoped_ptr<rocksdb::DB> db( getDB( td.path() ) );
+
+        {
+            RocksSortedDataImpl sortedData( db.get(), db->DefaultColumnFamily(), dummyOrdering );
+
+            MyOperationContext opCtx( db.get() );
+            scoped_ptr<SortedDataBuilderInterface> builder(
+                    sortedData.getBulkBuilder( &opCtx, false ) );
+
+            ASSERT_OK( builder->addKey( BSON( "" << 1 ), DiskLoc( 5, 16 ) ) );
+            ASSERT_EQUALS( ErrorCodes::DuplicateKey,
+                           builder->addKey( BSON( "" << 1 ), DiskLoc( 5, 32 ) ).code() );
+            ASSERT_OK( builder->addKey( BSON( "" << 2 ), DiskLoc( 5, 48 ) ) );
+            builder->commit( false );
+
+            scoped_ptr<SortedDataInterface::Cursor> cursor( sortedData.newCursor( &opCtx, 1 ) );
+            ASSERT( !cursor->locate( BSONObj(), DiskLoc() ) );
+            ASSERT_EQUALS( DiskLoc( 5, 16 ), cursor->getDiskLoc() );
+            cursor->advance();
+            ASSERT_EQUALS( DiskLoc( 5, 48 ), cursor->getDiskLoc() );
+            cursor->advance();
+            ASSERT( cursor->isEOF() );
+        }
+    }
 }
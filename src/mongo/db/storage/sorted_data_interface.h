@@ -26,6 +26,8 @@
  *    it in the license file.
  */
 
+#include <boost/scoped_ptr.hpp>
+
 #include "mongo/bson/ordering.h"
 #include "mongo/db/catalog/head_manager.h"
 #include "mongo/db/diskloc.h"
@@ -105,6 +107,18 @@ namespace mongo {
          */
         virtual Status touch(OperationContext* txn) const = 0;
 
+        /**
+         * Hint that 'keys' are about to be looked up, so that the implementation can start
+         * bringing the parts of the index holding them into cache.  The default finds each key
+         * with a cursor, implementations that can do better without blocking should.
+         */
+        virtual void prefetchKeys(OperationContext* txn, const BSONObjSet& keys) const {
+            boost::scoped_ptr<Cursor> cursor(newCursor(txn, 1));
+            for (BSONObjSet::const_iterator i = keys.begin(); i != keys.end(); ++i) {
+                cursor->locate(*i, DiskLoc());
+            }
+        }
+
         /**
          * Implementors SHOULD override this with an efficient representation if at all possible.
          * @return the number of entries in the index.
@@ -103,6 +103,45 @@ namespace mongo {
         }
     } journalCommitIntervalSetting;
 
+    ExportedServerParameter<bool> JournalGroupCommitSetting(ServerParameterSet::getGlobal(),
+                                                            "journalGroupCommit",
+                                                            &storageGlobalParams.journalGroupCommit,
+                                                            true,
+                                                            true);
+
+    class JournalCompressorSetting : public ServerParameter {
+    public:
+        JournalCompressorSetting() :
+            ServerParameter(ServerParameterSet::getGlobal(), "journalCompressor",
+                    true, // allowedToChangeAtStartup
+                    false // allowedToChangeAtRuntime
+                    ) {}
+
+        virtual void append(OperationContext* txn, BSONObjBuilder& b, const std::string& name) {
+            b << name << storageGlobalParams.journalCompressor;
+        }
+
+        virtual Status set(const BSONElement& newValueElement) {
+            if (newValueElement.type() != String) {
+                StringBuilder sb;
+                sb << "Expected string type for journalCompressor: " << newValueElement;
+                return Status(ErrorCodes::BadValue, sb.str());
+            }
+            return setFromString(newValueElement.String());
+        }
+
+        virtual Status setFromString(const std::string& str) {
+            if (str != "snappy" && str != "snappyFramed" && str != "none") {
+                StringBuilder sb;
+                sb << "journalCompressor must be one of \"snappy\", \"snappyFramed\" or "
+                   << "\"none\", but attempted to set to: " << str;
+                return Status(ErrorCodes::BadValue, sb.str());
+            }
+            storageGlobalParams.journalCompressor = str;
+            return Status::OK();
+        }
+    } journalCompressorSetting;
+
     ExportedServerParameter<bool> NoTableScanSetting(ServerParameterSet::getGlobal(),
                                                      "notablescan",
                                                      &storageGlobalParams.noTableScan,
@@ -50,6 +50,8 @@ namespace mongo {
             lenForNewNsFiles(16 * 1024 * 1024),
             preallocj(true),
             journalCommitInterval(0), // 0 means use default
+            journalGroupCommit(false),
+            journalCompressor("snappy"),
             quota(false), quotaFiles(8),
             syncdelay(60)
         {
@@ -83,6 +85,11 @@ namespace mongo {
 
         bool dur;                       // --dur durability (now --journal)
         unsigned journalCommitInterval; // group/batch commit interval ms
+        bool journalGroupCommit;        // j:true writers trigger a commit instead of waiting
+                                        // out journalCommitInterval
+        std::string journalCompressor;  // "snappy", "snappyFramed" or "none", used for new
+                                        // journal files.  only "snappy" can be read by
+                                        // versions before the compressor was recorded
 
         /** --durOptions 7      dump journal and terminate without doing anything further
             --durOptions 4      recover and terminate without listening
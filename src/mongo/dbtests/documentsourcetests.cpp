@@ -897,6 +897,150 @@ namespace DocumentSourceTests {
             string expectedResultSetString() { return "[{_id:[1,2,3],a:[[4,5,6]]}]"; }
         };
 
+        /** Sorts that bring all documents of each group together. */
+        class GroupedBySort : public Base {
+        public:
+            void run() {
+                createGroup( fromjson( "{_id:{x:'$a',y:'$b.c'},n:{$sum:1}}" ) );
+                DocumentSourceGroup* byFields = dynamic_cast<DocumentSourceGroup*>( group() );
+                ASSERT( byFields->isGroupedBySort( BSON( "b.c" << -1 << "a" << 1 ) ) );
+                ASSERT( byFields->isGroupedBySort( BSON( "a" << 1 << "b.c" << 1 << "d" << 1 ) ) );
+                ASSERT( !byFields->isGroupedBySort( BSON( "a" << 1 ) ) );
+                ASSERT( !byFields->isGroupedBySort( BSON( "a" << 1 << "d" << 1 << "b.c" << 1 ) ) );
+                ASSERT( !byFields->isGroupedBySort( BSONObj() ) );
+
+                createGroup( fromjson( "{_id:'$$ROOT.a'}" ) );
+                ASSERT( dynamic_cast<DocumentSourceGroup*>( group() )->
+                        isGroupedBySort( BSON( "a" << 1 ) ) );
+
+                // A computed _id is not ordered by any sort pattern.
+                createGroup( fromjson( "{_id:{$add:['$a',1]}}" ) );
+                ASSERT( !dynamic_cast<DocumentSourceGroup*>( group() )->
+                        isGroupedBySort( BSON( "a" << 1 ) ) );
+            }
+        };
+
+        /** $group stages that only need the first or last document of each group. */
+        class FirstOrLastPerGroup : public Base {
+        public:
+            void run() {
+                string idField;
+                bool useLast = true;
+
+                createGroup( fromjson( "{_id:'$a.b',x:{$first:'$c'},y:{$first:{$toLower:'$d'}}}" ) );
+                ASSERT( firstOrLast( &idField, &useLast ) );
+                ASSERT_EQUALS( "a.b", idField );
+                ASSERT( !useLast );
+
+                createGroup( fromjson( "{_id:'$a',x:{$last:'$c'}}" ) );
+                ASSERT( firstOrLast( &idField, &useLast ) );
+                ASSERT_EQUALS( "a", idField );
+                ASSERT( useLast );
+
+                createGroup( fromjson( "{_id:'$a'}" ) );
+                ASSERT( firstOrLast( &idField, &useLast ) );
+
+                createGroup( fromjson( "{_id:'$a',x:{$first:'$c'},y:{$last:'$c'}}" ) );
+                ASSERT( !firstOrLast( &idField, &useLast ) );
+
+                createGroup( fromjson( "{_id:'$a',x:{$first:'$c'},n:{$sum:1}}" ) );
+                ASSERT( !firstOrLast( &idField, &useLast ) );
+
+                createGroup( fromjson( "{_id:{a:'$a',b:'$b'},x:{$first:'$c'}}" ) );
+                ASSERT( !firstOrLast( &idField, &useLast ) );
+            }
+        private:
+            bool firstOrLast( string* idField, bool* useLast ) {
+                return dynamic_cast<DocumentSourceGroup*>( group() )->
+                        isFirstOrLastPerGroup( idField, useLast );
+            }
+        };
+
+        /** A streaming $group outputs each group as soon as the _id of its input changes. */
+        class Streaming : public Base {
+        public:
+            void run() {
+                // Inserted, and so scanned, in order of 'a'. The last document has no 'a'.
+                for( int i = 0; i < 31; ++i ) {
+                    BSONObjBuilder bob;
+                    bob.append( "_id", i );
+                    if ( i < 30 ) {
+                        bob.append( "a", i / 10 );
+                    }
+                    bob.append( "b", i );
+                    client.insert( ns, bob.obj() );
+                }
+                createSource();
+                createGroup( fromjson( "{_id:'$a',n:{$sum:1},last:{$last:'$b'}}" ) );
+                dynamic_cast<DocumentSourceGroup*>( group() )->setStreaming( true );
+
+                // Groups come out in input order.
+                for( int i = 0; i < 3; ++i ) {
+                    boost::optional<Document> next = group()->getNext();
+                    ASSERT( bool( next ) );
+                    ASSERT_EQUALS( BSON( "_id" << i << "n" << 10 << "last" << i * 10 + 9 ),
+                                   next->toBson() );
+                }
+                boost::optional<Document> next = group()->getNext();
+                ASSERT( bool( next ) );
+                ASSERT_EQUALS( fromjson( "{_id:null,n:1,last:30}" ), next->toBson() );
+                assertExhausted( group() );
+
+                vector<Value> explain;
+                group()->serializeToArray( explain, true );
+                ASSERT( explain[ 0 ][ "streaming" ].getBool() );
+            }
+        };
+
+        /** A $group whose input is hash-partitioned by _id across worker threads. */
+        class Parallel : public Base {
+        public:
+            Parallel() : _oldThreads( internalDocumentSourceGroupThreads ) {
+                internalDocumentSourceGroupThreads = 4;
+            }
+            ~Parallel() {
+                internalDocumentSourceGroupThreads = _oldThreads;
+            }
+            void run() {
+                for( int i = 0; i < 5000; ++i ) {
+                    client.insert( ns, BSON( "_id" << i << "a" << i % 50 << "b" << i ) );
+                }
+                createSource();
+                createGroup( fromjson( "{_id:'$a',n:{$sum:1},total:{$sum:'$b'},low:{$min:'$b'}}" ) );
+
+                // Every group is output once, fully accumulated, whichever worker built it.
+                set<int> ids;
+                while (boost::optional<Document> next = group()->getNext()) {
+                    const int id = next->getField( "_id" ).getInt();
+                    ASSERT( ids.insert( id ).second );
+                    ASSERT_EQUALS( 100, next->getField( "n" ).getInt() );
+                    ASSERT_EQUALS( 100 * id + 247500, next->getField( "total" ).getInt() );
+                    ASSERT_EQUALS( id, next->getField( "low" ).getInt() );
+                }
+                ASSERT_EQUALS( 50U, ids.size() );
+                assertExhausted( group() );
+
+                // Explain reports what each partition did.
+                vector<Value> explain;
+                group()->serializeToArray( explain, true );
+                Document explained = explain[ 0 ].getDocument();
+                ASSERT_EQUALS( 4, explained[ "numPartitions" ].getLong() );
+                const vector<Value>& partitions = explained[ "partitionStats" ].getArray();
+                ASSERT_EQUALS( 4U, partitions.size() );
+                long long documents = 0;
+                long long groups = 0;
+                for( size_t i = 0; i < partitions.size(); ++i ) {
+                    documents += partitions[ i ][ "documents" ].getLong();
+                    groups += partitions[ i ][ "groups" ].getLong();
+                    ASSERT_EQUALS( 0, partitions[ i ][ "spills" ].getLong() );
+                }
+                ASSERT_EQUALS( 5000, documents );
+                ASSERT_EQUALS( 50, groups );
+            }
+        private:
+            int _oldThreads;
+        };
+
     } // namespace DocumentSourceGroup
 
     namespace DocumentSourceProject {
@@ -1931,6 +2075,10 @@ namespace DocumentSourceTests {
             add<DocumentSourceGroup::Dependencies>();
             add<DocumentSourceGroup::StringConstantIdAndAccumulatorExpressions>();
             add<DocumentSourceGroup::ArrayConstantAccumulatorExpression>();
+            add<DocumentSourceGroup::GroupedBySort>();
+            add<DocumentSourceGroup::FirstOrLastPerGroup>();
+            add<DocumentSourceGroup::Streaming>();
+            add<DocumentSourceGroup::Parallel>();
 
             add<DocumentSourceProject::Inclusion>();
             add<DocumentSourceProject::Optimize>();
@@ -344,6 +344,95 @@ namespace DocumentTests {
             }
         };
 
+        /** Named lookups in a lazy Document only convert the fields looked up. */
+        class LazyLookup {
+        public:
+            void run() {
+                BSONObj obj = fromjson( "{a:1,b:{c:'x'},d:[1,2],a:3}" );
+                Document document = Document::fromBsonLazy( obj );
+                ASSERT_EQUALS( 4U, document.size() );
+                ASSERT( !document.empty() );
+                ASSERT_EQUALS( Value( 1 ), document["a"] );
+                ASSERT_EQUALS( Value( DOC( "c" << "x" ) ), document["b"] );
+                ASSERT( document["e"].missing() );
+                ASSERT_EQUALS( Value( "x" ), document.getNestedField( FieldPath( "b.c" ) ) );
+
+                // Nothing changed, so the original BSON is returned as is.
+                ASSERT_EQUALS( obj, toBson( document ) );
+                ASSERT_EQUALS( fromBson( obj ), document );
+                ASSERT( Document::fromBsonLazy( BSONObj() ).empty() );
+            }
+        };
+
+        /** Iterating a lazy Document converts its fields in order. */
+        class LazyIterate {
+        public:
+            void run() {
+                Document document = Document::fromBsonLazy( BSON( "a" << 1 << "b" << "q" <<
+                                                                  "c" << 2.5 ) );
+                ASSERT_EQUALS( Value( "q" ), document["b"] );
+                ASSERT_EQUALS( "a", getNthField( document, 0 ).first.toString() );
+                ASSERT_EQUALS( "b", getNthField( document, 1 ).first.toString() );
+                ASSERT_EQUALS( "q", getNthField( document, 1 ).second.getString() );
+                ASSERT_EQUALS( "c", getNthField( document, 2 ).first.toString() );
+                ASSERT_EQUALS( 3U, document.size() );
+                ASSERT_EQUALS( Value( 2.5 ), document["c"] );
+                assertRoundTrips( document );
+            }
+        };
+
+        /** Modifying a lazy Document leaves the original unchanged. */
+        class LazyModify {
+        public:
+            void run() {
+                BSONObj obj = BSON( "a" << 1 << "b" << 2 );
+                const Document document = Document::fromBsonLazy( obj );
+                MutableDocument md( document );
+                md.setField( "b", Value( 3 ) );
+                md.addField( "c", Value( 4 ) );
+                ASSERT_EQUALS( DOC( "a" << 1 << "b" << 3 << "c" << 4 ), md.freeze() );
+                ASSERT_EQUALS( DOC( "a" << 1 << "b" << 2 ), document );
+                ASSERT_EQUALS( obj, toBson( document ) );
+            }
+        };
+
+        /** Metadata is parsed out of BSON read lazily. */
+        class LazyMetaData {
+        public:
+            void run() {
+                Document document = Document::fromBsonLazy( BSON( "a" << 1 <<
+                                                                  "$textScore" << 2.0 ) );
+                ASSERT( document.hasTextScore() );
+                ASSERT_EQUALS( 2.0, document.getTextScore() );
+                ASSERT_EQUALS( BSON( "a" << 1 ), toBson( document ) );
+            }
+        };
+
+        /**
+         * A lazy Document of a wide BSON document reads the same fields and converts back to
+         * the same BSON as an eager one.  perftests.cpp compares their speed.
+         */
+        class LazyWide {
+        public:
+            void run() {
+                BSONObjBuilder bob;
+                for ( int i = 0; i < 40; ++i ) {
+                    bob.append( std::string( str::stream() << "field" << i ), i );
+                    bob.append( std::string( str::stream() << "string" << i ), "some string value" );
+                }
+                bob.append( "sub", fromjson( "{a:[1,2,3],b:{c:1,d:'e'}}" ) );
+                const BSONObj obj = bob.obj();
+
+                const Document eager = Document::fromBsonWithMetaData( obj );
+                const Document lazy = Document::fromBsonLazy( obj );
+                ASSERT_EQUALS( 37, lazy["field37"].getInt() );
+                ASSERT_EQUALS( eager["string3"], lazy["string3"] );
+                ASSERT_EQUALS( eager["sub"], lazy["sub"] );
+                ASSERT_EQUALS( eager, lazy );
+                ASSERT_EQUALS( obj, toBson( lazy ) );
+            }
+        };
+
         class AllTypesDoc {
         public:
             void run() {
@@ -1428,6 +1517,11 @@ namespace DocumentTests {
             add<Document::FieldIteratorSingle>();
             add<Document::FieldIteratorMultiple>();
             add<Document::AllTypesDoc>();
+            add<Document::LazyLookup>();
+            add<Document::LazyIterate>();
+            add<Document::LazyModify>();
+            add<Document::LazyMetaData>();
+            add<Document::LazyWide>();
 
             add<Value::BSONArrayTest>();
             add<Value::Int>();
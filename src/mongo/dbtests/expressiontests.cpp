@@ -30,8 +30,11 @@
 
 #include "mongo/pch.h"
 
+#include "mongo/db/json.h"
+#include "mongo/db/pipeline/accumulator.h"
 #include "mongo/db/pipeline/document.h"
 #include "mongo/db/pipeline/expression.h"
+#include "mongo/db/pipeline/expression_compiled.h"
 #include "mongo/dbtests/dbtests.h"
 
 namespace ExpressionTests {
@@ -3436,6 +3439,261 @@ namespace ExpressionTests {
 
     } // namespace AllAnyElements
 
+    namespace Compiled {
+
+        /** Parses and optimizes 'spec', an operand such as {$add: ['$a', 1]}. */
+        static intrusive_ptr<Expression> parseOptimized(const BSONObj& spec) {
+            BSONObj wrapped = BSON("" << spec);
+            VariablesIdGenerator idGenerator;
+            VariablesParseState vps(&idGenerator);
+            return Expression::parseOperand(wrapped.firstElement(), vps)->optimize();
+        }
+
+        /** The documents that compiled and interpreted expressions are checked against. */
+        static vector<Document> inputDocuments() {
+            const char* docs[] = {
+                "{}",
+                "{a: 1, b: 2}",
+                "{a: 2147483647, b: 1}",
+                "{a: NumberLong(5), b: 2.5}",
+                "{a: -7, b: 3, c: {d: 4}}",
+                "{a: 7.5, b: 0}",
+                "{a: null, b: 1}",
+                "{a: 'str', b: 1}",
+                "{a: new Date(1000), b: 10}",
+                "{a: true, b: false}",
+                "{a: [1, 2], b: 1, c: [{d: 1}, {d: 2}]}",
+                "{a: 0, b: 0, c: 5}",
+                "{a: NaN, b: 1, c: {d: null}}",
+            };
+            vector<Document> out;
+            for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); i++) {
+                out.push_back(Document(fromjson(docs[i])));
+            }
+            return out;
+        }
+
+        /** Evaluates 'expr' against 'doc' into 'result', or the code of the error into 'code'. */
+        static void evaluate(const intrusive_ptr<Expression>& expr, const Document& doc,
+                             Value* result, int* code) {
+            *code = 0;
+            try {
+                *result = expr->evaluate(doc);
+            }
+            catch (const UserException& e) {
+                *code = e.getCode();
+            }
+        }
+
+        /** Compiled expressions give the same results and errors as the tree they came from. */
+        class SameAsTree {
+        public:
+            void run() {
+                const char* specs[] = {
+                    "{$add: ['$a', '$b']}",
+                    "{$add: ['$a', '$b', 1.5]}",
+                    "{$add: ['$a', '$c.d']}",
+                    "{$multiply: ['$a', '$b', 3]}",
+                    "{$subtract: ['$a', '$b']}",
+                    "{$subtract: ['$a', 1]}",
+                    "{$divide: ['$a', '$b']}",
+                    "{$mod: ['$a', '$b']}",
+                    "{$mod: ['$a', 2.5]}",
+                    "{$eq: ['$a', '$b']}",
+                    "{$ne: ['$a', 1]}",
+                    "{$gt: ['$a', '$b']}",
+                    "{$gte: [{$add: ['$a', 1]}, '$b']}",
+                    "{$lt: ['$a', 'str']}",
+                    "{$lte: ['$c.d', 4]}",
+                    "{$cmp: ['$a', '$b']}",
+                    "{$and: ['$a', '$b']}",
+                    "{$and: [{$gt: ['$b', 0]}, {$gt: [{$divide: ['$a', '$b']}, 1]}]}",
+                    "{$or: [{$eq: ['$b', 0]}, {$gt: [{$divide: ['$a', '$b']}, 1]}]}",
+                    "{$or: ['$a', '$c']}",
+                    "{$not: [{$lt: ['$a', 3]}]}",
+                    "{$and: ['$a', true]}",
+                };
+                const vector<Document> docs = inputDocuments();
+
+                for (size_t i = 0; i < sizeof(specs) / sizeof(specs[0]); i++) {
+                    const intrusive_ptr<Expression> tree = parseOptimized(fromjson(specs[i]));
+                    const intrusive_ptr<Expression> compiled = ExpressionCompiled::compile(tree);
+                    ASSERT(dynamic_cast<ExpressionCompiled*>(compiled.get()));
+                    ASSERT_EQUALS(tree->serialize(false), compiled->serialize(false));
+
+                    for (size_t j = 0; j < docs.size(); j++) {
+                        Value expected;
+                        int expectedCode;
+                        evaluate(tree, docs[j], &expected, &expectedCode);
+                        Value actual;
+                        int actualCode;
+                        evaluate(compiled, docs[j], &actual, &actualCode);
+
+                        const string context = str::stream() << specs[i] << " on "
+                                                             << docs[j].toString();
+                        ASSERT(expectedCode == actualCode) << context;
+                        ASSERT(expected.getType() == actual.getType()) << context;
+                        ASSERT(Value::compare(expected, actual) == 0) << context;
+                    }
+                }
+            }
+        };
+
+        /** Expressions the program can't evaluate are left as they are. */
+        class NotCompiled {
+        public:
+            void run() {
+                assertNotCompiled("{$concat: ['$a', '$b']}");
+                assertNotCompiled("{$add: ['$a', {$size: '$b'}]}");
+                assertNotCompiled("{$add: ['$$ROOT', 1]}");
+                assertNotCompiled("{$let: {vars: {x: 1}, in: {$add: ['$$x', '$a']}}}");
+            }
+
+        private:
+            void assertNotCompiled(const char* spec) {
+                const intrusive_ptr<Expression> tree = parseOptimized(fromjson(spec));
+                ASSERT(ExpressionCompiled::compile(tree) == tree);
+            }
+        };
+
+        /** Programs that would need a deeper stack than kMaxStackDepth are not compiled. */
+        class TooDeep {
+        public:
+            void run() {
+                BSONObj spec = BSON("$add" << BSON_ARRAY("$a" << 1));
+                for (size_t i = 0; i < ExpressionCompiled::kMaxStackDepth; i++) {
+                    spec = BSON("$subtract" << BSON_ARRAY("$a" << spec));
+                }
+                const intrusive_ptr<Expression> tree = parseOptimized(spec);
+                ASSERT(ExpressionCompiled::compile(tree) == tree);
+            }
+        };
+
+        /** $project and $group compile their computed fields when they are optimized. */
+        class CompiledByOptimize {
+        public:
+            void run() {
+                VariablesIdGenerator idGenerator;
+                VariablesParseState vps(&idGenerator);
+                Expression::ObjectCtx ctx(Expression::ObjectCtx::DOCUMENT_OK
+                                          | Expression::ObjectCtx::TOP_LEVEL
+                                          | Expression::ObjectCtx::INCLUSION_OK);
+                const intrusive_ptr<ExpressionObject> projection =
+                    dynamic_pointer_cast<ExpressionObject>(Expression::parseObject(
+                        fromjson("{a: 1, sum: {$add: ['$a', '$b']}, cond: {$cond: [true, "
+                                 "{$multiply: ['$a', 2]}, '$b']}}"),
+                        &ctx, vps)->optimize());
+
+                // The constant $cond is folded to its 'then' branch.
+                ASSERT_EQUALS(fromjson("{a: true, sum: {$add: ['$a', '$b']},"
+                                       " cond: {$multiply: ['$a', {$const: 2}]}}"),
+                              projection->serialize(false).getDocument().toBson());
+
+                const Document input(fromjson("{a: 3, b: 4}"));
+                Variables vars(0, input);
+                MutableDocument out;
+                projection->addToDocument(out, input, &vars);
+                ASSERT_EQUALS(Document(fromjson("{a: 3, sum: 7, cond: 6}")), out.freeze());
+            }
+        };
+
+        /**
+         * Wide documents for checking compiled $project and $group expressions.  perftests.cpp
+         * compares their speed on the same documents.
+         */
+        static vector<Document> wideDocuments() {
+            vector<Document> docs;
+            for (int i = 0; i < 1000; ++i) {
+                BSONObjBuilder bob;
+                bob.append("_id", i);
+                bob.append("group", i % 10);
+                bob.append("price", 1.5 + i % 100);
+                bob.append("qty", i % 7);
+                bob.append("discount", i % 3 ? 0.1 : 0.0);
+                for (int f = 0; f < 10; ++f) {
+                    bob.append(std::string(str::stream() << "f" << f), i + f);
+                }
+                docs.push_back(Document(bob.obj()));
+            }
+            return docs;
+        }
+
+        /** An optimized $project computes the same fields as the unoptimized one. */
+        class ProjectSameAsTree {
+        public:
+            void run() {
+                const BSONObj spec = fromjson(
+                    "{_id: 0,"
+                    " total: {$multiply: ['$price', '$qty', {$subtract: [1, '$discount']}]},"
+                    " big: {$and: [{$gt: ['$qty', 3]}, {$gte: ['$price', 50]}]},"
+                    " bucket: {$mod: ['$f9', 4]}}");
+                VariablesIdGenerator idGenerator;
+                VariablesParseState vps(&idGenerator);
+                Expression::ObjectCtx ctx(Expression::ObjectCtx::DOCUMENT_OK
+                                          | Expression::ObjectCtx::TOP_LEVEL
+                                          | Expression::ObjectCtx::INCLUSION_OK);
+                const intrusive_ptr<ExpressionObject> interpreted =
+                    dynamic_pointer_cast<ExpressionObject>(
+                        Expression::parseObject(spec, &ctx, vps));
+                const intrusive_ptr<ExpressionObject> compiled =
+                    dynamic_pointer_cast<ExpressionObject>(
+                        Expression::parseObject(spec, &ctx, vps)->optimize());
+                const vector<Document> docs = wideDocuments();
+
+                for (size_t i = 0; i < docs.size(); ++i) {
+                    ASSERT_EQUALS(project(interpreted, docs[i]), project(compiled, docs[i]));
+                }
+            }
+
+        private:
+            static Document project(const intrusive_ptr<ExpressionObject>& projection,
+                                    const Document& doc) {
+                Variables vars(0, doc);
+                MutableDocument out(projection->getSizeHint());
+                projection->addToDocument(out, doc, &vars);
+                return out.freeze();
+            }
+        };
+
+        /** $group accumulators give the same result for a compiled argument as for its tree. */
+        class GroupSameAsTree {
+        public:
+            void run() {
+                check(fromjson("{$multiply: ['$price', '$qty']}"), &AccumulatorSum::create);
+                check(fromjson("{$subtract: ['$price', {$multiply: ['$price', '$discount']}]}"),
+                      &AccumulatorAvg::create);
+                check(fromjson("{$add: ['$f1', '$f5', '$f9']}"), &AccumulatorMinMax::createMax);
+            }
+
+        private:
+            typedef intrusive_ptr<Accumulator> (*AccumulatorFactory)();
+
+            void check(const BSONObj& spec, AccumulatorFactory factory) {
+                const intrusive_ptr<Expression> interpreted = parseOptimized(spec);
+                const intrusive_ptr<Expression> compiled =
+                    ExpressionCompiled::compile(interpreted);
+                ASSERT(dynamic_cast<ExpressionCompiled*>(compiled.get()));
+                const vector<Document> docs = wideDocuments();
+
+                ASSERT_EQUALS(accumulate(interpreted, docs, factory),
+                              accumulate(compiled, docs, factory));
+            }
+
+            static Value accumulate(const intrusive_ptr<Expression>& expr,
+                                    const vector<Document>& docs,
+                                    AccumulatorFactory factory) {
+                intrusive_ptr<Accumulator> acc = factory();
+                Variables vars(0);
+                for (size_t i = 0; i < docs.size(); ++i) {
+                    vars.setRoot(docs[i]);
+                    acc->process(expr->evaluate(&vars), false);
+                }
+                return acc->getValue(false);
+            }
+        };
+
+    } // namespace Compiled
+
     class All : public Suite {
     public:
         All() : Suite( "expression" ) {
@@ -3739,6 +3997,13 @@ namespace ExpressionTests {
             add<AllAnyElements::TrueViaInt>();
             add<AllAnyElements::FalseViaInt>();
             add<AllAnyElements::Null>();
+
+            add<Compiled::SameAsTree>();
+            add<Compiled::NotCompiled>();
+            add<Compiled::TooDeep>();
+            add<Compiled::CompiledByOptimize>();
+            add<Compiled::ProjectSameAsTree>();
+            add<Compiled::GroupSameAsTree>();
         }
     } myall;
 
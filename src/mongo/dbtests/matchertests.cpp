@@ -30,6 +30,7 @@
  */
 
 #include "mongo/db/json.h"
+#include "mongo/db/matcher/expression_compiled.h"
 #include "mongo/db/matcher/matcher.h"
 #include "mongo/db/operation_context_impl.h"
 #include "mongo/dbtests/dbtests.h"
@@ -247,6 +248,41 @@ namespace MatcherTests {
     };
 
 
+    /**
+     * Checks that a query's compiled MatchExpression matches the same documents as the
+     * MatchExpression, over documents with enough fields that finding the queried ones takes
+     * some work.  perftests.cpp compares their speed.
+     */
+    class CompiledEquivalence {
+    public:
+        void run() {
+            check(BSON("f7" << 7));
+            check(BSON("f2" << GT << 1 << "f7" << 7 << "f9" << BSON("$exists" << true)));
+            check(BSON("s" << "abc" << "f5" << BSON("$in" << BSON_ARRAY(4 << 5 << 6))));
+            check(BSON("f3" << 3 << "f8" << LT << 0));
+        }
+
+    private:
+        void check(const BSONObj& query) {
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(query);
+            ASSERT_OK(swme.getStatus());
+            boost::scoped_ptr<MatchExpression> expr(swme.getValue());
+            boost::scoped_ptr<CompiledMatchExpression> compiled(
+                CompiledMatchExpression::compile(expr.get()));
+            ASSERT(NULL != compiled.get());
+
+            for (int i = 0; i < 100; ++i) {
+                BSONObjBuilder bob;
+                for (int f = 0; f < 10; ++f) {
+                    bob.append(std::string(str::stream() << "f" << f), (i + f) % 10);
+                }
+                bob.append("s", i % 2 ? "abc" : "xyz");
+                const BSONObj doc = bob.obj();
+                ASSERT_EQUALS(expr->matchesBSON(doc), compiled->matchesBSON(doc));
+            }
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "matcher" ) {
@@ -269,6 +305,7 @@ namespace MatcherTests {
             ADD_BOTH(WithinBox);
             ADD_BOTH(WithinCenter);
             ADD_BOTH(WithinPolygon);
+            add<CompiledEquivalence>();
         }
     } dball;
 
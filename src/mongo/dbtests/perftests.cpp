@@ -41,11 +41,26 @@
 #include <iomanip>
 #include <fstream>
 
+#include "mongo/db/catalog/database.h"
+#include "mongo/db/concurrency/lock_state.h"
 #include "mongo/db/db.h"
 #include "mongo/db/dbdirectclient.h"
+#include "mongo/db/exec/collection_scan.h"
+#include "mongo/db/exec/working_set.h"
 #include "mongo/db/json.h"
 #include "mongo/db/lasterror.h"
+#include "mongo/db/matcher/expression_compiled.h"
+#include "mongo/db/matcher/expression_parser.h"
 #include "mongo/db/operation_context_impl.h"
+#include "mongo/db/operation_context_noop.h"
+#include "mongo/db/pipeline/accumulator.h"
+#include "mongo/db/pipeline/document.h"
+#include "mongo/db/pipeline/expression.h"
+#include "mongo/db/pipeline/expression_compiled.h"
+#include "mongo/db/query/plan_executor.h"
+#include "mongo/db/storage/heap1/heap1_btree_impl.h"
+#include "mongo/db/storage/heap1/heap1_recovery_unit.h"
+#include "mongo/db/storage/heap1/record_store_heap.h"
 #include "mongo/db/storage/mmap_v1/durable_mapped_file.h"
 #include "mongo/db/storage/mmap_v1/dur_stats.h"
 #include "mongo/db/storage/mmap_v1/btree/key.h"
@@ -57,6 +72,7 @@
 #include "mongo/util/fail_point.h"
 #include "mongo/util/log.h"
 #include "mongo/util/mmap.h"
+#include "mongo/util/processinfo.h"
 #include "mongo/util/timer.h"
 #include "mongo/util/version.h"
 #include "mongo/util/version_reporting.h"
@@ -192,6 +208,9 @@ namespace PerfTests {
         /* override if your test output doesn't need that */
         virtual bool showDurStats() { return true; }
 
+        /* override to report the size of the collection after the test */
+        virtual bool showCollectionSize() { return false; }
+
     public:
         virtual unsigned batchSize() { return 50; }
 
@@ -324,6 +343,14 @@ namespace PerfTests {
 
             post();
 
+            if( showCollectionSize() ) {
+                BSONObj stats;
+                client()->runCommand("perftest", BSON("collStats" << name()), stats);
+                cout << "stats " << setw(42) << left << name() << " size: " << stats["size"].numberLong()
+                     << " storageSize: " << stats["storageSize"].numberLong()
+                     << " residentMB: " << ProcessInfo().getResidentSize() << endl;
+            }
+
             string test2name = name2();
             {
                 if( test2name != name() ) {
@@ -1075,6 +1102,51 @@ namespace PerfTests {
         }
     };
 
+    /** inserts documents that are mostly text, then looks them up by _id */
+    class InsertText : public B {
+        string text;
+    public:
+        virtual int howLongMillis() { return profiling ? 30000 : 5000; }
+        InsertText() : i(0) {
+            for( int j = 0; j < 20; j++ )
+                text += "the quick brown fox jumps over the lazy dog, again and again. ";
+        }
+        string name() { return "insert-text"; }
+        virtual bool showCollectionSize() { return true; }
+        unsigned i;
+        void timed() {
+            BSONObj o = BSON( "_id" << i << "n" << i << "text" << text );
+            i++;
+            client()->insert( ns(), o );
+        }
+        string name2() {
+            return "findOne_by_id-text";
+        }
+        void timed2(DBClientBase* c) {
+            Query q = QUERY( "_id" << (unsigned) (rand() % i) );
+            c->findOne(ns(), q);
+        }
+    };
+
+    /** runs T on a collection created with compressRecords, and reports how much it saved */
+    template <typename T>
+    class CompressedRecords : public T {
+    public:
+        string name() { return T::name() + "-compressed"; }
+        string name2() {
+            return T::name2() == T::name() ? name() : T::name2() + "-compressed";
+        }
+        void prep() {
+            BSONObj info;
+            verify( this->client()->runCommand( "perftest",
+                                                BSON( "create" << name() <<
+                                                      "compressRecords" << true ),
+                                                info ) );
+            T::prep();
+        }
+        virtual bool showCollectionSize() { return true; }
+    };
+
     template <typename T>
     class MoreIndexes : public T {
     public:
@@ -1086,6 +1158,308 @@ namespace PerfTests {
         }
     };
 
+    /** full scans of a heap1 record store of small records, reporting the space used per record */
+    class Heap1Scan : public B {
+        static const int N = 200 * 1000;
+        scoped_ptr<HeapRecordStore> rs;
+        scoped_ptr<OperationContext> txn;
+    public:
+        string name() { return "heap1-scan"; }
+        virtual int howLongMillis() { return 2000; }
+        virtual bool showDurStats() { return false; }
+        virtual unsigned batchSize() { return 1; }
+        void prep() {
+            rs.reset( new HeapRecordStore( "perftest.heap1scan" ) );
+            txn.reset( new OperationContextNoop( new Heap1RecoveryUnit() ) );
+            const string s( 50, 'x' );
+            for( int i = 0; i < N; i++ )
+                verify( rs->insertRecord( txn.get(), s.c_str(), s.size() + 1, false ).isOK() );
+        }
+        void timed() {
+            scoped_ptr<RecordIterator> it( rs->getIterator( txn.get(), DiskLoc(), false,
+                                                            CollectionScanParams::FORWARD ) );
+            while( !it->isEOF() ) {
+                DiskLoc loc = it->getNext();
+                dontOptimizeOutHopefully += it->dataFor( loc ).size();
+            }
+        }
+        void post() {
+            cout << "stats " << setw(42) << left << name() << " bytes per record: "
+                 << rs->storageSize( txn.get() ) / N << endl;
+        }
+    };
+
+    /**
+     * nThreads writers each inserting N records, with an _id index entry, into one heap1 record
+     * store and then updating them, either relying on document locks or serialized by a
+     * collection X lock the way writers were before heap1 supported document locking.  Every
+     * tenth insert is rolled back.
+     */
+    template <bool docLocking, int nThreads>
+    class Heap1Writers : public B {
+        // OperationContextNoop has no Locker, which would leave the documents unlocked.
+        class LockingOperationContext : public OperationContextNoop {
+        public:
+            LockingOperationContext() : OperationContextNoop( new Heap1RecoveryUnit() ) {}
+            virtual Locker* lockState() const { return &_locker; }
+        private:
+            mutable LockState _locker;
+        };
+
+        static const int N = 1000;
+        scoped_ptr<HeapRecordStore> rs;
+        boost::shared_ptr<void> indexData;
+        scoped_ptr<SortedDataInterface> index;
+        int round;
+    public:
+        string name() {
+            return str::stream() << "heap1-writers-" << nThreads
+                                 << ( docLocking ? "-doclocks" : "-collectionlock" );
+        }
+        virtual int howLongMillis() { return 3000; }
+        virtual bool showDurStats() { return false; }
+        virtual unsigned batchSize() { return 1; }
+        void prep() {
+            rs.reset( new HeapRecordStore( "perftest.heap1writers" ) );
+            index.reset( getHeap1BtreeImpl( Ordering::make( BSON( "_id" << 1 ) ), &indexData ) );
+            round = 0;
+        }
+        void timed() {
+            boost::thread_group threads;
+            for( int i = 0; i < nThreads; i++ ) {
+                threads.create_thread( stdx::bind( &Heap1Writers::writer, this,
+                                                   ( round * nThreads + i ) * N ) );
+            }
+            threads.join_all();
+            round++;
+        }
+        void writer( int firstId ) {
+            LockingOperationContext txn;
+            Locker* locker = txn.lockState();
+            const newlm::ResourceId collection( newlm::RESOURCE_COLLECTION, rs->ns() );
+            const newlm::LockMode mode = docLocking ? newlm::MODE_IX : newlm::MODE_X;
+            locker->lockGlobal( newlm::MODE_IX );
+
+            vector<DiskLoc> inserted;
+            for( int id = firstId; id < firstId + N; id++ ) {
+                const BSONObj doc = BSON( "_id" << id << "n" << 0 );
+                verify( locker->lock( collection, mode ) == newlm::LOCK_OK );
+                {
+                    WriteUnitOfWork wunit( &txn );
+                    StatusWith<DiskLoc> res = rs->insertRecord( &txn, doc.objdata(),
+                                                                doc.objsize(), false );
+                    verify( res.isOK() );
+                    verify( index->insert( &txn, BSON( "" << id ), res.getValue(), false ).isOK() );
+                    if( id % 10 != 9 ) {
+                        wunit.commit();
+                        inserted.push_back( res.getValue() );
+                    }
+                }
+                locker->unlock( collection );
+            }
+
+            for( size_t i = 0; i < inserted.size(); i++ ) {
+                verify( locker->lock( collection, mode ) == newlm::LOCK_OK );
+                {
+                    WriteUnitOfWork wunit( &txn );
+                    BSONObj doc = rs->dataFor( &txn, inserted[i] ).toBson();
+                    doc = BSON( "_id" << doc["_id"] << "n" << 1 );
+                    verify( rs->updateRecord( &txn, inserted[i], doc.objdata(), doc.objsize(),
+                                              false, NULL ).isOK() );
+                    wunit.commit();
+                }
+                locker->unlock( collection );
+            }
+
+            locker->unlockGlobal();
+        }
+    };
+
+    /** scans a collection with a filter, either a result or a batch of results at a time */
+    template <bool batched>
+    class CollscanFilter : public B {
+        scoped_ptr<MatchExpression> filter;
+    public:
+        string name() { return batched ? "collscan-filter-batched" : "collscan-filter"; }
+        virtual int howLongMillis() { return 2000; }
+        virtual bool showDurStats() { return false; }
+        virtual unsigned batchSize() { return 1; }
+        void prep() {
+            for( int i = 0; i < 10000; i++ )
+                insert( ns(), BSON( "_id" << i << "x" << i % 10 ) );
+            StatusWithMatchExpression swme =
+                MatchExpressionParser::parse( BSON( "x" << GTE << 5 ) );
+            verify( swme.isOK() );
+            filter.reset( swme.getValue() );
+        }
+        void timed() {
+            OperationContextImpl txn;
+            Client::ReadContext ctx( &txn, ns() );
+            CollectionScanParams params;
+            params.collection = ctx.ctx().db()->getCollection( &txn, ns() );
+            WorkingSet* ws = new WorkingSet();
+            PlanExecutor exec( ws, new CollectionScan( &txn, params, ws, filter.get() ),
+                               params.collection );
+            exec.setBatchedExecution( batched );
+            for( BSONObj obj; PlanExecutor::ADVANCED == exec.getNext( &obj, NULL ); )
+                dontOptimizeOutHopefully++;
+        }
+    };
+
+    /** matches a query against documents with a dozen fields, by its MatchExpression or compiled */
+    template <bool compiled>
+    class MatchFilter : public B {
+        scoped_ptr<MatchExpression> expr;
+        scoped_ptr<CompiledMatchExpression> program;
+        vector<BSONObj> docs;
+    public:
+        string name() { return compiled ? "match-filter-compiled" : "match-filter"; }
+        virtual int howLongMillis() { return 2000; }
+        virtual bool showDurStats() { return false; }
+        void prep() {
+            for( int i = 0; i < 100; i++ ) {
+                BSONObjBuilder b;
+                for( int f = 0; f < 10; f++ )
+                    b.append( string( str::stream() << "f" << f ), ( i + f ) % 10 );
+                b.append( "s", i % 2 ? "abc" : "xyz" );
+                docs.push_back( b.obj() );
+            }
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(
+                BSON( "f2" << GT << 1 << "f7" << 7 << "f9" << BSON( "$exists" << true ) ) );
+            verify( swme.isOK() );
+            expr.reset( swme.getValue() );
+            program.reset( CompiledMatchExpression::compile( expr.get() ) );
+            verify( program.get() );
+        }
+        void timed() {
+            for( size_t i = 0; i < docs.size(); i++ ) {
+                if( compiled ? program->matchesBSON( docs[i] ) : expr->matchesBSON( docs[i] ) )
+                    dontOptimizeOutHopefully++;
+            }
+        }
+    };
+
+    /**
+     * converts a wide BSON document to a Document eagerly or lazily, then either converts it
+     * back, as a cursor source passing documents through does, or reads two of its fields
+     */
+    template <bool lazy, bool twoFields>
+    class DocumentFromBson : public B {
+        BSONObj obj;
+    public:
+        string name() {
+            return string( lazy ? "document-lazy" : "document-eager" ) +
+                   ( twoFields ? "-two-fields" : "-pass-through" );
+        }
+        virtual int howLongMillis() { return 2000; }
+        virtual bool showDurStats() { return false; }
+        void prep() {
+            BSONObjBuilder b;
+            for( int i = 0; i < 40; i++ ) {
+                b.append( string( str::stream() << "field" << i ), i );
+                b.append( string( str::stream() << "string" << i ), "some string value" );
+            }
+            b.append( "sub", fromjson( "{a:[1,2,3],b:{c:1,d:'e'}}" ) );
+            obj = b.obj();
+        }
+        void timed() {
+            Document doc = lazy ? Document::fromBsonLazy( obj )
+                                : Document::fromBsonWithMetaData( obj );
+            if( twoFields ) {
+                dontOptimizeOutHopefully += doc["field37"].getInt();
+                if( !doc["string3"].missing() )
+                    dontOptimizeOutHopefully++;
+            }
+            else {
+                dontOptimizeOutHopefully += doc.toBson().objsize();
+            }
+        }
+    };
+
+    /** documents for the aggregation expression tests, with a few computed-on fields */
+    static vector<Document> expressionDocuments() {
+        vector<Document> docs;
+        for( int i = 0; i < 1000; i++ ) {
+            BSONObjBuilder b;
+            b.append( "_id", i );
+            b.append( "group", i % 10 );
+            b.append( "price", 1.5 + i % 100 );
+            b.append( "qty", i % 7 );
+            b.append( "discount", i % 3 ? 0.1 : 0.0 );
+            for( int f = 0; f < 10; f++ )
+                b.append( string( str::stream() << "f" << f ), i + f );
+            docs.push_back( Document( b.obj() ) );
+        }
+        return docs;
+    }
+
+    /** computes the fields of a $project, with or without compiling its expressions */
+    template <bool compiled>
+    class ProjectExpressions : public B {
+        intrusive_ptr<ExpressionObject> projection;
+        vector<Document> docs;
+        size_t i;
+    public:
+        ProjectExpressions() : i(0) { }
+        string name() { return compiled ? "project-expressions-compiled" : "project-expressions"; }
+        virtual int howLongMillis() { return 2000; }
+        virtual bool showDurStats() { return false; }
+        void prep() {
+            VariablesIdGenerator idGenerator;
+            VariablesParseState vps( &idGenerator );
+            Expression::ObjectCtx ctx( Expression::ObjectCtx::DOCUMENT_OK
+                                       | Expression::ObjectCtx::TOP_LEVEL
+                                       | Expression::ObjectCtx::INCLUSION_OK );
+            intrusive_ptr<Expression> expr = Expression::parseObject(
+                fromjson( "{_id: 0,"
+                          " total: {$multiply: ['$price', '$qty', {$subtract: [1, '$discount']}]},"
+                          " big: {$and: [{$gt: ['$qty', 3]}, {$gte: ['$price', 50]}]},"
+                          " bucket: {$mod: ['$f9', 4]}}" ),
+                &ctx, vps );
+            // Optimizing an ExpressionObject is what compiles its fields.
+            if( compiled )
+                expr = expr->optimize();
+            projection = dynamic_pointer_cast<ExpressionObject>( expr );
+            verify( projection.get() );
+            docs = expressionDocuments();
+        }
+        void timed() {
+            const Document& doc = docs[i++ % docs.size()];
+            Variables vars( 0, doc );
+            MutableDocument out( projection->getSizeHint() );
+            projection->addToDocument( out, doc, &vars );
+            dontOptimizeOutHopefully += out.freeze().size();
+        }
+    };
+
+    /** evaluates a $sum argument for each document, compiled or as an expression tree */
+    template <bool compiled>
+    class GroupExpression : public B {
+        intrusive_ptr<Expression> expr;
+        intrusive_ptr<Accumulator> acc;
+        vector<Document> docs;
+        size_t i;
+    public:
+        GroupExpression() : i(0) { }
+        string name() { return compiled ? "group-expression-compiled" : "group-expression"; }
+        virtual int howLongMillis() { return 2000; }
+        virtual bool showDurStats() { return false; }
+        void prep() {
+            VariablesIdGenerator idGenerator;
+            VariablesParseState vps( &idGenerator );
+            BSONObj spec = BSON( "" << fromjson( "{$multiply: ['$price', '$qty']}" ) );
+            expr = Expression::parseOperand( spec.firstElement(), vps )->optimize();
+            if( compiled )
+                expr = ExpressionCompiled::compile( expr );
+            acc = AccumulatorSum::create();
+            docs = expressionDocuments();
+        }
+        void timed() {
+            Variables vars( 0, docs[i++ % docs.size()] );
+            acc->process( expr->evaluate( &vars ), false );
+        }
+    };
+
     // Tests what the worst case is for the overhead of enabling a fail point. If 'fpInjected'
     // is false, then the fail point will be compiled out. If 'fpInjected' is true, then the
     // fail point will be compiled in. Since the conditioned block is more or less trivial, any
@@ -1367,6 +1741,27 @@ namespace PerfTests {
                 add< Update1 >();
                 add< MoreIndexes<Update1> >();
                 add< InsertBig >();
+                add< InsertText >();
+                add< CompressedRecords<InsertText> >();
+                add< CompressedRecords<Insert1> >();
+                add< CompressedRecords<Update1> >();
+                add< Heap1Scan >();
+                add< Heap1Writers<false, 1> >();
+                add< Heap1Writers<true, 1> >();
+                add< Heap1Writers<false, 4> >();
+                add< Heap1Writers<true, 4> >();
+                add< CollscanFilter<false> >();
+                add< CollscanFilter<true> >();
+                add< MatchFilter<false> >();
+                add< MatchFilter<true> >();
+                add< DocumentFromBson<false, false> >();
+                add< DocumentFromBson<true, false> >();
+                add< DocumentFromBson<false, true> >();
+                add< DocumentFromBson<true, true> >();
+                add< ProjectExpressions<false> >();
+                add< ProjectExpressions<true> >();
+                add< GroupExpression<false> >();
+                add< GroupExpression<true> >();
                 add< FailPointTest<false, false> >();
                 add< FailPointTest<true, false> >();
                 add< FailPointTest<true, true> >();
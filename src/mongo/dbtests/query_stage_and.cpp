@@ -884,6 +884,283 @@ namespace QueryStageAnd {
         }
     };
 
+    /**
+     * A locs-only hashed AND keeps just DiskLocs while hashing, so the large keys that make
+     * QueryStageAndHashTwoLeafFirstChildLargeKeys run out of memory fit easily.  The results are
+     * the members produced by the last child.
+     */
+    class QueryStageAndHashLocsOnlyLargeKeys : public QueryStageAndBase {
+    public:
+        void run() {
+            Client::WriteContext ctx(&_txn, ns());
+            Database* db = ctx.ctx().db();
+            Collection* coll = db->getCollection(&_txn, ns());
+            if (!coll) {
+                coll = db->createCollection(&_txn, ns());
+            }
+
+            std::string big(512, 'a');
+            for (int i = 0; i < 50; ++i) {
+                insert(BSON("foo" << i << "bar" << i << "big" << big));
+            }
+
+            addIndex(BSON("foo" << 1 << "big" << 1));
+            addIndex(BSON("bar" << 1));
+
+            WorkingSet ws;
+            scoped_ptr<AndHashStage> ah(new AndHashStage(&_txn, &ws, NULL, coll, 20 * big.size()));
+            ah->setLocsOnly();
+
+            // Foo <= 20
+            IndexScanParams params;
+            params.descriptor = getIndex(BSON("foo" << 1 << "big" << 1), coll);
+            params.bounds.isSimpleRange = true;
+            params.bounds.startKey = BSON("" << 20 << "" << big);
+            params.bounds.endKey = BSONObj();
+            params.bounds.endKeyInclusive = true;
+            params.direction = -1;
+            ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
+
+            // Bar >= 10
+            params.descriptor = getIndex(BSON("bar" << 1), coll);
+            params.bounds.startKey = BSON("" << 10);
+            params.bounds.endKey = BSONObj();
+            params.bounds.endKeyInclusive = true;
+            params.direction = 1;
+            ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
+            ctx.commit();
+
+            int count = 0;
+            while (!ah->isEOF()) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                PlanStage::StageState status = ah->work(&id);
+                ASSERT_NOT_EQUALS(PlanStage::FAILURE, status);
+                if (PlanStage::ADVANCED != status) { continue; }
+
+                ++count;
+                WorkingSetMember* member = ws.get(id);
+                ASSERT_TRUE(member->hasLoc());
+                ASSERT_FALSE(member->hasObj());
+
+                // Only the key of the last child, the index on bar, is present.
+                BSONElement elt;
+                ASSERT_TRUE(member->getFieldDotted("bar", &elt));
+                ASSERT_FALSE(member->getFieldDotted("foo", &elt));
+            }
+            ASSERT_EQUALS(11, count);
+        }
+    };
+
+    /**
+     * Invalidate a DiskLoc held by a locs-only hashed AND.  The AND must fetch the document
+     * itself to flag it, since it kept no WorkingSetMember for it.
+     */
+    class QueryStageAndHashLocsOnlyInvalidation : public QueryStageAndBase {
+    public:
+        void run() {
+            Client::WriteContext ctx(&_txn, ns());
+            Database* db = ctx.ctx().db();
+            Collection* coll = db->getCollection(&_txn, ns());
+            if (!coll) {
+                coll = db->createCollection(&_txn, ns());
+            }
+
+            for (int i = 0; i < 50; ++i) {
+                insert(BSON("foo" << i << "bar" << i));
+            }
+
+            addIndex(BSON("foo" << 1));
+            addIndex(BSON("bar" << 1));
+
+            WorkingSet ws;
+            scoped_ptr<AndHashStage> ah(new AndHashStage(&_txn, &ws, NULL, coll));
+            ah->setLocsOnly();
+
+            // Foo <= 20
+            IndexScanParams params;
+            params.descriptor = getIndex(BSON("foo" << 1), coll);
+            params.bounds.isSimpleRange = true;
+            params.bounds.startKey = BSON("" << 20);
+            params.bounds.endKey = BSONObj();
+            params.bounds.endKeyInclusive = true;
+            params.direction = -1;
+            ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
+
+            // Bar >= 10
+            params.descriptor = getIndex(BSON("bar" << 1), coll);
+            params.bounds.startKey = BSON("" << 10);
+            params.bounds.endKey = BSONObj();
+            params.bounds.endKeyInclusive = true;
+            params.direction = 1;
+            ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
+
+            // Read half of the first child, yield and invalidate foo == 15.
+            for (int i = 0; i < 10; ++i) {
+                WorkingSetID out;
+                ASSERT_EQUALS(PlanStage::NEED_TIME, ah->work(&out));
+            }
+            ah->saveState();
+            set<DiskLoc> data;
+            getLocs(&data, coll);
+            for (set<DiskLoc>::const_iterator it = data.begin(); it != data.end(); ++it) {
+                if (coll->docFor(&_txn, *it)["foo"].numberInt() == 15) {
+                    ah->invalidate(*it, INVALIDATION_DELETION);
+                    remove(coll->docFor(&_txn, *it));
+                    break;
+                }
+            }
+            ah->restoreState(&_txn);
+
+            const unordered_set<WorkingSetID>& flagged = ws.getFlagged();
+            ASSERT_EQUALS(size_t(1), flagged.size());
+            WorkingSetMember* member = ws.get(*flagged.begin());
+            ASSERT_EQUALS(WorkingSetMember::OWNED_OBJ, member->state);
+            BSONElement elt;
+            ASSERT_TRUE(member->getFieldDotted("foo", &elt));
+            ASSERT_EQUALS(15, elt.numberInt());
+
+            // 11 results less the invalidated one.
+            int count = 0;
+            while (!ah->isEOF()) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                PlanStage::StageState status = ah->work(&id);
+                if (PlanStage::ADVANCED != status) { continue; }
+
+                ++count;
+                ASSERT_TRUE(ws.get(id)->getFieldDotted("bar", &elt));
+                ASSERT_NOT_EQUALS(15, elt.numberInt());
+            }
+
+            ctx.commit();
+            ASSERT_EQUALS(10, count);
+        }
+    };
+
+    /**
+     * A locs-only hashed AND with a filter fetches the survivors to match them.
+     */
+    class QueryStageAndHashLocsOnlyWithMatcher : public QueryStageAndBase {
+    public:
+        void run() {
+            Client::WriteContext ctx(&_txn, ns());
+            Database* db = ctx.ctx().db();
+            Collection* coll = db->getCollection(&_txn, ns());
+            if (!coll) {
+                coll = db->createCollection(&_txn, ns());
+            }
+
+            for (int i = 0; i < 50; ++i) {
+                insert(BSON("foo" << i << "bar" << i << "baz" << i % 2));
+            }
+
+            addIndex(BSON("foo" << 1));
+            addIndex(BSON("bar" << 1));
+
+            // The filter is on a field neither index has.
+            BSONObj filter = BSON("baz" << 1);
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(filter);
+            verify(swme.isOK());
+            auto_ptr<MatchExpression> expr(swme.getValue());
+
+            WorkingSet ws;
+            scoped_ptr<AndHashStage> ah(new AndHashStage(&_txn, &ws, expr.get(), coll));
+            ah->setLocsOnly();
+
+            // Foo <= 20
+            IndexScanParams params;
+            params.descriptor = getIndex(BSON("foo" << 1), coll);
+            params.bounds.isSimpleRange = true;
+            params.bounds.startKey = BSON("" << 20);
+            params.bounds.endKey = BSONObj();
+            params.bounds.endKeyInclusive = true;
+            params.direction = -1;
+            ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
+
+            // Bar >= 10
+            params.descriptor = getIndex(BSON("bar" << 1), coll);
+            params.bounds.startKey = BSON("" << 10);
+            params.bounds.endKey = BSONObj();
+            params.bounds.endKeyInclusive = true;
+            params.direction = 1;
+            ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
+            ctx.commit();
+
+            // Odd values of foo in [10, 20].
+            for (int i = 11; i <= 19; i += 2) {
+                BSONObj obj = getNext(ah.get(), &ws);
+                ASSERT_EQUALS(i, obj["foo"].numberInt());
+                ASSERT_EQUALS(1, obj["baz"].numberInt());
+            }
+            ASSERT_EQUALS(0, countResults(ah.get()));
+        }
+    };
+
+    /**
+     * A locs-only hashed AND uses less memory while hashing than a default one over the same
+     * large intersection.
+     */
+    class QueryStageAndHashLocsOnlyMemory : public QueryStageAndBase {
+    public:
+        void run() {
+            Client::WriteContext ctx(&_txn, ns());
+            Database* db = ctx.ctx().db();
+            Collection* coll = db->getCollection(&_txn, ns());
+            if (!coll) {
+                coll = db->createCollection(&_txn, ns());
+            }
+
+            // Give the first index keys of a realistic size.
+            const int numDocs = 20000;
+            std::string pad(24, 'x');
+            for (int i = 0; i < numDocs; ++i) {
+                insert(BSON("foo" << i << "bar" << i << "pad" << pad));
+            }
+
+            addIndex(BSON("foo" << 1 << "pad" << 1));
+            addIndex(BSON("bar" << 1));
+
+            size_t memUsage[2];
+            for (int locsOnly = 0; locsOnly < 2; ++locsOnly) {
+                WorkingSet ws;
+                scoped_ptr<AndHashStage> ah(new AndHashStage(&_txn, &ws, NULL, coll));
+                if (locsOnly) {
+                    ah->setLocsOnly();
+                }
+
+                // All of foo, intersected with bar >= numDocs / 2.
+                IndexScanParams params;
+                params.descriptor = getIndex(BSON("foo" << 1 << "pad" << 1), coll);
+                params.bounds.isSimpleRange = true;
+                params.bounds.startKey = BSON("" << 0 << "" << pad);
+                params.bounds.endKey = BSONObj();
+                params.bounds.endKeyInclusive = true;
+                params.direction = 1;
+                ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
+
+                params.descriptor = getIndex(BSON("bar" << 1), coll);
+                params.bounds.startKey = BSON("" << numDocs / 2);
+                ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
+
+                int count = 0;
+                size_t peakMemUsage = 0;
+                while (!ah->isEOF()) {
+                    WorkingSetID id = WorkingSet::INVALID_ID;
+                    PlanStage::StageState status = ah->work(&id);
+                    ASSERT_NOT_EQUALS(PlanStage::FAILURE, status);
+                    peakMemUsage = std::max(peakMemUsage, ah->getMemUsage());
+                    if (PlanStage::ADVANCED != status) { continue; }
+                    ++count;
+                    ws.free(id);
+                }
+                memUsage[locsOnly] = peakMemUsage;
+                ASSERT_EQUALS(numDocs / 2, count);
+            }
+            ctx.commit();
+
+            ASSERT_LESS_THAN(memUsage[1], memUsage[0]);
+        }
+    };
+
 
     //
     // Sorted AND tests
@@ -1383,6 +1660,10 @@ namespace QueryStageAnd {
             add<QueryStageAndHashInvalidateLookahead>();
             add<QueryStageAndHashFirstChildFetched>();
             add<QueryStageAndHashSecondChildFetched>();
+            add<QueryStageAndHashLocsOnlyLargeKeys>();
+            add<QueryStageAndHashLocsOnlyInvalidation>();
+            add<QueryStageAndHashLocsOnlyWithMatcher>();
+            add<QueryStageAndHashLocsOnlyMemory>();
             add<QueryStageAndSortedInvalidation>();
             add<QueryStageAndSortedThreeLeaf>();
             add<QueryStageAndSortedWithNothing>();
@@ -35,10 +35,12 @@
 #include "mongo/db/catalog/database.h"
 #include "mongo/db/dbdirectclient.h"
 #include "mongo/db/exec/collection_scan.h"
+#include "mongo/db/exec/parallel_collection_scan.h"
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/json.h"
 #include "mongo/db/matcher/expression_parser.h"
 #include "mongo/db/query/plan_executor.h"
+#include "mongo/db/query/query_knobs.h"
 #include "mongo/db/operation_context_impl.h"
 #include "mongo/db/storage/mmap_v1/extent.h"
 #include "mongo/db/storage/mmap_v1/extent_manager.h"
@@ -77,7 +79,8 @@ namespace QueryStageCollectionScan {
             _client.remove(ns(), obj);
         }
 
-        int countResults(CollectionScanParams::Direction direction, const BSONObj& filterObj) {
+        int countResults(CollectionScanParams::Direction direction, const BSONObj& filterObj,
+                         bool batched = false) {
             Client::ReadContext ctx(&_txn, ns());
 
             // Configure the scan.
@@ -95,6 +98,7 @@ namespace QueryStageCollectionScan {
             WorkingSet* ws = new WorkingSet();
             PlanStage* ps = new CollectionScan(&_txn, params, ws, filterExpr.get());
             PlanExecutor runner(ws, ps, params.collection);
+            runner.setBatchedExecution(batched);
 
             // Use the runner to count the number of objects scanned.
             int count = 0;
@@ -365,6 +369,177 @@ namespace QueryStageCollectionScan {
         }
     };
 
+    //
+    // A batched executor still returns a buffered result whose document is deleted.
+    //
+    class QueryStageCollscanBatchedInvalidate : public QueryStageCollectionScanBase {
+    public:
+        void run() {
+            Client::WriteContext ctx(&_txn, ns());
+            Collection* coll = ctx.ctx().db()->getCollection(&_txn, ns());
+
+            vector<DiskLoc> locs;
+            getLocs(coll, CollectionScanParams::FORWARD, &locs);
+
+            CollectionScanParams params;
+            params.collection = coll;
+            params.direction = CollectionScanParams::FORWARD;
+            params.tailable = false;
+
+            WorkingSet* ws = new WorkingSet();
+            PlanStage* ps = new CollectionScan(&_txn, params, ws, NULL);
+            PlanExecutor runner(ws, ps, coll);
+            runner.setBatchedExecution(true);
+
+            // Batches of one and then two results, so locs[2] is buffered.
+            BSONObj obj;
+            for (int i = 0; i < 2; ++i) {
+                ASSERT_EQUALS(PlanExecutor::ADVANCED, runner.getNext(&obj, NULL));
+                ASSERT_EQUALS(i, obj["foo"].numberInt());
+            }
+
+            runner.saveState();
+            runner.invalidate(locs[2], INVALIDATION_DELETION);
+            remove(coll->docFor(&_txn, locs[2]));
+            runner.restoreState(&_txn);
+
+            int count = 2;
+            while (PlanExecutor::ADVANCED == runner.getNext(&obj, NULL)) {
+                ASSERT_EQUALS(count, obj["foo"].numberInt());
+                ++count;
+            }
+            ctx.commit();
+
+            ASSERT_EQUALS(numObj(), count);
+        }
+    };
+
+    /**
+     * A parallel scan finds the same documents as a plain one, whatever the size of the worker
+     * pool.
+     */
+    class QueryStageCollscanParallel : public QueryStageCollectionScanBase {
+    public:
+        QueryStageCollscanParallel()
+            : _oldThreads(internalQueryParallelCollectionScanThreads) { }
+
+        virtual ~QueryStageCollscanParallel() {
+            internalQueryParallelCollectionScanThreads = _oldThreads;
+        }
+
+        void run() {
+            Client::ReadContext ctx(&_txn, ns());
+            Collection* coll = ctx.ctx().db()->getCollection(&_txn, ns());
+
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(BSON("foo" << GTE << 10));
+            verify(swme.isOK());
+            auto_ptr<MatchExpression> filterExpr(swme.getValue());
+
+            // The pool is remade when the knob changes.
+            const int poolThreads[] = { 4, 2, 0 };
+            for (size_t i = 0; i < sizeof(poolThreads) / sizeof(poolThreads[0]); ++i) {
+                internalQueryParallelCollectionScanThreads = poolThreads[i];
+
+                WorkingSet ws;
+                scoped_ptr<ParallelCollectionScan> scan(
+                    new ParallelCollectionScan(&_txn, coll, &ws, filterExpr.get(), 4));
+
+                std::set<int> seen;
+                while (!scan->isEOF()) {
+                    WorkingSetID id = WorkingSet::INVALID_ID;
+                    PlanStage::StageState state = scan->work(&id);
+                    ASSERT_NOT_EQUALS(PlanStage::FAILURE, state);
+                    if (PlanStage::ADVANCED != state) { continue; }
+
+                    WorkingSetMember* member = ws.get(id);
+                    ASSERT_TRUE(member->hasLoc());
+                    ASSERT_TRUE(member->hasObj());
+                    ASSERT_TRUE(seen.insert(member->obj["foo"].numberInt()).second);
+                    ws.free(id);
+                }
+
+                ASSERT_EQUALS(static_cast<size_t>(numObj() - 10), seen.size());
+                ASSERT_EQUALS(10, *seen.begin());
+                ASSERT_EQUALS(numObj() - 1, *seen.rbegin());
+
+                const ParallelCollectionScanStats* stats =
+                    static_cast<const ParallelCollectionScanStats*>(scan->getSpecificStats());
+                ASSERT_EQUALS(static_cast<size_t>(numObj()), stats->docsTested);
+            }
+        }
+
+    private:
+        int _oldThreads;
+    };
+
+    /**
+     * A parallel scan buffers the matches of each round.  A buffered match that is deleted must
+     * not be returned, and one that is modified must be matched again.
+     */
+    class QueryStageCollscanParallelInvalidate : public QueryStageCollectionScanBase {
+    public:
+        void run() {
+            Client::WriteContext ctx(&_txn, ns());
+            Collection* coll = ctx.ctx().db()->getCollection(&_txn, ns());
+
+            vector<DiskLoc> locs;
+            getLocs(coll, CollectionScanParams::FORWARD, &locs);
+
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(BSON("foo" << LT << 40));
+            verify(swme.isOK());
+            auto_ptr<MatchExpression> filterExpr(swme.getValue());
+
+            WorkingSet ws;
+            scoped_ptr<ParallelCollectionScan> scan(
+                new ParallelCollectionScan(&_txn, coll, &ws, filterExpr.get(), 2));
+
+            // The first result means the whole collection, which is one round's worth, is
+            // buffered.
+            WorkingSetID id = WorkingSet::INVALID_ID;
+            while (PlanStage::ADVANCED != scan->work(&id)) { }
+            int count = 1;
+
+            // Delete foo == 20, and make foo == 30 stop matching.
+            scan->saveState();
+            scan->invalidate(locs[20], INVALIDATION_DELETION);
+            remove(coll->docFor(&_txn, locs[20]));
+            scan->invalidate(locs[30], INVALIDATION_MUTATION);
+            DBDirectClient client(&_txn);
+            client.update(ns(), BSON("foo" << 30), BSON("$set" << BSON("foo" << 100)));
+            scan->restoreState(&_txn);
+
+            while (!scan->isEOF()) {
+                PlanStage::StageState state = scan->work(&id);
+                if (PlanStage::ADVANCED != state) { continue; }
+
+                int foo = ws.get(id)->obj["foo"].numberInt();
+                ASSERT_NOT_EQUALS(20, foo);
+                ASSERT_LESS_THAN(foo, 40);
+                ++count;
+            }
+            ctx.commit();
+
+            // foo < 40, less the deleted and the modified document.
+            ASSERT_EQUALS(38, count);
+        }
+    };
+
+    //
+    // A batched executor returns the same results as a plain one, in both directions.
+    //
+    class QueryStageCollscanBatchedMatchesPlain : public QueryStageCollectionScanBase {
+    public:
+        void run() {
+            BSONObj filters[] = { BSONObj(), BSON("foo" << GTE << 10), BSON("foo" << 1000) };
+            for (size_t i = 0; i < sizeof(filters) / sizeof(filters[0]); ++i) {
+                ASSERT_EQUALS(countResults(CollectionScanParams::FORWARD, filters[i], false),
+                              countResults(CollectionScanParams::FORWARD, filters[i], true));
+                ASSERT_EQUALS(countResults(CollectionScanParams::BACKWARD, filters[i], false),
+                              countResults(CollectionScanParams::BACKWARD, filters[i], true));
+            }
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "QueryStageCollectionScan" ) {}
@@ -379,6 +554,10 @@ namespace QueryStageCollectionScan {
             add<QueryStageCollscanObjectsInOrderBackward>();
             add<QueryStageCollscanInvalidateUpcomingObject>();
             add<QueryStageCollscanInvalidateUpcomingObjectBackward>();
+            add<QueryStageCollscanBatchedInvalidate>();
+            add<QueryStageCollscanBatchedMatchesPlain>();
+            add<QueryStageCollscanParallel>();
+            add<QueryStageCollscanParallelInvalidate>();
         }
     } all;
 
@@ -32,6 +32,7 @@
 #include "mongo/db/exec/distinct_scan.h"
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/json.h"
+#include "mongo/db/matcher/expression_parser.h"
 #include "mongo/db/operation_context_impl.h"
 #include "mongo/db/query/index_bounds_builder.h"
 #include "mongo/db/query/plan_executor.h"
@@ -234,6 +235,74 @@ namespace QueryStageDistinct {
         }
     };
 
+    // Tests distinct over a non-leading field of a compound index, with a filter on another
+    // field of the index key.
+    class QueryStageDistinctCompoundFilter : public DistinctBase {
+    public:
+        virtual ~QueryStageDistinctCompoundFilter() { }
+
+        void run() {
+            // Every (a, b) pair has c in [0, 10), except when a is 0, where c is in [0, 5).
+            for (int a = 0; a < 5; ++a) {
+                for (int b = 0; b < 3; ++b) {
+                    for (int c = 0; c < (0 == a ? 5 : 10); ++c) {
+                        insert(BSON("a" << a << "b" << b << "c" << c));
+                    }
+                }
+            }
+
+            addIndex(BSON("a" << 1 << "b" << 1 << "c" << 1));
+
+            Client::ReadContext ctx(&_txn, ns());
+
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(BSON("c" << 7));
+            verify(swme.isOK());
+            auto_ptr<MatchExpression> filterExpr(swme.getValue());
+
+            DistinctParams params;
+            params.descriptor = getIndex(BSON("a" << 1 << "b" << 1 << "c" << 1));
+            verify(params.descriptor);
+            params.direction = 1;
+            // Distinct-ing over the 1-st field of the keypattern.
+            params.fieldNo = 1;
+            params.filter = filterExpr.get();
+            params.bounds.isSimpleRange = false;
+            const char* fields[] = { "a", "b", "c" };
+            for (size_t i = 0; i < 3; ++i) {
+                OrderedIntervalList oil(fields[i]);
+                oil.intervals.push_back(IndexBoundsBuilder::allValues());
+                params.bounds.fields.push_back(oil);
+            }
+
+            WorkingSet ws;
+            scoped_ptr<DistinctScan> distinct(new DistinctScan(&_txn, params, &ws));
+
+            // One result per (a, b) pair that has c == 7.
+            std::set<int> seen;
+            int numResults = 0;
+            WorkingSetID wsid;
+            PlanStage::StageState state;
+            while (PlanStage::IS_EOF != (state = distinct->work(&wsid))) {
+                if (PlanStage::ADVANCED == state) {
+                    ASSERT_EQUALS(7, getIntFieldDotted(ws, wsid, "c"));
+                    ASSERT_NOT_EQUALS(0, getIntFieldDotted(ws, wsid, "a"));
+                    seen.insert(getIntFieldDotted(ws, wsid, "b"));
+                    ++numResults;
+                }
+            }
+
+            ASSERT_EQUALS(12, numResults);
+            ASSERT_EQUALS(3U, seen.size());
+
+            // Each pair is skipped past once a key passes the filter, so the keys with c > 7 are
+            // never examined.
+            const DistinctScanStats* stats =
+                static_cast<const DistinctScanStats*>(distinct->getSpecificStats());
+            ASSERT_LESS_THAN(stats->keysExamined, static_cast<size_t>(3 * 5 + 12 * 10));
+            ASSERT_EQUALS(stats->matchTested, static_cast<size_t>(3 * 5 + 12 * 8));
+        }
+    };
+
     // XXX: add a test case with bounds where skipping to the next key gets us a result that's not
     // valid w.r.t. our query.
 
@@ -244,6 +313,7 @@ namespace QueryStageDistinct {
         void setupTests() {
             add<QueryStageDistinctBasic>();
             add<QueryStageDistinctMultiKey>();
+            add<QueryStageDistinctCompoundFilter>();
         }
     }  queryStageDistinctAll;
 
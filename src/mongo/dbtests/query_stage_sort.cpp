@@ -384,6 +384,147 @@ namespace QueryStageSortTests {
         }
     };
 
+    // Sort more data than fits in memory.  The sort stage spills to disk only if it is allowed
+    // to.
+    template<bool allowDiskUse>
+    class QueryStageSortSpill : public QueryStageSortTestBase {
+    public:
+        virtual int numObj() { return 400; }
+
+        void run() {
+            Client::WriteContext ctx(&_txn, ns());
+
+            Database* db = ctx.ctx().db();
+            Collection* coll = db->getCollection(&_txn, ns());
+            if (!coll) {
+                coll = db->createCollection(&_txn, ns());
+            }
+
+            WorkingSet* ws = new WorkingSet();
+            MockStage* ms = new MockStage(ws);
+
+            // 400 documents of 100KB each add up to more than the sort stage's memory limit.
+            const string padding(100 * 1024, 'x');
+            for (int i = 0; i < numObj(); ++i) {
+                WorkingSetMember member;
+                member.state = WorkingSetMember::OWNED_OBJ;
+                member.obj = BSON("foo" << (i * 7) % numObj() << "padding" << padding);
+                ms->pushBack(member);
+            }
+
+            SortStageParams params;
+            params.collection = coll;
+            params.pattern = BSON("foo" << 1);
+            params.limit = 0;
+            params.allowDiskUse = allowDiskUse;
+
+            SortStage* sort = new SortStage(&_txn, params, ws, ms);
+            PlanExecutor runner(ws, sort, coll);
+
+            BSONObj obj;
+            int count = 0;
+            PlanExecutor::ExecState state;
+            while (PlanExecutor::ADVANCED == (state = runner.getNext(&obj, NULL))) {
+                ASSERT_EQUALS(count, obj["foo"].numberInt());
+                ++count;
+            }
+
+            const SortStats* stats = static_cast<const SortStats*>(sort->getSpecificStats());
+            if (allowDiskUse) {
+                ASSERT_EQUALS(PlanExecutor::IS_EOF, state);
+                ASSERT_EQUALS(numObj(), count);
+                ASSERT_TRUE(stats->usedDisk);
+            }
+            else {
+                ASSERT_EQUALS(PlanExecutor::EXEC_ERROR, state);
+                ASSERT_EQUALS(0, count);
+                ASSERT_FALSE(stats->usedDisk);
+            }
+            ctx.commit();
+        }
+    };
+
+    // A result spilled to disk loses its DiskLoc if the DiskLoc is invalidated, even when a newer
+    // result with the same DiskLoc is spilled afterwards.  The newer result keeps it.
+    class QueryStageSortSpillInvalidationLocReuse : public QueryStageSortTestBase {
+    public:
+        virtual int numObj() { return 400; }
+
+        void run() {
+            Client::WriteContext ctx(&_txn, ns());
+
+            Database* db = ctx.ctx().db();
+            Collection* coll = db->getCollection(&_txn, ns());
+            if (!coll) {
+                coll = db->createCollection(&_txn, ns());
+            }
+
+            WorkingSet ws;
+            MockStage* ms = new MockStage(&ws);
+
+            const string padding(100 * 1024, 'x');
+            for (int i = 0; i < numObj(); ++i) {
+                WorkingSetMember member;
+                member.state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+                member.loc = DiskLoc(0, (i + 1) * 16);
+                member.obj = BSON("foo" << i << "padding" << padding);
+                ms->pushBack(member);
+            }
+
+            SortStageParams params;
+            params.collection = coll;
+            params.pattern = BSON("foo" << 1);
+            params.limit = 0;
+            params.allowDiskUse = true;
+            auto_ptr<SortStage> ss(new SortStage(&_txn, params, &ws, ms));
+
+            while (!ms->isEOF()) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                ASSERT_EQUALS(PlanStage::NEED_TIME, ss->work(&id));
+            }
+            const SortStats* stats = static_cast<const SortStats*>(ss->getSpecificStats());
+            ASSERT_TRUE(stats->usedDisk);
+
+            // Invalidate the DiskLoc of {foo: 0}, then reuse it for a new document.
+            const DiskLoc reused(0, 16);
+            ss->saveState();
+            ss->invalidate(reused, INVALIDATION_DELETION);
+            ss->restoreState(&_txn);
+
+            WorkingSetMember member;
+            member.state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+            member.loc = reused;
+            member.obj = BSON("foo" << -1);
+            ms->pushBack(member);
+
+            int count = 0;
+            while (!ss->isEOF()) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                PlanStage::StageState status = ss->work(&id);
+                if (PlanStage::ADVANCED != status) {
+                    ASSERT_EQUALS(PlanStage::NEED_TIME, status);
+                    continue;
+                }
+
+                WorkingSetMember* out = ws.get(id);
+                const int foo = out->obj["foo"].numberInt();
+                ASSERT_EQUALS(count - 1, foo);
+                if (0 == foo) {
+                    ASSERT_FALSE(out->hasLoc());
+                }
+                else {
+                    ASSERT_TRUE(out->hasLoc());
+                    ASSERT_EQUALS(-1 == foo ? reused : DiskLoc(0, (foo + 1) * 16), out->loc);
+                }
+                ws.free(id);
+                ++count;
+            }
+            ASSERT_EQUALS(numObj() + 1, count);
+            ASSERT_EQUALS(1U, stats->forcedFetches);
+            ctx.commit();
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "query_stage_sort_test" ) { }
@@ -400,6 +541,9 @@ namespace QueryStageSortTests {
             add<QueryStageSortInvalidationWithLimit<10> >();
             add<QueryStageSortInvalidationWithLimit<1> >();
             add<QueryStageSortParallelArrays>();
+            add<QueryStageSortSpill<true> >();
+            add<QueryStageSortSpill<false> >();
+            add<QueryStageSortSpillInvalidationLocReuse>();
         }
     }  queryStageSortTest;
 
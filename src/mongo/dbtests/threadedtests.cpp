@@ -37,8 +37,13 @@
 
 #include "mongo/db/concurrency/d_concurrency.h"
 #include "mongo/db/concurrency/lock_state.h"
+#include "mongo/db/concurrency/write_conflict_exception.h"
 #include "mongo/db/dbdirectclient.h"
 #include "mongo/db/operation_context_impl.h"
+#include "mongo/db/operation_context_noop.h"
+#include "mongo/db/storage/heap1/heap1_btree_impl.h"
+#include "mongo/db/storage/heap1/heap1_recovery_unit.h"
+#include "mongo/db/storage/heap1/record_store_heap.h"
 #include "mongo/dbtests/dbtests.h"
 #include "mongo/platform/atomic_word.h"
 #include "mongo/platform/bits.h"
@@ -890,6 +895,94 @@ namespace ThreadedTests {
 
     };
 
+    /**
+     * Several writers increment the same heap1 document, each reading it and then writing the
+     * next value and its index key the way an update does.  A write based on a version that
+     * another writer replaced in the meantime must fail with a WriteConflictException instead of
+     * losing that writer's increment.  perftests.cpp times concurrent heap1 writers.
+     */
+    class Heap1ConcurrentUpdates {
+        // OperationContextNoop has no Locker, which would leave the documents unlocked.
+        class LockingOperationContext : public OperationContextNoop {
+        public:
+            LockingOperationContext() : OperationContextNoop(new Heap1RecoveryUnit()) {}
+
+            virtual Locker* lockState() const { return &_locker; }
+
+        private:
+            mutable LockState _locker;
+        };
+
+        static const int NumThreads = 4;
+        static const int N = 500; // increments per writer
+
+    public:
+        void run() {
+            HeapRecordStore rs("unittests.heap1_concurrent_updates");
+            boost::shared_ptr<void> indexData;
+            const Ordering ordering = Ordering::make(BSON("n" << 1));
+            scoped_ptr<SortedDataInterface> index(getHeap1BtreeImpl(ordering, &indexData));
+
+            DiskLoc loc;
+            {
+                OperationContextNoop txn(new Heap1RecoveryUnit());
+                const BSONObj doc = BSON("_id" << 0 << "n" << 0);
+                StatusWith<DiskLoc> res = rs.insertRecord(&txn, doc.objdata(), doc.objsize(),
+                                                          false);
+                ASSERT_OK(res.getStatus());
+                loc = res.getValue();
+                ASSERT_OK(index->insert(&txn, BSON("" << 0), loc, false));
+            }
+
+            boost::thread_group threads;
+            for (int i = 0; i < NumThreads; i++) {
+                threads.create_thread(stdx::bind(&Heap1ConcurrentUpdates::writer, this, &rs,
+                                                 index.get(), loc));
+            }
+            threads.join_all();
+
+            OperationContextNoop txn(new Heap1RecoveryUnit());
+            ASSERT_EQUALS(1, rs.numRecords(&txn));
+            ASSERT_EQUALS(NumThreads * N, rs.dataFor(&txn, loc).toBson()["n"].numberInt());
+
+            // The index holds the key of the last version, and nothing else.
+            long long numKeys;
+            index->fullValidate(&txn, &numKeys);
+            ASSERT_EQUALS(1, numKeys);
+            scoped_ptr<SortedDataInterface::Cursor> cursor(index->newCursor(&txn, 1));
+            ASSERT(cursor->locate(BSON("" << NumThreads * N), loc));
+        }
+
+    private:
+        void writer(HeapRecordStore* rs, SortedDataInterface* index, DiskLoc loc) {
+            LockingOperationContext txn;
+            Locker* locker = txn.lockState();
+            const newlm::ResourceId collection(newlm::RESOURCE_COLLECTION, rs->ns());
+            locker->lockGlobal(newlm::MODE_IX);
+            invariant(locker->lock(collection, newlm::MODE_IX) == newlm::LOCK_OK);
+
+            for (int i = 0; i < N;) {
+                const int n = rs->dataFor(&txn, loc).toBson()["n"].numberInt();
+                const BSONObj doc = BSON("_id" << 0 << "n" << n + 1);
+                try {
+                    WriteUnitOfWork wunit(&txn);
+                    ASSERT_OK(rs->updateRecord(&txn, loc, doc.objdata(), doc.objsize(), false,
+                                               NULL).getStatus());
+                    ASSERT(index->unindex(&txn, BSON("" << n), loc));
+                    ASSERT_OK(index->insert(&txn, BSON("" << n + 1), loc, false));
+                    wunit.commit();
+                    i++;
+                }
+                catch (const WriteConflictException&) {
+                    // Rolled back, read the new version and try again.
+                }
+            }
+
+            locker->unlock(collection);
+            locker->unlockGlobal();
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "threading" ) { }
@@ -923,6 +1016,7 @@ namespace ThreadedTests {
 
             add< MongoMutexTest >();
             add< TicketHolderWaits >();
+            add< Heap1ConcurrentUpdates >();
         }
     } myall;
 }
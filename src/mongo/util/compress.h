@@ -38,6 +38,11 @@ namespace mongo {
 
     bool uncompress(const char* compressed, size_t compressed_length, std::string* uncompressed);
 
+    /** @param uncompressed must have room for the uncompressed length of the data */
+    bool rawUncompress(const char* compressed, size_t compressed_length, char* uncompressed);
+
+    bool getUncompressedLength(const char* compressed, size_t compressed_length, size_t* result);
+
     size_t maxCompressedLength(size_t source_len);
     void rawCompress(const char* input,
         size_t input_length,
@@ -53,6 +53,9 @@ namespace mongo {
         enum Advice { Sequential=1 , Random=2 };
         MAdvise(void *p, unsigned len, Advice a);
         ~MAdvise(); // destructor resets the range to MADV_NORMAL
+
+        /** asks the OS to start reading [p, p+len) in, without waiting for it */
+        static void willNeed(void *p, unsigned len);
     private:
         void *_p;
         unsigned _len;
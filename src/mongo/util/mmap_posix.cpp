@@ -121,6 +121,7 @@ namespace mongo {
 #if defined(__sunos__)
     MAdvise::MAdvise(void *,unsigned, Advice) { }
     MAdvise::~MAdvise() { }
+    void MAdvise::willNeed(void *, unsigned) { }
 #else
     MAdvise::MAdvise(void *p, unsigned len, Advice a) {
 
@@ -147,6 +148,14 @@ namespace mongo {
     MAdvise::~MAdvise() {
         madvise(_p,_len,MADV_NORMAL);
     }
+    void MAdvise::willNeed(void *p, unsigned len) {
+        void* start = _pageAlign( p );
+        len += static_cast<unsigned>( reinterpret_cast<size_t>(p) -
+                                      reinterpret_cast<size_t>(start) );
+
+        // only a hint, nothing to do if it fails
+        madvise(start,len,MADV_WILLNEED);
+    }
 #endif
 
     void* MemoryMappedFile::map(const char *filename, unsigned long long &length, int options) {